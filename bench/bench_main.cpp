@@ -0,0 +1,332 @@
+// Schrodinger2D_bench - performance suite
+// Times the CN-ADI stages (potential kick, x-sweep, y-sweep, whole step), the
+// potential build, the diagnostics reduction, the view colorizer (GUI builds)
+// and the eigensolver on N x N grids, for each thread count, and reports
+// ns/cell, an effective bandwidth and the speedup over one thread.
+//
+// GB/s counts the minimum traffic of each kernel (every cell's psi / V / output
+// read or written once per pass); neighbour rows and line buffers that stay in
+// cache are not counted, so it is a lower bound on the real traffic.
+//
+// Usage: Schrodinger2D_bench [options] [N ...]   (default sizes 128 ... 4096)
+//   --threads 1,2,4     thread counts to run (default 1 and all cores)
+//   --json path|-       also write the results as JSON
+//   --compare base.json fail (exit 1) when a result is slower than the baseline ...
+//   --tolerance 0.15    ... by more than this fraction
+//   --eigen-max N       largest grid for the eigensolver (default 512)
+//   --min-time s        measuring time per result (default 0.2)
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "io/json.hpp"
+#include "sim/simulation.hpp"
+#include "sim/solver.hpp"
+#if BUILD_GUI
+#include "ui/field_renderer.hpp"
+#endif
+
+namespace {
+
+using cd = std::complex<double>;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::vector<int> sizes;
+    std::vector<int> threads;
+    std::string jsonPath;
+    std::string comparePath;
+    double tolerance{0.15};
+    int eigenMax{512};
+    double minTime{0.2};
+};
+
+struct Result {
+    std::string name;
+    int N{0};
+    int threads{1};
+    double nsPerCell{0.0}; // per call (per step for the stepping kernels)
+    double msPerCall{0.0};
+    double gbPerS{0.0};    // 0 when the kernel has no streaming traffic model
+    double speedup{1.0};   // vs. the same result at one thread (1 when not run)
+    int reps{0};
+};
+
+struct Timing {
+    double bestNs{0.0};
+    int reps{0};
+};
+
+// Best-of wall time after a warm-up call; repeats until minTime has passed
+// and at least minReps calls were timed.
+Timing measure(const std::function<void()>& fn, double minTime, int minReps = 3) {
+    fn();
+    Timing t;
+    t.bestNs = 1e300;
+    const auto start = Clock::now();
+    do {
+        const auto t0 = Clock::now();
+        fn();
+        const auto t1 = Clock::now();
+        t.bestNs = std::min(t.bestNs, std::chrono::duration<double, std::nano>(t1 - t0).count());
+        ++t.reps;
+    } while (t.reps < minReps || std::chrono::duration<double>(Clock::now() - start).count() < minTime);
+    return t;
+}
+
+class Suite {
+public:
+    explicit Suite(const Options& opts) : opts_(opts) {}
+
+    void add(const std::string& name, int N, int threads, double bytesPerCell, const Timing& t) {
+        const double cells = static_cast<double>(N) * N;
+        Result r;
+        r.name = name;
+        r.N = N;
+        r.threads = threads;
+        r.nsPerCell = t.bestNs / cells;
+        r.msPerCall = t.bestNs * 1e-6;
+        r.gbPerS = bytesPerCell > 0.0 ? bytesPerCell * cells / t.bestNs : 0.0;
+        r.reps = t.reps;
+        for (const Result& base : results_) {
+            if (base.name == name && base.N == N && base.threads == 1) r.speedup = base.nsPerCell / r.nsPerCell;
+        }
+        results_.push_back(r);
+        std::cout << std::left << std::setw(20) << r.name << std::right << std::setw(6) << r.N << std::setw(5)
+                  << r.threads << std::setw(12) << r.nsPerCell << std::setw(12) << r.msPerCall << std::setw(9)
+                  << r.gbPerS << std::setw(9) << r.speedup << "\n";
+    }
+
+    const std::vector<Result>& results() const { return results_; }
+    const Options& options() const { return opts_; }
+
+private:
+    const Options& opts_;
+    std::vector<Result> results_;
+};
+
+// Obstacles, a well, the CAP and a moving packet: every kernel sees a realistic V and psi.
+void setup_scene(sim::Simulation& s, int N) {
+    s.pfield.boxes.clear();
+    s.pfield.wells.clear();
+    s.pfield.boxes.push_back({0.48, 0.0, 0.52, 0.45, 200.0});
+    s.pfield.boxes.push_back({0.48, 0.55, 0.52, 1.0, 200.0});
+    sim::RadialWell well;
+    well.cx = 0.75;
+    well.cy = 0.5;
+    well.strength = -300.0;
+    well.radius = 0.08;
+    s.pfield.wells.push_back(well);
+    s.packets.clear();
+    s.packets.push_back({0.25, 0.5, 0.05, 1.0, 12.0, 0.0});
+    s.dt = 1e-4;
+    s.resize(N, N); // rebuilds V and injects the packet
+}
+
+// Single-threaded line-kernel variants, kept to compare them against the defaults
+void bench_kernel_variants(Suite& suite, sim::Simulation& s) {
+    const int N = s.Nx;
+    const double minTime = suite.options().minTime;
+    using Kernel = sim::CrankNicolsonADI::LineKernel;
+    using YSweep = sim::CrankNicolsonADI::YSweep;
+    sim::CrankNicolsonADI solver;
+    solver.ensure_workspace(N, N);
+    solver.ensure_factors(s.dx, s.dy, s.dt);
+    sim::Field psi = s.psi;
+    solver.lineKernel = Kernel::Scalar;
+    suite.add("cn_x_sweep_scalar", N, 1, 32.0, measure([&] { solver.sweep_x(psi, nullptr); }, minTime));
+    solver.ySweep = YSweep::Columns;
+    suite.add("cn_y_sweep_columns", N, 1, 32.0, measure([&] { solver.sweep_y(psi, nullptr); }, minTime));
+    solver.ySweep = YSweep::Tiled;
+    suite.add("cn_y_sweep_scalar", N, 1, 32.0, measure([&] { solver.sweep_y(psi, nullptr); }, minTime));
+
+    sim::ComplexField<float> psiF;
+    psiF.assign_from(s.psi);
+    sim::CrankNicolsonADIf solverF;
+    solverF.ensure_workspace(N, N);
+    solverF.ensure_factors(s.dx, s.dy, s.dt);
+    suite.add("cn_x_sweep_f32", N, 1, 16.0, measure([&] { solverF.sweep_x(psiF, nullptr); }, minTime));
+    suite.add("cn_y_sweep_f32", N, 1, 16.0, measure([&] { solverF.sweep_y(psiF, nullptr); }, minTime));
+}
+
+void bench_grid(Suite& suite, int N) {
+    const Options& opts = suite.options();
+    sim::Simulation s;
+    setup_scene(s, N);
+    bench_kernel_variants(suite, s);
+    suite.add("potential_build", N, 1, 16.0, measure([&] { s.pfield.build(s.V); }, opts.minTime));
+
+    for (int threads : opts.threads) {
+        s.set_threads(threads);
+        sim::ThreadPool* pool = s.pool.get();
+        s.step(); // sizes the solver for this pool, factorizes, builds the propagators
+        sim::CrankNicolsonADI& solver = s.solver;
+        suite.add("cn_kick", N, threads, 48.0,
+                  measure([&] { solver.kicks.apply(s.psi, solver.kicks.half, pool); }, opts.minTime));
+        suite.add("cn_x_sweep", N, threads, 32.0, measure([&] { solver.sweep_x(s.psi, pool); }, opts.minTime));
+        suite.add("cn_y_sweep", N, threads, 32.0, measure([&] { solver.sweep_y(s.psi, pool); }, opts.minTime));
+        suite.add("cn_step", N, threads, 160.0, measure([&] { s.step(); }, opts.minTime));
+        suite.add("diagnostics", N, threads, 16.0, measure([&] { s.update_diagnostics(true); }, opts.minTime));
+#if BUILD_GUI
+        ui::FieldRenderer renderer;
+        std::vector<unsigned char> rgba;
+        suite.add("render_rgba", N, threads, 20.0,
+                  measure([&] { renderer.render(s, rgba, true, sim::ViewMode::MagnitudePhase, true); }, opts.minTime));
+#endif
+        if (N <= opts.eigenMax) {
+            suite.add("eigen_4_modes", N, threads, 0.0,
+                      measure([&] { s.compute_eigenstates(4, 64, 4000, 1e-6); }, 0.0, 1));
+        }
+    }
+}
+
+std::vector<int> parse_list(const std::string& text) {
+    std::vector<int> out;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        const int v = std::atoi(item.c_str());
+        if (v > 0) out.push_back(v);
+    }
+    return out;
+}
+
+void write_json(std::ostream& out, const Suite& suite) {
+    out << std::setprecision(6);
+    out << "{\n  \"version\": 1,\n  \"simd\": \"" << sim::simd_level_name(sim::detect_simd_level())
+        << "\",\n  \"hardware_threads\": " << sim::ThreadPool::hardware_threads() << ",\n  \"results\": [\n";
+    const auto& results = suite.results();
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"N\": " << r.N << ", \"threads\": " << r.threads
+            << ", \"ns_per_cell\": " << r.nsPerCell << ", \"ms_per_call\": " << r.msPerCall
+            << ", \"gb_per_s\": " << r.gbPerS << ", \"speedup\": " << r.speedup << ", \"reps\": " << r.reps << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// Results slower than their baseline entry by more than the tolerance; -1 if the baseline is unreadable
+int compare_with_baseline(const Suite& suite, const std::string& path, double tolerance) {
+    std::string text;
+    if (!io::read_file(path, text)) {
+        std::cerr << "Cannot read baseline " << path << "\n";
+        return -1;
+    }
+    io::JsonValue root;
+    try {
+        root = io::JsonParser(text).parse();
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid baseline " << path << ": " << e.what() << "\n";
+        return -1;
+    }
+    const io::JsonValue* list = io::get_member(root, "results");
+    if (!list || list->type != io::JsonValue::Type::Array) {
+        std::cerr << "Baseline " << path << " has no results\n";
+        return -1;
+    }
+    int regressions = 0;
+    int compared = 0;
+    for (const io::JsonValue& item : list->array) {
+        const std::string name = io::as_string(io::get_member(item, "name"), "");
+        const int N = io::as_int(io::get_member(item, "N"), 0);
+        const int threads = io::as_int(io::get_member(item, "threads"), 0);
+        const double base = io::as_number(io::get_member(item, "ns_per_cell"), 0.0);
+        for (const Result& r : suite.results()) {
+            if (r.name != name || r.N != N || r.threads != threads || base <= 0.0) continue;
+            ++compared;
+            const double change = r.nsPerCell / base - 1.0;
+            if (change > tolerance) {
+                ++regressions;
+                std::cout << "REGRESSION " << name << " N=" << N << " threads=" << threads << ": " << base
+                          << " -> " << r.nsPerCell << " ns/cell (+" << 100.0 * change << "%)\n";
+            }
+        }
+    }
+    std::cout << "Compared " << compared << " results with " << path << ": " << regressions << " regression(s) above "
+              << 100.0 * tolerance << "%\n";
+    return regressions;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--threads" && hasValue) {
+            opts.threads = parse_list(argv[++i]);
+        } else if (arg == "--json" && hasValue) {
+            opts.jsonPath = argv[++i];
+        } else if (arg == "--compare" && hasValue) {
+            opts.comparePath = argv[++i];
+        } else if (arg == "--tolerance" && hasValue) {
+            opts.tolerance = std::atof(argv[++i]);
+        } else if (arg == "--eigen-max" && hasValue) {
+            opts.eigenMax = std::atoi(argv[++i]);
+        } else if (arg == "--min-time" && hasValue) {
+            opts.minTime = std::atof(argv[++i]);
+        } else if (arg == "-h" || arg == "--help") {
+            std::cout << "Usage: Schrodinger2D_bench [--threads 1,2,4] [--json path|-] [--compare base.json]\n"
+                         "                           [--tolerance 0.15] [--eigen-max N] [--min-time s] [N ...]\n";
+            return 0;
+        } else {
+            const int n = std::atoi(arg.c_str());
+            if (n >= 8) {
+                opts.sizes.push_back(n);
+            } else {
+                std::cerr << "Unknown argument: " << arg << "\n";
+                return 2;
+            }
+        }
+    }
+    if (opts.sizes.empty()) opts.sizes = {128, 256, 512, 1024, 2048, 4096};
+    if (opts.threads.empty()) opts.threads = {1, sim::ThreadPool::hardware_threads()};
+    // One thread first, so the other counts can report their speedup
+    opts.threads.push_back(1);
+    std::sort(opts.threads.begin(), opts.threads.end());
+    opts.threads.erase(std::unique(opts.threads.begin(), opts.threads.end()), opts.threads.end());
+
+    // With --json -, stdout carries only the JSON
+    const bool jsonToStdout = opts.jsonPath == "-";
+    std::streambuf* console = std::cout.rdbuf();
+    if (jsonToStdout) std::cout.rdbuf(std::cerr.rdbuf());
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Schrodinger2D benchmarks (simd=" << sim::simd_level_name(sim::detect_simd_level())
+              << ", hardware threads=" << sim::ThreadPool::hardware_threads() << ")\n";
+    std::cout << std::left << std::setw(20) << "name" << std::right << std::setw(6) << "N" << std::setw(5) << "thr"
+              << std::setw(12) << "ns/cell" << std::setw(12) << "ms/call" << std::setw(9) << "GB/s" << std::setw(9)
+              << "speedup" << "\n";
+    Suite suite(opts);
+    for (int n : opts.sizes) bench_grid(suite, n);
+
+    if (jsonToStdout) {
+        std::cout.rdbuf(console);
+        write_json(std::cout, suite);
+    } else if (!opts.jsonPath.empty()) {
+        std::ofstream f(opts.jsonPath);
+        write_json(f, suite);
+        if (!f) {
+            std::cerr << "Failed to write " << opts.jsonPath << "\n";
+            return 2;
+        }
+    }
+    if (!opts.comparePath.empty()) {
+        if (jsonToStdout) std::cout.rdbuf(std::cerr.rdbuf());
+        const int regressions = compare_with_baseline(suite, opts.comparePath, opts.tolerance);
+        std::cout.rdbuf(console);
+        if (regressions != 0) return 1;
+    }
+    return 0;
+}
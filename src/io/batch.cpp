@@ -0,0 +1,487 @@
+#include "batch.hpp"
+#include "json.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+
+#include "sim/thread_pool.hpp"
+
+namespace io {
+
+namespace {
+
+bool ends_with(const std::string& s, const char* suffix) {
+    const std::string suf(suffix);
+    return s.size() >= suf.size() && s.compare(s.size() - suf.size(), suf.size(), suf) == 0;
+}
+
+// Maps a JSON Lines file and records its non-blank lines.
+bool load_scene_lines(const std::string& path, SweepSpec& spec, std::string& error) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(path, &error)) return false;
+    std::string_view text = file->text();
+    spec.scenes.clear();
+    while (!text.empty()) {
+        const size_t eol = text.find('\n');
+        const std::string_view line = text.substr(0, eol);
+        text = eol == std::string_view::npos ? std::string_view() : text.substr(eol + 1);
+        if (line.find_first_not_of(" \t\r") != std::string_view::npos) spec.scenes.push_back(line);
+    }
+    if (spec.scenes.empty()) {
+        error = path + " holds no scenes";
+        return false;
+    }
+    spec.scenesFile = std::move(file);
+    return true;
+}
+
+size_t axis_job_count(const SweepSpec& spec) {
+    size_t n = 1;
+    for (const auto& axis : spec.axes) n *= axis.values.size();
+    return n;
+}
+
+} // namespace
+
+bool load_sweep_spec(const std::string& path, SweepSpec& spec, std::string& error) {
+    if (ends_with(path, ".jsonl")) {
+        spec.axes.clear();
+        return load_scene_lines(path, spec, error);
+    }
+    std::string txt;
+    if (!read_file(path, txt)) {
+        error = "cannot read " + path;
+        return false;
+    }
+    JsonValue root;
+    try {
+        root = JsonParser(txt).parse();
+    } catch (const std::exception& e) {
+        error = std::string("invalid JSON: ") + e.what();
+        return false;
+    }
+    if (root.type != JsonValue::Type::Object) {
+        error = "spec must be a JSON object";
+        return false;
+    }
+
+    const JsonValue* base = get_member(root, "base");
+    if (base && base->type == JsonValue::Type::String) {
+        std::filesystem::path scenePath(base->string);
+        if (scenePath.is_relative()) scenePath = std::filesystem::path(path).parent_path() / scenePath;
+        if (!load_scene(scenePath.string(), spec.base)) {
+            error = "failed to load base scene " + scenePath.string();
+            return false;
+        }
+    } else if (base && base->type == JsonValue::Type::Object) {
+        if (!scene_from_json(*base, spec.base)) {
+            error = "invalid inline base scene";
+            return false;
+        }
+    } else if (base) {
+        error = "\"base\" must be a scene path or object";
+        return false;
+    }
+
+    spec.scenes.clear();
+    spec.scenesFile.reset();
+    if (const JsonValue* scenes = get_member(root, "scenes"); scenes && scenes->type == JsonValue::Type::String) {
+        std::filesystem::path scenesPath(scenes->string);
+        if (scenesPath.is_relative()) scenesPath = std::filesystem::path(path).parent_path() / scenesPath;
+        if (!load_scene_lines(scenesPath.string(), spec, error)) return false;
+    } else if (scenes) {
+        error = "\"scenes\" must be a JSON Lines path";
+        return false;
+    }
+
+    spec.axes.clear();
+    if (const JsonValue* sweep = get_member(root, "sweep"); sweep && sweep->type == JsonValue::Type::Array) {
+        for (const auto& item : sweep->array) {
+            SweepAxis axis;
+            axis.param = as_string(get_member(item, "param"), "");
+            if (const JsonValue* values = get_member(item, "values"); values && values->type == JsonValue::Type::Array) {
+                for (const auto& v : values->array) {
+                    if (v.type == JsonValue::Type::Number) axis.values.push_back(v.number);
+                }
+            } else {
+                // Inclusive linear range
+                const double from = as_number(get_member(item, "from"), 0.0);
+                const double to = as_number(get_member(item, "to"), from);
+                const int count = std::max(1, as_int(get_member(item, "count"), 1));
+                for (int k = 0; k < count; ++k) {
+                    const double t = count > 1 ? double(k) / double(count - 1) : 0.0;
+                    axis.values.push_back(from + (to - from) * t);
+                }
+            }
+            // Checked against the first scene: list indices depend on it
+            Scene probe = spec.base;
+            if (!spec.scenes.empty() && !overlay_scene(spec.scenes.front(), probe, &error)) {
+                error = "scene 0: " + error;
+                return false;
+            }
+            if (axis.values.empty() || !set_scene_param(probe, axis.param, axis.values.front())) {
+                error = "invalid sweep axis \"" + axis.param + "\"";
+                return false;
+            }
+            spec.axes.push_back(std::move(axis));
+        }
+    }
+
+    spec.output = as_string(get_member(root, "output"), spec.output);
+    spec.workers = as_int(get_member(root, "workers"), spec.workers);
+    return true;
+}
+
+template <typename T>
+static bool set_member(std::vector<T>& list, size_t index, const std::string& field, double value) {
+    if (index >= list.size()) return false;
+    T& item = list[index];
+    if constexpr (std::is_same_v<T, SceneBox>) {
+        if (field == "x0") item.x0 = value;
+        else if (field == "y0") item.y0 = value;
+        else if (field == "x1") item.x1 = value;
+        else if (field == "y1") item.y1 = value;
+        else if (field == "height") item.height = value;
+        else return false;
+    } else if constexpr (std::is_same_v<T, SceneWell>) {
+        if (field == "cx") item.cx = value;
+        else if (field == "cy") item.cy = value;
+        else if (field == "strength") item.strength = value;
+        else if (field == "radius") item.radius = value;
+        else return false;
+    } else {
+        if (field == "cx") item.cx = value;
+        else if (field == "cy") item.cy = value;
+        else if (field == "sigma") item.sigma = value;
+        else if (field == "amplitude") item.amplitude = value;
+        else if (field == "kx") item.kx = value;
+        else if (field == "ky") item.ky = value;
+        else return false;
+    }
+    return true;
+}
+
+bool set_scene_param(Scene& s, const std::string& param, double value) {
+    const size_t open = param.find('[');
+    if (open != std::string::npos) {
+        // list[index].field
+        const size_t close = param.find(']', open);
+        if (close == std::string::npos || close + 1 >= param.size() || param[close + 1] != '.') return false;
+        const std::string list = param.substr(0, open);
+        const std::string digits = param.substr(open + 1, close - open - 1);
+        if (digits.empty() || !std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            return false;
+        }
+        const size_t index = static_cast<size_t>(std::stoul(digits));
+        const std::string field = param.substr(close + 2);
+        if (list == "boxes") return set_member(s.boxes, index, field, value);
+        if (list == "wells") return set_member(s.wells, index, field, value);
+        if (list == "packets") return set_member(s.packets, index, field, value);
+        return false;
+    }
+
+    const int asInt = static_cast<int>(std::llround(value));
+    if (param == "Nx") s.Nx = asInt;
+    else if (param == "Ny") s.Ny = asInt;
+    else if (param == "steps") s.steps = asInt;
+    else if (param == "dt") s.dt = value;
+    else if (param == "spatial_order") s.spatial_order = asInt;
+    else if (param == "cap_strength") s.cap_strength = value;
+    else if (param == "cap_ratio") s.cap_ratio = value;
+    else if (param == "well_cutoff") s.well_cutoff = value;
+    else if (param == "rel_mass_drift_tol") s.rel_mass_drift_tol = value;
+    else if (param == "rel_cap_mass_growth_tol") s.rel_cap_mass_growth_tol = value;
+    else if (param == "rel_interior_mass_drift_tol") s.rel_interior_mass_drift_tol = value;
+    else if (param == "interior_mass_drift_vs_total_tol") s.interior_mass_drift_vs_total_tol = value;
+    else if (param == "stability_check_every_n_steps") s.stability_check_every_n_steps = asInt;
+    else if (param == "adaptive_tol") s.adaptive_tol = value;
+    else if (param == "active_window_threshold") s.active_window_threshold = value;
+    else if (param == "active_window_margin") s.active_window_margin = asInt;
+    else return false;
+    return true;
+}
+
+size_t sweep_job_count(const SweepSpec& spec) {
+    return axis_job_count(spec) * std::max<size_t>(1, spec.scenes.size());
+}
+
+size_t sweep_job_scene(const SweepSpec& spec, size_t index) {
+    return index / axis_job_count(spec);
+}
+
+std::vector<double> sweep_job_values(const SweepSpec& spec, size_t index) {
+    index %= axis_job_count(spec);
+    std::vector<double> values(spec.axes.size());
+    for (size_t a = spec.axes.size(); a-- > 0;) {
+        const size_t n = spec.axes[a].values.size();
+        values[a] = spec.axes[a].values[index % n];
+        index /= n;
+    }
+    return values;
+}
+
+namespace {
+
+// Job indices split into one contiguous block per worker. A worker takes
+// jobs from the front of its own block and, once that is empty, steals from
+// the back of the others, so uneven job costs (grid sizes, early unstable
+// exits) still balance out.
+class WorkStealingQueue {
+public:
+    WorkStealingQueue(size_t jobs, int workers) : lanes_(static_cast<size_t>(std::max(1, workers))) {
+        const size_t n = lanes_.size();
+        for (size_t w = 0; w < n; ++w) {
+            const size_t begin = jobs * w / n;
+            const size_t end = jobs * (w + 1) / n;
+            for (size_t j = begin; j < end; ++j) lanes_[w].jobs.push_back(j);
+        }
+    }
+
+    bool pop(int worker, size_t& job) {
+        const size_t n = lanes_.size();
+        const size_t self = static_cast<size_t>(worker);
+        {
+            Lane& own = lanes_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty()) {
+                job = own.jobs.front();
+                own.jobs.pop_front();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < n; ++k) {
+            Lane& victim = lanes_[(self + k) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.back();
+                victim.jobs.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Lane {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+    std::vector<Lane> lanes_;
+};
+
+struct JobResult {
+    size_t job{0};
+    size_t scene{0}; // line of spec.scenes
+    std::vector<double> values;
+    int steps{0};
+    double time{0.0};
+    double dtMin{0.0}, dtMax{0.0}; // smallest and largest step taken (dt without adaptive dt)
+    double mass{0.0};
+    double left{0.0};
+    double right{0.0};
+    double interior{0.0};
+    double drift{0.0};
+    const char* stability{"OK"};
+    std::string reason;
+    double wallMs{0.0};
+};
+
+std::string json_escape(const std::string& in) {
+    std::string out;
+    for (char c : in) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+// Serializes results as they arrive; every row is flushed so partial sweeps
+// are usable while the batch is still running.
+class ResultWriter {
+public:
+    ResultWriter(std::ostream& out, BatchFormat format, const SweepSpec& spec)
+        : out_(out), format_(format), spec_(spec) {
+        out_ << std::setprecision(10);
+        if (format_ == BatchFormat::Csv) {
+            out_ << "job";
+            if (!spec_.scenes.empty()) out_ << ",scene";
+            for (const auto& axis : spec_.axes) out_ << "," << axis.param;
+            out_ << ",steps,time,dt_min,dt_max,mass,left,right,interior,drift,stability,reason,wall_ms\n";
+            out_.flush();
+        }
+    }
+
+    void write(const JobResult& r) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (format_ == BatchFormat::Csv) {
+            out_ << r.job;
+            if (!spec_.scenes.empty()) out_ << "," << r.scene;
+            for (double v : r.values) out_ << "," << v;
+            std::string reason = r.reason;
+            std::replace(reason.begin(), reason.end(), '"', '\'');
+            out_ << "," << r.steps << "," << r.time << "," << r.dtMin << "," << r.dtMax << "," << r.mass << "," << r.left << "," << r.right << "," << r.interior
+                 << "," << r.drift << "," << r.stability << ",\"" << reason << "\"," << r.wallMs << "\n";
+        } else {
+            out_ << "{\"job\": " << r.job;
+            if (!spec_.scenes.empty()) out_ << ", \"scene\": " << r.scene;
+            out_ << ", \"params\": {";
+            for (size_t a = 0; a < r.values.size(); ++a) {
+                out_ << (a ? ", " : "") << "\"" << json_escape(spec_.axes[a].param) << "\": " << r.values[a];
+            }
+            out_ << "}, \"steps\": " << r.steps << ", \"time\": " << r.time << ", \"dt_min\": " << r.dtMin
+                 << ", \"dt_max\": " << r.dtMax << ", \"mass\": " << r.mass << ", \"left\": " << r.left
+                 << ", \"right\": " << r.right << ", \"interior\": " << r.interior << ", \"drift\": " << r.drift
+                 << ", \"stability\": \"" << r.stability << "\", \"reason\": \"" << json_escape(r.reason)
+                 << "\", \"wall_ms\": " << r.wallMs << "}\n";
+        }
+        out_.flush();
+    }
+
+private:
+    std::ostream& out_;
+    BatchFormat format_;
+    const SweepSpec& spec_;
+    std::mutex mutex_;
+};
+
+// Runs one job on a worker's reusable simulation. Steps advance in blocks of
+// the scene's check cadence (fused kicks inside a block) and stop early once
+// the run is flagged unstable. A scene line that does not parse, or that an
+// axis does not apply to, gives an INVALID row without running.
+JobResult run_job(const SweepSpec& spec, size_t job, sim::Simulation& simulation) {
+    const auto t0 = std::chrono::steady_clock::now();
+    JobResult r;
+    r.job = job;
+    r.values = sweep_job_values(spec, job);
+    auto invalid = [&](std::string reason) {
+        r.stability = "INVALID";
+        r.reason = std::move(reason);
+        r.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        return r;
+    };
+
+    Scene s = spec.base;
+    if (!spec.scenes.empty()) {
+        r.scene = sweep_job_scene(spec, job);
+        std::string error;
+        if (!overlay_scene(spec.scenes[r.scene], s, &error)) return invalid("scene " + std::to_string(r.scene) + ": " + error);
+    }
+    for (size_t a = 0; a < spec.axes.size(); ++a) {
+        if (!set_scene_param(s, spec.axes[a].param, r.values[a])) return invalid(spec.axes[a].param + " does not apply");
+    }
+    to_simulation(s, simulation);
+
+    if (simulation.adaptive.enabled) {
+        // Same end time as the fixed-step sweep, in as few steps as the tolerance allows
+        simulation.advance_to(s.steps * s.dt);
+        r.steps = static_cast<int>(simulation.stepCount);
+        r.dtMin = simulation.stepper.stats.minDt;
+        r.dtMax = simulation.stepper.stats.maxDt;
+    } else {
+        const int block = std::max(1, simulation.stability.check_every_n_steps);
+        while (r.steps < s.steps && !simulation.diagnostics.unstable) {
+            const int n = std::min(block, s.steps - r.steps);
+            simulation.stepN(n);
+            r.steps += n;
+        }
+        r.dtMin = r.dtMax = simulation.dt;
+    }
+    simulation.sync_diagnostics();
+    r.time = simulation.time;
+
+    const auto& diag = simulation.diagnostics;
+    r.mass = diag.current_mass;
+    r.left = diag.left_mass;
+    r.right = diag.right_mass;
+    r.interior = diag.current_interior_mass;
+    r.drift = diag.rel_mass_drift;
+    if (diag.unstable) {
+        r.stability = "UNSTABLE";
+        r.reason = diag.reason;
+    } else if (diag.warning) {
+        r.stability = "WARNING";
+        r.reason = diag.warning_reason;
+    }
+    r.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return r;
+}
+
+} // namespace
+
+int run_batch_cli(const std::string& spec_path, const BatchOptions& opts) {
+    SweepSpec spec;
+    std::string error;
+    if (!load_sweep_spec(spec_path, spec, error)) {
+        std::cerr << "Failed to load sweep spec " << spec_path << ": " << error << "\n";
+        return 2;
+    }
+    if (!opts.output.empty()) spec.output = opts.output;
+    if (opts.workers >= 0) spec.workers = opts.workers;
+
+    const size_t jobs = sweep_job_count(spec);
+    int workers = spec.workers > 0 ? spec.workers : sim::ThreadPool::hardware_threads();
+    workers = static_cast<int>(std::max<size_t>(1, std::min<size_t>(static_cast<size_t>(workers), jobs)));
+
+    const BatchFormat format = (ends_with(spec.output, ".jsonl") || ends_with(spec.output, ".json"))
+                                   ? BatchFormat::JsonLines : BatchFormat::Csv;
+    std::ofstream file;
+    if (spec.output != "-") {
+        file.open(spec.output);
+        if (!file) {
+            std::cerr << "Failed to open batch output " << spec.output << "\n";
+            return 2;
+        }
+    }
+    std::ostream& out = spec.output == "-" ? std::cout : file;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    ResultWriter writer(out, format, spec);
+    WorkStealingQueue queue(jobs, workers);
+    std::atomic<int> unstable{0};
+    std::atomic<int> invalid{0};
+
+    // Independent simulations run one per worker; each simulation steps serially.
+    auto work = [&](int worker) {
+        sim::Simulation simulation;
+        simulation.set_threads(1);
+        size_t job = 0;
+        while (queue.pop(worker, job)) {
+            const JobResult r = run_job(spec, job, simulation);
+            if (r.stability[0] == 'U') ++unstable;
+            if (r.stability[0] == 'I') ++invalid;
+            writer.write(r);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int w = 1; w < workers; ++w) threads.emplace_back(work, w);
+    work(0);
+    for (auto& t : threads) t.join();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cerr << "Batch: " << jobs << " job(s) on " << workers << " worker(s) in " << seconds << " s, "
+              << unstable.load() << " unstable";
+    if (invalid.load() > 0) std::cerr << ", " << invalid.load() << " invalid";
+    std::cerr << "\n";
+    return 0;
+}
+
+} // namespace io
@@ -0,0 +1,71 @@
+// Headless parameter sweeps: many independent scene variants across cores
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "scene.hpp"
+
+namespace io {
+
+// One swept parameter. Paths name a Scene field ("cap_strength", "dt",
+// "steps", ...) or a member of a listed object ("boxes[0].height",
+// "packets[1].kx", "wells[0].radius").
+struct SweepAxis {
+    std::string param;
+    std::vector<double> values;
+};
+
+// Sweep spec (JSON):
+//   {
+//     "base": "scene.json" | { ...inline scene... },
+//     "scenes": "lattice.jsonl", // optional: one scene per line, each over base
+//     "sweep": [ {"param": "boxes[0].height", "values": [50, 100, 200]},
+//                {"param": "packets[0].kx", "from": 8, "to": 16, "count": 5} ],
+//     "output": "results.csv",   // or .jsonl; "-" = stdout
+//     "workers": 0               // 0 = all cores
+//   }
+// Jobs are the Cartesian product of the scenes (or just base) and the axes,
+// the last axis varying fastest. A scene line sets only the fields and object
+// lists it names (overlay_scene). A spec path ending in .jsonl is read as a
+// scenes file with no axes.
+struct SweepSpec {
+    Scene base;
+    // Lines of the memory-mapped scenes file; each is parsed by the worker
+    // that runs its job, so loading the spec does not parse the scenes.
+    std::shared_ptr<const MappedFile> scenesFile;
+    std::vector<std::string_view> scenes;
+    std::vector<SweepAxis> axes;
+    std::string output{"-"};
+    int workers{0};
+};
+
+enum class BatchFormat { Csv, JsonLines };
+
+// Relative "base" paths are resolved against the spec's directory.
+bool load_sweep_spec(const std::string& path, SweepSpec& spec, std::string& error);
+
+// Applies `value` to the field named by `param`; false if the path is unknown
+// or out of range.
+bool set_scene_param(Scene& s, const std::string& param, double value);
+
+// Number of jobs, and the scene line and parameter values of job `index`.
+size_t sweep_job_count(const SweepSpec& spec);
+size_t sweep_job_scene(const SweepSpec& spec, size_t index); // 0 without scenes
+std::vector<double> sweep_job_values(const SweepSpec& spec, size_t index);
+
+struct BatchOptions {
+    std::string output;  // overrides spec.output when non-empty
+    int workers{-1};     // overrides spec.workers when >= 0
+};
+
+// Runs every job of the spec and streams one result row per job, in completion
+// order, to the output (CSV if it ends in .csv or is stdout, JSON Lines for
+// .jsonl/.json). Each worker reuses one sim::Simulation for all of its jobs.
+// Returns 0 when all jobs ran (whatever their stability), non-zero on setup errors.
+int run_batch_cli(const std::string& spec_path, const BatchOptions& opts = {});
+
+} // namespace io
@@ -0,0 +1,404 @@
+#include "checkpoint.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#ifndef S2D_HAVE_ZLIB
+#define S2D_HAVE_ZLIB 0
+#endif
+#if S2D_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace io {
+
+namespace {
+
+constexpr std::uint64_t kPayloadAlignment = 64;
+
+bool fail(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+bool little_endian() {
+    const std::uint32_t probe = 1;
+    unsigned char first = 0;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Version 1 layout: no time, and dt was the step size at the time of the save
+struct CheckpointHeaderV1 {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::int32_t Nx;
+    std::int32_t Ny;
+    double Lx;
+    double Ly;
+    double dt;
+    std::uint64_t stepCount;
+    double initialMass;
+    double initialInteriorMass;
+    double initialInteriorMassFraction;
+    std::int32_t stepsSinceBaseline;
+    std::int32_t reserved0;
+    std::uint64_t sceneOffset;
+    std::uint64_t sceneBytes;
+    std::uint64_t psiOffset;
+    std::uint64_t psiBytes;
+    std::uint64_t psiRawBytes;
+};
+static_assert(sizeof(CheckpointHeaderV1) == 128, "checkpoint v1 header layout");
+
+CheckpointHeader upgrade(const CheckpointHeaderV1& v1) {
+    CheckpointHeader h{};
+    std::memcpy(h.magic, v1.magic, sizeof(h.magic));
+    h.version = v1.version;
+    h.flags = v1.flags;
+    h.Nx = v1.Nx;
+    h.Ny = v1.Ny;
+    h.Lx = v1.Lx;
+    h.Ly = v1.Ly;
+    h.dt = v1.dt;
+    h.stepCount = v1.stepCount;
+    h.time = static_cast<double>(v1.stepCount) * v1.dt; // exact for fixed-step runs only
+    h.stepDt = v1.dt;
+    h.initialMass = v1.initialMass;
+    h.initialInteriorMass = v1.initialInteriorMass;
+    h.initialInteriorMassFraction = v1.initialInteriorMassFraction;
+    h.stepsSinceBaseline = v1.stepsSinceBaseline;
+    h.sceneOffset = v1.sceneOffset;
+    h.sceneBytes = v1.sceneBytes;
+    h.psiOffset = v1.psiOffset;
+    h.psiBytes = v1.psiBytes;
+    h.psiRawBytes = v1.psiRawBytes;
+    return h;
+}
+
+std::uint64_t align_up(std::uint64_t v) {
+    return (v + kPayloadAlignment - 1) / kPayloadAlignment * kPayloadAlignment;
+}
+
+// Header and scene text for sim; psi offsets/sizes are filled in by the writer.
+void describe(const sim::Simulation& sim, CheckpointHeader& h, std::string& scene) {
+    Scene s;
+    from_simulation(sim, s);
+    std::ostringstream ss;
+    write_scene(ss, s);
+    scene = ss.str();
+
+    h = CheckpointHeader{};
+    std::memcpy(h.magic, kCheckpointMagic, sizeof(h.magic));
+    h.version = kCheckpointVersion;
+    h.Nx = sim.Nx;
+    h.Ny = sim.Ny;
+    h.Lx = sim.Lx;
+    h.Ly = sim.Ly;
+    h.dt = s.dt;
+    h.stepCount = sim.stepCount;
+    h.time = sim.time;
+    h.stepDt = sim.dt;
+    h.initialMass = sim.diagnostics.initial_mass;
+    h.initialInteriorMass = sim.diagnostics.initial_interior_mass;
+    h.initialInteriorMassFraction = sim.diagnostics.initial_interior_mass_fraction;
+    h.stepsSinceBaseline = sim.diagnostics.steps_since_baseline;
+}
+
+#if S2D_HAVE_ZLIB
+// Byte planes of n doubles: out[b * n + k] = byte b of v[k]. Neighbouring
+// amplitudes share sign/exponent bytes, which deflate then compresses well.
+// Float input (the resident float state) is widened on the fly.
+template <typename T>
+void shuffle(const T* v, size_t n, unsigned char* out) {
+    for (size_t k = 0; k < n; ++k) {
+        const double d = static_cast<double>(v[k]);
+        unsigned char in[sizeof(double)];
+        std::memcpy(in, &d, sizeof(d));
+        for (size_t b = 0; b < sizeof(double); ++b) out[b * n + k] = in[b];
+    }
+}
+
+void unshuffle(const unsigned char* in, size_t n, double* v) {
+    unsigned char* out = reinterpret_cast<unsigned char*>(v);
+    for (size_t k = 0; k < n; ++k) {
+        for (size_t b = 0; b < sizeof(double); ++b) out[k * sizeof(double) + b] = in[b * n + k];
+    }
+}
+#endif
+
+// n values as doubles: double arrays directly, float ones widened a chunk at a time
+bool write_doubles(std::FILE* f, const double* v, size_t n) {
+    return std::fwrite(v, sizeof(double), n, f) == n;
+}
+
+bool write_doubles(std::FILE* f, const float* v, size_t n) {
+    double chunk[4096];
+    for (size_t k0 = 0; k0 < n; k0 += std::size(chunk)) {
+        const size_t m = std::min(n - k0, std::size(chunk));
+        for (size_t k = 0; k < m; ++k) chunk[k] = v[k0 + k];
+        if (std::fwrite(chunk, sizeof(double), m, f) != m) return false;
+    }
+    return true;
+}
+
+template <typename T>
+bool write_file(const std::string& path, CheckpointHeader h, const std::string& scene,
+                const T* re, const T* im, bool compress, std::string* error) {
+    if (!little_endian()) return fail(error, "checkpoints require a little-endian host");
+    const size_t n = static_cast<size_t>(h.Nx) * static_cast<size_t>(h.Ny);
+    const size_t arrayBytes = n * sizeof(double);
+    h.sceneOffset = sizeof(CheckpointHeader);
+    h.sceneBytes = scene.size();
+    h.psiOffset = align_up(h.sceneOffset + h.sceneBytes);
+    h.psiRawBytes = 2 * arrayBytes;
+
+    std::vector<unsigned char> packed;
+#if S2D_HAVE_ZLIB
+    if (compress) {
+        std::vector<unsigned char> planes(2 * arrayBytes);
+        shuffle(re, n, planes.data());
+        shuffle(im, n, planes.data() + arrayBytes);
+        uLongf packedBytes = compressBound(static_cast<uLong>(planes.size()));
+        packed.resize(packedBytes);
+        if (compress2(packed.data(), &packedBytes, planes.data(), static_cast<uLong>(planes.size()), Z_BEST_SPEED) != Z_OK) {
+            return fail(error, "deflate failed");
+        }
+        packed.resize(packedBytes);
+        h.flags |= kCheckpointCompressed;
+    }
+#else
+    (void)compress;
+#endif
+    h.psiBytes = (h.flags & kCheckpointCompressed) ? packed.size() : h.psiRawBytes;
+
+    // Written to a temporary name and renamed, so a crash mid-write never
+    // clobbers the previous checkpoint. rename() replaces path atomically on
+    // POSIX; Windows refuses to rename onto an existing file.
+    const std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return fail(error, "cannot open " + tmp);
+    std::vector<char> buffer(1 << 20);
+    std::setvbuf(f, buffer.data(), _IOFBF, buffer.size());
+    const char zeros[kPayloadAlignment] = {};
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = ok && std::fwrite(scene.data(), 1, scene.size(), f) == scene.size();
+    const size_t pad = static_cast<size_t>(h.psiOffset - h.sceneOffset - h.sceneBytes);
+    ok = ok && std::fwrite(zeros, 1, pad, f) == pad;
+    if (h.flags & kCheckpointCompressed) {
+        ok = ok && std::fwrite(packed.data(), 1, packed.size(), f) == packed.size();
+    } else {
+        ok = ok && write_doubles(f, re, n);
+        ok = ok && write_doubles(f, im, n);
+    }
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        return fail(error, "write failed: " + tmp);
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) return fail(error, "cannot rename " + tmp + " to " + path);
+    return true;
+}
+
+} // namespace
+
+bool checkpoint_compression_available() {
+    return S2D_HAVE_ZLIB != 0;
+}
+
+bool save_checkpoint(const std::string& path, const sim::Simulation& sim, bool compress, std::string* error) {
+    CheckpointHeader h;
+    std::string scene;
+    describe(sim, h, scene);
+    if (sim.float_ahead()) {
+        // After float steps the current state is psiF; psi has not caught up
+        return write_file(path, h, scene, sim.psiF.re.data(), sim.psiF.im.data(), compress, error);
+    }
+    return write_file(path, h, scene, sim.psi.re.data(), sim.psi.im.data(), compress, error);
+}
+
+// ---- reading ----
+
+CheckpointView::CheckpointView() = default;
+CheckpointView::~CheckpointView() = default;
+
+bool CheckpointView::open(const std::string& path, std::string* error) {
+    if (!little_endian()) return fail(error, "checkpoints require a little-endian host");
+    auto map = std::make_unique<MappedFile>();
+    if (!map->open(path, error)) return false;
+    if (map->size() < sizeof(CheckpointHeaderV1)) return fail(error, "not a checkpoint: " + path);
+
+    CheckpointHeaderV1 v1;
+    std::memcpy(&v1, map->data(), sizeof(v1));
+    if (std::memcmp(v1.magic, kCheckpointMagic, sizeof(v1.magic)) != 0) return fail(error, "not a checkpoint: " + path);
+    CheckpointHeader h;
+    if (v1.version == 1) {
+        h = upgrade(v1);
+    } else if (v1.version == kCheckpointVersion) {
+        if (map->size() < sizeof(CheckpointHeader)) return fail(error, "not a checkpoint: " + path);
+        std::memcpy(&h, map->data(), sizeof(h));
+    } else {
+        return fail(error, "unsupported checkpoint version");
+    }
+    const std::uint64_t cells = static_cast<std::uint64_t>(std::max(0, h.Nx)) * static_cast<std::uint64_t>(std::max(0, h.Ny));
+    // Each range is checked against the bytes left after its offset, so corrupt
+    // offsets cannot wrap around; re() casts the payload to double, hence the alignment.
+    const std::uint64_t size = map->size();
+    if (h.Nx <= 0 || h.Ny <= 0 || cells > UINT64_MAX / (2 * sizeof(double)) ||
+        h.psiRawBytes != 2 * cells * sizeof(double) ||
+        h.sceneOffset > size || h.sceneBytes > size - h.sceneOffset ||
+        h.psiOffset > size || h.psiBytes > size - h.psiOffset || h.psiOffset % alignof(double) != 0 ||
+        (!(h.flags & kCheckpointCompressed) && h.psiBytes != h.psiRawBytes)) {
+        return fail(error, "truncated or inconsistent checkpoint: " + path);
+    }
+    header_ = h;
+    map_ = std::move(map);
+    return true;
+}
+
+std::string_view CheckpointView::scene_json() const {
+    if (!map_) return {};
+    return map_->text().substr(header_.sceneOffset, header_.sceneBytes);
+}
+
+const double* CheckpointView::re() const {
+    if (!map_ || compressed()) return nullptr;
+    return reinterpret_cast<const double*>(map_->data() + header_.psiOffset);
+}
+
+const double* CheckpointView::im() const {
+    if (!map_ || compressed()) return nullptr;
+    return re() + static_cast<size_t>(header_.Nx) * static_cast<size_t>(header_.Ny);
+}
+
+bool CheckpointView::read_psi(double* re, double* im, std::string* error) const {
+    if (!map_) return fail(error, "no checkpoint open");
+    const size_t n = static_cast<size_t>(header_.Nx) * static_cast<size_t>(header_.Ny);
+    if (!compressed()) {
+        std::memcpy(re, this->re(), n * sizeof(double));
+        std::memcpy(im, this->im(), n * sizeof(double));
+        return true;
+    }
+#if S2D_HAVE_ZLIB
+    std::vector<unsigned char> planes(static_cast<size_t>(header_.psiRawBytes));
+    uLongf rawBytes = static_cast<uLongf>(planes.size());
+    if (uncompress(planes.data(), &rawBytes, map_->data() + header_.psiOffset, static_cast<uLong>(header_.psiBytes)) != Z_OK ||
+        rawBytes != planes.size()) {
+        return fail(error, "corrupt compressed psi");
+    }
+    unshuffle(planes.data(), n, re);
+    unshuffle(planes.data() + n * sizeof(double), n, im);
+    return true;
+#else
+    (void)re;
+    (void)im;
+    return fail(error, "compressed checkpoint needs a build with zlib");
+#endif
+}
+
+bool load_checkpoint(const std::string& path, sim::Simulation& sim, std::string* error, Scene* scene) {
+    CheckpointView view;
+    if (!view.open(path, error)) return false;
+
+    Scene s;
+    if (!parse_scene(view.scene_json(), s)) return fail(error, "invalid scene in checkpoint");
+    const CheckpointHeader& h = view.header();
+    if (s.Nx != h.Nx || s.Ny != h.Ny) return fail(error, "checkpoint grid does not match its scene");
+
+    // Objects and settings first (this resets psi), then the saved state
+    to_simulation(s, sim);
+    if (sim.Nx != h.Nx || sim.Ny != h.Ny) return fail(error, "checkpoint grid is below the minimum size");
+    if (!view.read_psi(sim.psi.re.data(), sim.psi.im.data(), error)) return false;
+    sim.dt = h.stepDt; // an adaptive run resumes at its last step size
+    sim.stepCount = h.stepCount;
+    sim.time = h.time;
+    sim.running = false;
+    sim.diagnostics = sim::StabilityDiagnostics{};
+    sim.diagnostics.initial_mass = h.initialMass;
+    sim.diagnostics.initial_interior_mass = h.initialInteriorMass;
+    sim.diagnostics.initial_interior_mass_fraction = h.initialInteriorMassFraction;
+    sim.diagnostics.steps_since_baseline = h.stepsSinceBaseline;
+    sim.stepsSinceCheck = 0;
+    ++sim.psiGeneration;
+    sim.update_diagnostics(false);
+    if (scene) *scene = s;
+    return true;
+}
+
+// ---- background writer ----
+
+AsyncCheckpointWriter::AsyncCheckpointWriter() : thread_([this] { worker_loop(); }) {}
+
+AsyncCheckpointWriter::~AsyncCheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+void AsyncCheckpointWriter::submit(const std::string& path, const sim::Simulation& sim, bool compress) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return !pending_; });
+    describe(sim, header_, scene_);
+    if (sim.float_ahead()) {
+        psi_.assign_from(sim.psiF); // after float steps the current state is psiF
+    } else {
+        psi_.re.assign(sim.psi.re.begin(), sim.psi.re.end());
+        psi_.im.assign(sim.psi.im.begin(), sim.psi.im.end());
+    }
+    path_ = path;
+    compress_ = compress;
+    pending_ = true;
+    lock.unlock();
+    wake_.notify_all();
+}
+
+void AsyncCheckpointWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return !pending_; });
+}
+
+bool AsyncCheckpointWriter::busy() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+bool AsyncCheckpointWriter::last_ok() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lastOk_;
+}
+
+std::string AsyncCheckpointWriter::last_error() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lastError_;
+}
+
+void AsyncCheckpointWriter::worker_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return pending_ || stop_; });
+        if (!pending_) return; // stop requested with nothing queued
+        // The snapshot is not touched by submit() while pending_ is set
+        lock.unlock();
+        std::string error;
+        const bool ok = write_file(path_, header_, scene_, psi_.re.data(), psi_.im.data(), compress_, &error);
+        lock.lock();
+        lastOk_ = ok;
+        lastError_ = ok ? std::string() : error;
+        pending_ = false;
+        done_.notify_all();
+    }
+}
+
+} // namespace io
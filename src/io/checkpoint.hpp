@@ -0,0 +1,128 @@
+// Binary checkpoint/restart of a running simulation (scene + evolved psi)
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "mapped_file.hpp"
+#include "scene.hpp"
+
+namespace io {
+
+// File layout (little endian):
+//   CheckpointHeader (144 bytes; 128 in version 1, which had no time or stepDt)
+//   scene JSON (write_scene), sceneBytes long
+//   psi payload at a 64-byte aligned offset: Nx*Ny doubles of Re psi, then Im psi.
+//   With kCheckpointCompressed the payload is byte-shuffled (byte b of every
+//   double grouped into plane b) and deflated as one zlib stream.
+constexpr char kCheckpointMagic[8] = {'S', '2', 'D', 'C', 'K', 'P', 'T', '\0'};
+constexpr std::uint32_t kCheckpointVersion = 2;
+constexpr std::uint32_t kCheckpointCompressed = 1u << 0;
+
+struct CheckpointHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::int32_t Nx;
+    std::int32_t Ny;
+    double Lx;
+    double Ly;
+    double dt;                 // the scene's dt (nominal with adaptive dt)
+    std::uint64_t stepCount;
+    double time;               // simulated time
+    double stepDt;             // size of the last step (differs from dt with adaptive dt)
+    // Diagnostics baseline, so drift checks continue across a restart
+    double initialMass;
+    double initialInteriorMass;
+    double initialInteriorMassFraction;
+    std::int32_t stepsSinceBaseline;
+    std::int32_t reserved0;
+    std::uint64_t sceneOffset;
+    std::uint64_t sceneBytes;
+    std::uint64_t psiOffset;
+    std::uint64_t psiBytes;    // bytes stored in the file
+    std::uint64_t psiRawBytes; // 2 * Nx * Ny * sizeof(double)
+};
+static_assert(sizeof(CheckpointHeader) == 144, "checkpoint header layout");
+
+// True when checkpoints can be written compressed (built with zlib).
+bool checkpoint_compression_available();
+
+// Writes sim to path. compress is ignored (uncompressed file) without zlib.
+// Uncompressed, psi is streamed from its arrays without a full-grid copy; a
+// resident float state is widened a few thousand values at a time.
+bool save_checkpoint(const std::string& path, const sim::Simulation& sim, bool compress, std::string* error = nullptr);
+
+// Read-only view of a checkpoint file. The file is memory-mapped where the
+// platform allows it (read into memory otherwise), and for uncompressed files
+// re()/im() point straight into the mapping.
+class CheckpointView {
+public:
+    CheckpointView();
+    ~CheckpointView();
+    CheckpointView(const CheckpointView&) = delete;
+    CheckpointView& operator=(const CheckpointView&) = delete;
+
+    bool open(const std::string& path, std::string* error = nullptr);
+
+    const CheckpointHeader& header() const { return header_; }
+    std::string_view scene_json() const; // points into the mapping
+    bool compressed() const { return (header_.flags & kCheckpointCompressed) != 0; }
+    // Uncompressed payload only (nullptr otherwise)
+    const double* re() const;
+    const double* im() const;
+    // Copies (or inflates) psi into re/im arrays of Nx*Ny doubles each.
+    bool read_psi(double* re, double* im, std::string* error = nullptr) const;
+
+private:
+    std::unique_ptr<MappedFile> map_;
+    CheckpointHeader header_{};
+};
+
+// Rebuilds sim from a checkpoint: scene objects and settings, psi, step count
+// and the diagnostics baseline. scene (optional) receives the stored scene.
+bool load_checkpoint(const std::string& path, sim::Simulation& sim, std::string* error = nullptr, Scene* scene = nullptr);
+
+// Writes checkpoints on a background thread. submit() snapshots psi into a
+// reusable buffer (one memcpy) and returns; the file is compressed and written
+// while the caller keeps stepping. submit() only blocks if the previous write
+// is still running.
+class AsyncCheckpointWriter {
+public:
+    AsyncCheckpointWriter();
+    ~AsyncCheckpointWriter();
+    AsyncCheckpointWriter(const AsyncCheckpointWriter&) = delete;
+    AsyncCheckpointWriter& operator=(const AsyncCheckpointWriter&) = delete;
+
+    void submit(const std::string& path, const sim::Simulation& sim, bool compress);
+    void wait(); // until the pending write (if any) has finished
+    bool busy();
+    // Result of the last finished write
+    bool last_ok();
+    std::string last_error();
+
+private:
+    void worker_loop();
+
+    // Everything the file needs, detached from the live simulation
+    CheckpointHeader header_{};
+    std::string scene_;
+    sim::Field psi_;
+    std::string path_;
+    bool compress_{false};
+    bool pending_{false};
+    bool stop_{false};
+    bool lastOk_{true};
+    std::string lastError_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::thread thread_;
+};
+
+} // namespace io
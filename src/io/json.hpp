@@ -0,0 +1,239 @@
+// Minimal JSON reader shared by the scene loader and the batch sweep specs
+#pragma once
+
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace io {
+
+inline bool read_file(const std::string& path, std::string& out) {
+    std::ifstream f(path);
+    if (!f) return false;
+    std::ostringstream ss; ss << f.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+struct JsonValue {
+    enum class Type { Null, Number, Bool, String, Array, Object } type{Type::Null};
+    double number{0.0};
+    bool boolean{false};
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : s_(text) {}
+
+    JsonValue parse() {
+        skip_ws();
+        JsonValue v = parse_value();
+        skip_ws();
+        if (!eof()) {
+            throw std::runtime_error("unexpected trailing characters");
+        }
+        return v;
+    }
+
+private:
+    const std::string& s_;
+    size_t pos_{0};
+
+    bool eof() const { return pos_ >= s_.size(); }
+    char peek() const { return eof() ? '\0' : s_[pos_]; }
+    char get() { return eof() ? '\0' : s_[pos_++]; }
+
+    void skip_ws() {
+        while (!eof() && std::isspace(static_cast<unsigned char>(s_[pos_]))) {
+            ++pos_;
+        }
+    }
+
+    void expect(char c) {
+        if (get() != c) {
+            throw std::runtime_error("unexpected token");
+        }
+    }
+
+    bool consume(const char* kw) {
+        size_t n = std::char_traits<char>::length(kw);
+        if (s_.compare(pos_, n, kw) == 0) {
+            pos_ += n;
+            return true;
+        }
+        return false;
+    }
+
+    JsonValue parse_value() {
+        skip_ws();
+        char c = peek();
+        if (c == '{') return parse_object();
+        if (c == '[') return parse_array();
+        if (c == '"') {
+            JsonValue v;
+            v.type = JsonValue::Type::String;
+            v.string = parse_string();
+            return v;
+        }
+        if (c == '-' || (c >= '0' && c <= '9')) return parse_number();
+        if (consume("true")) {
+            JsonValue v;
+            v.type = JsonValue::Type::Bool;
+            v.boolean = true;
+            return v;
+        }
+        if (consume("false")) {
+            JsonValue v;
+            v.type = JsonValue::Type::Bool;
+            v.boolean = false;
+            return v;
+        }
+        if (consume("null")) {
+            JsonValue v;
+            v.type = JsonValue::Type::Null;
+            return v;
+        }
+        throw std::runtime_error("invalid json value");
+    }
+
+    std::string parse_string() {
+        expect('"');
+        std::string out;
+        while (!eof()) {
+            char c = get();
+            if (c == '"') {
+                return out;
+            }
+            if (c == '\\') {
+                if (eof()) throw std::runtime_error("invalid escape");
+                char e = get();
+                switch (e) {
+                    case '"': out.push_back('"'); break;
+                    case '\\': out.push_back('\\'); break;
+                    case '/': out.push_back('/'); break;
+                    case 'b': out.push_back('\b'); break;
+                    case 'f': out.push_back('\f'); break;
+                    case 'n': out.push_back('\n'); break;
+                    case 'r': out.push_back('\r'); break;
+                    case 't': out.push_back('\t'); break;
+                    default: throw std::runtime_error("unsupported escape");
+                }
+            } else {
+                out.push_back(c);
+            }
+        }
+        throw std::runtime_error("unterminated string");
+    }
+
+    JsonValue parse_number() {
+        size_t start = pos_;
+        if (peek() == '-') ++pos_;
+        if (peek() == '0') {
+            ++pos_;
+        } else {
+            if (peek() < '1' || peek() > '9') throw std::runtime_error("invalid number");
+            while (peek() >= '0' && peek() <= '9') ++pos_;
+        }
+        if (peek() == '.') {
+            ++pos_;
+            if (peek() < '0' || peek() > '9') throw std::runtime_error("invalid fraction");
+            while (peek() >= '0' && peek() <= '9') ++pos_;
+        }
+        if (peek() == 'e' || peek() == 'E') {
+            ++pos_;
+            if (peek() == '+' || peek() == '-') ++pos_;
+            if (peek() < '0' || peek() > '9') throw std::runtime_error("invalid exponent");
+            while (peek() >= '0' && peek() <= '9') ++pos_;
+        }
+
+        JsonValue v;
+        v.type = JsonValue::Type::Number;
+        v.number = std::stod(s_.substr(start, pos_ - start));
+        return v;
+    }
+
+    JsonValue parse_array() {
+        expect('[');
+        JsonValue v;
+        v.type = JsonValue::Type::Array;
+        skip_ws();
+        if (peek() == ']') {
+            get();
+            return v;
+        }
+        while (true) {
+            v.array.push_back(parse_value());
+            skip_ws();
+            if (peek() == ']') {
+                get();
+                return v;
+            }
+            expect(',');
+            skip_ws();
+        }
+    }
+
+    JsonValue parse_object() {
+        expect('{');
+        JsonValue v;
+        v.type = JsonValue::Type::Object;
+        skip_ws();
+        if (peek() == '}') {
+            get();
+            return v;
+        }
+        while (true) {
+            if (peek() != '"') throw std::runtime_error("object key expected");
+            std::string key = parse_string();
+            skip_ws();
+            expect(':');
+            JsonValue value = parse_value();
+            v.object.push_back({std::move(key), std::move(value)});
+            skip_ws();
+            if (peek() == '}') {
+                get();
+                return v;
+            }
+            expect(',');
+            skip_ws();
+        }
+    }
+};
+
+inline const JsonValue* get_member(const JsonValue& obj, const char* key) {
+    if (obj.type != JsonValue::Type::Object) return nullptr;
+    for (const auto& kv : obj.object) {
+        if (kv.first == key) return &kv.second;
+    }
+    return nullptr;
+}
+
+inline double as_number(const JsonValue* v, double def) {
+    if (!v || v->type != JsonValue::Type::Number) return def;
+    return v->number;
+}
+
+inline int as_int(const JsonValue* v, int def) {
+    if (!v || v->type != JsonValue::Type::Number) return def;
+    return static_cast<int>(std::llround(v->number));
+}
+
+inline bool as_bool(const JsonValue* v, bool def) {
+    if (!v || v->type != JsonValue::Type::Bool) return def;
+    return v->boolean;
+}
+
+inline std::string as_string(const JsonValue* v, const std::string& def) {
+    if (!v || v->type != JsonValue::Type::String) return def;
+    return v->string;
+}
+
+} // namespace io
@@ -0,0 +1,262 @@
+#include "json_sax.hpp"
+#include "json.hpp"
+
+#include <charconv>
+#include <cstring>
+
+namespace io {
+
+namespace {
+
+// Deeper documents are rejected instead of recursing without bound
+constexpr int kMaxDepth = 256;
+
+class SaxReader {
+public:
+    SaxReader(std::string_view text, JsonHandler& handler) : s_(text), h_(handler) {}
+
+    bool parse(std::string* error) {
+        skip_ws();
+        bool ok = value(0);
+        if (ok) {
+            skip_ws();
+            if (pos_ < s_.size()) ok = fail("unexpected trailing characters");
+        }
+        if (!ok && error) *error = error_ + " at byte " + std::to_string(pos_);
+        return ok;
+    }
+
+private:
+    std::string_view s_;
+    JsonHandler& h_;
+    size_t pos_{0};
+    std::string scratch_; // decoded strings with escapes
+    std::string error_;
+
+    char peek() const { return pos_ < s_.size() ? s_[pos_] : '\0'; }
+    bool digit() const { return peek() >= '0' && peek() <= '9'; }
+
+    bool fail(const char* message) {
+        error_ = message;
+        return false;
+    }
+
+    void skip_ws() {
+        while (pos_ < s_.size()) {
+            const char c = s_[pos_];
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') break;
+            ++pos_;
+        }
+    }
+
+    bool literal(std::string_view word) {
+        if (s_.compare(pos_, word.size(), word) != 0) return fail("invalid json value");
+        pos_ += word.size();
+        return true;
+    }
+
+    bool value(int depth) {
+        if (depth > kMaxDepth) return fail("nesting too deep");
+        switch (peek()) {
+        case '{': return object(depth);
+        case '[': return array(depth);
+        case '"': {
+            std::string_view v;
+            if (!string(v)) return false;
+            h_.string(v);
+            return true;
+        }
+        case 't':
+            if (!literal("true")) return false;
+            h_.boolean(true);
+            return true;
+        case 'f':
+            if (!literal("false")) return false;
+            h_.boolean(false);
+            return true;
+        case 'n':
+            if (!literal("null")) return false;
+            h_.null();
+            return true;
+        default:
+            return number();
+        }
+    }
+
+    // The view points into the text unless the string has escapes.
+    bool string(std::string_view& out) {
+        ++pos_; // opening quote
+        const size_t start = pos_;
+        const char* base = s_.data();
+        const void* quote = std::memchr(base + pos_, '"', s_.size() - pos_);
+        if (!quote) return fail("unterminated string");
+        const size_t end = static_cast<size_t>(static_cast<const char*>(quote) - base);
+        if (!std::memchr(base + start, '\\', end - start)) {
+            out = s_.substr(start, end - start);
+            pos_ = end + 1;
+            return true;
+        }
+        scratch_.clear();
+        while (pos_ < s_.size()) {
+            const char c = s_[pos_++];
+            if (c == '"') {
+                out = scratch_;
+                return true;
+            }
+            if (c != '\\') {
+                scratch_.push_back(c);
+                continue;
+            }
+            if (pos_ >= s_.size()) break;
+            switch (s_[pos_++]) {
+            case '"': scratch_.push_back('"'); break;
+            case '\\': scratch_.push_back('\\'); break;
+            case '/': scratch_.push_back('/'); break;
+            case 'b': scratch_.push_back('\b'); break;
+            case 'f': scratch_.push_back('\f'); break;
+            case 'n': scratch_.push_back('\n'); break;
+            case 'r': scratch_.push_back('\r'); break;
+            case 't': scratch_.push_back('\t'); break;
+            default: return fail("unsupported escape");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    bool number() {
+        const size_t start = pos_;
+        if (peek() == '-') ++pos_;
+        if (peek() == '0') {
+            ++pos_;
+        } else {
+            if (peek() < '1' || peek() > '9') return fail("invalid json value");
+            while (digit()) ++pos_;
+        }
+        if (peek() == '.') {
+            ++pos_;
+            if (!digit()) return fail("invalid fraction");
+            while (digit()) ++pos_;
+        }
+        if (peek() == 'e' || peek() == 'E') {
+            ++pos_;
+            if (peek() == '+' || peek() == '-') ++pos_;
+            if (!digit()) return fail("invalid exponent");
+            while (digit()) ++pos_;
+        }
+        double v = 0.0;
+        const auto r = std::from_chars(s_.data() + start, s_.data() + pos_, v);
+        if (r.ec != std::errc()) return fail("number out of range");
+        h_.number(v);
+        return true;
+    }
+
+    // Elements of the array starting at pos_ ('['): top-level commas up to the
+    // matching bracket, skipping strings. Malformed input only skews the hint.
+    size_t count_elements() const {
+        size_t depth = 0;
+        size_t commas = 0;
+        bool any = false;
+        for (size_t i = pos_ + 1; i < s_.size(); ++i) {
+            const char c = s_[i];
+            if (c == '"') {
+                for (++i; i < s_.size() && s_[i] != '"'; ++i) {
+                    if (s_[i] == '\\') ++i;
+                }
+                any = true;
+            } else if (c == '[' || c == '{') {
+                ++depth;
+                any = true;
+            } else if (c == ']' || c == '}') {
+                if (depth == 0) break;
+                --depth;
+            } else if (c == ',' && depth == 0) {
+                ++commas;
+            } else if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                any = true;
+            }
+        }
+        return any ? commas + 1 : 0;
+    }
+
+    bool array(int depth) {
+        h_.start_array(depth <= 1 ? count_elements() : 0);
+        ++pos_;
+        skip_ws();
+        if (peek() == ']') {
+            ++pos_;
+            h_.end_array();
+            return true;
+        }
+        while (true) {
+            skip_ws();
+            if (!value(depth + 1)) return false;
+            skip_ws();
+            const char c = peek();
+            ++pos_;
+            if (c == ']') break;
+            if (c != ',') return fail("unexpected token");
+        }
+        h_.end_array();
+        return true;
+    }
+
+    bool object(int depth) {
+        h_.start_object();
+        ++pos_;
+        skip_ws();
+        if (peek() == '}') {
+            ++pos_;
+            h_.end_object();
+            return true;
+        }
+        while (true) {
+            skip_ws();
+            if (peek() != '"') return fail("object key expected");
+            std::string_view k;
+            if (!string(k)) return false;
+            h_.key(k);
+            skip_ws();
+            if (peek() != ':') return fail("unexpected token");
+            ++pos_;
+            skip_ws();
+            if (!value(depth + 1)) return false;
+            skip_ws();
+            const char c = peek();
+            ++pos_;
+            if (c == '}') break;
+            if (c != ',') return fail("unexpected token");
+        }
+        h_.end_object();
+        return true;
+    }
+};
+
+} // namespace
+
+bool parse_json(std::string_view text, JsonHandler& handler, std::string* error) {
+    return SaxReader(text, handler).parse(error);
+}
+
+void replay_json(const JsonValue& value, JsonHandler& handler) {
+    switch (value.type) {
+    case JsonValue::Type::Null: handler.null(); break;
+    case JsonValue::Type::Number: handler.number(value.number); break;
+    case JsonValue::Type::Bool: handler.boolean(value.boolean); break;
+    case JsonValue::Type::String: handler.string(value.string); break;
+    case JsonValue::Type::Array:
+        handler.start_array(value.array.size());
+        for (const JsonValue& item : value.array) replay_json(item, handler);
+        handler.end_array();
+        break;
+    case JsonValue::Type::Object:
+        handler.start_object();
+        for (const auto& kv : value.object) {
+            handler.key(kv.first);
+            replay_json(kv.second, handler);
+        }
+        handler.end_object();
+        break;
+    }
+}
+
+} // namespace io
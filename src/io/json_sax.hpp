@@ -0,0 +1,40 @@
+// Streaming JSON reader: events straight from the text, without a JsonValue tree
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace io {
+
+struct JsonValue; // json.hpp
+
+// Receives the values of a document in order. Keys and strings are views that
+// are only valid during the call (into the text, or into a scratch buffer
+// when the string has escapes).
+class JsonHandler {
+public:
+    virtual ~JsonHandler() = default;
+
+    virtual void start_object() = 0;
+    virtual void key(std::string_view k) = 0;
+    virtual void end_object() = 0;
+    // sizeHint: element count of the root array and of arrays directly inside
+    // the root value (counted by a quick pre-scan); 0 deeper down.
+    virtual void start_array(std::size_t sizeHint) = 0;
+    virtual void end_array() = 0;
+    virtual void number(double v) = 0;
+    virtual void boolean(bool v) = 0;
+    virtual void string(std::string_view v) = 0;
+    virtual void null() = 0;
+};
+
+// Parses one document (the grammar of JsonParser) without copying text.
+// Returns false with a message and byte offset in error on malformed input;
+// the handler has then seen the events up to the error.
+bool parse_json(std::string_view text, JsonHandler& handler, std::string* error = nullptr);
+
+// Emits the events of an already parsed value, so one handler serves both readers.
+void replay_json(const JsonValue& value, JsonHandler& handler);
+
+} // namespace io
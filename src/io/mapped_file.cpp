@@ -0,0 +1,67 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define S2D_HAVE_MMAP 1
+#else
+#define S2D_HAVE_MMAP 0
+#endif
+
+namespace io {
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path, std::string* error) {
+    close();
+    auto fail = [&](const std::string& message) {
+        if (error) *error = message;
+        return false;
+    };
+#if S2D_HAVE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return fail("cannot open " + path);
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return fail("cannot stat " + path);
+    }
+    if (st.st_size == 0) {
+        // mmap rejects empty lengths; an empty file is just no data
+        ::close(fd);
+        return true;
+    }
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return fail("mmap failed: " + path);
+    mapped_ = p;
+    data_ = static_cast<const unsigned char*>(p);
+    size_ = static_cast<size_t>(st.st_size);
+#else
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return fail("cannot open " + path);
+    owned_.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    data_ = owned_.data();
+    size_ = owned_.size();
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#if S2D_HAVE_MMAP
+    if (mapped_) munmap(mapped_, size_);
+#endif
+    mapped_ = nullptr;
+    owned_.clear();
+    data_ = nullptr;
+    size_ = 0;
+}
+
+} // namespace io
@@ -0,0 +1,34 @@
+// Read-only memory mapping of a whole file
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace io {
+
+// Maps a file read-only (mmap on POSIX; elsewhere the file is read into an
+// owned buffer). The contents stay valid until close() or destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path, std::string* error = nullptr);
+    void close();
+
+    const unsigned char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view text() const { return {reinterpret_cast<const char*>(data_), size_}; }
+
+private:
+    const unsigned char* data_{nullptr};
+    std::size_t size_{0};
+    void* mapped_{nullptr};
+    std::vector<unsigned char> owned_; // fallback when mmap is unavailable
+};
+
+} // namespace io
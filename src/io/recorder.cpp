@@ -0,0 +1,385 @@
+#include "recorder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+#ifndef S2D_HAVE_ZLIB
+#define S2D_HAVE_ZLIB 0
+#endif
+#if S2D_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace io {
+
+// ChunkedStream layout (little endian):
+//   StreamHeader, then per frame a FrameHeader followed by `chunks` ChunkHeaders,
+//   each directly followed by its payload: rows * Nx float32 |psi|^2. With
+//   kStreamDeflate the payload is byte-shuffled (byte b of every float grouped
+//   into plane b) and deflated. Frames can be skipped by summing chunk sizes.
+namespace {
+
+constexpr char kStreamMagic[8] = {'S', '2', 'D', 'S', 'T', 'R', 'M', '\0'};
+constexpr std::uint32_t kStreamVersion = 1;
+constexpr std::uint32_t kStreamDeflate = 1u << 0;
+
+struct StreamHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::int32_t Nx;
+    std::int32_t Ny;
+    std::int32_t chunkRows;
+    std::int32_t stride;
+    double dt;
+    std::uint8_t reserved[24];
+};
+static_assert(sizeof(StreamHeader) == 64, "stream header layout");
+
+struct FrameHeader {
+    char tag[4]; // "FRME"
+    std::uint32_t chunks;
+    std::uint64_t index;
+    std::uint64_t step;
+    double time;
+};
+static_assert(sizeof(FrameHeader) == 32, "frame header layout");
+
+struct ChunkHeader {
+    std::uint32_t row0;
+    std::uint32_t rows;
+    std::uint64_t bytes;
+};
+static_assert(sizeof(ChunkHeader) == 16, "chunk header layout");
+
+std::string frame_name(std::uint64_t index) {
+    std::ostringstream ss;
+    ss << "frame_" << std::setw(6) << std::setfill('0') << index << ".png";
+    return ss.str();
+}
+
+} // namespace
+
+const char* record_format_name(RecordFormat f) {
+    switch (f) {
+    case RecordFormat::PngSequence: return "png";
+    case RecordFormat::RawDensity: return "raw";
+    case RecordFormat::ChunkedStream: return "stream";
+    }
+    return "png";
+}
+
+bool parse_record_format(const std::string& name, RecordFormat& out) {
+    for (RecordFormat f : {RecordFormat::PngSequence, RecordFormat::RawDensity, RecordFormat::ChunkedStream}) {
+        if (name == record_format_name(f)) {
+            out = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+FrameRecorder::FrameRecorder() : slots_(2), thread_([this] { worker_loop(); }) {
+    for (auto& s : slots_) free_.push_back(&s);
+}
+
+FrameRecorder::~FrameRecorder() {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+bool FrameRecorder::start(const RecorderConfig& config, int Nx, int Ny, double dt, std::string* error) {
+    stop();
+    {
+        // No frame is in flight after stop(), so the ring can be rebuilt.
+        std::unique_lock<std::mutex> lock(mutex_);
+        drained_.wait(lock, [this] { return inFlight_ == 0; });
+        config_ = config;
+        config_.stride = std::max(1, config_.stride);
+        config_.ringFrames = std::max(2, config_.ringFrames);
+        config_.chunkRows = std::max(1, config_.chunkRows);
+        Nx_ = Nx;
+        Ny_ = Ny;
+        dt_ = dt;
+        slots_ = std::vector<Slot>(static_cast<size_t>(config_.ringFrames));
+        free_.clear();
+        const size_t cells = static_cast<size_t>(Nx) * static_cast<size_t>(Ny);
+        for (auto& s : slots_) {
+            s.density.resize(cells);
+            if (config_.format == RecordFormat::PngSequence) s.rgba.resize(cells * 4);
+            free_.push_back(&s);
+        }
+        error_.clear();
+    }
+    nextStep_ = 0;
+    frameIndex_ = 0;
+    frameSteps_.clear();
+    written_ = 0;
+    dropped_ = 0;
+    bytes_ = 0;
+
+    auto bail = [&](const std::string& message) {
+        if (error) *error = message;
+        return false;
+    };
+    std::error_code ec;
+    std::filesystem::create_directories(config_.directory, ec);
+    if (ec) return bail("cannot create " + config_.directory);
+
+    const std::filesystem::path dir(config_.directory);
+    if (config_.format == RecordFormat::RawDensity) {
+        out_ = std::fopen((dir / "density.f32").string().c_str(), "wb");
+        if (!out_) return bail("cannot open density.f32 in " + config_.directory);
+    } else if (config_.format == RecordFormat::ChunkedStream) {
+        out_ = std::fopen((dir / "density.s2ds").string().c_str(), "wb");
+        if (!out_) return bail("cannot open density.s2ds in " + config_.directory);
+        StreamHeader h{};
+        std::memcpy(h.magic, kStreamMagic, sizeof(h.magic));
+        h.version = kStreamVersion;
+        h.flags = S2D_HAVE_ZLIB ? kStreamDeflate : 0u;
+        h.Nx = Nx;
+        h.Ny = Ny;
+        h.chunkRows = config_.chunkRows;
+        h.stride = config_.stride;
+        h.dt = dt;
+        std::fwrite(&h, sizeof(h), 1, out_);
+        bytes_ += sizeof(h);
+    }
+    active_ = true;
+    return true;
+}
+
+void FrameRecorder::stop() {
+    if (!active_) return;
+    active_ = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        drained_.wait(lock, [this] { return inFlight_ == 0; });
+    }
+    if (out_) {
+        std::fclose(out_);
+        out_ = nullptr;
+    }
+    if (config_.format == RecordFormat::RawDensity) {
+        std::ofstream meta(std::filesystem::path(config_.directory) / "density.json");
+        meta << "{\n  \"Nx\": " << Nx_ << ",\n  \"Ny\": " << Ny_ << ",\n  \"dtype\": \"float32\",\n"
+             << "  \"dt\": " << std::setprecision(17) << dt_ << ",\n  \"stride\": " << config_.stride
+             << ",\n  \"frames\": " << frameSteps_.size() << ",\n  \"steps\": [";
+        for (size_t k = 0; k < frameSteps_.size(); ++k) meta << (k ? ", " : "") << frameSteps_[k];
+        meta << "]\n}\n";
+    }
+}
+
+std::string FrameRecorder::last_error() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
+
+FrameRecorder::Slot* FrameRecorder::acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.empty()) return nullptr;
+    Slot* s = free_.back();
+    free_.pop_back();
+    ++inFlight_;
+    return s;
+}
+
+void FrameRecorder::enqueue(Slot* slot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(slot);
+    }
+    wake_.notify_one();
+}
+
+bool FrameRecorder::maybe_capture(const sim::Simulation& sim, const unsigned char* rgba) {
+    if (!active_) return false;
+    const std::uint64_t stride = static_cast<std::uint64_t>(config_.stride);
+    if (sim.stepCount + stride < nextStep_) nextStep_ = sim.stepCount; // reset() rewound the run
+    if (sim.stepCount < nextStep_) return false;
+    nextStep_ = sim.stepCount + stride;
+    return capture(sim, rgba);
+}
+
+bool FrameRecorder::capture(const sim::Simulation& sim, const unsigned char* rgba) {
+    if (!active_) return false;
+    if (sim.Nx != Nx_ || sim.Ny != Ny_) {
+        ++dropped_;
+        fail("grid size changed while recording; frame dropped");
+        return false;
+    }
+    Slot* slot = acquire();
+    if (!slot) {
+        ++dropped_; // encoder is behind: drop instead of stalling the caller
+        return false;
+    }
+    slot->kind = Slot::Kind::Frame;
+    slot->index = frameIndex_++;
+    slot->step = sim.stepCount;
+    slot->time = sim.time;
+    slot->w = Nx_;
+    slot->h = Ny_;
+    slot->hasRgba = rgba != nullptr && config_.format == RecordFormat::PngSequence;
+    if (slot->hasRgba) {
+        // submit_png() may have left the slot holding a screenshot of another size
+        const size_t bytes = static_cast<size_t>(Nx_) * static_cast<size_t>(Ny_) * 4;
+        slot->rgba.resize(bytes);
+        std::memcpy(slot->rgba.data(), rgba, bytes);
+    } else {
+        // After float steps the current state is psiF (see Simulation::sync_psi)
+        auto density = [&](const auto& psi) {
+            float* d = slot->density.data();
+            for (size_t k = 0; k < slot->density.size(); ++k) {
+                const double re = psi.re[k];
+                const double im = psi.im[k];
+                d[k] = static_cast<float>(re * re + im * im);
+            }
+        };
+        if (sim.float_ahead()) density(sim.psiF);
+        else density(sim.psi);
+    }
+    if (config_.format == RecordFormat::RawDensity) frameSteps_.push_back(slot->step);
+    enqueue(slot);
+    return true;
+}
+
+bool FrameRecorder::submit_png(const std::string& path, const unsigned char* rgba, int w, int h) {
+    Slot* slot = acquire();
+    if (!slot) return false;
+    slot->kind = Slot::Kind::Png;
+    slot->path = path;
+    slot->w = w;
+    slot->h = h;
+    slot->hasRgba = true;
+    slot->rgba.assign(rgba, rgba + static_cast<size_t>(w) * static_cast<size_t>(h) * 4);
+    enqueue(slot);
+    return true;
+}
+
+void FrameRecorder::fail(const std::string& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = message;
+}
+
+void FrameRecorder::worker_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this] { return !queue_.empty() || stop_; });
+        if (queue_.empty()) return;
+        Slot* slot = queue_.front();
+        queue_.erase(queue_.begin());
+        lock.unlock();
+        encode(*slot);
+        lock.lock();
+        slot->kind = Slot::Kind::Free;
+        free_.push_back(slot);
+        --inFlight_;
+        if (inFlight_ == 0) drained_.notify_all();
+    }
+}
+
+void FrameRecorder::encode(Slot& slot) {
+    if (slot.kind == Slot::Kind::Png) {
+        if (stbi_write_png(slot.path.c_str(), slot.w, slot.h, 4, slot.rgba.data(), slot.w * 4) == 0) {
+            fail("failed to write " + slot.path);
+        }
+        return;
+    }
+
+    const size_t cells = static_cast<size_t>(slot.w) * static_cast<size_t>(slot.h);
+    switch (config_.format) {
+    case RecordFormat::PngSequence: {
+        const std::string path = (std::filesystem::path(config_.directory) / frame_name(slot.index)).string();
+        int ok = 0;
+        if (slot.hasRgba) {
+            ok = stbi_write_png(path.c_str(), slot.w, slot.h, 4, slot.rgba.data(), slot.w * 4);
+        } else {
+            // Grayscale |psi|^2 normalized to the frame's peak
+            const float peak = *std::max_element(slot.density.begin(), slot.density.end());
+            const float scale = peak > 0.0f ? 255.0f / peak : 0.0f;
+            gray_.resize(cells);
+            for (size_t k = 0; k < cells; ++k) {
+                gray_[k] = static_cast<unsigned char>(std::min(255.0f, slot.density[k] * scale + 0.5f));
+            }
+            ok = stbi_write_png(path.c_str(), slot.w, slot.h, 1, gray_.data(), slot.w);
+        }
+        if (!ok) {
+            fail("failed to write " + path);
+            return;
+        }
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(path, ec);
+        if (!ec) bytes_ += size;
+        break;
+    }
+    case RecordFormat::RawDensity: {
+        if (std::fwrite(slot.density.data(), sizeof(float), cells, out_) != cells) {
+            fail("short write to density.f32");
+            return;
+        }
+        std::fflush(out_);
+        bytes_ += cells * sizeof(float);
+        break;
+    }
+    case RecordFormat::ChunkedStream: {
+        const int rowsPerChunk = config_.chunkRows;
+        FrameHeader fh{};
+        std::memcpy(fh.tag, "FRME", 4);
+        fh.chunks = static_cast<std::uint32_t>((slot.h + rowsPerChunk - 1) / rowsPerChunk);
+        fh.index = slot.index;
+        fh.step = slot.step;
+        fh.time = slot.time;
+        bool ok = std::fwrite(&fh, sizeof(fh), 1, out_) == 1;
+        std::uint64_t bytes = sizeof(fh);
+        for (int row0 = 0; ok && row0 < slot.h; row0 += rowsPerChunk) {
+            const int rows = std::min(rowsPerChunk, slot.h - row0);
+            const float* src = slot.density.data() + static_cast<size_t>(row0) * slot.w;
+            const size_t rawBytes = static_cast<size_t>(rows) * slot.w * sizeof(float);
+            const void* payload = src;
+            ChunkHeader ch{static_cast<std::uint32_t>(row0), static_cast<std::uint32_t>(rows), rawBytes};
+#if S2D_HAVE_ZLIB
+            // Byte-shuffle the floats (byte b of every value into plane b) before deflating
+            const size_t count = static_cast<size_t>(rows) * slot.w;
+            const unsigned char* bytesIn = reinterpret_cast<const unsigned char*>(src);
+            shuffled_.resize(rawBytes);
+            for (size_t k = 0; k < count; ++k) {
+                for (size_t b = 0; b < sizeof(float); ++b) shuffled_[b * count + k] = bytesIn[k * sizeof(float) + b];
+            }
+            uLongf packedBytes = compressBound(static_cast<uLong>(rawBytes));
+            packed_.resize(packedBytes);
+            if (compress2(packed_.data(), &packedBytes, shuffled_.data(), static_cast<uLong>(rawBytes), Z_BEST_SPEED) != Z_OK) {
+                fail("deflate failed");
+                return;
+            }
+            ch.bytes = packedBytes;
+            payload = packed_.data();
+#endif
+            ok = std::fwrite(&ch, sizeof(ch), 1, out_) == 1 &&
+                 std::fwrite(payload, 1, static_cast<size_t>(ch.bytes), out_) == ch.bytes;
+            bytes += sizeof(ch) + ch.bytes;
+        }
+        if (!ok) {
+            fail("short write to density.s2ds");
+            return;
+        }
+        std::fflush(out_);
+        bytes_ += bytes;
+        break;
+    }
+    }
+    ++written_;
+}
+
+} // namespace io
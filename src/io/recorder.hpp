@@ -0,0 +1,115 @@
+// Background recording of simulation frames (movies and density time series)
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sim/simulation.hpp"
+
+namespace io {
+
+// Output formats
+//  PngSequence: <dir>/frame_000000.png ... (the caller's RGBA view, or |psi|^2 in grayscale)
+//  RawDensity:  <dir>/density.f32, Nx*Ny float32 |psi|^2 per frame back to back,
+//               plus density.json (Nx, Ny, dt, stride, frames and their steps)
+//  ChunkedStream: <dir>/density.s2ds, self-describing stream of frames, each split
+//               into row chunks that are deflated when built with zlib (see recorder.cpp)
+enum class RecordFormat { PngSequence, RawDensity, ChunkedStream };
+
+const char* record_format_name(RecordFormat f);
+bool parse_record_format(const std::string& name, RecordFormat& out); // "png" / "raw" / "stream"
+
+struct RecorderConfig {
+    RecordFormat format{RecordFormat::PngSequence};
+    std::string directory{"recording"};
+    int stride{10};       // time steps between captured frames
+    int ringFrames{8};    // preallocated frame buffers
+    int chunkRows{64};    // ChunkedStream rows per chunk
+};
+
+// Captures run on the simulation thread and only copy into a free ring slot;
+// a background thread encodes and writes. When every slot is still queued the
+// frame is dropped and counted, so stepping never waits for the disk.
+class FrameRecorder {
+public:
+    FrameRecorder();
+    ~FrameRecorder();
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    // Allocates the ring for an Nx x Ny grid and opens the output.
+    bool start(const RecorderConfig& config, int Nx, int Ny, double dt, std::string* error = nullptr);
+    // Drains queued frames and closes the output.
+    void stop();
+    bool active() const { return active_; }
+    const RecorderConfig& config() const { return config_; }
+
+    // Captures a frame if at least `stride` steps passed since the last one.
+    // rgba (Nx*Ny*4, optional) is used for PNG frames instead of grayscale density.
+    // Returns true when a frame was queued.
+    bool maybe_capture(const sim::Simulation& sim, const unsigned char* rgba = nullptr);
+    bool capture(const sim::Simulation& sim, const unsigned char* rgba = nullptr);
+
+    // One-off PNG (screenshots) written by the same background thread; the
+    // pixels are copied and the call returns immediately. False if the ring is full.
+    bool submit_png(const std::string& path, const unsigned char* rgba, int w, int h);
+
+    std::uint64_t frames_written() const { return written_.load(); }
+    std::uint64_t frames_dropped() const { return dropped_.load(); }
+    std::uint64_t bytes_written() const { return bytes_.load(); }
+    std::string last_error();
+
+private:
+    struct Slot {
+        enum class Kind { Free, Frame, Png } kind{Kind::Free};
+        std::uint64_t index{0}; // frame number within the recording
+        std::uint64_t step{0};
+        double time{0.0};
+        int w{0}, h{0};
+        bool hasRgba{false};
+        std::vector<float> density;       // |psi|^2, w*h
+        std::vector<unsigned char> rgba;  // w*h*4
+        std::string path;                 // Png kind
+    };
+
+    Slot* acquire();               // free slot or nullptr (never blocks)
+    void enqueue(Slot* slot);
+    void worker_loop();
+    void encode(Slot& slot);
+    void fail(const std::string& message);
+
+    RecorderConfig config_;
+    bool active_{false};
+    int Nx_{0}, Ny_{0};
+    double dt_{0.0};
+    std::uint64_t nextStep_{0};
+    std::uint64_t frameIndex_{0};
+    std::vector<std::uint64_t> frameSteps_; // RawDensity sidecar
+
+    std::vector<Slot> slots_;
+    std::vector<Slot*> free_;
+    std::vector<Slot*> queue_; // FIFO, encoded in capture order
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable drained_;
+    int inFlight_{0};
+    bool stop_{false};
+    std::thread thread_;
+
+    std::FILE* out_{nullptr}; // RawDensity / ChunkedStream file
+    std::vector<unsigned char> gray_;     // encoder scratch (grayscale PNG)
+    std::vector<unsigned char> shuffled_; // encoder scratch (byte-shuffled chunk)
+    std::vector<unsigned char> packed_;   // encoder scratch (deflated chunk)
+    std::string error_;
+    std::atomic<std::uint64_t> written_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<std::uint64_t> bytes_{0};
+};
+
+} // namespace io
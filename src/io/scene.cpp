@@ -1,5 +1,17 @@
 #include "scene.hpp"
-
+#include "checkpoint.hpp"
+#include "json.hpp"
+#include "json_sax.hpp"
+#include "mapped_file.hpp"
+#include "recorder.hpp"
+#include "timeseries.hpp"
+#include "sim/profiler.hpp"
+#if S2D_HAVE_MPI
+#include "sim/distributed.hpp"
+#endif
+
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
@@ -12,6 +24,11 @@ namespace io {
 bool save_scene(const std::string& path, const Scene& s) {
     std::ofstream f(path);
     if (!f) return false;
+    write_scene(f, s);
+    return static_cast<bool>(f);
+}
+
+void write_scene(std::ostream& f, const Scene& s) {
     f << std::setprecision(17);
     f << "{\n";
     f << "  \"Nx\": " << s.Nx << ",\n";
@@ -19,6 +36,7 @@ bool save_scene(const std::string& path, const Scene& s) {
     f << "  \"dt\": " << s.dt << ",\n";
     f << "  \"cap_strength\": " << s.cap_strength << ",\n";
     f << "  \"cap_ratio\": " << s.cap_ratio << ",\n";
+    f << "  \"well_cutoff\": " << s.well_cutoff << ",\n";
     f << "  \"rel_mass_drift_tol\": " << s.rel_mass_drift_tol << ",\n";
     f << "  \"rel_cap_mass_growth_tol\": " << s.rel_cap_mass_growth_tol << ",\n";
     f << "  \"rel_interior_mass_drift_tol\": " << s.rel_interior_mass_drift_tol << ",\n";
@@ -26,9 +44,22 @@ bool save_scene(const std::string& path, const Scene& s) {
     f << "  \"min_initial_interior_mass_fraction\": " << s.min_initial_interior_mass_fraction << ",\n";
     f << "  \"min_interior_area_fraction\": " << s.min_interior_area_fraction << ",\n";
     f << "  \"stability_warmup_steps\": " << s.stability_warmup_steps << ",\n";
+    f << "  \"stability_check_every_n_steps\": " << s.stability_check_every_n_steps << ",\n";
     f << "  \"interior_drift_hard_fail\": " << (s.interior_drift_hard_fail ? "true" : "false") << ",\n";
     f << "  \"auto_pause_on_instability\": " << (s.auto_pause_on_instability ? "true" : "false") << ",\n";
     f << "  \"steps\": " << s.steps << ",\n";
+    f << "  \"precision\": \"" << sim::precision_name(s.precision) << "\",\n";
+    f << "  \"engine\": \"" << sim::engine_name(s.engine) << "\",\n";
+    f << "  \"magnetic_field\": " << s.magnetic_field << ",\n";
+    f << "  \"spatial_order\": " << s.spatial_order << ",\n";
+    f << "  \"adaptive_dt\": " << (s.adaptive_dt ? "true" : "false") << ",\n";
+    f << "  \"adaptive_tol\": " << s.adaptive_tol << ",\n";
+    f << "  \"adaptive_dt_min\": " << s.adaptive_dt_min << ",\n";
+    f << "  \"adaptive_dt_max\": " << s.adaptive_dt_max << ",\n";
+    f << "  \"active_window\": " << (s.active_window ? "true" : "false") << ",\n";
+    f << "  \"active_window_threshold\": " << s.active_window_threshold << ",\n";
+    f << "  \"active_window_margin\": " << s.active_window_margin << ",\n";
+    f << "  \"observables_every\": " << s.observables_every << ",\n";
     f << "  \"boxes\": [\n";
     for (size_t i = 0; i < s.boxes.size(); ++i) {
         const auto& b = s.boxes[i];
@@ -46,6 +77,15 @@ bool save_scene(const std::string& path, const Scene& s) {
         f << "\n";
     }
     f << "  ],\n";
+    f << "  \"probes\": [\n";
+    for (size_t i = 0; i < s.probes.size(); ++i) {
+        const auto& p = s.probes[i];
+        f << "    {\"kind\": \"" << sim::probe_kind_name(p.kind) << "\", \"name\": \"" << p.name
+          << "\", \"x0\": "<<p.x0<<", \"y0\": "<<p.y0<<", \"x1\": "<<p.x1<<", \"y1\": "<<p.y1<<"}";
+        if (i + 1 < s.probes.size()) f << ",";
+        f << "\n";
+    }
+    f << "  ],\n";
 
     f << "  \"packets\": [\n";
     for (size_t i = 0; i < s.packets.size(); ++i) {
@@ -57,308 +97,293 @@ bool save_scene(const std::string& path, const Scene& s) {
     }
     f << "  ]\n";
     f << "}\n";
-    return true;
 }
 
-static bool read_file(const std::string& path, std::string& out) {
-    std::ifstream f(path);
-    if (!f) return false;
-    std::ostringstream ss; ss << f.rdbuf();
-    out = ss.str();
-    return true;
-}
+namespace {
 
-struct JsonValue {
-    enum class Type { Null, Number, Bool, String, Array, Object } type{Type::Null};
-    double number{0.0};
-    bool boolean{false};
-    std::string string;
-    std::vector<JsonValue> array;
-    std::vector<std::pair<std::string, JsonValue>> object;
+// Scalar members of Scene by JSON key; exactly one pointer is set.
+struct SceneField {
+    const char* name;
+    int Scene::*i;
+    double Scene::*d;
+    bool Scene::*b;
 };
 
-class JsonParser {
-public:
-    explicit JsonParser(const std::string& text) : s_(text) {}
-
-    JsonValue parse() {
-        skip_ws();
-        JsonValue v = parse_value();
-        skip_ws();
-        if (!eof()) {
-            throw std::runtime_error("unexpected trailing characters");
-        }
-        return v;
-    }
+constexpr SceneField int_field(const char* name, int Scene::*m) { return {name, m, nullptr, nullptr}; }
+constexpr SceneField real_field(const char* name, double Scene::*m) { return {name, nullptr, m, nullptr}; }
+constexpr SceneField bool_field(const char* name, bool Scene::*m) { return {name, nullptr, nullptr, m}; }
+
+constexpr SceneField kSceneFields[] = {
+    int_field("Nx", &Scene::Nx),
+    int_field("Ny", &Scene::Ny),
+    real_field("dt", &Scene::dt),
+    real_field("cap_strength", &Scene::cap_strength),
+    real_field("cap_ratio", &Scene::cap_ratio),
+    real_field("well_cutoff", &Scene::well_cutoff),
+    int_field("steps", &Scene::steps),
+    real_field("magnetic_field", &Scene::magnetic_field),
+    real_field("rel_mass_drift_tol", &Scene::rel_mass_drift_tol),
+    real_field("rel_cap_mass_growth_tol", &Scene::rel_cap_mass_growth_tol),
+    real_field("rel_interior_mass_drift_tol", &Scene::rel_interior_mass_drift_tol),
+    real_field("interior_mass_drift_vs_total_tol", &Scene::interior_mass_drift_vs_total_tol),
+    real_field("min_initial_interior_mass_fraction", &Scene::min_initial_interior_mass_fraction),
+    real_field("min_interior_area_fraction", &Scene::min_interior_area_fraction),
+    int_field("stability_warmup_steps", &Scene::stability_warmup_steps),
+    int_field("stability_check_every_n_steps", &Scene::stability_check_every_n_steps),
+    bool_field("interior_drift_hard_fail", &Scene::interior_drift_hard_fail),
+    bool_field("auto_pause_on_instability", &Scene::auto_pause_on_instability),
+    bool_field("adaptive_dt", &Scene::adaptive_dt),
+    real_field("adaptive_tol", &Scene::adaptive_tol),
+    real_field("adaptive_dt_min", &Scene::adaptive_dt_min),
+    real_field("adaptive_dt_max", &Scene::adaptive_dt_max),
+    int_field("observables_every", &Scene::observables_every),
+    int_field("spatial_order", &Scene::spatial_order),
+    bool_field("active_window", &Scene::active_window),
+    real_field("active_window_threshold", &Scene::active_window_threshold),
+    int_field("active_window_margin", &Scene::active_window_margin),
+};
 
-private:
-    const std::string& s_;
-    size_t pos_{0};
+// Numeric members of a listed object by JSON key (d or i set)
+template <typename T>
+struct ItemField {
+    const char* name;
+    double T::*d;
+    int T::*i;
+};
 
-    bool eof() const { return pos_ >= s_.size(); }
-    char peek() const { return eof() ? '\0' : s_[pos_]; }
-    char get() { return eof() ? '\0' : s_[pos_++]; }
+constexpr ItemField<SceneBox> kBoxFields[] = {
+    {"x0", &SceneBox::x0, nullptr}, {"y0", &SceneBox::y0, nullptr}, {"x1", &SceneBox::x1, nullptr},
+    {"y1", &SceneBox::y1, nullptr}, {"height", &SceneBox::height, nullptr},
+};
+constexpr ItemField<SceneWell> kWellFields[] = {
+    {"cx", &SceneWell::cx, nullptr}, {"cy", &SceneWell::cy, nullptr}, {"strength", &SceneWell::strength, nullptr},
+    {"radius", &SceneWell::radius, nullptr}, {"profile", nullptr, &SceneWell::profile},
+};
+constexpr ItemField<ScenePacket> kPacketFields[] = {
+    {"cx", &ScenePacket::cx, nullptr}, {"cy", &ScenePacket::cy, nullptr}, {"sigma", &ScenePacket::sigma, nullptr},
+    {"amplitude", &ScenePacket::amplitude, nullptr}, {"kx", &ScenePacket::kx, nullptr}, {"ky", &ScenePacket::ky, nullptr},
+};
+constexpr ItemField<SceneProbe> kProbeFields[] = {
+    {"x0", &SceneProbe::x0, nullptr}, {"y0", &SceneProbe::y0, nullptr},
+    {"x1", &SceneProbe::x1, nullptr}, {"y1", &SceneProbe::y1, nullptr},
+};
 
-    void skip_ws() {
-        while (!eof() && std::isspace(static_cast<unsigned char>(s_[pos_]))) {
-            ++pos_;
-        }
+template <typename T, size_t N>
+int find_field(const T (&fields)[N], std::string_view key) {
+    for (size_t k = 0; k < N; ++k) {
+        if (key == fields[k].name) return static_cast<int>(k);
     }
+    return -1;
+}
+
+template <typename T, size_t N>
+void set_item_field(const ItemField<T> (&fields)[N], int field, T& item, double v) {
+    if (field < 0) return;
+    const ItemField<T>& f = fields[field];
+    if (f.d) item.*(f.d) = v;
+    else item.*(f.i) = static_cast<int>(std::llround(v));
+}
 
-    void expect(char c) {
-        if (get() != c) {
-            throw std::runtime_error("unexpected token");
+// Fills a Scene from JSON events, so the text and tree readers share one
+// field mapping. Root members of the wrong type are ignored (the field keeps
+// its value); the object lists are replaced by the document's, skipping items
+// that are not objects and probes of unknown kind. With overlay, only the lists
+// the document names are replaced and the others keep their items.
+class SceneBuilder final : public JsonHandler {
+public:
+    explicit SceneBuilder(Scene& s, bool overlay = false) : s_(s), overlay_(overlay) {}
+
+    bool ok() const { return sawRoot_; }
+
+    void start_object() override {
+        if (skip_ || (depth_ == 0 && sawRoot_)) {
+            ++skip_;
+        } else if (depth_ == 0) {
+            sawRoot_ = true;
+            depth_ = 1;
+            if (!overlay_) {
+                s_.boxes.clear();
+                s_.wells.clear();
+                s_.packets.clear();
+                s_.probes.clear();
+            }
+        } else if (depth_ == 2) {
+            start_item();
+            depth_ = 3;
+        } else {
+            ++skip_;
         }
     }
 
-    bool consume(const char* kw) {
-        size_t n = std::char_traits<char>::length(kw);
-        if (s_.compare(pos_, n, kw) == 0) {
-            pos_ += n;
-            return true;
+    void end_object() override {
+        if (skip_) {
+            --skip_;
+        } else if (depth_ == 3) {
+            finish_item();
+            depth_ = 2;
+        } else {
+            depth_ = 0;
         }
-        return false;
     }
 
-    JsonValue parse_value() {
-        skip_ws();
-        char c = peek();
-        if (c == '{') return parse_object();
-        if (c == '[') return parse_array();
-        if (c == '"') {
-            JsonValue v;
-            v.type = JsonValue::Type::String;
-            v.string = parse_string();
-            return v;
-        }
-        if (c == '-' || (c >= '0' && c <= '9')) return parse_number();
-        if (consume("true")) {
-            JsonValue v;
-            v.type = JsonValue::Type::Bool;
-            v.boolean = true;
-            return v;
+    void start_array(std::size_t sizeHint) override {
+        if (skip_ || depth_ != 1 || list_ == List::None) {
+            ++skip_;
+            return;
         }
-        if (consume("false")) {
-            JsonValue v;
-            v.type = JsonValue::Type::Bool;
-            v.boolean = false;
-            return v;
+        depth_ = 2;
+        switch (list_) {
+        case List::Boxes: s_.boxes.clear(); s_.boxes.reserve(sizeHint); break;
+        case List::Wells: s_.wells.clear(); s_.wells.reserve(sizeHint); break;
+        case List::Packets: s_.packets.clear(); s_.packets.reserve(sizeHint); break;
+        case List::Probes: s_.probes.clear(); s_.probes.reserve(sizeHint); break;
+        case List::None: break;
         }
-        if (consume("null")) {
-            JsonValue v;
-            v.type = JsonValue::Type::Null;
-            return v;
+    }
+
+    void end_array() override {
+        if (skip_) {
+            --skip_;
+        } else {
+            depth_ = 1;
         }
-        throw std::runtime_error("invalid json value");
     }
 
-    std::string parse_string() {
-        expect('"');
-        std::string out;
-        while (!eof()) {
-            char c = get();
-            if (c == '"') {
-                return out;
-            }
-            if (c == '\\') {
-                if (eof()) throw std::runtime_error("invalid escape");
-                char e = get();
-                switch (e) {
-                    case '"': out.push_back('"'); break;
-                    case '\\': out.push_back('\\'); break;
-                    case '/': out.push_back('/'); break;
-                    case 'b': out.push_back('\b'); break;
-                    case 'f': out.push_back('\f'); break;
-                    case 'n': out.push_back('\n'); break;
-                    case 'r': out.push_back('\r'); break;
-                    case 't': out.push_back('\t'); break;
-                    default: throw std::runtime_error("unsupported escape");
-                }
-            } else {
-                out.push_back(c);
+    void key(std::string_view k) override {
+        if (skip_) return;
+        if (depth_ == 1) {
+            field_ = find_field(kSceneFields, k);
+            list_ = k == "boxes" ? List::Boxes : k == "wells" ? List::Wells : k == "packets" ? List::Packets
+                  : k == "probes" ? List::Probes : List::None;
+            special_ = k == "precision" ? Special::Precision : k == "engine" ? Special::Engine : Special::None;
+        } else if (depth_ == 3) {
+            switch (list_) {
+            case List::Boxes: field_ = find_field(kBoxFields, k); break;
+            case List::Wells: field_ = find_field(kWellFields, k); break;
+            case List::Packets: field_ = find_field(kPacketFields, k); break;
+            case List::Probes:
+                field_ = find_field(kProbeFields, k);
+                special_ = k == "kind" ? Special::ProbeKind : k == "name" ? Special::ProbeName : Special::None;
+                break;
+            case List::None: break;
             }
         }
-        throw std::runtime_error("unterminated string");
     }
 
-    JsonValue parse_number() {
-        size_t start = pos_;
-        if (peek() == '-') ++pos_;
-        if (peek() == '0') {
-            ++pos_;
-        } else {
-            if (peek() < '1' || peek() > '9') throw std::runtime_error("invalid number");
-            while (peek() >= '0' && peek() <= '9') ++pos_;
-        }
-        if (peek() == '.') {
-            ++pos_;
-            if (peek() < '0' || peek() > '9') throw std::runtime_error("invalid fraction");
-            while (peek() >= '0' && peek() <= '9') ++pos_;
-        }
-        if (peek() == 'e' || peek() == 'E') {
-            ++pos_;
-            if (peek() == '+' || peek() == '-') ++pos_;
-            if (peek() < '0' || peek() > '9') throw std::runtime_error("invalid exponent");
-            while (peek() >= '0' && peek() <= '9') ++pos_;
+    void number(double v) override {
+        if (skip_) return;
+        if (depth_ == 1 && field_ >= 0) {
+            const SceneField& f = kSceneFields[field_];
+            if (f.i) s_.*(f.i) = static_cast<int>(std::llround(v));
+            else if (f.d) s_.*(f.d) = v;
+        } else if (depth_ == 3) {
+            switch (list_) {
+            case List::Boxes: set_item_field(kBoxFields, field_, s_.boxes.back(), v); break;
+            case List::Wells: set_item_field(kWellFields, field_, s_.wells.back(), v); break;
+            case List::Packets: set_item_field(kPacketFields, field_, s_.packets.back(), v); break;
+            case List::Probes: set_item_field(kProbeFields, field_, s_.probes.back(), v); break;
+            case List::None: break;
+            }
         }
+    }
 
-        JsonValue v;
-        v.type = JsonValue::Type::Number;
-        v.number = std::stod(s_.substr(start, pos_ - start));
-        return v;
+    void boolean(bool v) override {
+        if (skip_ || depth_ != 1 || field_ < 0) return;
+        if (bool Scene::*b = kSceneFields[field_].b) s_.*b = v;
     }
 
-    JsonValue parse_array() {
-        expect('[');
-        JsonValue v;
-        v.type = JsonValue::Type::Array;
-        skip_ws();
-        if (peek() == ']') {
-            get();
-            return v;
-        }
-        while (true) {
-            v.array.push_back(parse_value());
-            skip_ws();
-            if (peek() == ']') {
-                get();
-                return v;
-            }
-            expect(',');
-            skip_ws();
-        }
+    void string(std::string_view v) override {
+        if (skip_) return;
+        const std::string text(v);
+        if (depth_ == 1 && special_ == Special::Precision) sim::parse_precision(text, s_.precision);
+        else if (depth_ == 1 && special_ == Special::Engine) sim::parse_engine(text, s_.engine);
+        else if (depth_ == 3 && special_ == Special::ProbeKind) probeKind_ = text;
+        else if (depth_ == 3 && special_ == Special::ProbeName) s_.probes.back().name = text;
     }
 
-    JsonValue parse_object() {
-        expect('{');
-        JsonValue v;
-        v.type = JsonValue::Type::Object;
-        skip_ws();
-        if (peek() == '}') {
-            get();
-            return v;
+    void null() override {}
+
+private:
+    enum class List { None, Boxes, Wells, Packets, Probes };
+    enum class Special { None, Precision, Engine, ProbeKind, ProbeName };
+
+    Scene& s_;
+    bool overlay_;
+    bool sawRoot_{false};
+    int depth_{0};  // 1: root members, 2: a list, 3: members of a list item
+    int skip_{0};   // nesting inside a value that is ignored
+    int field_{-1}; // current key in kSceneFields or the list's field table
+    List list_{List::None};
+    Special special_{Special::None};
+    std::string probeKind_;
+
+    void start_item() {
+        field_ = -1;
+        special_ = Special::None;
+        switch (list_) {
+        case List::Boxes: s_.boxes.push_back(SceneBox{}); break;
+        case List::Wells: s_.wells.push_back(SceneWell{}); break;
+        case List::Packets: s_.packets.push_back(ScenePacket{}); break;
+        case List::Probes:
+            s_.probes.push_back(SceneProbe{sim::Probe::Kind::Region, std::string(), 0.0, 0.0, 1.0, 1.0});
+            probeKind_ = "region";
+            break;
+        case List::None: break;
         }
-        while (true) {
-            if (peek() != '"') throw std::runtime_error("object key expected");
-            std::string key = parse_string();
-            skip_ws();
-            expect(':');
-            JsonValue value = parse_value();
-            v.object.push_back({std::move(key), std::move(value)});
-            skip_ws();
-            if (peek() == '}') {
-                get();
-                return v;
-            }
-            expect(',');
-            skip_ws();
+    }
+
+    void finish_item() {
+        if (list_ != List::Probes) return;
+        SceneProbe& p = s_.probes.back();
+        if (!sim::parse_probe_kind(probeKind_, p.kind)) {
+            s_.probes.pop_back();
+            return;
         }
+        if (p.name.empty()) p.name = sim::probe_kind_name(p.kind) + std::to_string(s_.probes.size() - 1);
     }
 };
 
-static const JsonValue* get_member(const JsonValue& obj, const char* key) {
-    if (obj.type != JsonValue::Type::Object) return nullptr;
-    for (const auto& kv : obj.object) {
-        if (kv.first == key) return &kv.second;
-    }
-    return nullptr;
-}
+} // namespace
 
-static double as_number(const JsonValue* v, double def) {
-    if (!v || v->type != JsonValue::Type::Number) return def;
-    return v->number;
+bool load_scene(const std::string& path, Scene& sc) {
+    MappedFile file;
+    return file.open(path) && parse_scene(file.text(), sc);
 }
 
-static int as_int(const JsonValue* v, int def) {
-    if (!v || v->type != JsonValue::Type::Number) return def;
-    return static_cast<int>(std::llround(v->number));
+static bool parse_scene_text(std::string_view text, Scene& sc, std::string* error, bool overlay) {
+    Scene parsed = sc;
+    SceneBuilder builder(parsed, overlay);
+    if (!parse_json(text, builder, error)) return false;
+    if (!builder.ok()) {
+        if (error) *error = "scene must be a JSON object";
+        return false;
+    }
+    sc = std::move(parsed);
+    return true;
 }
 
-static bool as_bool(const JsonValue* v, bool def) {
-    if (!v || v->type != JsonValue::Type::Bool) return def;
-    return v->boolean;
+bool parse_scene(std::string_view text, Scene& sc, std::string* error) {
+    return parse_scene_text(text, sc, error, false);
 }
 
-bool load_scene(const std::string& path, Scene& sc) {
-    std::string txt;
-    if (!read_file(path, txt)) return false;
+bool overlay_scene(std::string_view text, Scene& sc, std::string* error) {
+    return parse_scene_text(text, sc, error, true);
+}
 
-    JsonValue root;
-    try {
-        root = JsonParser(txt).parse();
-    } catch (const std::exception&) {
-        return false;
-    }
+bool scene_from_json(const JsonValue& root, Scene& sc) {
     if (root.type != JsonValue::Type::Object) return false;
-
-    sc.Nx = as_int(get_member(root, "Nx"), sc.Nx);
-    sc.Ny = as_int(get_member(root, "Ny"), sc.Ny);
-    sc.dt = as_number(get_member(root, "dt"), sc.dt);
-    sc.cap_strength = as_number(get_member(root, "cap_strength"), sc.cap_strength);
-    sc.cap_ratio = as_number(get_member(root, "cap_ratio"), sc.cap_ratio);
-    sc.steps = as_int(get_member(root, "steps"), sc.steps);
-    sc.rel_mass_drift_tol = as_number(get_member(root, "rel_mass_drift_tol"), sc.rel_mass_drift_tol);
-    sc.rel_cap_mass_growth_tol = as_number(get_member(root, "rel_cap_mass_growth_tol"), sc.rel_cap_mass_growth_tol);
-    sc.rel_interior_mass_drift_tol = as_number(get_member(root, "rel_interior_mass_drift_tol"), sc.rel_interior_mass_drift_tol);
-    sc.interior_mass_drift_vs_total_tol = as_number(get_member(root, "interior_mass_drift_vs_total_tol"), sc.interior_mass_drift_vs_total_tol);
-    sc.min_initial_interior_mass_fraction = as_number(get_member(root, "min_initial_interior_mass_fraction"), sc.min_initial_interior_mass_fraction);
-    sc.min_interior_area_fraction = as_number(get_member(root, "min_interior_area_fraction"), sc.min_interior_area_fraction);
-    sc.stability_warmup_steps = as_int(get_member(root, "stability_warmup_steps"), sc.stability_warmup_steps);
-    sc.interior_drift_hard_fail = as_bool(get_member(root, "interior_drift_hard_fail"), sc.interior_drift_hard_fail);
-    sc.auto_pause_on_instability = as_bool(get_member(root, "auto_pause_on_instability"), sc.auto_pause_on_instability);
-
-    sc.boxes.clear();
-    sc.wells.clear();
-    sc.packets.clear();
-
-    if (const JsonValue* boxes = get_member(root, "boxes"); boxes && boxes->type == JsonValue::Type::Array) {
-        for (const auto& item : boxes->array) {
-            if (item.type != JsonValue::Type::Object) continue;
-            SceneBox b{};
-            b.x0 = as_number(get_member(item, "x0"), 0.0);
-            b.y0 = as_number(get_member(item, "y0"), 0.0);
-            b.x1 = as_number(get_member(item, "x1"), 0.0);
-            b.y1 = as_number(get_member(item, "y1"), 0.0);
-            b.height = as_number(get_member(item, "height"), 0.0);
-            sc.boxes.push_back(b);
-        }
-    }
-
-    if (const JsonValue* wells = get_member(root, "wells"); wells && wells->type == JsonValue::Type::Array) {
-        for (const auto& item : wells->array) {
-            if (item.type != JsonValue::Type::Object) continue;
-            SceneWell w{};
-            w.cx = as_number(get_member(item, "cx"), 0.0);
-            w.cy = as_number(get_member(item, "cy"), 0.0);
-            w.strength = as_number(get_member(item, "strength"), 0.0);
-            w.radius = as_number(get_member(item, "radius"), 0.0);
-            w.profile = as_int(get_member(item, "profile"), 0);
-            sc.wells.push_back(w);
-        }
-    }
-
-    if (const JsonValue* packets = get_member(root, "packets"); packets && packets->type == JsonValue::Type::Array) {
-        for (const auto& item : packets->array) {
-            if (item.type != JsonValue::Type::Object) continue;
-            ScenePacket p{};
-            p.cx = as_number(get_member(item, "cx"), 0.0);
-            p.cy = as_number(get_member(item, "cy"), 0.0);
-            p.sigma = as_number(get_member(item, "sigma"), 0.0);
-            p.amplitude = as_number(get_member(item, "amplitude"), 0.0);
-            p.kx = as_number(get_member(item, "kx"), 0.0);
-            p.ky = as_number(get_member(item, "ky"), 0.0);
-            sc.packets.push_back(p);
-        }
-    }
-
+    SceneBuilder builder(sc);
+    replay_json(root, builder);
     return true;
 }
 
 void from_simulation(const sim::Simulation& srcSim, Scene& s) {
     s.Nx = srcSim.Nx;
     s.Ny = srcSim.Ny;
-    s.dt = srcSim.dt;
+    // An adaptive run's dt is its last step; the scene keeps the nominal one
+    s.dt = srcSim.adaptive.enabled && srcSim.adaptive.dt_nominal > 0.0 ? srcSim.adaptive.dt_nominal : srcSim.dt;
     s.cap_ratio = srcSim.pfield.cap_ratio;
+    s.well_cutoff = srcSim.pfield.well_cutoff;
     s.cap_strength = srcSim.pfield.cap_strength;
     s.rel_mass_drift_tol = srcSim.stability.rel_mass_drift_tol;
     s.rel_cap_mass_growth_tol = srcSim.stability.rel_cap_mass_growth_tol;
@@ -367,8 +392,20 @@ void from_simulation(const sim::Simulation& srcSim, Scene& s) {
     s.min_initial_interior_mass_fraction = srcSim.stability.min_initial_interior_mass_fraction;
     s.min_interior_area_fraction = srcSim.stability.min_interior_area_fraction;
     s.stability_warmup_steps = srcSim.stability.warmup_steps;
+    s.stability_check_every_n_steps = srcSim.stability.check_every_n_steps;
     s.interior_drift_hard_fail = srcSim.stability.interior_drift_hard_fail;
     s.auto_pause_on_instability = srcSim.stability.auto_pause_on_instability;
+    s.precision = srcSim.precision;
+    s.engine = srcSim.engine;
+    s.magnetic_field = srcSim.magneticField;
+    s.spatial_order = srcSim.spatialOrder;
+    s.adaptive_dt = srcSim.adaptive.enabled;
+    s.adaptive_tol = srcSim.adaptive.tol;
+    s.adaptive_dt_min = srcSim.adaptive.dt_min;
+    s.adaptive_dt_max = srcSim.adaptive.dt_max;
+    s.active_window = srcSim.activeRegion.enabled;
+    s.active_window_threshold = srcSim.activeRegion.threshold;
+    s.active_window_margin = srcSim.activeRegion.margin;
     s.boxes.clear();
     s.wells.clear();
     s.packets.clear();
@@ -377,6 +414,24 @@ void from_simulation(const sim::Simulation& srcSim, Scene& s) {
         s.wells.push_back({w.cx, w.cy, w.strength, w.radius, (int)w.profile});
     }
     for (const auto& p : srcSim.packets) s.packets.push_back({p.cx,p.cy,p.sigma,p.amplitude,p.kx,p.ky});
+    s.probes.clear();
+    for (const auto& p : srcSim.observables.probes) s.probes.push_back({p.kind,p.name,p.x0,p.y0,p.x1,p.y1});
+    s.observables_every = srcSim.observables.every;
+}
+
+static sim::StabilityConfig stability_config(const Scene& s) {
+    sim::StabilityConfig c;
+    c.rel_mass_drift_tol = s.rel_mass_drift_tol;
+    c.rel_cap_mass_growth_tol = s.rel_cap_mass_growth_tol;
+    c.rel_interior_mass_drift_tol = s.rel_interior_mass_drift_tol;
+    c.interior_mass_drift_vs_total_tol = s.interior_mass_drift_vs_total_tol;
+    c.min_initial_interior_mass_fraction = s.min_initial_interior_mass_fraction;
+    c.min_interior_area_fraction = s.min_interior_area_fraction;
+    c.warmup_steps = s.stability_warmup_steps;
+    c.check_every_n_steps = std::max(1, s.stability_check_every_n_steps);
+    c.interior_drift_hard_fail = s.interior_drift_hard_fail;
+    c.auto_pause_on_instability = s.auto_pause_on_instability;
+    return c;
 }
 
 void to_simulation(const Scene& s, sim::Simulation& dstSim) {
@@ -395,50 +450,194 @@ void to_simulation(const Scene& s, sim::Simulation& dstSim) {
         dstSim.pfield.wells.push_back(rw);
     }
     dstSim.pfield.cap_ratio = s.cap_ratio;
+    dstSim.pfield.well_cutoff = s.well_cutoff;
     dstSim.pfield.cap_strength = s.cap_strength;
-    dstSim.stability.rel_mass_drift_tol = s.rel_mass_drift_tol;
-    dstSim.stability.rel_cap_mass_growth_tol = s.rel_cap_mass_growth_tol;
-    dstSim.stability.rel_interior_mass_drift_tol = s.rel_interior_mass_drift_tol;
-    dstSim.stability.interior_mass_drift_vs_total_tol = s.interior_mass_drift_vs_total_tol;
-    dstSim.stability.min_initial_interior_mass_fraction = s.min_initial_interior_mass_fraction;
-    dstSim.stability.min_interior_area_fraction = s.min_interior_area_fraction;
-    dstSim.stability.warmup_steps = s.stability_warmup_steps;
-    dstSim.stability.interior_drift_hard_fail = s.interior_drift_hard_fail;
-    dstSim.stability.auto_pause_on_instability = s.auto_pause_on_instability;
-    dstSim.pfield.build(dstSim.V);
+    dstSim.stability = stability_config(s);
+    dstSim.precision = s.precision;
+    dstSim.engine = s.engine;
+    dstSim.magneticField = s.magnetic_field;
+    dstSim.spatialOrder = s.spatial_order == 4 ? 4 : 2;
+    dstSim.adaptive.enabled = s.adaptive_dt;
+    dstSim.adaptive.tol = s.adaptive_tol;
+    dstSim.adaptive.dt_nominal = s.dt;
+    dstSim.adaptive.dt_min = s.adaptive_dt_min > 0.0 ? s.adaptive_dt_min : s.dt / 64.0;
+    dstSim.adaptive.dt_max = s.adaptive_dt_max > 0.0 ? s.adaptive_dt_max : s.dt * 16.0;
+    dstSim.activeRegion.enabled = s.active_window;
+    dstSim.activeRegion.threshold = s.active_window_threshold;
+    dstSim.activeRegion.margin = std::max(0, s.active_window_margin);
+    dstSim.rebuild_potential();
     dstSim.packets.clear();
     for (const auto& p : s.packets) dstSim.packets.push_back({p.cx,p.cy,p.sigma,p.amplitude,p.kx,p.ky});
+    dstSim.observables.probes.clear();
+    for (const auto& p : s.probes) dstSim.observables.probes.push_back({p.kind,p.name,p.x0,p.y0,p.x1,p.y1});
+    dstSim.observables.every = std::max(1, s.observables_every);
     dstSim.reset();
 }
 
-int run_example_cli(const std::string& scene_path) {
-    Scene s;
-    if (!scene_path.empty()) {
-        if (!load_scene(scene_path, s)) {
-            std::cerr << "Failed to load scene: " << scene_path << "\n";
-            return 2;
+// Runs the scene's steps at the given precision.
+static void run_scene_steps(const Scene& s, sim::Precision precision, int threads, sim::Simulation& simulation) {
+    simulation.set_threads(threads);
+    to_simulation(s, simulation);
+    simulation.precision = precision;
+    if (simulation.adaptive.enabled) {
+        simulation.advance_to(s.steps * s.dt);
+    } else {
+        for (int i = 0; i < s.steps; ++i) simulation.step();
+    }
+    simulation.sync_diagnostics(); // steps after the last cadence check
+    simulation.sync_psi();
+}
+
+// Achieved dt of an adaptive run: totals, then one line per run of equal steps.
+static void report_adaptive(const sim::Simulation& simulation) {
+    const sim::AdaptiveStats& st = simulation.stepper.stats;
+    double span = 0.0; // time covered by the recorded steps (less than time after a restart)
+    for (const sim::DtSegment& seg : st.history) span += seg.dt * static_cast<double>(seg.steps);
+    std::cout << "Adaptive time=" << simulation.time << " accepted=" << st.accepted
+              << " rejected=" << st.errorRejects + st.stabilityRejects << " (error=" << st.errorRejects
+              << " stability=" << st.stabilityRejects << ") tol=" << simulation.adaptive.tol
+              << " dt_min=" << st.minDt << " dt_max=" << st.maxDt
+              << " dt_mean=" << (st.accepted ? span / static_cast<double>(st.accepted) : 0.0) << "\n";
+    for (const sim::DtSegment& seg : st.history) {
+        std::cout << "DtHistory t=" << seg.t0 << " dt=" << seg.dt << " steps=" << seg.steps << "\n";
+    }
+}
+
+// Float vs double accuracy report for the same scene.
+static void report_precision_comparison(const Scene& s, int threads) {
+    sim::Simulation ref;
+    sim::Simulation low;
+    run_scene_steps(s, sim::Precision::Double, threads, ref);
+    run_scene_steps(s, sim::Precision::Float, threads, low);
+
+    double maxDiff = 0.0;
+    for (size_t k = 0; k < ref.psi.size(); ++k) {
+        maxDiff = std::max(maxDiff, std::abs(ref.psi[k] - low.psi[k]));
+    }
+    const double refMass = ref.diagnostics.current_mass;
+    const double lowMass = low.diagnostics.current_mass;
+    std::cout << "PrecisionCompare\n";
+    for (const sim::Simulation* run : {&ref, &low}) {
+        std::cout << sim::precision_name(run->precision)
+                  << " Mass=" << run->diagnostics.current_mass
+                  << " Drift=" << run->diagnostics.rel_mass_drift
+                  << " InteriorDrift=" << run->diagnostics.rel_interior_mass_drift << "\n";
+    }
+    std::cout << "MassRelDiff=" << std::fabs(lowMass - refMass) / std::max(1e-15, refMass)
+              << " MaxAbsPsiDiff=" << maxDiff << "\n";
+}
+
+// Steps a restarted, checkpointed, recorded or probed run up to `steps` in
+// total (up to endTime with adaptive dt), handing a snapshot to the background
+// writer every opts.checkpoint_every steps, a frame to the recorder every
+// opts.record_every steps and each probe sample to opts.observables_path.
+static bool run_instrumented_steps(const CliOptions& opts, int steps, double endTime, sim::Simulation& simulation) {
+    AsyncCheckpointWriter writer;
+    FrameRecorder recorder;
+    if (!opts.record_path.empty()) {
+        RecorderConfig config;
+        config.format = opts.record_format;
+        config.directory = opts.record_path;
+        config.stride = opts.record_every;
+        std::string error;
+        if (!recorder.start(config, simulation.Nx, simulation.Ny, simulation.dt, &error)) {
+            std::cerr << "Failed to start recording: " << error << "\n";
+            return false;
         }
+        recorder.maybe_capture(simulation);
     }
-    sim::Simulation simulation;
-    to_simulation(s, simulation);
+    SeriesWriter series;
+    if (!opts.observables_path.empty()) {
+        if (!simulation.observables.active()) {
+            std::cerr << "The scene declares no probes; " << opts.observables_path << " only gets the total mass\n";
+        }
+        std::string error;
+        if (!series.open(opts.observables_path, simulation.observables, simulation.dt, &error)) {
+            std::cerr << "Failed to start observables output: " << error << "\n";
+            return false;
+        }
+        simulation.sample_observables(); // the starting point of the series
+        series.maybe_write(simulation.observables);
+    }
+    const bool periodic = !opts.checkpoint_path.empty() && opts.checkpoint_every > 0;
+    const bool adaptive = simulation.adaptive.enabled;
+    while (adaptive ? simulation.time < endTime * (1.0 - 1e-12)
+                    : simulation.stepCount < static_cast<std::uint64_t>(std::max(0, steps))) {
+        if (adaptive) simulation.step_adaptive(endTime - simulation.time);
+        else simulation.step();
+        if (periodic && simulation.stepCount % static_cast<std::uint64_t>(opts.checkpoint_every) == 0) {
+            writer.submit(opts.checkpoint_path, simulation, opts.checkpoint_compress);
+        }
+        if (recorder.active()) recorder.maybe_capture(simulation);
+        if (series.active()) series.maybe_write(simulation.observables);
+    }
+    simulation.sync_diagnostics();
+    if (series.active()) {
+        series.close();
+        std::cerr << "Observables: " << series.rows_written() << " samples written to " << opts.observables_path << "\n";
+        if (!series.ok()) {
+            std::cerr << "Failed to write " << opts.observables_path << "\n";
+            return false;
+        }
+    }
+    if (recorder.active()) {
+        recorder.stop();
+        std::cerr << "Recorded " << recorder.frames_written() << " frames (" << recorder.frames_dropped()
+                  << " dropped, " << recorder.bytes_written() << " bytes) to " << opts.record_path << "\n";
+        const std::string error = recorder.last_error();
+        if (!error.empty()) std::cerr << "Recorder: " << error << "\n";
+    }
+    if (!opts.checkpoint_path.empty()) {
+        writer.submit(opts.checkpoint_path, simulation, opts.checkpoint_compress);
+        writer.wait();
+        if (!writer.last_ok()) {
+            std::cerr << "Failed to write checkpoint: " << writer.last_error() << "\n";
+            return false;
+        }
+    }
+    return true;
+}
 
-    // Run N steps
-    for (int i = 0; i < s.steps; ++i) simulation.step();
+// Replaces stepping with spectral evolution: solves the lowest modes, projects
+// the initial psi onto them and evaluates psi at steps * dt directly.
+static bool run_spectral_steps(const CliOptions& opts, int steps, sim::Simulation& simulation) {
+    sim::EigenSolverOptions options;
+    options.modes = opts.spectral_modes;
+    options.maxIter = 2000 * opts.spectral_modes;
+    options.tol = 1e-8;
+    const sim::EigenResult solved = sim::solve_eigenstates(simulation.eigen_problem(), options, simulation.pool.get());
+    if (solved.states.empty()) {
+        std::cerr << "Spectral: no eigenmodes found\n";
+        return false;
+    }
+    const double residual = simulation.project_spectral(solved.states);
+    std::cout << "Spectral modes=" << solved.states.size() << " converged=" << solved.converged
+              << " iterations=" << solved.iterations << " residual=" << residual << "\n";
+    simulation.evolve_spectral(static_cast<std::uint64_t>(std::max(0, steps)));
+    return true;
+}
 
-    // Diagnostics: norm and split mass (approx transmission/reflection)
-    double M = simulation.mass();
-    double L = 0.0;
-    double R = 0.0;
-    simulation.mass_split(L, R);
-    const auto& diag = simulation.diagnostics;
-    std::cout << "Diagnostics\n";
-    std::cout << "Nx=" << simulation.Nx << " Ny=" << simulation.Ny << " dt=" << simulation.dt << " steps=" << s.steps << "\n";
+// Mass line of the diagnostics report.
+static void print_masses(const sim::StabilityDiagnostics& diag) {
     std::cout << std::setprecision(8);
-    std::cout << "Mass=" << M << " Left=" << L << " Right=" << R
+    std::cout << "Mass=" << diag.current_mass << " Left=" << diag.left_mass << " Right=" << diag.right_mass
               << " Interior=" << diag.current_interior_mass
               << " Drift=" << diag.rel_mass_drift
               << " InteriorDrift=" << diag.rel_interior_mass_drift
               << " InteriorDriftVsTotal=" << diag.rel_interior_mass_drift_vs_total << "\n";
+}
+
+// Latest probe sample, one name=value per column.
+static void print_observables(const sim::Observables& obs) {
+    if (!obs.active() || obs.samples == 0) return;
+    const std::vector<std::string> names = obs.columns();
+    std::cout << "Observables step=" << obs.sampleStep << " time=" << obs.sampleTime;
+    for (size_t k = 0; k < names.size() && k < obs.values.size(); ++k) std::cout << " " << names[k] << "=" << obs.values[k];
+    std::cout << "\n";
+}
+
+// Stability lines of the report; returns the exit code.
+static int report_stability(const sim::StabilityDiagnostics& diag) {
     if (diag.warning) {
         std::cout << "Stability=WARNING reason=\"" << diag.warning_reason << "\"\n";
     }
@@ -455,5 +654,142 @@ int run_example_cli(const std::string& scene_path) {
     return 0;
 }
 
+#if S2D_HAVE_MPI
+// Runs the scene's steps split over the MPI ranks (sim/distributed.hpp); rank 0 reports.
+static int run_distributed_example(const Scene& s, const CliOptions& opts) {
+    sim::DistributedSimulation dist;
+    const bool root = dist.rank() == 0;
+    auto fail = [root](const char* what) {
+        if (root) std::cerr << "Distributed run: " << what << "\n";
+        return 2;
+    };
+    if (s.engine != sim::Engine::CrankNicolsonADI || s.precision != sim::Precision::Double ||
+        s.magnetic_field != 0.0 || s.adaptive_dt || s.active_window || s.spatial_order != 2) {
+        return fail("only engine cn_adi in double precision with fixed dt, spatial order 2, no magnetic field "
+                    "and no active window");
+    }
+    if (opts.compare_precision || opts.spectral_modes > 0 || !opts.checkpoint_path.empty() ||
+        !opts.restart_path.empty() || !opts.record_path.empty() || !opts.profile_path.empty() ||
+        !opts.observables_path.empty() || !s.probes.empty()) {
+        return fail("checkpoints, recording, probes, profiling, spectral and precision comparison need a single process");
+    }
+    if (!sim::DistributedSimulation::fits(dist.ranks(), s.Nx, s.Ny)) {
+        return fail("more ranks than grid rows or columns");
+    }
+
+    dist.set_threads(opts.threads);
+    dist.dt = s.dt;
+    dist.pfield.cap_strength = s.cap_strength;
+    dist.pfield.cap_ratio = s.cap_ratio;
+    dist.pfield.well_cutoff = s.well_cutoff;
+    dist.pfield.boxes.clear();
+    for (const auto& b : s.boxes) dist.pfield.boxes.push_back({b.x0, b.y0, b.x1, b.y1, b.height});
+    dist.pfield.wells.clear();
+    for (const auto& w : s.wells) {
+        dist.pfield.wells.push_back({w.cx, w.cy, w.strength, w.radius, static_cast<sim::RadialWell::Profile>(w.profile)});
+    }
+    for (const auto& p : s.packets) dist.packets.push_back({p.cx, p.cy, p.sigma, p.amplitude, p.kx, p.ky});
+    dist.stability = stability_config(s);
+    dist.resize(s.Nx, s.Ny);
+
+    for (int i = 0; i < s.steps; ++i) dist.step();
+    dist.sync_diagnostics();
+
+    unsigned long long bytes = dist.local_bytes();
+    unsigned long long maxBytes = 0;
+    MPI_Reduce(&bytes, &maxBytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (!root) return dist.diagnostics.unstable ? 3 : 0;
+
+    std::cout << "Diagnostics\n";
+    std::cout << "Nx=" << dist.Nx << " Ny=" << dist.Ny << " dt=" << dist.dt << " steps=" << dist.stepCount
+              << " threads=" << dist.threads() << " precision=double engine=cn_adi\n";
+    print_masses(dist.diagnostics);
+    std::cout << "Distributed ranks=" << dist.ranks() << " rows_per_rank=" << sim::block_of(0, dist.ranks(), dist.Ny).size()
+              << " max_rank_bytes=" << maxBytes << "\n";
+    return report_stability(dist.diagnostics);
+}
+#endif
+
+int run_example_cli(const std::string& scene_path, const CliOptions& opts) {
+    Scene s;
+    if (!scene_path.empty()) {
+        if (!load_scene(scene_path, s)) {
+            std::cerr << "Failed to load scene: " << scene_path << "\n";
+            return 2;
+        }
+    }
+    if (opts.distributed) {
+#if S2D_HAVE_MPI
+        return run_distributed_example(s, opts);
+#else
+        std::cerr << "Distributed runs need a build with MPI (-DENABLE_MPI=ON)\n";
+        return 2;
+#endif
+    }
+    sim::Simulation simulation;
+    sim::profile::TraceRecorder trace;
+    if (!opts.profile_path.empty()) {
+        if (!sim::profile::available()) std::cerr << "Profiling was compiled out (ENABLE_PROFILER=OFF)\n";
+        trace.start();
+    }
+    if (!opts.restart_path.empty()) {
+        // The checkpoint supplies the scene; a scene file only sets the step target.
+        Scene stored;
+        std::string error;
+        simulation.set_threads(opts.threads);
+        if (!load_checkpoint(opts.restart_path, simulation, &error, &stored)) {
+            std::cerr << "Failed to load checkpoint " << opts.restart_path << ": " << error << "\n";
+            return 2;
+        }
+        if (!scene_path.empty()) stored.steps = s.steps;
+        s = stored;
+        if (!run_instrumented_steps(opts, s.steps, s.steps * s.dt, simulation)) return 2;
+    } else if (opts.spectral_modes > 0) {
+        simulation.set_threads(opts.threads);
+        to_simulation(s, simulation);
+        if (!run_spectral_steps(opts, s.steps, simulation)) return 2;
+    } else if (!opts.checkpoint_path.empty() || !opts.record_path.empty() || !opts.observables_path.empty()) {
+        simulation.set_threads(opts.threads);
+        to_simulation(s, simulation);
+        if (!run_instrumented_steps(opts, s.steps, s.steps * s.dt, simulation)) return 2;
+    } else {
+        run_scene_steps(s, s.precision, opts.threads, simulation);
+    }
+
+    if (!opts.profile_path.empty()) {
+        trace.stop();
+        std::string error;
+        if (!trace.write_chrome_trace(opts.profile_path, &error)) {
+            std::cerr << "Failed to write profile " << opts.profile_path << ": " << error << "\n";
+            return 2;
+        }
+        std::cerr << "Profile: " << trace.events() << " events (" << trace.dropped() << " dropped) written to "
+                  << opts.profile_path << "\n";
+    }
+
+    // Diagnostics: norm and split mass (approx transmission/reflection),
+    // taken from the final step's fused reduction
+    const auto& diag = simulation.diagnostics;
+    std::cout << "Diagnostics\n";
+    const bool adaptive = simulation.adaptive.enabled && opts.spectral_modes <= 0;
+    const sim::Engine engine = simulation.separable() ? simulation.engine : sim::Engine::CrankNicolsonMultigrid;
+    std::cout << "Nx=" << simulation.Nx << " Ny=" << simulation.Ny << " dt=" << simulation.dt
+              << " steps=" << (adaptive ? static_cast<long long>(simulation.stepCount) : s.steps)
+              << " threads=" << simulation.threads() << " precision=" << sim::precision_name(simulation.precision)
+              << " engine=" << (opts.spectral_modes > 0 ? "spectral" : sim::engine_name(engine)) << "\n";
+    print_masses(diag);
+    print_observables(simulation.observables);
+    if (adaptive) report_adaptive(simulation);
+    if (engine == sim::Engine::CrankNicolsonMultigrid && opts.spectral_modes <= 0) {
+        const auto& mg = simulation.multigrid;
+        std::cout << "Multigrid levels=" << mg.levels.size() << " iterations=" << mg.lastIterations
+                  << " residual=" << mg.lastResidual << " converged=" << (mg.lastConverged ? "yes" : "no") << "\n";
+    }
+    if (opts.compare_precision) {
+        report_precision_comparison(s, opts.threads);
+    }
+    return report_stability(diag);
+}
+
 } // namespace io
 
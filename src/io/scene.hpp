@@ -1,21 +1,28 @@
 #pragma once
 
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "recorder.hpp"
 #include "sim/simulation.hpp"
 
 namespace io {
 
+struct JsonValue; // json.hpp
+
 struct SceneBox { double x0,y0,x1,y1,height; };
 struct ScenePacket { double cx,cy,sigma,amplitude,kx,ky; };
 struct SceneWell { double cx,cy,strength,radius; int profile; };
+struct SceneProbe { sim::Probe::Kind kind; std::string name; double x0,y0,x1,y1; }; // see sim/observables.hpp
 
 struct Scene {
     int Nx{128}, Ny{128};
     double dt{0.001};
     double cap_strength{1.0};
     double cap_ratio{0.1};
+    double well_cutoff{1e-6}; // relative cutoff of radial well tails (0 = full grid)
     double rel_mass_drift_tol{0.15};
     double rel_cap_mass_growth_tol{0.01};
     double rel_interior_mass_drift_tol{1.0};
@@ -23,24 +30,65 @@ struct Scene {
     double min_initial_interior_mass_fraction{0.05};
     double min_interior_area_fraction{0.01};
     int stability_warmup_steps{8};
+    int stability_check_every_n_steps{1};
     bool interior_drift_hard_fail{false};
     bool auto_pause_on_instability{true};
     std::vector<SceneBox> boxes;
     std::vector<SceneWell> wells;
     std::vector<ScenePacket> packets;
+    // "probes": [{"kind": "flux", "name": "T", "x0": 0.6, "y0": 0, "x1": 0.6, "y1": 1}, ...]
+    std::vector<SceneProbe> probes;
+    int observables_every{10}; // time steps between probe samples
     int steps{600}; // for smoke example
+    sim::Precision precision{sim::Precision::Double}; // "precision": "double" | "float"
+    sim::Engine engine{sim::Engine::CrankNicolsonADI}; // "engine": "cn_adi" | "split_step" | "cn_mg"
+    double magnetic_field{0.0}; // uniform B_z; non-zero steps with cn_mg whatever the engine
+    int spatial_order{2}; // 2 | 4 (compact Laplacian in cn_adi steps and eigenmodes)
+    // Adaptive dt (CN-ADI, double): runs to time steps * dt instead of a step count
+    bool adaptive_dt{false};
+    double adaptive_tol{1e-5};   // local error per step relative to |psi|
+    double adaptive_dt_min{0.0}; // 0: dt / 64
+    double adaptive_dt_max{0.0}; // 0: dt * 16
+    // Cropped stepping (CN-ADI): only the occupied box plus a margin is stepped
+    bool active_window{false};
+    double active_window_threshold{1e-12}; // occupied: |psi|^2 dx dy above this fraction of the mass
+    int active_window_margin{16};          // cells around the occupied box
 };
 
-// Serialize/deserialize (minimal JSON; assumes well-formed input from our own writer)
+// Serialize/deserialize. Loading streams the (memory-mapped) text straight
+// into s without building a JsonValue tree.
 bool save_scene(const std::string& path, const Scene& s);
+void write_scene(std::ostream& out, const Scene& s);
 bool load_scene(const std::string& path, Scene& s);
+// Fields missing from the document keep their current values in s (scene
+// lists are replaced). On malformed input s is left unchanged.
+bool parse_scene(std::string_view text, Scene& s, std::string* error = nullptr);
+// Same, but a list the document does not name keeps its items in s (a scene
+// line of a batch over its base).
+bool overlay_scene(std::string_view text, Scene& s, std::string* error = nullptr);
+bool scene_from_json(const JsonValue& root, Scene& s); // same, from a parsed tree
 
 // Conversion helpers
 void from_simulation(const sim::Simulation& srcSim, Scene& s);
 void to_simulation(const Scene& s, sim::Simulation& dstSim);
 
 // CLI example runner
-int run_example_cli(const std::string& scene_path);
+struct CliOptions {
+    int threads{1}; // worker threads for stepping (<= 0: hardware thread count)
+    bool compare_precision{false}; // also run the scene in float and double and report both
+    std::string checkpoint_path;   // binary checkpoint written during/after the run (empty = none)
+    int checkpoint_every{0};       // steps between checkpoints (0 = only at the end)
+    bool checkpoint_compress{false};
+    std::string restart_path;      // resume from this checkpoint instead of the scene's initial state
+    std::string record_path;       // record frames into this directory (empty = none)
+    RecordFormat record_format{RecordFormat::PngSequence};
+    int record_every{10};          // steps between recorded frames
+    int spectral_modes{0};         // > 0: evolve by projection onto this many eigenmodes instead of stepping
+    std::string profile_path;      // Chrome trace of the run's timed stages (empty = none)
+    bool distributed{false};       // split the grid over the MPI ranks (sim/distributed.hpp; ENABLE_MPI builds)
+    std::string observables_path;  // stream the scene's probe samples here (.csv, else binary; empty = none)
+};
+int run_example_cli(const std::string& scene_path, const CliOptions& opts = {});
 
 } // namespace io
 
@@ -0,0 +1,91 @@
+#include "timeseries.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace io {
+
+namespace {
+
+constexpr char kSeriesMagic[8] = {'S', '2', 'D', 'S', 'E', 'R', 'S', '\0'};
+constexpr std::uint32_t kSeriesVersion = 1;
+
+struct SeriesHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t columns;
+    std::uint32_t nameBytes; // column names that follow the header
+    std::int32_t every;      // time steps between samples
+    double dt;
+    std::uint8_t reserved[32];
+};
+static_assert(sizeof(SeriesHeader) == 64, "series header layout");
+
+} // namespace
+
+SeriesFormat series_format_for(const std::string& path) {
+    const std::string ext(".csv");
+    const bool csv = path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+    return csv ? SeriesFormat::Csv : SeriesFormat::Binary;
+}
+
+SeriesWriter::~SeriesWriter() {
+    close();
+}
+
+bool SeriesWriter::open(const std::string& path, const sim::Observables& obs, double dt, std::string* error) {
+    close();
+    format_ = series_format_for(path);
+    out_ = std::fopen(path.c_str(), format_ == SeriesFormat::Csv ? "w" : "wb");
+    if (!out_) {
+        if (error) *error = "cannot open " + path;
+        return false;
+    }
+    const std::vector<std::string> names = obs.columns();
+    columns_ = names.size();
+    lastSample_ = obs.samples;
+    rows_ = 0;
+    ok_ = true;
+    if (format_ == SeriesFormat::Csv) {
+        std::fputs("step,time", out_);
+        for (const std::string& n : names) std::fprintf(out_, ",%s", n.c_str());
+        std::fputc('\n', out_);
+    } else {
+        std::string text;
+        for (const std::string& n : names) text += n + '\n';
+        SeriesHeader h{};
+        std::memcpy(h.magic, kSeriesMagic, sizeof(h.magic));
+        h.version = kSeriesVersion;
+        h.columns = static_cast<std::uint32_t>(columns_);
+        h.nameBytes = static_cast<std::uint32_t>(text.size());
+        h.every = obs.every;
+        h.dt = dt;
+        ok_ = std::fwrite(&h, sizeof(h), 1, out_) == 1 && std::fwrite(text.data(), 1, text.size(), out_) == text.size();
+    }
+    return ok_;
+}
+
+void SeriesWriter::close() {
+    if (!out_) return;
+    if (std::fclose(out_) != 0) ok_ = false;
+    out_ = nullptr;
+}
+
+void SeriesWriter::maybe_write(const sim::Observables& obs) {
+    if (!out_ || obs.samples == lastSample_ || obs.values.size() != columns_) return;
+    lastSample_ = obs.samples;
+    if (format_ == SeriesFormat::Csv) {
+        std::fprintf(out_, "%llu,%.17g", static_cast<unsigned long long>(obs.sampleStep), obs.sampleTime);
+        for (double v : obs.values) std::fprintf(out_, ",%.17g", v);
+        ok_ = std::fputc('\n', out_) != EOF && ok_;
+    } else {
+        const std::uint64_t step = obs.sampleStep;
+        bool written = std::fwrite(&step, sizeof(step), 1, out_) == 1;
+        written = written && std::fwrite(&obs.sampleTime, sizeof(double), 1, out_) == 1;
+        written = written && std::fwrite(obs.values.data(), sizeof(double), columns_, out_) == columns_;
+        ok_ = written && ok_;
+    }
+    ++rows_;
+}
+
+} // namespace io
@@ -0,0 +1,50 @@
+// Streaming output of probe samples (sim/observables.hpp) as a time series
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "sim/observables.hpp"
+
+namespace io {
+
+// Output formats
+//  Csv:    header "step,time,<columns>", then one line per sample
+//  Binary: SeriesHeader, the column names ('\n'-terminated), then per sample
+//          a uint64 step, a float64 time and one float64 per column (little endian)
+enum class SeriesFormat { Csv, Binary };
+
+// ".csv" paths are written as CSV, anything else as Binary.
+SeriesFormat series_format_for(const std::string& path);
+
+// Rows are appended on the stepping thread: a sample is a few dozen bytes, so
+// the buffered file absorbs it without a background writer.
+class SeriesWriter {
+public:
+    SeriesWriter() = default;
+    ~SeriesWriter();
+    SeriesWriter(const SeriesWriter&) = delete;
+    SeriesWriter& operator=(const SeriesWriter&) = delete;
+
+    // Opens path and writes the header for the columns of obs.
+    bool open(const std::string& path, const sim::Observables& obs, double dt, std::string* error = nullptr);
+    void close();
+    bool active() const { return out_ != nullptr; }
+
+    // Appends obs' latest sample unless it was already written.
+    void maybe_write(const sim::Observables& obs);
+
+    std::uint64_t rows_written() const { return rows_; }
+    bool ok() const { return ok_; } // false once a write failed
+
+private:
+    std::FILE* out_{nullptr};
+    SeriesFormat format_{SeriesFormat::Csv};
+    std::size_t columns_{0};
+    std::uint64_t lastSample_{0};
+    std::uint64_t rows_{0};
+    bool ok_{true};
+};
+
+} // namespace io
@@ -2,12 +2,18 @@
 // - GUI mode: Dear ImGui + GLFW + OpenGL2 (if available)
 // - Headless mode: runs a small smoke example via --example
 
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "io/batch.hpp"
 #include "io/scene.hpp"
 
+#if S2D_HAVE_MPI
+#include "sim/distributed.hpp"
+#endif
+
 #if BUILD_GUI
 // GUI includes (GLFW + ImGui backends)
 #include <GLFW/glfw3.h>
@@ -18,11 +24,36 @@ static void print_usage() {
     std::cout << "Schrodinger2D\n"
               << "Usage:\n"
               << "  Schrodinger2D                 # launch GUI (if available)\n"
-              << "  Schrodinger2D --example [path]# run headless smoke example\n";
+              << "  Schrodinger2D --example [path]# run headless smoke example\n"
+              << "  Schrodinger2D --batch spec    # run a parameter sweep (see src/io/batch.hpp)\n"
+              << "Options:\n"
+              << "  --threads N                   # worker threads for stepping (0 = all cores)\n"
+              << "  --compare-precision           # with --example: report float vs double mass drift\n"
+              << "  --checkpoint path             # with --example: write a binary checkpoint at the end\n"
+              << "  --checkpoint-every N          # ... and every N steps (written in the background)\n"
+              << "  --compress                    # deflate checkpoints (needs zlib)\n"
+              << "  --restart path                # resume a checkpoint and run to the scene's step count\n"
+              << "  --record dir                  # with --example: record frames into dir (background encoder)\n"
+              << "  --record-format png|raw|stream# PNG sequence, raw float32 |psi|^2 or chunked stream\n"
+              << "  --record-every N              # steps between recorded frames (default 10)\n"
+              << "  --profile trace.json          # with --example: write a Chrome trace of the timed stages\n"
+              << "  --observables path            # with --example: stream the scene's probes (.csv, else binary)\n"
+              << "  --spectral N                  # with --example: evolve by projection onto N eigenmodes\n"
+              << "  --distributed                 # with --example: split the grid over the MPI ranks (implied\n"
+              << "                                #   under mpirun with more than one rank; needs ENABLE_MPI)\n"
+              << "  --out path                    # with --batch: results file (.csv/.jsonl, - = stdout)\n"
+              << "  --jobs N                      # with --batch: concurrent simulations (0 = all cores)\n";
 }
 
 int main(int argc, char** argv) {
     std::string example_path;
+    std::string batch_path;
+    io::CliOptions cli;
+    io::BatchOptions batch;
+#if S2D_HAVE_MPI
+    sim::MpiSession mpi(argc, argv);
+    cli.distributed = mpi.size() > 1;
+#endif
     for (int i = 1; i < argc; ++i) {
         std::string arg(argv[i]);
         if (arg == "--example") {
@@ -31,14 +62,85 @@ int main(int argc, char** argv) {
             } else {
                 example_path = "examples/smoke_example.json"; // default
             }
+        } else if (arg == "--threads") {
+            if (i + 1 >= argc) {
+                std::cerr << "--threads requires a value\n";
+                return 1;
+            }
+            cli.threads = std::atoi(argv[++i]);
+        } else if (arg == "--batch" || arg == "--out" || arg == "--jobs") {
+            if (i + 1 >= argc) {
+                std::cerr << arg << " requires a value\n";
+                return 1;
+            }
+            const std::string value(argv[++i]);
+            if (arg == "--batch") batch_path = value;
+            else if (arg == "--out") batch.output = value;
+            else batch.workers = std::atoi(value.c_str());
+        } else if (arg == "--checkpoint" || arg == "--checkpoint-every" || arg == "--restart") {
+            if (i + 1 >= argc) {
+                std::cerr << arg << " requires a value\n";
+                return 1;
+            }
+            const std::string value(argv[++i]);
+            if (arg == "--checkpoint") cli.checkpoint_path = value;
+            else if (arg == "--restart") cli.restart_path = value;
+            else cli.checkpoint_every = std::atoi(value.c_str());
+        } else if (arg == "--record" || arg == "--record-format" || arg == "--record-every") {
+            if (i + 1 >= argc) {
+                std::cerr << arg << " requires a value\n";
+                return 1;
+            }
+            const std::string value(argv[++i]);
+            if (arg == "--record") {
+                cli.record_path = value;
+            } else if (arg == "--record-every") {
+                cli.record_every = std::atoi(value.c_str());
+            } else if (!io::parse_record_format(value, cli.record_format)) {
+                std::cerr << "Unknown record format: " << value << " (png, raw or stream)\n";
+                return 1;
+            }
+        } else if (arg == "--profile") {
+            if (i + 1 >= argc) {
+                std::cerr << "--profile requires a value\n";
+                return 1;
+            }
+            cli.profile_path = argv[++i];
+        } else if (arg == "--observables") {
+            if (i + 1 >= argc) {
+                std::cerr << "--observables requires a value\n";
+                return 1;
+            }
+            cli.observables_path = argv[++i];
+        } else if (arg == "--spectral") {
+            if (i + 1 >= argc) {
+                std::cerr << "--spectral requires a value\n";
+                return 1;
+            }
+            cli.spectral_modes = std::atoi(argv[++i]);
+        } else if (arg == "--compress") {
+            cli.checkpoint_compress = true;
+        } else if (arg == "--distributed") {
+            cli.distributed = true;
+        } else if (arg == "--compare-precision") {
+            cli.compare_precision = true;
         } else if (arg == "-h" || arg == "--help") {
             print_usage();
             return 0;
         }
     }
 
-    if (!example_path.empty()) {
-        return io::run_example_cli(example_path);
+#if S2D_HAVE_MPI
+    if (mpi.size() > 1 && example_path.empty()) {
+        if (mpi.rank() == 0) std::cerr << "Under mpirun with several ranks only --example runs\n";
+        return 1;
+    }
+#endif
+    if (!batch_path.empty()) {
+        return io::run_batch_cli(batch_path, batch);
+    }
+    if (!example_path.empty() || !cli.restart_path.empty()) {
+        return io::run_example_cli(example_path, cli);
     }
 
 #if BUILD_GUI
@@ -0,0 +1,98 @@
+#include "adaptive.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sim {
+
+void AdaptiveStats::record(double t0, double dt) {
+    ++accepted;
+    minDt = accepted == 1 ? dt : std::min(minDt, dt);
+    maxDt = std::max(maxDt, dt);
+    if (history.empty() || history.back().dt != dt) history.push_back({t0, dt, 0});
+    ++history.back().steps;
+}
+
+AdaptiveStepper& AdaptiveStepper::operator=(const AdaptiveStepper& other) {
+    if (this == &other) return *this;
+    stats = other.stats;
+    start = other.start;
+    coarse = other.coarse;
+    config_ = other.config_;
+    configured_ = other.configured_;
+    level_ = other.level_;
+    maxLevel_ = other.maxLevel_;
+    useClock_ = other.useClock_;
+    cache_.clear();
+    return *this;
+}
+
+void AdaptiveStepper::reset(const AdaptiveConfig& config, double dt) {
+    config_ = config;
+    config_.dt_max = std::max(config.dt_max, 1e-300);
+    config_.dt_min = std::clamp(config.dt_min, 1e-300, config_.dt_max);
+    maxLevel_ = static_cast<int>(std::floor(std::log2(config_.dt_max / config_.dt_min) + 1e-9));
+    const double want = dt > 0.0 ? dt : config_.dt_max;
+    set_level(static_cast<int>(std::lround(std::log2(config_.dt_max / want))));
+    stats = AdaptiveStats{};
+    configured_ = true;
+}
+
+bool AdaptiveStepper::configured_for(const AdaptiveConfig& config) const {
+    return configured_ && config.tol == config_.tol && config.dt_min == config_.dt_min &&
+           config.dt_max == config_.dt_max && config.max_rejects == config_.max_rejects;
+}
+
+void AdaptiveStepper::set_level(int level) {
+    level_ = std::clamp(level, 0, maxLevel_);
+}
+
+double AdaptiveStepper::dt_at(int level) const {
+    return std::ldexp(config_.dt_max, -level);
+}
+
+CrankNicolsonADI& AdaptiveStepper::solver_for(double h) {
+    ++useClock_;
+    for (Cached& c : cache_) {
+        if (c.dt == h) {
+            c.lastUse = useClock_;
+            return *c.solver;
+        }
+    }
+    if (static_cast<int>(cache_.size()) >= kCachedSolvers) {
+        auto oldest = std::min_element(cache_.begin(), cache_.end(),
+                                       [](const Cached& a, const Cached& b) { return a.lastUse < b.lastUse; });
+        cache_.erase(oldest);
+    }
+    cache_.push_back({h, useClock_, std::make_unique<CrankNicolsonADI>()});
+    return *cache_.back().solver;
+}
+
+double AdaptiveStepper::relative_difference(const Field& a, const Field& b, int Nx, int Ny, ThreadPool* pool) {
+    // Every row is written below, so resizing (a no-op once sized) is enough
+    rowDiff_.resize(static_cast<std::size_t>(Ny));
+    rowNorm_.resize(static_cast<std::size_t>(Ny));
+    double* rowDiff = rowDiff_.data();
+    double* rowNorm = rowNorm_.data();
+    parallel_for(pool, 0, Ny, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            double diff = 0.0, norm = 0.0;
+            for (std::size_t k = static_cast<std::size_t>(j) * Nx, e = k + Nx; k < e; ++k) {
+                const double r = a.re[k] - b.re[k];
+                const double i = a.im[k] - b.im[k];
+                diff += r * r + i * i;
+                norm += a.re[k] * a.re[k] + a.im[k] * a.im[k];
+            }
+            rowDiff[j] = diff;
+            rowNorm[j] = norm;
+        }
+    });
+    double diff = 0.0, norm = 0.0;
+    for (int j = 0; j < Ny; ++j) {
+        diff += rowDiff[j];
+        norm += rowNorm[j];
+    }
+    return norm > 0.0 ? std::sqrt(diff / norm) : 0.0;
+}
+
+} // namespace sim
@@ -0,0 +1,96 @@
+// Adaptive time step control for CN-ADI by step doubling
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "field.hpp"
+#include "solver.hpp"
+#include "thread_pool.hpp"
+
+namespace sim {
+
+struct AdaptiveConfig {
+    bool enabled{false};
+    double tol{1e-5};     // local error per step, relative to |psi| (see AdaptiveStepper)
+    double dt_min{1e-6};
+    double dt_max{5e-3};
+    double dt_nominal{0.0}; // the scene's dt; Simulation::dt follows the steps taken (0: unset)
+    int max_rejects{16};  // per step; the last attempt is accepted whatever its error
+};
+
+// Steps of one dt in a row
+struct DtSegment {
+    double t0{0.0};
+    double dt{0.0};
+    std::uint64_t steps{0};
+};
+
+struct AdaptiveStats {
+    std::uint64_t accepted{0};
+    std::uint64_t errorRejects{0};     // local error above tol
+    std::uint64_t stabilityRejects{0}; // StabilityConfig criteria failed
+    double minDt{0.0}, maxDt{0.0};
+    double lastError{0.0};
+    std::vector<DtSegment> history;
+
+    void record(double t0, double dt);
+};
+
+// Controller state and solver caches behind Simulation::step_adaptive().
+//
+// A step of h is compared with two steps of h/2 from the same psi; CN is
+// second order, so the difference over 3 estimates the error of the h/2
+// result, which is the one kept. Step sizes are dt_max / 2^k, so the h/2 of
+// one level is the h of the next and every size keeps its own CN-ADI
+// factorization and potential propagators: changing dt only picks another
+// cached solver.
+class AdaptiveStepper {
+public:
+    AdaptiveStepper() = default;
+    // Copies take the controller state but not the cached solvers (rebuilt on demand)
+    AdaptiveStepper(const AdaptiveStepper& other) { *this = other; }
+    AdaptiveStepper& operator=(const AdaptiveStepper& other);
+    AdaptiveStepper(AdaptiveStepper&&) noexcept = default;
+    AdaptiveStepper& operator=(AdaptiveStepper&&) noexcept = default;
+
+    // Restarts control at the level nearest dt (and clears the statistics)
+    void reset(const AdaptiveConfig& config, double dt);
+    bool configured_for(const AdaptiveConfig& config) const;
+    void restart() { configured_ = false; } // reset() again on the next step
+
+    int level() const { return level_; }
+    void set_level(int level);
+    int max_level() const { return maxLevel_; }
+    double dt_at(int level) const;
+
+    // Solver whose caches belong to step size h (least recently used dropped beyond kCachedSolvers)
+    CrankNicolsonADI& solver_for(double h);
+
+    // |a - b| / |a| over the grid, rows split across pool. The per-row sums
+    // live in members sized on first use, so repeated steps do not allocate.
+    double relative_difference(const Field& a, const Field& b, int Nx, int Ny, ThreadPool* pool);
+
+    AdaptiveStats stats;
+    Field start;  // psi at the start of the attempted step
+    Field coarse; // one step of h
+
+private:
+    static constexpr int kCachedSolvers = 4;
+    struct Cached {
+        double dt{0.0};
+        std::uint64_t lastUse{0};
+        std::unique_ptr<CrankNicolsonADI> solver;
+    };
+
+    AdaptiveConfig config_;
+    bool configured_{false};
+    int level_{0};
+    int maxLevel_{0};
+    std::uint64_t useClock_{0};
+    std::vector<Cached> cache_;
+    std::vector<double> rowDiff_, rowNorm_; // relative_difference() row sums
+};
+
+} // namespace sim
@@ -0,0 +1,134 @@
+#include "alloc_guard.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace sim::heap {
+
+#if S2D_ALLOC_GUARD
+
+namespace {
+
+// Plain thread_local integers: constant-initialized, so touching them from
+// operator new never allocates itself.
+thread_local std::uint64_t t_allocations = 0;
+thread_local int t_suspended = 0;
+
+void count() {
+    if (t_suspended == 0) ++t_allocations;
+}
+
+void* allocate(std::size_t size) {
+    count();
+    return std::malloc(size ? size : 1);
+}
+
+void* allocate_aligned(std::size_t size, std::align_val_t align) {
+    count();
+    const std::size_t a = static_cast<std::size_t>(align);
+    const std::size_t rounded = ((size ? size : 1) + a - 1) / a * a;
+#if defined(_MSC_VER)
+    return _aligned_malloc(rounded, a);
+#else
+    return std::aligned_alloc(a, rounded);
+#endif
+}
+
+void release_aligned(void* p) {
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+} // namespace
+
+bool counting() { return true; }
+std::uint64_t thread_allocations() { return t_allocations; }
+Uncounted::Uncounted() { ++t_suspended; }
+Uncounted::~Uncounted() { --t_suspended; }
+
+#else
+
+bool counting() { return false; }
+std::uint64_t thread_allocations() { return 0; }
+Uncounted::Uncounted() {}
+Uncounted::~Uncounted() {}
+
+#endif
+
+std::uint64_t key(std::initializer_list<std::uint64_t> parts) {
+    // FNV-1a over the parts, a word at a time
+    std::uint64_t h = 1469598103934665603ull;
+    for (std::uint64_t v : parts) {
+        h ^= v;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::uint64_t bits(double v) {
+    std::uint64_t out = 0;
+    std::memcpy(&out, &v, sizeof(out));
+    return out;
+}
+
+NoAllocScope::NoAllocScope(const char* what, bool armed)
+    : what_(what), armed_(armed && counting()), start_(thread_allocations()) {}
+
+NoAllocScope::~NoAllocScope() {
+    if (!armed_) return;
+    const std::uint64_t made = thread_allocations() - start_;
+    if (made == 0) return;
+    std::fprintf(stderr, "heap guard: %llu allocation(s) in steady-state %s\n",
+                 static_cast<unsigned long long>(made), what_);
+    std::abort();
+}
+
+} // namespace sim::heap
+
+#if S2D_ALLOC_GUARD
+
+// Replacements of the global allocation functions; they count, then defer to malloc.
+void* operator new(std::size_t size) {
+    if (void* p = sim::heap::allocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+    if (void* p = sim::heap::allocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return sim::heap::allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return sim::heap::allocate(size); }
+void* operator new(std::size_t size, std::align_val_t align) {
+    if (void* p = sim::heap::allocate_aligned(size, align)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+    if (void* p = sim::heap::allocate_aligned(size, align)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return sim::heap::allocate_aligned(size, align);
+}
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return sim::heap::allocate_aligned(size, align);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { sim::heap::release_aligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { sim::heap::release_aligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { sim::heap::release_aligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { sim::heap::release_aligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { sim::heap::release_aligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { sim::heap::release_aligned(p); }
+
+#endif
@@ -0,0 +1,69 @@
+// Debug check that the steady-state hot paths stay off the heap
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+
+namespace sim::heap {
+
+// With S2D_ALLOC_GUARD (default: debug builds; -DENABLE_ALLOC_GUARD=OFF
+// removes it) the global operator new counts the allocations of each thread,
+// and a NoAllocScope aborts with a message when its thread allocates.
+#ifndef S2D_ALLOC_GUARD
+#ifdef NDEBUG
+#define S2D_ALLOC_GUARD 0
+#else
+#define S2D_ALLOC_GUARD 1
+#endif
+#endif
+
+bool counting();                    // true when built with the guard
+std::uint64_t thread_allocations(); // operator new calls on this thread so far (0 without the guard)
+
+// Allocations inside are not counted: one-time lazy setup that may happen
+// to run first inside a guarded scope (profiler buffers, for instance).
+class Uncounted {
+public:
+    Uncounted();
+    ~Uncounted();
+    Uncounted(const Uncounted&) = delete;
+    Uncounted& operator=(const Uncounted&) = delete;
+};
+
+// Fingerprint of the state that sizes a hot path's buffers.
+std::uint64_t key(std::initializer_list<std::uint64_t> parts);
+std::uint64_t bits(double v);
+
+// Arms a NoAllocScope from the second call with an unchanged key on: the
+// first call at a new shape is where the buffers grow to size.
+class SteadyState {
+public:
+    bool arm(std::uint64_t k) {
+        const bool steady = valid_ && k == key_;
+        key_ = k;
+        valid_ = true;
+        return steady;
+    }
+    void invalidate() { valid_ = false; }
+
+private:
+    std::uint64_t key_{0};
+    bool valid_{false};
+};
+
+// Asserts that this thread does not allocate while the scope is alive (when
+// armed and built with the guard). Other threads are not checked.
+class NoAllocScope {
+public:
+    NoAllocScope(const char* what, bool armed);
+    ~NoAllocScope();
+    NoAllocScope(const NoAllocScope&) = delete;
+    NoAllocScope& operator=(const NoAllocScope&) = delete;
+
+private:
+    const char* what_;
+    bool armed_;
+    std::uint64_t start_{0};
+};
+
+} // namespace sim::heap
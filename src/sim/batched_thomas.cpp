@@ -0,0 +1,216 @@
+#include "batched_thomas.hpp"
+
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define S2D_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define S2D_ALWAYS_INLINE __forceinline
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define S2D_X86_DISPATCH 1
+#else
+#define S2D_X86_DISPATCH 0
+#endif
+
+// Every ISA variant must round exactly like solve_factored(), so results do not
+// depend on the machine: keep the compiler from contracting a*b+c into FMAs
+// (AVX-512 implies FMA, and GCC contracts by default outside ISO C).
+#if defined(__clang__)
+#define S2D_NO_CONTRACT
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#define S2D_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#else
+#define S2D_NO_CONTRACT
+#endif
+
+namespace sim {
+
+namespace {
+
+// Written as loops over fixed-width lane groups so the compiler maps each group
+// onto vector registers of whatever ISA the enclosing function is compiled for.
+// A row holds `groups` groups of L lanes; partial groups use L = lane count.
+template <typename Real, typename Lanes>
+S2D_ALWAYS_INLINE void forward_rows(const BasicBatchedFactor<Real>& f, int j0, int j1, Real* re, Real* im,
+                                    std::size_t stride, int groups, Lanes L) {
+    for (int j = std::max(1, j0); j < j1; ++j) {
+        const Real wr = f.w_re[j];
+        const Real wi = f.w_im[j];
+        for (int g = 0; g < groups; ++g) {
+            Real* r = re + j * stride + g * L;
+            Real* m = im + j * stride + g * L;
+            const Real* pr = r - stride;
+            const Real* pm = m - stride;
+            for (int l = 0; l < L; ++l) {
+                const Real tr = wr * pr[l] - wi * pm[l];
+                const Real ti = wr * pm[l] + wi * pr[l];
+                r[l] -= tr;
+                m[l] -= ti;
+            }
+        }
+    }
+}
+
+template <typename Real, typename Lanes>
+S2D_ALWAYS_INLINE void backward_rows(const BasicBatchedFactor<Real>& f, Real* re, Real* im,
+                                     std::size_t stride, int groups, Lanes L) {
+    const int n = f.n;
+    if (n == 0) return;
+    {
+        const Real ir = f.inv_re[n - 1];
+        const Real ii = f.inv_im[n - 1];
+        for (int g = 0; g < groups; ++g) {
+            Real* r = re + (n - 1) * stride + g * L;
+            Real* m = im + (n - 1) * stride + g * L;
+            for (int l = 0; l < L; ++l) {
+                const Real xr = r[l];
+                const Real xi = m[l];
+                r[l] = xr * ir - xi * ii;
+                m[l] = xr * ii + xi * ir;
+            }
+        }
+    }
+    const Real sr = f.sup_re;
+    const Real si = f.sup_im;
+    for (int j = n - 2; j >= 0; --j) {
+        const Real ir = f.inv_re[j];
+        const Real ii = f.inv_im[j];
+        for (int g = 0; g < groups; ++g) {
+            Real* r = re + j * stride + g * L;
+            Real* m = im + j * stride + g * L;
+            const Real* nr = r + stride;
+            const Real* nm = m + stride;
+            for (int l = 0; l < L; ++l) {
+                const Real ur = r[l] - (sr * nr[l] - si * nm[l]);
+                const Real ui = m[l] - (sr * nm[l] + si * nr[l]);
+                r[l] = ur * ir - ui * ii;
+                m[l] = ur * ii + ui * ir;
+            }
+        }
+    }
+}
+
+template <typename Real>
+using FixedLanes = std::integral_constant<int, kBatchLanesFor<Real>>;
+
+// One instantiation of both halves per ISA and precision. Baseline build: SSE2
+// on x86-64, NEON on AArch64.
+#define S2D_DEFINE_KERNELS_FOR(Real, suffix, attrs)                                                    \
+    attrs void forward_##suffix(const BasicBatchedFactor<Real>& f, int j0, int j1, Real* re, Real* im, \
+                                std::size_t stride, int groups) {                                      \
+        forward_rows(f, j0, j1, re, im, stride, groups, FixedLanes<Real>{});                           \
+    }                                                                                                  \
+    attrs void backward_##suffix(const BasicBatchedFactor<Real>& f, Real* re, Real* im,                \
+                                 std::size_t stride, int groups) {                                     \
+        backward_rows(f, re, im, stride, groups, FixedLanes<Real>{});                                  \
+    }
+#define S2D_DEFINE_KERNELS(suffix, attrs)           \
+    S2D_DEFINE_KERNELS_FOR(double, suffix, attrs) \
+    S2D_DEFINE_KERNELS_FOR(float, suffix, attrs)
+
+S2D_DEFINE_KERNELS(generic, S2D_NO_CONTRACT)
+#if S2D_X86_DISPATCH
+S2D_DEFINE_KERNELS(avx2, __attribute__((target("avx2"))) S2D_NO_CONTRACT)
+S2D_DEFINE_KERNELS(avx512, __attribute__((target("avx512f"))) S2D_NO_CONTRACT)
+#endif
+
+#undef S2D_DEFINE_KERNELS
+#undef S2D_DEFINE_KERNELS_FOR
+
+} // namespace
+
+SimdLevel detect_simd_level() {
+    static const SimdLevel level = [] {
+#if S2D_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        return SimdLevel::Scalar;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        return SimdLevel::NEON;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }();
+    return level;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar: return "scalar";
+    case SimdLevel::NEON: return "neon";
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    }
+    return "scalar";
+}
+
+template <typename Real>
+void solve_batched_forward(const BasicBatchedFactor<Real>& f, int j0, int j1, Real* re, Real* im,
+                           std::size_t stride, int groups, SimdLevel level) {
+    switch (level) {
+#if S2D_X86_DISPATCH
+    case SimdLevel::AVX512: forward_avx512(f, j0, j1, re, im, stride, groups); return;
+    case SimdLevel::AVX2: forward_avx2(f, j0, j1, re, im, stride, groups); return;
+#endif
+    default: forward_generic(f, j0, j1, re, im, stride, groups); return;
+    }
+}
+
+template <typename Real>
+void solve_batched_backward(const BasicBatchedFactor<Real>& f, Real* re, Real* im, std::size_t stride, int groups,
+                            SimdLevel level) {
+    switch (level) {
+#if S2D_X86_DISPATCH
+    case SimdLevel::AVX512: backward_avx512(f, re, im, stride, groups); return;
+    case SimdLevel::AVX2: backward_avx2(f, re, im, stride, groups); return;
+#endif
+    default: backward_generic(f, re, im, stride, groups); return;
+    }
+}
+
+template <typename Real>
+void solve_batched(const BasicBatchedFactor<Real>& f, Real* re, Real* im, std::size_t stride, int groups,
+                   SimdLevel level) {
+    solve_batched_forward(f, 0, f.n, re, im, stride, groups, level);
+    solve_batched_backward(f, re, im, stride, groups, level);
+}
+
+template <typename Real>
+S2D_NO_CONTRACT void solve_lanes_forward(const BasicBatchedFactor<Real>& f, int j0, int j1, Real* re, Real* im,
+                                         std::size_t stride, int lanes) {
+    forward_rows(f, j0, j1, re, im, stride, 1, lanes);
+}
+
+template <typename Real>
+S2D_NO_CONTRACT void solve_lanes_backward(const BasicBatchedFactor<Real>& f, Real* re, Real* im, std::size_t stride,
+                                          int lanes) {
+    backward_rows(f, re, im, stride, 1, lanes);
+}
+
+template <typename Real>
+void solve_lanes(const BasicBatchedFactor<Real>& f, Real* re, Real* im, std::size_t stride, int lanes) {
+    solve_lanes_forward(f, 0, f.n, re, im, stride, lanes);
+    solve_lanes_backward(f, re, im, stride, lanes);
+}
+
+#define S2D_INSTANTIATE(Real)                                                                                    \
+    template void solve_batched_forward(const BasicBatchedFactor<Real>&, int, int, Real*, Real*, std::size_t,   \
+                                        int, SimdLevel);                                                         \
+    template void solve_batched_backward(const BasicBatchedFactor<Real>&, Real*, Real*, std::size_t, int,       \
+                                         SimdLevel);                                                             \
+    template void solve_batched(const BasicBatchedFactor<Real>&, Real*, Real*, std::size_t, int, SimdLevel);    \
+    template void solve_lanes_forward(const BasicBatchedFactor<Real>&, int, int, Real*, Real*, std::size_t, int); \
+    template void solve_lanes_backward(const BasicBatchedFactor<Real>&, Real*, Real*, std::size_t, int);        \
+    template void solve_lanes(const BasicBatchedFactor<Real>&, Real*, Real*, std::size_t, int);
+
+S2D_INSTANTIATE(double)
+S2D_INSTANTIATE(float)
+
+#undef S2D_INSTANTIATE
+
+} // namespace sim
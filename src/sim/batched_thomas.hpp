@@ -0,0 +1,83 @@
+// Batched complex Thomas solver: many independent lines sharing one factorization
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "tridiag.hpp"
+
+namespace sim {
+
+// Number of lines solved in lockstep: one 64-byte vector of lanes, i.e. 8
+// doubles or 16 floats. Lane l of row j lives at [j * stride + l] in separate
+// real and imaginary arrays, so one row of a batch is one (AVX-512) or two
+// (AVX2) vector registers per component. With stride = Nx the lanes are
+// adjacent columns of a split-layout field and the solve runs in place.
+template <typename Real>
+constexpr int kBatchLanesFor = static_cast<int>(64 / sizeof(Real));
+constexpr int kBatchLanes = kBatchLanesFor<double>;
+
+enum class SimdLevel { Scalar, NEON, AVX2, AVX512 };
+
+// Best instruction set usable on this CPU, detected once at runtime.
+SimdLevel detect_simd_level();
+const char* simd_level_name(SimdLevel level);
+
+// BasicTridiagFactor with split real/imaginary coefficient arrays.
+template <typename Real>
+struct BasicBatchedFactor {
+    int n{0};
+    Real sup_re{0};
+    Real sup_im{0};
+    std::vector<Real> w_re, w_im;
+    std::vector<Real> inv_re, inv_im;
+
+    void assign(const BasicTridiagFactor<Real>& f) {
+        n = f.n;
+        sup_re = f.sup.real();
+        sup_im = f.sup.imag();
+        w_re.resize(static_cast<size_t>(n));
+        w_im.resize(static_cast<size_t>(n));
+        inv_re.resize(static_cast<size_t>(n));
+        inv_im.resize(static_cast<size_t>(n));
+        for (int i = 0; i < n; ++i) {
+            w_re[i] = f.w[i].real();
+            w_im[i] = f.w[i].imag();
+            inv_re[i] = f.inv_b[i].real();
+            inv_im[i] = f.inv_b[i].imag();
+        }
+    }
+};
+
+using BatchedFactor = BasicBatchedFactor<double>;
+
+// The kernels below are provided for Real = double (kBatchLanes lanes per
+// group) and Real = float (kBatchLanesFor<float> lanes per group).
+
+// Solves groups * kBatchLanesFor<Real> systems in place (lanes [0, groups * lanes)
+// of every row). Per lane the arithmetic matches solve_factored().
+template <typename Real>
+void solve_batched(const BasicBatchedFactor<Real>& f, Real* re, Real* im, std::size_t stride, int groups,
+                   SimdLevel level);
+
+// Same recurrence for any lane count (no SIMD dispatch); used for partial batches.
+template <typename Real>
+void solve_lanes(const BasicBatchedFactor<Real>& f, Real* re, Real* im, std::size_t stride, int lanes);
+
+// The two halves of the solves above, so callers can produce the right-hand
+// side row by row and eliminate it while it is still in cache:
+// forward eliminates rows [j0, j1) (row 0 is untouched), backward scales the
+// last row and back-substitutes. forward(0, n) + backward == full solve.
+template <typename Real>
+void solve_batched_forward(const BasicBatchedFactor<Real>& f, int j0, int j1, Real* re, Real* im,
+                           std::size_t stride, int groups, SimdLevel level);
+template <typename Real>
+void solve_batched_backward(const BasicBatchedFactor<Real>& f, Real* re, Real* im, std::size_t stride, int groups,
+                            SimdLevel level);
+template <typename Real>
+void solve_lanes_forward(const BasicBatchedFactor<Real>& f, int j0, int j1, Real* re, Real* im,
+                         std::size_t stride, int lanes);
+template <typename Real>
+void solve_lanes_backward(const BasicBatchedFactor<Real>& f, Real* re, Real* im, std::size_t stride, int lanes);
+
+} // namespace sim
@@ -0,0 +1,316 @@
+#include "distributed.hpp"
+
+#if S2D_HAVE_MPI
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "profiler.hpp"
+#include "resample.hpp"
+
+namespace sim {
+
+MpiSession::MpiSession(int& argc, char**& argv) {
+    int provided = 0;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+    MPI_Comm_size(MPI_COMM_WORLD, &size_);
+}
+
+MpiSession::~MpiSession() {
+    MPI_Finalize();
+}
+
+Block block_of(int k, int n, int count) {
+    const int base = count / n;
+    const int extra = count % n;
+    Block b;
+    b.begin = k * base + std::min(k, extra);
+    b.end = b.begin + base + (k < extra ? 1 : 0);
+    return b;
+}
+
+DistributedSimulation::DistributedSimulation(MPI_Comm comm) : comm_(comm), pool_(std::make_unique<ThreadPool>(1)) {
+    MPI_Comm_rank(comm_, &rank_);
+    MPI_Comm_size(comm_, &ranks_);
+}
+
+void DistributedSimulation::set_threads(int n) {
+    pool_->resize(n);
+}
+
+void DistributedSimulation::resize(int nx, int ny) {
+    const GridGeometry g = grid_geometry(nx, ny);
+    Nx = g.Nx;
+    Ny = g.Ny;
+    Lx = g.Lx;
+    Ly = g.Ly;
+    dx = g.dx;
+    dy = g.dy;
+    factorsValid_ = false;
+
+    rows_ = block_of(rank_, ranks_, Ny);
+    columns_ = block_of(rank_, ranks_, Nx);
+    const std::size_t local = static_cast<std::size_t>(rows_.size()) * Nx;
+    psi_.assign(local);
+    phi_.assign(local);
+    haloUp_.assign(2 * static_cast<std::size_t>(Nx), 0.0);
+    haloDown_.assign(2 * static_cast<std::size_t>(Nx), 0.0);
+    haloSend_.assign(2 * static_cast<std::size_t>(Nx), 0.0);
+    rowBlocks_.assign(local, cd(0.0, 0.0));
+    colBlocks_.assign(static_cast<std::size_t>(Ny) * columns_.size(), cd(0.0, 0.0));
+
+    // Rank s sends its rows x this rank's columns and receives this rank's rows x its columns
+    rowCounts_.assign(static_cast<std::size_t>(ranks_), 0);
+    rowDispls_.assign(static_cast<std::size_t>(ranks_), 0);
+    colCounts_.assign(static_cast<std::size_t>(ranks_), 0);
+    colDispls_.assign(static_cast<std::size_t>(ranks_), 0);
+    sumCounts_.assign(static_cast<std::size_t>(ranks_), 0);
+    sumDispls_.assign(static_cast<std::size_t>(ranks_), 0);
+    for (int s = 0; s < ranks_; ++s) {
+        const Block theirRows = block_of(s, ranks_, Ny);
+        const Block theirCols = block_of(s, ranks_, Nx);
+        rowCounts_[s] = rows_.size() * theirCols.size();
+        rowDispls_[s] = rows_.size() * theirCols.begin;
+        colCounts_[s] = theirRows.size() * columns_.size();
+        colDispls_[s] = theirRows.begin * columns_.size();
+        sumCounts_[s] = theirRows.size();
+        sumDispls_[s] = theirRows.begin;
+    }
+    reset();
+}
+
+void DistributedSimulation::reset() {
+    S2D_PROFILE_SCOPE("DistributedSimulation::reset");
+    pfield.Nx = Nx;
+    pfield.Ny = Ny;
+    pfield.Lx = Lx;
+    pfield.Ly = Ly;
+    pfield.build_rows(V_, rows_.begin, rows_.end);
+    ++vGeneration_;
+
+    psi_.fill(cd(0.0, 0.0));
+    for (const Packet& p : packets) add_packet_rows(psi_, p, Nx, rows_.begin, rows_.end, Lx, Ly, dx, dy);
+    stepCount = 0;
+    time = 0.0;
+
+    prepare_mass_window(localSums_, Nx, Ny, pfield.cap_ratio);
+    localSums_.j0 = std::clamp(localSums_.j0 - rows_.begin, 0, rows_.size());
+    localSums_.j1 = std::clamp(localSums_.j1 - rows_.begin, 0, rows_.size());
+    localSums_.reduce(psi_, Nx, rows_.size(), pool_.get());
+    gather_sums();
+    diagnostics = StabilityDiagnostics{};
+    evaluate(false, 1);
+    rebase_stability(diagnostics);
+    stepsSinceCheck = 0;
+}
+
+void DistributedSimulation::ensure_factors() {
+    if (factorsValid_ && factorDx_ == dx && factorDy_ == dy && factorDt_ == dt) return;
+    // Same operators as CrankNicolsonADI::ensure_factors (alpha = i dt / 4)
+    const cd alpha = cd(0.0, 1.0) * (dt * 0.25);
+    const cd ax = alpha / (dx * dx);
+    const cd ay = alpha / (dy * dy);
+    fx_.factor(Nx, -ax, cd(1.0, 0.0) + cd(2.0, 0.0) * ax, -ax);
+    fy_.factor(Ny, -ay, cd(1.0, 0.0) + cd(2.0, 0.0) * ay, -ay);
+    const std::size_t line = static_cast<std::size_t>(std::max(Nx, Ny));
+    lines_.resize(static_cast<std::size_t>(pool_->size()));
+    for (auto& l : lines_) l.assign(line, cd(0.0, 0.0));
+    factorDx_ = dx;
+    factorDy_ = dy;
+    factorDt_ = dt;
+    factorsValid_ = true;
+}
+
+void DistributedSimulation::exchange_halo() {
+    S2D_PROFILE_SCOPE("MPI halo");
+    const int up = rank_ > 0 ? rank_ - 1 : MPI_PROC_NULL;
+    const int down = rank_ + 1 < ranks_ ? rank_ + 1 : MPI_PROC_NULL;
+    const int n = 2 * Nx;
+    auto pack = [&](int j) {
+        const std::size_t row = static_cast<std::size_t>(j) * Nx;
+        std::memcpy(haloSend_.data(), psi_.re.data() + row, sizeof(double) * Nx);
+        std::memcpy(haloSend_.data() + Nx, psi_.im.data() + row, sizeof(double) * Nx);
+    };
+    // First row up, the next slab's first row arrives from below; then the reverse.
+    // MPI_PROC_NULL at the walls leaves those halos at zero.
+    pack(0);
+    MPI_Sendrecv(haloSend_.data(), n, MPI_DOUBLE, up, 0, haloDown_.data(), n, MPI_DOUBLE, down, 0, comm_,
+                 MPI_STATUS_IGNORE);
+    pack(rows_.size() - 1);
+    MPI_Sendrecv(haloSend_.data(), n, MPI_DOUBLE, down, 1, haloUp_.data(), n, MPI_DOUBLE, up, 1, comm_,
+                 MPI_STATUS_IGNORE);
+}
+
+void DistributedSimulation::sweep_x() {
+    S2D_PROFILE_SCOPE("CN x-sweep");
+    const int rows = rows_.size();
+    // Explicit half (I + alpha D_y): center * (1 - 2a) + a * (up + dn)
+    const cd ay = -fy_.sup;
+    const cd cy = cd(1.0, 0.0) - cd(2.0, 0.0) * ay;
+    const ExplicitOp<double> op{cy.real(), cy.imag(), ay.real(), ay.imag()};
+
+    // (I - alpha D_x) phi = (I + alpha D_y) psi
+    parallel_for(pool_.get(), 0, rows, [&](int j0, int j1, int worker) {
+        cd* d = lines_[static_cast<std::size_t>(worker)].data();
+        double* dd = reinterpret_cast<double*>(d);
+        for (int j = j0; j < j1; ++j) {
+            const std::size_t row = static_cast<std::size_t>(j) * Nx;
+            const double* zr = psi_.re.data() + row;
+            const double* zi = psi_.im.data() + row;
+            const double* ur = j > 0 ? zr - Nx : haloUp_.data();
+            const double* ui = j > 0 ? zi - Nx : haloUp_.data() + Nx;
+            const double* dr = j < rows - 1 ? zr + Nx : haloDown_.data();
+            const double* di = j < rows - 1 ? zi + Nx : haloDown_.data() + Nx;
+            for (int i = 0; i < Nx; ++i) {
+                op.apply(zr[i], zi[i], ur[i] + dr[i], ui[i] + di[i], dd[2 * i], dd[2 * i + 1]);
+            }
+            solve_factored(fx_, d);
+            for (int i = 0; i < Nx; ++i) {
+                phi_.re[row + i] = d[i].real();
+                phi_.im[row + i] = d[i].imag();
+            }
+        }
+    });
+}
+
+void DistributedSimulation::sweep_y() {
+    S2D_PROFILE_SCOPE("CN y-sweep");
+    const int rows = rows_.size();
+    const int cols = columns_.size();
+    // Explicit half (I + alpha D_x): center * (1 - 2a) + a * (lf + rt)
+    const cd ax = -fx_.sup;
+    const cd cx = cd(1.0, 0.0) - cd(2.0, 0.0) * ax;
+    const ExplicitOp<double> op{cx.real(), cx.imag(), ax.real(), ax.imag()};
+
+    // Right-hand side of the local rows, cut into the column blocks of every rank
+    parallel_for(pool_.get(), 0, rows, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            const std::size_t row = static_cast<std::size_t>(j) * Nx;
+            const double* zr = phi_.re.data() + row;
+            const double* zi = phi_.im.data() + row;
+            for (int s = 0; s < ranks_; ++s) {
+                const Block c = block_of(s, ranks_, Nx);
+                double* out = reinterpret_cast<double*>(rowBlocks_.data() + rowDispls_[s] +
+                                                        static_cast<std::size_t>(j) * c.size());
+                for (int i = c.begin; i < c.end; ++i) {
+                    const double lr = i > 0 ? zr[i - 1] : 0.0;
+                    const double li = i > 0 ? zi[i - 1] : 0.0;
+                    const double rr = i < Nx - 1 ? zr[i + 1] : 0.0;
+                    const double ri = i < Nx - 1 ? zi[i + 1] : 0.0;
+                    const int o = 2 * (i - c.begin);
+                    op.apply(zr[i], zi[i], lr + rr, li + ri, out[o], out[o + 1]);
+                }
+            }
+        }
+    });
+
+    {
+        S2D_PROFILE_SCOPE("MPI transpose");
+        MPI_Alltoallv(rowBlocks_.data(), rowCounts_.data(), rowDispls_.data(), MPI_C_DOUBLE_COMPLEX,
+                      colBlocks_.data(), colCounts_.data(), colDispls_.data(), MPI_C_DOUBLE_COMPLEX, comm_);
+    }
+
+    // (I - alpha D_y) psi_new = (I + alpha D_x) phi, column by column
+    parallel_for(pool_.get(), 0, cols, [&](int c0, int c1, int worker) {
+        cd* line = lines_[static_cast<std::size_t>(worker)].data();
+        for (int c = c0; c < c1; ++c) {
+            for (int j = 0; j < Ny; ++j) line[j] = colBlocks_[static_cast<std::size_t>(j) * cols + c];
+            solve_factored(fy_, line);
+            for (int j = 0; j < Ny; ++j) colBlocks_[static_cast<std::size_t>(j) * cols + c] = line[j];
+        }
+    });
+
+    {
+        S2D_PROFILE_SCOPE("MPI transpose");
+        MPI_Alltoallv(colBlocks_.data(), colCounts_.data(), colDispls_.data(), MPI_C_DOUBLE_COMPLEX,
+                      rowBlocks_.data(), rowCounts_.data(), rowDispls_.data(), MPI_C_DOUBLE_COMPLEX, comm_);
+    }
+
+    parallel_for(pool_.get(), 0, rows, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            const std::size_t row = static_cast<std::size_t>(j) * Nx;
+            for (int s = 0; s < ranks_; ++s) {
+                const Block c = block_of(s, ranks_, Nx);
+                const cd* in = rowBlocks_.data() + rowDispls_[s] + static_cast<std::size_t>(j) * c.size();
+                for (int i = c.begin; i < c.end; ++i) psi_.set(row + i, in[i - c.begin]);
+            }
+        }
+    });
+}
+
+void DistributedSimulation::advance(int n, bool reduce) {
+    S2D_PROFILE_SCOPE("Distributed CN-ADI step_n");
+    ensure_factors();
+    kicks_.ensure(V_, Nx, rows_.size(), vGeneration_, dt, pool_.get());
+
+    // Same sequence as CrankNicolsonADI::step_n
+    kicks_.apply(psi_, kicks_.half, pool_.get());
+    for (int k = 0; k < n; ++k) {
+        exchange_halo();
+        sweep_x();
+        sweep_y();
+        const bool last = k + 1 == n;
+        kicks_.apply(psi_, last ? kicks_.half : kicks_.full, pool_.get(), last && reduce ? &localSums_ : nullptr);
+    }
+    if (reduce) gather_sums();
+}
+
+void DistributedSimulation::gather_sums() {
+    S2D_PROFILE_SCOPE("MPI diagnostics");
+    sums_.prepare(Ny);
+    const int rows = rows_.size();
+    const std::pair<std::vector<double>*, std::vector<double>*> parts[] = {
+        {&localSums_.rowLeft, &sums_.rowLeft},
+        {&localSums_.rowRight, &sums_.rowRight},
+        {&localSums_.rowInterior, &sums_.rowInterior},
+    };
+    for (const auto& part : parts) {
+        MPI_Allgatherv(part.first->data(), rows, MPI_DOUBLE, part.second->data(), sumCounts_.data(),
+                       sumDispls_.data(), MPI_DOUBLE, comm_);
+    }
+    sums_.finish();
+}
+
+void DistributedSimulation::evaluate(bool is_time_step, int steps) {
+    evaluate_stability(diagnostics, stability, sums_, Nx, Ny, dx * dy, pfield, is_time_step, steps);
+}
+
+void DistributedSimulation::step() {
+    stepN(1);
+}
+
+void DistributedSimulation::stepN(int n) {
+    if (n <= 0) return;
+    // The check cadence is the same on every rank, so all of them take part in
+    // the same gathers.
+    stepsSinceCheck += n;
+    stepCount += static_cast<std::uint64_t>(n);
+    time += n * dt;
+    if (stepsSinceCheck < std::max(1, stability.check_every_n_steps)) {
+        advance(n, false);
+        return;
+    }
+    advance(n, true);
+    evaluate(true, stepsSinceCheck);
+    stepsSinceCheck = 0;
+}
+
+void DistributedSimulation::sync_diagnostics() {
+    if (stepsSinceCheck == 0) return;
+    localSums_.reduce(psi_, Nx, rows_.size(), pool_.get());
+    gather_sums();
+    evaluate(true, stepsSinceCheck);
+    stepsSinceCheck = 0;
+}
+
+std::size_t DistributedSimulation::local_bytes() const {
+    auto field = [](const Field& f) { return f.size() * 2 * sizeof(double); };
+    return field(psi_) + field(phi_) + field(V_) + field(kicks_.half) + field(kicks_.full) +
+           (rowBlocks_.size() + colBlocks_.size()) * sizeof(cd);
+}
+
+} // namespace sim
+
+#endif // S2D_HAVE_MPI
@@ -0,0 +1,143 @@
+// Crank-Nicolson ADI split across MPI ranks, for grids too large for one process
+#pragma once
+
+#if S2D_HAVE_MPI
+
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <mpi.h>
+
+#include "field.hpp"
+#include "potential.hpp"
+#include "propagator.hpp"
+#include "simulation.hpp"
+#include "thread_pool.hpp"
+#include "tridiag.hpp"
+
+namespace sim {
+
+// MPI_Init / MPI_Finalize for the process. Only the thread that created it
+// communicates (MPI_THREAD_FUNNELED); worker pools never call MPI.
+class MpiSession {
+public:
+    MpiSession(int& argc, char**& argv);
+    ~MpiSession();
+    MpiSession(const MpiSession&) = delete;
+    MpiSession& operator=(const MpiSession&) = delete;
+
+    int rank() const { return rank_; }
+    int size() const { return size_; }
+
+private:
+    int rank_{0};
+    int size_{1};
+};
+
+// Part k of n of [0, count): the first count % n parts are one longer.
+struct Block {
+    int begin{0}, end{0};
+    int size() const { return end - begin; }
+};
+Block block_of(int k, int n, int count);
+
+// The scene and CN-ADI stepping of Simulation over a grid split into slabs of
+// whole rows, one per rank of comm. Each rank holds psi, V and the solver
+// state of its rows only.
+//  x-sweep: rows are local; the two neighbour rows of the explicit y half come
+//           from the adjacent ranks (one halo row each way).
+//  y-sweep: the right-hand side is transposed with one MPI_Alltoallv so each
+//           rank holds whole columns of a column block, solved with the same
+//           Thomas factors, and transposed back.
+// Diagnostics gather the per-row mass sums on every rank and combine them in
+// row order, so they are the same on every rank and do not depend on the rank
+// count. Lines and rounding follow CrankNicolsonADI with LineKernel::Scalar and
+// YSweep::Columns, so psi matches a single-process run of that configuration.
+// Double precision; calls marked collective must be made by every rank.
+class DistributedSimulation {
+public:
+    using cd = std::complex<double>;
+
+    explicit DistributedSimulation(MPI_Comm comm = MPI_COMM_WORLD);
+
+    // Scene, the same on every rank. resize() sets the geometry as Simulation does.
+    int Nx{128}, Ny{128};
+    double Lx{1.0}, Ly{1.0};
+    double dx{1.0 / 128}, dy{1.0 / 128};
+    double dt{0.001};
+    PotentialField pfield;
+    std::vector<Packet> packets;
+    StabilityConfig stability;
+
+    std::uint64_t stepCount{0};
+    double time{0.0};
+    StabilityDiagnostics diagnostics; // whole grid, identical on every rank
+    int stepsSinceCheck{0};
+
+    int rank() const { return rank_; }
+    int ranks() const { return ranks_; }
+    Block rows() const { return rows_; }       // this rank's slab
+    Block columns() const { return columns_; } // this rank's columns during the y-sweep
+    const Field& local_psi() const { return psi_; } // rows() x Nx, row-major
+
+    // Every rank needs at least one row and one column.
+    static bool fits(int ranks, int nx, int ny) { return ranks <= nx && ranks <= ny; }
+
+    void set_threads(int n); // workers per rank; n <= 0 selects the hardware thread count
+    int threads() const { return pool_->size(); }
+
+    void resize(int nx, int ny); // collective only through the reset() it ends with
+    void reset();                // rebuild this rank's V and psi rows, new diagnostics baseline (collective)
+    void step();                 // one CN-ADI step (collective)
+    void stepN(int n);           // n steps with fused half-kicks (collective)
+    void sync_diagnostics();     // evaluate now if steps are pending from the check cadence (collective)
+
+    std::size_t local_bytes() const; // grid-sized buffers held by this rank
+
+private:
+    void ensure_factors();
+    void advance(int n, bool reduce);
+    void exchange_halo();
+    void sweep_x();
+    void sweep_y();
+    void gather_sums(); // localSums_ -> sums_ on every rank
+    void evaluate(bool is_time_step, int steps);
+
+    MPI_Comm comm_;
+    int rank_{0};
+    int ranks_{1};
+    Block rows_;
+    Block columns_;
+    std::unique_ptr<ThreadPool> pool_;
+
+    Field psi_; // local rows
+    Field phi_; // x-sweep result
+    Field V_;
+    std::uint64_t vGeneration_{0};
+    PotentialKicks<double> kicks_;
+
+    bool factorsValid_{false};
+    double factorDx_{0.0}, factorDy_{0.0}, factorDt_{0.0};
+    TridiagFactor fx_, fy_;
+
+    std::vector<double> haloUp_, haloDown_; // psi rows rows_.begin - 1 and rows_.end, re then im (zero at walls)
+    std::vector<double> haloSend_;
+    std::vector<std::vector<cd>> lines_;    // per worker, max(Nx, Ny)
+
+    // Transpose: rowBlocks_ holds the local rows cut into every rank's column
+    // block, colBlocks_ this rank's column block over all Ny rows (row-major).
+    std::vector<cd> rowBlocks_;
+    std::vector<cd> colBlocks_;
+    std::vector<int> rowCounts_, rowDispls_; // per rank, in rowBlocks_
+    std::vector<int> colCounts_, colDispls_; // per rank, in colBlocks_
+
+    MassReduction localSums_; // this rank's rows, window in local row indices
+    MassReduction sums_;      // all Ny rows
+    std::vector<int> sumCounts_, sumDispls_;
+};
+
+} // namespace sim
+
+#endif // S2D_HAVE_MPI
@@ -0,0 +1,1036 @@
+#include "eigensolver.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+
+#include "split_step.hpp"
+
+namespace sim {
+
+namespace {
+
+using cd = std::complex<double>;
+
+constexpr double kPi = 3.14159265358979323846264338327950;
+// Points per tile of the basis kernels: one tile of every basis vector is
+// streamed against a tile of the target while that stays in L1.
+constexpr int kTile = 256;
+// Second orthogonalization pass when the first keeps less than this fraction of the norm (DGKS)
+constexpr double kReorthRatio = 0.7071067811865476;
+// A new direction is dropped when orthogonalization leaves less than this fraction of it
+constexpr double kDropRatio = 1e-10;
+
+int pool_size(ThreadPool* pool) {
+    return pool ? pool->size() : 1;
+}
+
+// Deterministic start vectors (splitmix64), in [-1, 1)
+void fill_random(double* x, int n, std::uint64_t seed) {
+    for (int p = 0; p < n; ++p) {
+        std::uint64_t z = seed * 0xD1B54A32D192ED03ull + 0x9E3779B97F4A7C15ull * static_cast<std::uint64_t>(p + 1);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        x[p] = static_cast<double>(z >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+    }
+}
+
+// Four interleaved partial sums, so the loop is not one serial chain of adds
+double dot_range(const double* __restrict a, const double* __restrict b, int p0, int p1) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    int p = p0;
+    for (; p + 4 <= p1; p += 4) {
+        s0 += a[p] * b[p];
+        s1 += a[p + 1] * b[p + 1];
+        s2 += a[p + 2] * b[p + 2];
+        s3 += a[p + 3] * b[p + 3];
+    }
+    for (; p < p1; ++p) s0 += a[p] * b[p];
+    return (s0 + s1) + (s2 + s3);
+}
+
+// Dense vector kernels over N points, split across the pool. Partial sums are
+// kept per worker and added in worker order, so results only depend on the
+// thread count. Blocks of vectors are stored column after column (column b at b N).
+class Kernels {
+public:
+    Kernels(ThreadPool* pool, int n) : pool_(pool), n_(n) {}
+
+    int size() const { return n_; }
+
+    double dot(const double* a, const double* b) {
+        partial_.assign(pool_size(pool_), 0.0);
+        parallel_for(pool_, 0, n_, [&](int p0, int p1, int worker) { partial_[worker] = dot_range(a, b, p0, p1); });
+        return std::accumulate(partial_.begin(), partial_.end(), 0.0);
+    }
+
+    double norm(const double* a) { return std::sqrt(dot(a, a)); }
+
+    void scale(double* a, double s) {
+        parallel_for(pool_, 0, n_, [&](int p0, int p1, int) {
+            for (int p = p0; p < p1; ++p) a[p] *= s;
+        });
+    }
+
+    // y = a - s b
+    void residual(const double* a, const double* b, double s, double* y) {
+        parallel_for(pool_, 0, n_, [&](int p0, int p1, int) {
+            for (int p = p0; p < p1; ++p) y[p] = a[p] - s * b[p];
+        });
+    }
+
+    // c[b * nw + i] = basis_b . w_i for b < count, i < nw (w: nw consecutive columns)
+    void project(const double* basis, int count, const double* w, int nw, double* c) {
+        const int workers = pool_size(pool_);
+        const std::size_t cells = static_cast<std::size_t>(count) * nw;
+        partial_.assign(static_cast<std::size_t>(workers) * cells, 0.0);
+        parallel_for(pool_, 0, n_, [&](int p0, int p1, int worker) {
+            double* acc = partial_.data() + static_cast<std::size_t>(worker) * cells;
+            for (int t0 = p0; t0 < p1; t0 += kTile) {
+                const int t1 = std::min(p1, t0 + kTile);
+                for (int b = 0; b < count; ++b) {
+                    const double* __restrict v = column(basis, b);
+                    for (int i = 0; i < nw; ++i) {
+                        const double* __restrict x = column(w, i);
+                        acc[static_cast<std::size_t>(b) * nw + i] += dot_range(v, x, t0, t1);
+                    }
+                }
+            }
+        });
+        for (std::size_t e = 0; e < cells; ++e) {
+            double s = 0.0;
+            for (int k = 0; k < workers; ++k) s += partial_[static_cast<std::size_t>(k) * cells + e];
+            c[e] = s;
+        }
+    }
+
+    // w_i -= sum_b c[b * nw + i] basis_b
+    void subtract(const double* basis, int count, const double* c, double* w, int nw) {
+        parallel_for(pool_, 0, n_, [&](int p0, int p1, int) {
+            for (int t0 = p0; t0 < p1; t0 += kTile) {
+                const int t1 = std::min(p1, t0 + kTile);
+                for (int b = 0; b < count; ++b) {
+                    const double* __restrict v = column(basis, b);
+                    for (int i = 0; i < nw; ++i) {
+                        double* __restrict x = column(w, i);
+                        const double cb = c[static_cast<std::size_t>(b) * nw + i];
+                        for (int p = t0; p < t1; ++p) x[p] -= cb * v[p];
+                    }
+                }
+            }
+        });
+    }
+
+    // Column i < outCount of the result is sum_b basis_b coeff[b * outCount + i],
+    // written over column i of the same block. Each tile is fully read before
+    // it is written, so the result may overlap the inputs.
+    void combine(double* basis, int count, const std::vector<double>& coeff, int outCount) {
+        const int workers = pool_size(pool_);
+        tmp_.resize(static_cast<std::size_t>(workers) * outCount * kTile);
+        parallel_for(pool_, 0, n_, [&](int p0, int p1, int worker) {
+            double* tmp = tmp_.data() + static_cast<std::size_t>(worker) * outCount * kTile;
+            for (int t0 = p0; t0 < p1; t0 += kTile) {
+                const int len = std::min(p1, t0 + kTile) - t0;
+                std::fill(tmp, tmp + static_cast<std::size_t>(outCount) * kTile, 0.0);
+                for (int b = 0; b < count; ++b) {
+                    const double* __restrict v = column(basis, b) + t0;
+                    for (int i = 0; i < outCount; ++i) {
+                        const double y = coeff[static_cast<std::size_t>(b) * outCount + i];
+                        if (y == 0.0) continue;
+                        double* __restrict out = tmp + static_cast<std::size_t>(i) * kTile;
+                        for (int p = 0; p < len; ++p) out[p] += y * v[p];
+                    }
+                }
+                for (int i = 0; i < outCount; ++i) {
+                    const double* out = tmp + static_cast<std::size_t>(i) * kTile;
+                    std::copy(out, out + len, column(basis, i) + t0);
+                }
+            }
+        });
+    }
+
+    // Orthogonalizes columns first..first+nw-1 of `basis` against columns
+    // 0..first-1 as a block, applying the same combination to `image` (H basis)
+    // when given. A second pass runs only if the first lost most of some
+    // column's norm. norms receives what is left of each column.
+    void orthogonalize(double* basis, double* image, int first, int nw, std::vector<double>& norms) {
+        norms.resize(static_cast<std::size_t>(nw));
+        for (int i = 0; i < nw; ++i) norms[i] = norm(column(basis, first + i));
+        if (first == 0) return;
+        coeff_.resize(static_cast<std::size_t>(first) * nw);
+        for (int pass = 0; pass < 2; ++pass) {
+            double* w = column(basis, first);
+            project(basis, first, w, nw, coeff_.data());
+            subtract(basis, first, coeff_.data(), w, nw);
+            if (image) subtract(image, first, coeff_.data(), column(image, first), nw);
+            bool enough = true;
+            for (int i = 0; i < nw; ++i) {
+                const double left = norm(column(basis, first + i));
+                enough = enough && left >= kReorthRatio * norms[i];
+                norms[i] = left;
+            }
+            if (enough) break;
+        }
+    }
+
+    // Single column j against columns 0..j-1; before receives its starting norm
+    double orthogonalize(double* basis, double* image, int j, double& before) {
+        before = norm(column(basis, j));
+        orthogonalize(basis, image, j, 1, norms_);
+        return norms_[0];
+    }
+
+    double* column(double* basis, int b) const { return basis + static_cast<std::size_t>(b) * n_; }
+    const double* column(const double* basis, int b) const { return basis + static_cast<std::size_t>(b) * n_; }
+
+private:
+    ThreadPool* pool_;
+    int n_;
+    std::vector<double> partial_;
+    std::vector<double> tmp_;
+    std::vector<double> coeff_;
+    std::vector<double> norms_;
+};
+
+// Cyclic Jacobi for the small dense projected matrix (row-major n x n).
+// evecs column k (evecs[i * n + k]) belongs to evals[k].
+void symmetric_eigen(std::vector<double> a, int n, std::vector<double>& evals, std::vector<double>& evecs) {
+    evecs.assign(static_cast<std::size_t>(n) * n, 0.0);
+    for (int i = 0; i < n; ++i) evecs[static_cast<std::size_t>(i) * n + i] = 1.0;
+    auto at = [n](std::vector<double>& m, int r, int c) -> double& { return m[static_cast<std::size_t>(r) * n + c]; };
+    for (int sweep = 0; sweep < 64; ++sweep) {
+        double off = 0.0, diag = 0.0;
+        for (int p = 0; p < n; ++p) {
+            diag += at(a, p, p) * at(a, p, p);
+            for (int q = p + 1; q < n; ++q) off += at(a, p, q) * at(a, p, q);
+        }
+        if (off == 0.0 || off <= 1e-32 * diag) break;
+        for (int p = 0; p < n - 1; ++p) {
+            for (int q = p + 1; q < n; ++q) {
+                const double apq = at(a, p, q);
+                if (apq == 0.0) continue;
+                const double theta = (at(a, q, q) - at(a, p, p)) / (2.0 * apq);
+                const double t = std::copysign(1.0, theta) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                const double c = 1.0 / std::sqrt(t * t + 1.0);
+                const double s = t * c;
+                for (int k = 0; k < n; ++k) {
+                    const double akp = at(a, k, p), akq = at(a, k, q);
+                    at(a, k, p) = c * akp - s * akq;
+                    at(a, k, q) = s * akp + c * akq;
+                }
+                for (int k = 0; k < n; ++k) {
+                    const double apk = at(a, p, k), aqk = at(a, q, k);
+                    at(a, p, k) = c * apk - s * aqk;
+                    at(a, q, k) = s * apk + c * aqk;
+                }
+                for (int k = 0; k < n; ++k) {
+                    const double vkp = at(evecs, k, p), vkq = at(evecs, k, q);
+                    at(evecs, k, p) = c * vkp - s * vkq;
+                    at(evecs, k, q) = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+    evals.resize(n);
+    for (int i = 0; i < n; ++i) evals[i] = at(a, i, i);
+}
+
+// Thomas factors of the compact mass matrix B = tridiag(1, 10, 1) / 12 for any
+// size: the pivots converge to their limit by a factor ~1e-4 per row, so the
+// first kStored are kept and later rows use the last one.
+struct CompactMass {
+    static constexpr int kStored = 16;
+    static constexpr double kOff = 1.0 / 12.0;
+    double inv[kStored]; // 1 / pivot
+    double w[kStored];   // elimination multipliers, w[0] unused
+
+    CompactMass() {
+        double pivot = 10.0 / 12.0;
+        inv[0] = 1.0 / pivot;
+        w[0] = 0.0;
+        for (int i = 1; i < kStored; ++i) {
+            w[i] = kOff * inv[i - 1];
+            pivot = 10.0 / 12.0 - w[i] * kOff;
+            inv[i] = 1.0 / pivot;
+        }
+    }
+
+    // d <- B^-1 d for lanes [0, lanes) of a line of n points, point i of lane l at d[i * stride + l]
+    void solve(double* d, int n, std::size_t stride, int lanes) const {
+        if (n <= 0) return;
+        for (int i = 1; i < n; ++i) {
+            const double wi = w[std::min(i, kStored - 1)];
+            double* cur = d + static_cast<std::size_t>(i) * stride;
+            const double* prev = cur - stride;
+            for (int l = 0; l < lanes; ++l) cur[l] -= wi * prev[l];
+        }
+        double* last = d + static_cast<std::size_t>(n - 1) * stride;
+        const double invLast = inv[std::min(n - 1, kStored - 1)];
+        for (int l = 0; l < lanes; ++l) last[l] *= invLast;
+        for (int i = n - 2; i >= 0; --i) {
+            const double ii = inv[std::min(i, kStored - 1)];
+            double* cur = d + static_cast<std::size_t>(i) * stride;
+            const double* next = cur + stride;
+            for (int l = 0; l < lanes; ++l) cur[l] = (cur[l] - kOff * next[l]) * ii;
+        }
+    }
+};
+
+// y = H x with the compact Laplacian: y = Bx^-1 By^-1 z + V x, where
+// z = -(cx By delta_x^2 + cy Bx delta_y^2) x is a nine-point stencil. Rows are
+// built and solved along x while in cache, then column tiles are solved along y.
+void apply_hamiltonian_compact(const EigenProblem& problem, const double* x, double* y, ThreadPool* pool) {
+    static const CompactMass mass;
+    constexpr int kColumns = 64; // columns per tile of the y solve
+    const int Nx = problem.Nx, Ny = problem.Ny;
+    const double cx = 0.5 / (problem.dx * problem.dx);
+    const double cy = 0.5 / (problem.dy * problem.dy);
+    // Neighbour and centre weights in the row itself and in the rows above and below
+    const double aC = (-10.0 * cx + 2.0 * cy) / 12.0;
+    const double bC = 20.0 * (cx + cy) / 12.0;
+    const double aN = -(cx + cy) / 12.0;
+    const double bN = (2.0 * cx - 10.0 * cy) / 12.0;
+    // out (+)= a * (r[i - 1] + r[i + 1]) + b * r[i], zero outside the row
+    auto row3 = [Nx](const double* r, double a, double b, double* out, bool add) {
+        auto put = [&](int i, double s) {
+            const double v = a * s + b * r[i];
+            out[i] = add ? out[i] + v : v;
+        };
+        put(0, Nx > 1 ? r[1] : 0.0);
+        for (int i = 1; i < Nx - 1; ++i) put(i, r[i - 1] + r[i + 1]);
+        if (Nx > 1) put(Nx - 1, r[Nx - 2]);
+    };
+    parallel_for(pool, 0, Ny, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            const std::size_t row = static_cast<std::size_t>(j) * Nx;
+            double* out = y + row;
+            row3(x + row, aC, bC, out, false);
+            if (j > 0) row3(x + row - Nx, aN, bN, out, true);
+            if (j < Ny - 1) row3(x + row + Nx, aN, bN, out, true);
+            mass.solve(out, Nx, 1, 1);
+        }
+    });
+    const int tiles = (Nx + kColumns - 1) / kColumns;
+    parallel_for(pool, 0, tiles, [&](int t0, int t1, int) {
+        for (int t = t0; t < t1; ++t) {
+            const int i0 = t * kColumns;
+            const int cols = std::min(kColumns, Nx - i0);
+            mass.solve(y + i0, Ny, static_cast<std::size_t>(Nx), cols);
+            for (int j = 0; j < Ny; ++j) {
+                const std::size_t k = static_cast<std::size_t>(j) * Nx + i0;
+                for (int l = 0; l < cols; ++l) y[k + l] += problem.V[k + l] * x[k + l];
+            }
+        }
+    });
+}
+
+// M^-1 = (T + c)^-1 with T the kinetic operator of the cell-centred sine basis
+// (the split-step engine's transforms), which differs from the five-point
+// Dirichlet Laplacian only next to the walls. Two real vectors go through one
+// complex transform, as its real and imaginary parts.
+class KineticPreconditioner {
+public:
+    void init(const EigenProblem& problem, double shift, int workers) {
+        Nx_ = problem.Nx;
+        Ny_ = problem.Ny;
+        dstX_.init(Nx_);
+        dstY_.init(Ny_);
+        const double cx = 0.5 / (problem.dx * problem.dx);
+        const double cy = 0.5 / (problem.dy * problem.dy);
+        lx_.resize(Nx_);
+        ly_.resize(Ny_);
+        // Symbol of -(1/2) delta^2 / h^2, divided by that of B when compact
+        auto symbol = [&](double c, int m, int n) {
+            const double cs = std::cos(kPi * (m + 1) / n);
+            const double l = 2.0 * c * (1.0 - cs);
+            return problem.compact ? l * 12.0 / (10.0 + 2.0 * cs) : l;
+        };
+        for (int m = 0; m < Nx_; ++m) lx_[m] = symbol(cx, m, Nx_);
+        for (int m = 0; m < Ny_; ++m) ly_[m] = symbol(cy, m, Ny_);
+        shift_ = std::max(shift, lx_[0] + ly_[0]);
+        norm_ = 1.0 / (4.0 * Nx_ * Ny_);
+        const std::size_t scratch = std::max(dstX_.scratch_size(), dstY_.scratch_size());
+        lines_.resize(static_cast<std::size_t>(std::max(1, workers)));
+        for (Line& line : lines_) {
+            line.scratch.assign(scratch, cd(0.0, 0.0));
+            line.colRe.assign(static_cast<std::size_t>(kBlock) * Ny_, 0.0);
+            line.colIm.assign(static_cast<std::size_t>(kBlock) * Ny_, 0.0);
+        }
+    }
+
+    // a = M^-1 a and b = M^-1 b (b may be null)
+    void apply(double* a, double* b, ThreadPool* pool) {
+        if (!b) {
+            zero_.assign(static_cast<std::size_t>(Nx_) * Ny_, 0.0);
+            b = zero_.data();
+        }
+        parallel_for(pool, 0, Ny_, [&](int j0, int j1, int worker) {
+            cd* scratch = lines_[static_cast<std::size_t>(worker)].scratch.data();
+            for (int j = j0; j < j1; ++j) dstX_.forward(a + static_cast<std::size_t>(j) * Nx_, b + static_cast<std::size_t>(j) * Nx_, scratch);
+        });
+        const int blocks = (Nx_ + kBlock - 1) / kBlock;
+        parallel_for(pool, 0, blocks, [&](int b0, int b1, int worker) {
+            Line& line = lines_[static_cast<std::size_t>(worker)];
+            for (int blk = b0; blk < b1; ++blk) {
+                const int i0 = blk * kBlock;
+                const int cols = std::min(kBlock, Nx_ - i0);
+                for (int j = 0; j < Ny_; ++j) {
+                    const std::size_t row = static_cast<std::size_t>(j) * Nx_ + i0;
+                    for (int l = 0; l < cols; ++l) {
+                        line.colRe[static_cast<std::size_t>(l) * Ny_ + j] = a[row + l];
+                        line.colIm[static_cast<std::size_t>(l) * Ny_ + j] = b[row + l];
+                    }
+                }
+                for (int l = 0; l < cols; ++l) {
+                    double* re = line.colRe.data() + static_cast<std::size_t>(l) * Ny_;
+                    double* im = line.colIm.data() + static_cast<std::size_t>(l) * Ny_;
+                    dstY_.forward(re, im, line.scratch.data());
+                    const double kx = lx_[i0 + l] + shift_;
+                    for (int m = 0; m < Ny_; ++m) {
+                        const double f = norm_ / (kx + ly_[m]);
+                        re[m] *= f;
+                        im[m] *= f;
+                    }
+                    dstY_.inverse(re, im, line.scratch.data());
+                }
+                for (int j = 0; j < Ny_; ++j) {
+                    const std::size_t row = static_cast<std::size_t>(j) * Nx_ + i0;
+                    for (int l = 0; l < cols; ++l) {
+                        a[row + l] = line.colRe[static_cast<std::size_t>(l) * Ny_ + j];
+                        b[row + l] = line.colIm[static_cast<std::size_t>(l) * Ny_ + j];
+                    }
+                }
+            }
+        });
+        parallel_for(pool, 0, Ny_, [&](int j0, int j1, int worker) {
+            cd* scratch = lines_[static_cast<std::size_t>(worker)].scratch.data();
+            for (int j = j0; j < j1; ++j) dstX_.inverse(a + static_cast<std::size_t>(j) * Nx_, b + static_cast<std::size_t>(j) * Nx_, scratch);
+        });
+    }
+
+private:
+    static constexpr int kBlock = 8; // columns gathered per transform block
+
+    struct Line {
+        std::vector<cd> scratch;
+        std::vector<double> colRe, colIm;
+    };
+
+    int Nx_{0}, Ny_{0};
+    SplitStepFourier::SineTransform dstX_, dstY_;
+    std::vector<double> lx_, ly_; // symbol of T per mode along x and y
+    double shift_{0.0};
+    double norm_{1.0};            // transform round trip
+    std::vector<Line> lines_;
+    std::vector<double> zero_;
+};
+
+// Preconditioned MINRES (Paige-Saunders) for (H - shift) x = b, which may be indefinite.
+class ShiftedSolver {
+public:
+    ShiftedSolver(const EigenProblem& problem, double shift, double tol, int maxIter, ThreadPool* pool,
+                  Kernels& k, KineticPreconditioner& precond, const std::atomic<bool>* cancel, Workspace& ws)
+        : problem_(problem), shift_(shift), tol_(tol), maxIter_(maxIter), pool_(pool), k_(k), precond_(precond), cancel_(cancel),
+          r1_(slot(ws, 0)), r2_(slot(ws, 1)), y_(slot(ws, 2)), v_(slot(ws, 3)), w_(slot(ws, 4)),
+          w1_(slot(ws, 5)), w2_(slot(ws, 6)) {}
+
+    // false when cancelled
+    bool solve(const double* b, double* x) {
+        const int n = k_.size();
+        std::fill(x, x + n, 0.0);
+        std::copy(b, b + n, r1_.begin());
+        std::copy(b, b + n, r2_.begin());
+        std::copy(b, b + n, y_.begin());
+        precond_.apply(y_.data(), nullptr, pool_);
+        const double beta1 = std::sqrt(std::max(0.0, k_.dot(r1_.data(), y_.data())));
+        if (beta1 == 0.0) return true;
+        std::fill(w_.begin(), w_.end(), 0.0);
+        std::fill(w2_.begin(), w2_.end(), 0.0);
+        double beta = beta1, oldb = 0.0, dbar = 0.0, epsln = 0.0, phibar = beta1, cs = -1.0, sn = 0.0;
+        for (int it = 0; it < maxIter_; ++it) {
+            if (cancel_ && cancel_->load(std::memory_order_relaxed)) return false;
+            const double s = 1.0 / beta;
+            parallel_for(pool_, 0, n, [&](int p0, int p1, int) {
+                for (int p = p0; p < p1; ++p) v_[p] = s * y_[p];
+            });
+            apply_hamiltonian(problem_, v_.data(), y_.data(), pool_);
+            const double back = it > 0 ? beta / oldb : 0.0;
+            parallel_for(pool_, 0, n, [&](int p0, int p1, int) {
+                for (int p = p0; p < p1; ++p) y_[p] -= shift_ * v_[p] + back * r1_[p];
+            });
+            const double alfa = k_.dot(v_.data(), y_.data());
+            const double down = alfa / beta;
+            parallel_for(pool_, 0, n, [&](int p0, int p1, int) {
+                for (int p = p0; p < p1; ++p) y_[p] -= down * r2_[p];
+            });
+            r1_.swap(r2_);
+            std::copy(y_.begin(), y_.end(), r2_.begin());
+            precond_.apply(y_.data(), nullptr, pool_);
+            oldb = beta;
+            beta = std::sqrt(std::max(0.0, k_.dot(r2_.data(), y_.data())));
+
+            const double oldeps = epsln;
+            const double delta = cs * dbar + sn * alfa;
+            const double gbar = sn * dbar - cs * alfa;
+            epsln = sn * beta;
+            dbar = -cs * beta;
+            const double gamma = std::max(std::hypot(gbar, beta), std::numeric_limits<double>::min());
+            cs = gbar / gamma;
+            sn = beta / gamma;
+            const double phi = cs * phibar;
+            phibar *= sn;
+            const double denom = 1.0 / gamma;
+            w1_.swap(w2_);
+            w2_.swap(w_);
+            parallel_for(pool_, 0, n, [&](int p0, int p1, int) {
+                for (int p = p0; p < p1; ++p) {
+                    w_[p] = (v_[p] - oldeps * w1_[p] - delta * w2_[p]) * denom;
+                    x[p] += phi * w_[p];
+                }
+            });
+            if (phibar <= tol_ * beta1 || beta == 0.0) break;
+        }
+        return true;
+    }
+
+private:
+    const EigenProblem& problem_;
+    double shift_, tol_;
+    int maxIter_;
+    ThreadPool* pool_;
+    Kernels& k_;
+    KineticPreconditioner& precond_;
+    const std::atomic<bool>* cancel_;
+    std::vector<double> &r1_, &r2_, &y_, &v_, &w_, &w1_, &w2_; // in the workspace's Minres slots
+
+    std::vector<double>& slot(Workspace& ws, int i) const {
+        return ws.doubles(Scratch::Minres, static_cast<std::size_t>(k_.size()), i);
+    }
+};
+
+struct Solve {
+    const EigenProblem& problem;
+    const EigenSolverOptions& options;
+    ThreadPool* pool;
+    EigenProgress* progress;
+    const std::vector<EigenState>* guess;
+    Workspace& ws;
+    Kernels k;
+    int N;
+    int nev;
+
+    // Guess states usable as start vectors (same grid)
+    int guesses() const {
+        if (!guess) return 0;
+        int usable = 0;
+        for (const EigenState& g : *guess) {
+            if (static_cast<int>(g.psi.size()) != N) return 0;
+            ++usable;
+        }
+        return usable;
+    }
+
+    void load_guess(int i, double* x) const {
+        const auto& psi = (*guess)[i].psi;
+        for (int p = 0; p < N; ++p) x[p] = psi[p].real();
+    }
+
+    bool cancelled() const { return progress && progress->cancel.load(std::memory_order_relaxed); }
+
+    void report(int iterations, int converged, double residual) {
+        if (!progress) return;
+        progress->iterations.store(iterations, std::memory_order_relaxed);
+        progress->converged.store(converged, std::memory_order_relaxed);
+        progress->residual.store(residual, std::memory_order_relaxed);
+    }
+
+    double relative(double residual, double energy) const {
+        return residual / std::max(std::fabs(energy), std::numeric_limits<double>::min());
+    }
+
+    // Energies (Rayleigh quotients) and residuals of the first `count` columns against H itself
+    void finish(double* basis, int count, EigenResult& result) {
+        std::vector<double>& hx = ws.doubles(Scratch::EigenVector, N);
+        const double invSqrtVol = 1.0 / std::sqrt(problem.dx * problem.dy);
+        struct Mode { double energy, residual; int column; };
+        std::vector<Mode> found;
+        for (int t = 0; t < count; ++t) {
+            double* x = k.column(basis, t);
+            const double nrm = k.norm(x);
+            if (nrm < 1e-300) continue;
+            k.scale(x, 1.0 / nrm);
+            apply_hamiltonian(problem, x, hx.data(), pool);
+            const double energy = k.dot(x, hx.data());
+            k.residual(hx.data(), x, energy, hx.data());
+            found.push_back({energy, relative(k.norm(hx.data()), energy), t});
+        }
+        std::sort(found.begin(), found.end(), [&](const Mode& a, const Mode& b) {
+            if (options.shiftInvert) return std::fabs(a.energy - options.shift) < std::fabs(b.energy - options.shift);
+            return a.energy < b.energy;
+        });
+        if (static_cast<int>(found.size()) > nev) found.resize(nev);
+        for (const Mode& mode : found) {
+            EigenState es;
+            es.energy = mode.energy;
+            es.residual = mode.residual;
+            es.psi.resize(N);
+            const double* x = k.column(basis, mode.column);
+            for (int p = 0; p < N; ++p) es.psi[p] = x[p] * invSqrtVol; // unit norm sum |psi|^2 dx dy
+            result.states.push_back(std::move(es));
+            if (mode.residual <= options.tol) ++result.converged;
+        }
+    }
+};
+
+// Lowest modes: block LOBPCG on span[X, W, P] (Ritz vectors, preconditioned
+// residuals, previous search directions), so memory stays at 2 x 3 blocks
+// (each with its image under H) however many iterations it takes.
+EigenResult solve_lowest(Solve& s) {
+    EigenResult result;
+    const int N = s.N;
+    int nb = std::min(N, s.nev + std::max(2, s.nev / 2));
+    const int capacity = std::min(N, 3 * nb);
+    std::vector<double>& S = s.ws.doubles(Scratch::EigenBlock, static_cast<std::size_t>(capacity) * N);
+    std::vector<double>& HS = s.ws.doubles(Scratch::EigenImage, S.size());
+    result.bytes = 2 * S.size() * sizeof(double);
+    auto col = [&](std::vector<double>& block, int b) { return s.k.column(block.data(), b); };
+
+    // Raising the shift by the spread of V keeps wells from stalling the preconditioner
+    const double minV = *std::min_element(s.problem.V.begin(), s.problem.V.end());
+    const double meanV = std::accumulate(s.problem.V.begin(), s.problem.V.end(), 0.0) / N;
+    KineticPreconditioner precond;
+    precond.init(s.problem, meanV - minV, pool_size(s.pool));
+    auto precondition = [&](int first, int count) {
+        for (int b = 0; b < count; b += 2) {
+            precond.apply(col(S, first + b), b + 1 < count ? col(S, first + b + 1) : nullptr, s.pool);
+        }
+    };
+
+    // Start block: the guess states, then smooth random vectors
+    const int warm = std::min(nb, s.guesses());
+    for (int b = 0; b < warm; ++b) s.load_guess(b, col(S, b));
+    for (int b = warm; b < nb; ++b) fill_random(col(S, b), N, static_cast<std::uint64_t>(b + 1));
+    precondition(warm, nb - warm);
+    int active = 0;
+    for (int b = 0; b < nb; ++b) {
+        if (b != active) std::copy(col(S, b), col(S, b) + N, col(S, active));
+        double before = 0.0;
+        const double left = s.k.orthogonalize(S.data(), nullptr, active, before);
+        if (left <= kDropRatio * before) continue;
+        s.k.scale(col(S, active), 1.0 / left);
+        ++active;
+    }
+    nb = active;
+    if (nb == 0) return result;
+    for (int b = 0; b < nb; ++b) apply_hamiltonian(s.problem, col(S, b), col(HS, b), s.pool);
+    int iterations = nb;
+
+    std::vector<double> G, theta, Y, coeff;
+    std::vector<int> order;
+    std::vector<double> ritz(nb, 0.0);
+    // Rayleigh-Ritz over the first `count` columns: X = lowest nb Ritz vectors,
+    // P = their part outside the old X block
+    auto rayleigh_ritz = [&](int count, bool directions) {
+        G.resize(static_cast<std::size_t>(count) * count);
+        s.k.project(S.data(), count, HS.data(), count, G.data());
+        for (int b = 0; b < count; ++b) {
+            for (int j = b + 1; j < count; ++j) {
+                const double sym = 0.5 * (G[static_cast<std::size_t>(b) * count + j] + G[static_cast<std::size_t>(j) * count + b]);
+                G[static_cast<std::size_t>(b) * count + j] = sym;
+                G[static_cast<std::size_t>(j) * count + b] = sym;
+            }
+        }
+        symmetric_eigen(G, count, theta, Y);
+        order.resize(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return theta[a] < theta[b]; });
+        const int outCount = directions ? 2 * nb : nb;
+        coeff.assign(static_cast<std::size_t>(count) * outCount, 0.0);
+        for (int b = 0; b < count; ++b) {
+            for (int i = 0; i < nb; ++i) {
+                const double y = Y[static_cast<std::size_t>(b) * count + order[i]];
+                coeff[static_cast<std::size_t>(b) * outCount + i] = y;
+                if (directions && b >= nb) coeff[static_cast<std::size_t>(b) * outCount + nb + i] = y;
+            }
+        }
+        s.k.combine(S.data(), count, coeff, outCount);
+        s.k.combine(HS.data(), count, coeff, outCount);
+        for (int i = 0; i < nb; ++i) ritz[i] = theta[order[i]];
+    };
+    rayleigh_ritz(nb, false);
+
+    // Orthonormalizes the columns src..end-1 (a block that followed column src
+    // before earlier blocks lost columns) into place at `at`, against the
+    // columns before them; directions that vanish are dropped (never from X).
+    // Returns the end of the kept columns.
+    std::vector<double> norms, starts;
+    auto orthonormalize = [&](int end, bool withImage, int at, int src) {
+        const int count = end - src;
+        if (count <= 0) return at;
+        if (at != src) {
+            std::copy(col(S, src), col(S, end), col(S, at));
+            if (withImage) std::copy(col(HS, src), col(HS, end), col(HS, at));
+        }
+        double* image = withImage ? HS.data() : nullptr;
+        starts.resize(count);
+        for (int i = 0; i < count; ++i) starts[i] = s.k.norm(col(S, at + i));
+        s.k.orthogonalize(S.data(), image, at, count, norms);
+        int kept = at;
+        for (int i = 0; i < count; ++i) {
+            const int b = at + i;
+            if (b != kept) {
+                std::copy(col(S, b), col(S, b) + N, col(S, kept));
+                if (withImage) std::copy(col(HS, b), col(HS, b) + N, col(HS, kept));
+            }
+            // Within the block, column by column
+            double before = 0.0;
+            double left = s.k.orthogonalize(S.data() + static_cast<std::size_t>(at) * N,
+                                            image ? image + static_cast<std::size_t>(at) * N : nullptr, kept - at, before);
+            const bool isX = src == 0;
+            if (!isX && left <= kDropRatio * starts[i]) continue;
+            const double inv = left > 0.0 ? 1.0 / left : 0.0;
+            s.k.scale(col(S, kept), inv);
+            if (withImage) s.k.scale(col(HS, kept), inv);
+            ++kept;
+        }
+        return kept;
+    };
+
+    int np = 0;
+    while (true) {
+        // Residuals of the Ritz pairs still short of the tolerance become W
+        int nw = 0;
+        int converged = 0;
+        double worst = 0.0;
+        for (int i = 0; i < nb; ++i) {
+            const int slot = std::min(capacity - 1, nb + np + nw);
+            double* r = col(S, slot);
+            s.k.residual(col(HS, i), col(S, i), ritz[i], r);
+            const double rel = s.relative(s.k.norm(r), ritz[i]);
+            if (i < s.nev) {
+                worst = std::max(worst, rel);
+                if (rel <= s.options.tol) ++converged;
+            }
+            if (rel > s.options.tol && nb + np + nw < capacity) ++nw;
+        }
+        s.report(iterations, converged, worst);
+        if (converged >= std::min(s.nev, nb) || iterations >= s.options.maxIter || nw == 0) break;
+        if (s.cancelled()) {
+            result.cancelled = true;
+            return result;
+        }
+        precondition(nb + np, nw);
+
+        // Orthonormal [X, P, W]; X and P carry their images, W gets one after
+        const int endX = orthonormalize(nb, true, 0, 0);
+        const int firstW = orthonormalize(nb + np, true, endX, nb);
+        active = orthonormalize(nb + np + nw, false, firstW, nb + np);
+        for (int b = firstW; b < active; ++b) apply_hamiltonian(s.problem, col(S, b), col(HS, b), s.pool);
+        iterations += active - firstW;
+
+        const bool directions = active > nb;
+        rayleigh_ritz(active, directions);
+        np = directions ? nb : 0;
+    }
+
+    result.iterations = iterations;
+    s.finish(S.data(), nb, result);
+    return result;
+}
+
+// Modes nearest the shift: thick-restart Lanczos on (H - shift)^-1. The basis
+// is capped at options.basis vectors and, when full, shrinks to the best Ritz
+// vectors plus the residual direction. New vectors are orthogonalized against
+// the whole basis (a second pass only when the first lost most of the norm),
+// so converged modes never reappear as spurious copies.
+EigenResult solve_shift_invert(Solve& s) {
+    EigenResult result;
+    const int N = s.N;
+    const int nev = s.nev;
+    const int m = std::min(N, std::max(s.options.basis, nev + 2));
+
+    const double meanV = std::accumulate(s.problem.V.begin(), s.problem.V.end(), 0.0) / N;
+    KineticPreconditioner precond;
+    precond.init(s.problem, std::fabs(s.options.shift - meanV), pool_size(s.pool));
+    ShiftedSolver shifted(s.problem, s.options.shift, std::max(1e-14, 0.1 * s.options.tol), s.options.innerMaxIter,
+                          s.pool, s.k, precond, s.progress ? &s.progress->cancel : nullptr, s.ws);
+
+    // Columns 0..m (column m holds the next Lanczos vector)
+    std::vector<double>& basis = s.ws.doubles(Scratch::EigenBasis, static_cast<std::size_t>(m + 1) * N);
+    result.bytes = basis.size() * sizeof(double);
+    auto col = [&](int b) { return s.k.column(basis.data(), b); };
+    std::vector<double> T(static_cast<std::size_t>(m) * m, 0.0);
+    std::vector<double> c(m + 1);
+    std::uint64_t seed = 1;
+
+    // Column j = a random direction orthogonal to columns 0..j-1
+    auto refill = [&](int j) {
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            fill_random(col(j), N, seed++);
+            double before = 0.0;
+            const double left = s.k.orthogonalize(basis.data(), nullptr, j, before);
+            if (left > kDropRatio * before) {
+                s.k.scale(col(j), 1.0 / left);
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (!refill(0)) return result;
+    if (const int warm = s.guesses()) {
+        // Start from the sum of the guess states, with a little of the random vector left
+        double* q = col(0);
+        s.k.scale(q, 1e-3);
+        std::vector<double>& g = s.ws.doubles(Scratch::EigenVector, N);
+        for (int i = 0; i < warm; ++i) {
+            s.load_guess(i, g.data());
+            const double inv = 1.0 / std::max(s.k.norm(g.data()), std::numeric_limits<double>::min());
+            for (int p = 0; p < N; ++p) q[p] += inv * g[p];
+        }
+        s.k.scale(q, 1.0 / s.k.norm(q));
+    }
+    int kept = 0;
+    int used = 0;
+    int iterations = 0;
+    double betaLast = 0.0;
+    std::vector<double> theta, Y, Tused, coeff;
+    std::vector<int> order;
+
+    while (true) {
+        int j = kept;
+        for (; j < m && iterations < s.options.maxIter; ++j) {
+            if (s.cancelled() || !shifted.solve(col(j), col(j + 1))) {
+                result.cancelled = true;
+                return result;
+            }
+            ++iterations;
+            // T column j is the projection of the new vector on the basis
+            s.k.project(basis.data(), j + 1, col(j + 1), 1, c.data());
+            for (int b = 0; b <= j; ++b) {
+                T[static_cast<std::size_t>(b) * m + j] = c[b];
+                T[static_cast<std::size_t>(j) * m + b] = c[b];
+            }
+            double before = 0.0;
+            const double beta = s.k.orthogonalize(basis.data(), nullptr, j + 1, before);
+            if (beta <= kDropRatio * before) {
+                // Invariant subspace: the Ritz pairs so far are exact
+                betaLast = 0.0;
+                if (j + 1 < m && !refill(j + 1)) {
+                    ++j;
+                    break;
+                }
+            } else {
+                s.k.scale(col(j + 1), 1.0 / beta);
+                betaLast = beta;
+            }
+        }
+        used = j;
+        if (used == 0) break;
+
+        Tused.resize(static_cast<std::size_t>(used) * used);
+        for (int r = 0; r < used; ++r) {
+            std::copy(T.begin() + static_cast<std::ptrdiff_t>(r) * m, T.begin() + static_cast<std::ptrdiff_t>(r) * m + used,
+                      Tused.begin() + static_cast<std::ptrdiff_t>(r) * used);
+        }
+        symmetric_eigen(Tused, used, theta, Y);
+        order.resize(used);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) { return std::fabs(theta[a]) > std::fabs(theta[b]); });
+
+        const int want = std::min(nev, used);
+        int converged = 0;
+        double worst = 0.0;
+        for (int t = 0; t < want; ++t) {
+            const double th = theta[order[t]];
+            // (H - shift)^-1 x = th x + r  =>  |H x - E x| ~ |r| / th^2 with E = shift + 1/th
+            const double res = std::fabs(betaLast * Y[static_cast<std::size_t>(used - 1) * used + order[t]]);
+            const double rel = th != 0.0 ? s.relative(res / (th * th), s.options.shift + 1.0 / th)
+                                         : std::numeric_limits<double>::infinity();
+            worst = std::max(worst, rel);
+            if (rel <= s.options.tol) ++converged;
+        }
+        s.report(iterations, converged, worst);
+        if (converged >= want || iterations >= s.options.maxIter || used < m) break;
+
+        // Thick restart: keep the best Ritz vectors and continue from the residual direction
+        const int keep = std::min(m - 1, nev + (m - nev) / 2);
+        coeff.assign(static_cast<std::size_t>(used) * keep, 0.0);
+        for (int b = 0; b < used; ++b)
+            for (int i = 0; i < keep; ++i) coeff[static_cast<std::size_t>(b) * keep + i] = Y[static_cast<std::size_t>(b) * used + order[i]];
+        s.k.combine(basis.data(), used, coeff, keep);
+        std::copy(col(used), col(used) + N, col(keep));
+        std::fill(T.begin(), T.end(), 0.0);
+        for (int i = 0; i < keep; ++i) T[static_cast<std::size_t>(i) * m + i] = theta[order[i]];
+        kept = keep;
+    }
+    if (used == 0) return result;
+
+    const int take = std::min(nev, used);
+    coeff.assign(static_cast<std::size_t>(used) * take, 0.0);
+    for (int b = 0; b < used; ++b)
+        for (int i = 0; i < take; ++i) coeff[static_cast<std::size_t>(b) * take + i] = Y[static_cast<std::size_t>(b) * used + order[i]];
+    s.k.combine(basis.data(), used, coeff, take);
+    result.iterations = iterations;
+    s.finish(basis.data(), take, result);
+    return result;
+}
+
+} // namespace
+
+void apply_hamiltonian(const EigenProblem& problem, const double* x, double* y, ThreadPool* pool) {
+    if (problem.compact) {
+        apply_hamiltonian_compact(problem, x, y, pool);
+        return;
+    }
+    const int Nx = problem.Nx, Ny = problem.Ny;
+    const double cx = 0.5 / (problem.dx * problem.dx);
+    const double cy = 0.5 / (problem.dy * problem.dy);
+    const double c0 = 2.0 * (cx + cy);
+    const double* V = problem.V.data();
+    parallel_for(pool, 0, Ny, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            const std::size_t row = static_cast<std::size_t>(j) * Nx;
+            const double* xc = x + row;
+            const double* v = V + row;
+            double* out = y + row;
+            // Interior points without branches; the row ends see a zero outside the grid
+            out[0] = (c0 + v[0]) * xc[0] - cx * (Nx > 1 ? xc[1] : 0.0);
+            for (int i = 1; i < Nx - 1; ++i) out[i] = (c0 + v[i]) * xc[i] - cx * (xc[i - 1] + xc[i + 1]);
+            if (Nx > 1) out[Nx - 1] = (c0 + v[Nx - 1]) * xc[Nx - 1] - cx * xc[Nx - 2];
+            if (j > 0) {
+                const double* xd = xc - Nx;
+                for (int i = 0; i < Nx; ++i) out[i] -= cy * xd[i];
+            }
+            if (j < Ny - 1) {
+                const double* xu = xc + Nx;
+                for (int i = 0; i < Nx; ++i) out[i] -= cy * xu[i];
+            }
+        }
+    });
+}
+
+EigenResult solve_eigenstates(const EigenProblem& problem, const EigenSolverOptions& options,
+                              ThreadPool* pool, EigenProgress* progress, const std::vector<EigenState>* guess,
+                              Workspace* workspace) {
+    const int N = problem.Nx * problem.Ny;
+    if (N <= 0 || static_cast<int>(problem.V.size()) != N) return {};
+    Workspace local;
+    Solve s{problem, options, pool, progress, guess, workspace ? *workspace : local, Kernels(pool, N), N,
+            std::clamp(options.modes, 1, N)};
+    return options.shiftInvert ? solve_shift_invert(s) : solve_lowest(s);
+}
+
+void match_modes(const std::vector<EigenState>& previous, std::vector<EigenState>& states, double dx, double dy) {
+    const std::size_t n = states.size();
+    if (previous.empty() || n == 0) return;
+    const std::size_t N = states[0].psi.size();
+    const double vol = dx * dy;
+    // overlap[i * n + j] = <previous_i | states_j>
+    std::vector<std::complex<double>> overlap(previous.size() * n);
+    for (std::size_t i = 0; i < previous.size(); ++i) {
+        if (previous[i].psi.size() != N) return;
+        for (std::size_t j = 0; j < n; ++j) {
+            std::complex<double> sum(0.0, 0.0);
+            const auto& a = previous[i].psi;
+            const auto& b = states[j].psi;
+            for (std::size_t p = 0; p < N; ++p) sum += std::conj(a[p]) * b[p];
+            overlap[i * n + j] = sum * vol;
+        }
+    }
+    // Greedy: the largest remaining overlap pairs first; a mode that mixed
+    // (overlap below 1/2) counts as new
+    std::vector<int> slotOf(n, -1);
+    std::vector<bool> previousUsed(previous.size(), false);
+    while (true) {
+        double best = 0.5;
+        std::size_t bi = 0, bj = 0;
+        bool found = false;
+        for (std::size_t i = 0; i < previous.size(); ++i) {
+            if (previousUsed[i]) continue;
+            for (std::size_t j = 0; j < n; ++j) {
+                if (slotOf[j] >= 0) continue;
+                const double o = std::abs(overlap[i * n + j]);
+                if (o > best) {
+                    best = o;
+                    bi = i;
+                    bj = j;
+                    found = true;
+                }
+            }
+        }
+        if (!found) break;
+        previousUsed[bi] = true;
+        slotOf[bj] = static_cast<int>(bi);
+        // Same phase as before, so a loaded mode does not flip sign between solves
+        const std::complex<double> o = overlap[bi * n + bj];
+        const std::complex<double> phase = std::conj(o) / std::abs(o);
+        for (auto& v : states[bj].psi) v *= phase;
+    }
+    // Matched modes keep their previous index; new ones fill the gaps in solver order
+    std::vector<EigenState> ordered(std::max(n, previous.size()));
+    std::vector<bool> filled(ordered.size(), false);
+    for (std::size_t j = 0; j < n; ++j) {
+        if (slotOf[j] < 0) continue;
+        ordered[slotOf[j]] = std::move(states[j]);
+        filled[slotOf[j]] = true;
+    }
+    std::size_t next = 0;
+    for (std::size_t j = 0; j < n; ++j) {
+        if (slotOf[j] >= 0) continue;
+        while (filled[next]) ++next;
+        ordered[next] = std::move(states[j]);
+        filled[next] = true;
+    }
+    std::vector<EigenState> out;
+    out.reserve(n);
+    for (std::size_t i = 0; i < ordered.size(); ++i) {
+        if (filled[i]) out.push_back(std::move(ordered[i]));
+    }
+    states = std::move(out);
+}
+
+EigenSolveTask::~EigenSolveTask() {
+    cancel();
+    join();
+}
+
+void EigenSolveTask::start(EigenProblem problem, const EigenSolverOptions& options, int threads,
+                           std::vector<EigenState> guess) {
+    cancel();
+    join();
+    options_ = options;
+    progress_.iterations.store(0);
+    progress_.converged.store(0);
+    progress_.residual.store(0.0);
+    progress_.cancel.store(false);
+    result_ = EigenResult{};
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread([this, problem = std::move(problem), threads, guess = std::move(guess)] {
+        ThreadPool pool(threads);
+        result_ = solve_eigenstates(problem, options_, &pool, &progress_, &guess, &workspace_);
+        if (!result_.cancelled) match_modes(guess, result_.states, problem.dx, problem.dy);
+        running_.store(false, std::memory_order_release);
+    });
+}
+
+void EigenSolveTask::cancel() {
+    progress_.cancel.store(true, std::memory_order_relaxed);
+}
+
+bool EigenSolveTask::take_result(EigenResult& out) {
+    if (!finished()) return false;
+    join();
+    out = std::move(result_);
+    result_ = EigenResult{};
+    return true;
+}
+
+void EigenSolveTask::join() {
+    if (thread_.joinable()) thread_.join();
+}
+
+} // namespace sim
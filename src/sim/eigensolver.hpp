@@ -0,0 +1,114 @@
+// Eigenmodes of H = -(1/2) Laplacian + Re V (Dirichlet walls)
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "workspace.hpp"
+
+namespace sim {
+
+struct EigenState {
+    double energy{0.0};
+    double residual{0.0}; // relative |H psi - E psi| / |E| when solved
+    std::vector<std::complex<double>> psi;
+};
+
+// The operator, detached from a Simulation so it can be solved on another thread.
+// Five-point Laplacian on the grid with zero values outside it (dx == dy), or
+// with compact the fourth-order Bx^-1 delta_x^2 / dx^2 + By^-1 delta_y^2 / dy^2,
+// B = tridiag(1, 10, 1) / 12, of the CN-ADI engine's Compact stencil.
+struct EigenProblem {
+    int Nx{0}, Ny{0};
+    double dx{1.0}, dy{1.0};
+    bool compact{false};
+    std::vector<double> V; // Re V, row-major
+};
+
+// y = H x, rows split across the pool
+void apply_hamiltonian(const EigenProblem& problem, const double* x, double* y, ThreadPool* pool);
+
+struct EigenSolverOptions {
+    int modes{3};
+    int basis{32};        // Krylov vectors held at once; memory is (basis + 1) N doubles
+    int maxIter{1000};    // operator applications
+    double tol{1e-6};     // relative residual |H x - E x| / |E|
+    // Shift-invert: the modes nearest `shift` instead of the lowest. Each
+    // operator application is a MINRES solve with (H - shift).
+    bool shiftInvert{false};
+    double shift{0.0};
+    int innerMaxIter{2000};
+};
+
+// Written by the solver while it runs; cancel is read between operator applications.
+struct EigenProgress {
+    std::atomic<int> iterations{0};
+    std::atomic<int> converged{0};
+    std::atomic<double> residual{0.0}; // worst relative residual among the wanted modes
+    std::atomic<bool> cancel{false};
+};
+
+struct EigenResult {
+    std::vector<EigenState> states; // ascending energy (nearest the shift first with shiftInvert)
+    int iterations{0};
+    int converged{0};
+    bool cancelled{false};
+    std::size_t bytes{0};           // basis memory
+};
+
+// Lowest modes: preconditioned block LOBPCG. Shift-invert: thick-restart
+// Lanczos with the basis capped at options.basis vectors. New directions are
+// orthogonalized against everything kept (a second pass only when the first
+// lost most of the norm), so no spurious copies of converged modes appear.
+// Energies are Rayleigh quotients of the returned states.
+// guess (states of a nearby potential on the same grid) seeds the start
+// vectors, so a small change of V converges in a few iterations.
+// The grid-sized blocks live in workspace when given, so repeated solves on
+// one grid reuse them instead of allocating anew.
+EigenResult solve_eigenstates(const EigenProblem& problem, const EigenSolverOptions& options,
+                              ThreadPool* pool, EigenProgress* progress = nullptr,
+                              const std::vector<EigenState>* guess = nullptr, Workspace* workspace = nullptr);
+
+// Reorders states so each one that overlaps a previous mode by more than 1/2
+// takes that mode's index (and its phase); the rest fill the free indices in order.
+void match_modes(const std::vector<EigenState>& previous, std::vector<EigenState>& states, double dx, double dy);
+
+// Runs solve_eigenstates on a background thread with its own pool and a
+// workspace kept from one solve to the next.
+class EigenSolveTask {
+public:
+    EigenSolveTask() = default;
+    ~EigenSolveTask();
+    EigenSolveTask(const EigenSolveTask&) = delete;
+    EigenSolveTask& operator=(const EigenSolveTask&) = delete;
+
+    // Cancels and joins a solve still in flight first. A non-empty guess warm
+    // starts the solve, and the result keeps the guess's mode order.
+    void start(EigenProblem problem, const EigenSolverOptions& options, int threads,
+               std::vector<EigenState> guess = {});
+    void cancel();
+    bool busy() const { return running_.load(std::memory_order_acquire); }
+    bool finished() const { return thread_.joinable() && !busy(); }
+    const EigenProgress& progress() const { return progress_; }
+    const EigenSolverOptions& options() const { return options_; }
+    // Joins a finished solve and hands over its result; false while busy or idle.
+    bool take_result(EigenResult& out);
+
+private:
+    void join();
+
+    EigenSolverOptions options_;
+    EigenProgress progress_;
+    EigenResult result_;
+    Workspace workspace_; // used only by the solve thread
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+} // namespace sim
@@ -0,0 +1,235 @@
+#include "fft.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sim {
+
+namespace {
+
+constexpr double kTwoPi = 6.283185307179586476925286766559;
+
+inline std::complex<double> mul_neg_i(std::complex<double> z) {
+    return {z.imag(), -z.real()};
+}
+
+// Plain complex product; std::complex's operator* adds a NaN-recovery branch
+// (C Annex G) that keeps the butterflies from vectorizing.
+inline std::complex<double> mul(std::complex<double> a, std::complex<double> b) {
+    return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+} // namespace
+
+void FftPlan::init(int size) {
+    n = std::max(0, size);
+    stages.clear();
+    twiddles.clear();
+    rootCos.clear();
+    rootSin.clear();
+    rootOffset.clear();
+    bluestein = false;
+    inner.reset();
+    chirp.clear();
+    chirpSpectrum.clear();
+    if (n <= 1) return;
+
+    // Factor n; radix-4 first, then the small primes.
+    std::vector<int> radices;
+    int rest = n;
+    while (rest % 4 == 0) { radices.push_back(4); rest /= 4; }
+    while (rest % 2 == 0) { radices.push_back(2); rest /= 2; }
+    for (int p = 3; p <= kMaxDirectRadix && rest > 1; p += 2) {
+        while (rest % p == 0) { radices.push_back(p); rest /= p; }
+    }
+
+    if (rest > 1) {
+        // Chirp-z: X[k] = c[k] * sum_j (x[j] c[j]) conj(c[k - j]), c[k] = exp(-i pi k^2 / n)
+        bluestein = true;
+        int m = 1;
+        while (m < 2 * n - 1) m *= 2;
+        auto plan = std::make_shared<FftPlan>();
+        plan->init(m);
+        chirp.resize(static_cast<size_t>(n));
+        const long long twoN = 2LL * n;
+        for (int k = 0; k < n; ++k) {
+            const long long k2 = (static_cast<long long>(k) * k) % twoN; // keeps the angle exact for large k
+            chirp[k] = std::polar(1.0, -kTwoPi * 0.5 * static_cast<double>(k2) / n);
+        }
+        chirpSpectrum.assign(static_cast<size_t>(m), cd(0.0, 0.0));
+        chirpSpectrum[0] = std::conj(chirp[0]);
+        for (int k = 1; k < n; ++k) {
+            chirpSpectrum[k] = std::conj(chirp[k]);
+            chirpSpectrum[m - k] = std::conj(chirp[k]);
+        }
+        std::vector<cd> scratch(plan->scratch_size());
+        plan->forward(chirpSpectrum.data(), scratch.data());
+        const double invM = 1.0 / m;
+        for (auto& v : chirpSpectrum) v *= invM;
+        inner = std::move(plan);
+        return;
+    }
+
+    int len = n;
+    int stride = 1;
+    for (int r : radices) {
+        Stage st;
+        st.radix = r;
+        st.m = len / r;
+        st.s = stride;
+        st.twiddle = twiddles.size();
+        for (int u = 1; u < r; ++u) {
+            for (int p = 0; p < st.m; ++p) {
+                twiddles.push_back(std::polar(1.0, -kTwoPi * static_cast<double>(p) * u / len));
+            }
+        }
+        rootOffset.push_back(rootCos.size());
+        if (r != 2 && r != 3 && r != 4) {
+            for (int k = 0; k < r; ++k) {
+                rootCos.push_back(std::cos(kTwoPi * k / r));
+                rootSin.push_back(std::sin(kTwoPi * k / r));
+            }
+        }
+        stages.push_back(st);
+        len = st.m;
+        stride *= r;
+    }
+}
+
+size_t FftPlan::scratch_size() const {
+    if (bluestein) return 2 * static_cast<size_t>(inner->n) + inner->scratch_size();
+    return static_cast<size_t>(n);
+}
+
+void FftPlan::forward(cd* data, cd* scratch) const {
+    if (n <= 1) return;
+    if (!bluestein) {
+        stockham(data, scratch);
+        return;
+    }
+    const int m = inner->n;
+    cd* buf = scratch;
+    cd* innerScratch = scratch + m;
+    for (int k = 0; k < n; ++k) buf[k] = mul(data[k], chirp[k]);
+    std::fill(buf + n, buf + m, cd(0.0, 0.0));
+    inner->forward(buf, innerScratch);
+    // Inverse transform of the product, as conj(FFT(conj(.))); 1/m is folded into chirpSpectrum.
+    for (int k = 0; k < m; ++k) buf[k] = std::conj(mul(buf[k], chirpSpectrum[k]));
+    inner->forward(buf, innerScratch);
+    for (int k = 0; k < n; ++k) data[k] = mul(chirp[k], std::conj(buf[k]));
+}
+
+// Self-sorting (Stockham) decimation in frequency: every stage reads x and
+// writes y in natural order, so no bit-reversal pass is needed.
+void FftPlan::stockham(cd* data, cd* scratch) const {
+    cd* x = data;
+    cd* y = scratch;
+    for (size_t si = 0; si < stages.size(); ++si) {
+        const Stage& st = stages[si];
+        const int r = st.radix;
+        const int m = st.m;
+        const int s = st.s;
+        const cd* tw = twiddles.data() + st.twiddle; // tw[(u - 1) * m + p] = w^(p u)
+        switch (r) {
+        case 2:
+            for (int p = 0; p < m; ++p) {
+                const cd w1 = tw[p];
+                for (int q = 0; q < s; ++q) {
+                    const cd a0 = x[q + s * p];
+                    const cd a1 = x[q + s * (p + m)];
+                    y[q + s * (2 * p)] = a0 + a1;
+                    y[q + s * (2 * p + 1)] = mul(a0 - a1, w1);
+                }
+            }
+            break;
+        case 3: {
+            const double c = -0.5;
+            const double sn = 0.86602540378443864676372317075294; // sqrt(3) / 2
+            for (int p = 0; p < m; ++p) {
+                const cd w1 = tw[p];
+                const cd w2 = tw[m + p];
+                for (int q = 0; q < s; ++q) {
+                    const cd a0 = x[q + s * p];
+                    const cd a1 = x[q + s * (p + m)];
+                    const cd a2 = x[q + s * (p + 2 * m)];
+                    const cd t1 = a1 + a2;
+                    const cd t2 = a0 + c * t1;
+                    const cd t3 = mul_neg_i(sn * (a1 - a2));
+                    y[q + s * (3 * p)] = a0 + t1;
+                    y[q + s * (3 * p + 1)] = mul(t2 + t3, w1);
+                    y[q + s * (3 * p + 2)] = mul(t2 - t3, w2);
+                }
+            }
+            break;
+        }
+        case 4:
+            for (int p = 0; p < m; ++p) {
+                const cd w1 = tw[p];
+                const cd w2 = tw[m + p];
+                const cd w3 = tw[2 * m + p];
+                for (int q = 0; q < s; ++q) {
+                    const cd a0 = x[q + s * p];
+                    const cd a1 = x[q + s * (p + m)];
+                    const cd a2 = x[q + s * (p + 2 * m)];
+                    const cd a3 = x[q + s * (p + 3 * m)];
+                    const cd e0 = a0 + a2;
+                    const cd e1 = a0 - a2;
+                    const cd o0 = a1 + a3;
+                    const cd o1 = mul_neg_i(a1 - a3);
+                    y[q + s * (4 * p)] = e0 + o0;
+                    y[q + s * (4 * p + 1)] = mul(e1 + o1, w1);
+                    y[q + s * (4 * p + 2)] = mul(e0 - o0, w2);
+                    y[q + s * (4 * p + 3)] = mul(e1 - o1, w3);
+                }
+            }
+            break;
+        default: {
+            // Odd prime radix: pair t with r - t, so each output pair (u, r - u) costs
+            // (r - 1) / 2 real-by-complex products per input pair.
+            const double* cs = rootCos.data() + rootOffset[si];
+            const double* sn = rootSin.data() + rootOffset[si];
+            const int h = (r - 1) / 2;
+            cd a[kMaxDirectRadix];
+            cd sp[kMaxDirectRadix / 2 + 1];
+            cd dm[kMaxDirectRadix / 2 + 1];
+            for (int p = 0; p < m; ++p) {
+                for (int q = 0; q < s; ++q) {
+                    for (int t = 0; t < r; ++t) a[t] = x[q + s * (p + t * m)];
+                    cd sum = a[0];
+                    for (int t = 1; t <= h; ++t) {
+                        sp[t] = a[t] + a[r - t];
+                        dm[t] = a[t] - a[r - t];
+                        sum += sp[t];
+                    }
+                    y[q + s * (r * p)] = sum;
+                    for (int u = 1; u <= h; ++u) {
+                        double cr = a[0].real();
+                        double ci = a[0].imag();
+                        double sr = 0.0;
+                        double si = 0.0;
+                        int k = 0;
+                        for (int t = 1; t <= h; ++t) {
+                            k += u;
+                            if (k >= r) k -= r;
+                            cr += sp[t].real() * cs[k];
+                            ci += sp[t].imag() * cs[k];
+                            sr += dm[t].real() * sn[k];
+                            si += dm[t].imag() * sn[k];
+                        }
+                        // b_u = c - i s, b_{r-u} = c + i s
+                        const cd bu(cr + si, ci - sr);
+                        const cd bv(cr - si, ci + sr);
+                        y[q + s * (r * p + u)] = mul(bu, tw[(u - 1) * m + p]);
+                        y[q + s * (r * p + r - u)] = mul(bv, tw[(r - u - 1) * m + p]);
+                    }
+                }
+            }
+            break;
+        }
+        }
+        std::swap(x, y);
+    }
+    if (x != data) std::copy(x, x + n, data);
+}
+
+} // namespace sim
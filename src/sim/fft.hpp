@@ -0,0 +1,57 @@
+// Built-in complex FFT with cached plans (no external dependency)
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace sim {
+
+// Plan for a forward DFT of one fixed length n:
+//   X[k] = sum_j x[j] exp(-2 pi i j k / n)
+// Lengths whose prime factors are all <= kMaxDirectRadix run as a mixed-radix
+// Stockham FFT (radix 4, 2, 3 butterflies, generic odd-prime butterflies up to
+// kMaxDirectRadix, which cost O(radix) per point);
+// anything else goes through Bluestein's chirp-z algorithm on a power-of-two plan.
+// Twiddles are computed once in init(); forward() is const and may be called
+// from several threads at once with separate scratch buffers.
+struct FftPlan {
+    using cd = std::complex<double>;
+
+    static constexpr int kMaxDirectRadix = 97;
+
+    struct Stage {
+        int radix{0};
+        int m{0};          // sub-transform length after this stage
+        int s{0};          // stride (product of earlier radices)
+        size_t twiddle{0}; // offset into twiddles: (radix - 1) * m entries
+    };
+
+    int n{0};
+    std::vector<Stage> stages;
+    std::vector<cd> twiddles;
+    // Generic butterflies: cos / sin(2 pi k / radix), k < radix, per stage (concatenated)
+    std::vector<double> rootCos;
+    std::vector<double> rootSin;
+    std::vector<size_t> rootOffset; // per stage
+
+    // Bluestein (n has a prime factor > kMaxDirectRadix)
+    bool bluestein{false};
+    std::shared_ptr<const FftPlan> inner; // power-of-two plan of length >= 2n - 1
+    std::vector<cd> chirp;                // exp(-i pi k^2 / n), k < n
+    std::vector<cd> chirpSpectrum;        // FFT of the conjugate chirp, scaled by 1 / inner->n
+
+    void init(int size);
+
+    // Scratch length (in complex values) forward() needs.
+    size_t scratch_size() const;
+
+    // In-place forward transform of data[0..n).
+    void forward(cd* data, cd* scratch) const;
+
+private:
+    void stockham(cd* data, cd* scratch) const;
+};
+
+} // namespace sim
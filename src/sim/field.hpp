@@ -0,0 +1,103 @@
+// Complex grid storage with split real/imaginary arrays (structure of arrays)
+#pragma once
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace sim {
+
+constexpr std::size_t kFieldAlignment = 64; // one cache line / one AVX-512 register
+
+// Minimal allocator returning kFieldAlignment-aligned blocks.
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(kFieldAlignment)));
+    }
+    void deallocate(T* p, std::size_t) noexcept {
+        ::operator delete(p, std::align_val_t(kFieldAlignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U>&) const noexcept { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Complex field of length Nx*Ny (row-major), stored as two aligned arrays so
+// kernels can stream and vectorize each component separately.
+// Element access returns values; writes go through set()/add() or re/im.
+template <typename T>
+struct ComplexField {
+    using value_type = std::complex<T>;
+
+    AlignedVector<T> re;
+    AlignedVector<T> im;
+
+    std::size_t size() const { return re.size(); }
+    bool empty() const { return re.empty(); }
+
+    void assign(std::size_t n, value_type v = value_type(0, 0)) {
+        re.assign(n, v.real());
+        im.assign(n, v.imag());
+    }
+    void fill(value_type v) {
+        std::fill(re.begin(), re.end(), v.real());
+        std::fill(im.begin(), im.end(), v.imag());
+    }
+    void scale(T s) {
+        for (auto& x : re) x *= s;
+        for (auto& x : im) x *= s;
+    }
+
+    value_type operator[](std::size_t k) const { return value_type(re[k], im[k]); }
+    void set(std::size_t k, value_type v) {
+        re[k] = v.real();
+        im[k] = v.imag();
+    }
+    void add(std::size_t k, value_type v) {
+        re[k] += v.real();
+        im[k] += v.imag();
+    }
+
+    // Adapters for interleaved std::complex callers
+    void assign_from(const std::vector<value_type>& src) {
+        re.resize(src.size());
+        im.resize(src.size());
+        for (std::size_t k = 0; k < src.size(); ++k) {
+            re[k] = src[k].real();
+            im[k] = src[k].imag();
+        }
+    }
+    // Element-wise precision conversion (e.g. double <-> float working copies)
+    template <typename U>
+    void assign_from(const ComplexField<U>& src) {
+        re.resize(src.size());
+        im.resize(src.size());
+        for (std::size_t k = 0; k < src.size(); ++k) {
+            re[k] = static_cast<T>(src.re[k]);
+            im[k] = static_cast<T>(src.im[k]);
+        }
+    }
+    std::vector<value_type> to_vector() const {
+        std::vector<value_type> out(size());
+        for (std::size_t k = 0; k < out.size(); ++k) out[k] = value_type(re[k], im[k]);
+        return out;
+    }
+};
+
+using Field = ComplexField<double>;
+
+} // namespace sim
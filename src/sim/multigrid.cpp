@@ -0,0 +1,357 @@
+#include "multigrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "profiler.hpp"
+
+namespace sim {
+
+namespace {
+
+using cd = std::complex<double>;
+
+int pool_size(ThreadPool* pool) {
+    return pool ? pool->size() : 1;
+}
+
+// Coarser levels while both sizes stay even and the coarse grid keeps 8 cells a side
+bool can_coarsen(int nx, int ny) {
+    return nx % 2 == 0 && ny % 2 == 0 && nx >= 16 && ny >= 16;
+}
+
+void build_stencil(CrankNicolsonMultigrid::Level& level, double alpha, double B) {
+    const int nx = level.Nx, ny = level.Ny;
+    // Symmetric gauge about the centre: A = (B/2) (-(y - yc), x - xc)
+    const double xc = 0.5 * nx * level.dx;
+    const double yc = 0.5 * ny * level.dy;
+    level.phaseX.resize(static_cast<std::size_t>(ny));
+    for (int j = 0; j < ny; ++j) {
+        const double ax = -0.5 * B * ((j + 0.5) * level.dy - yc);
+        level.phaseX[j] = std::polar(1.0, -ax * level.dx);
+    }
+    level.phaseY.resize(static_cast<std::size_t>(nx));
+    for (int i = 0; i < nx; ++i) {
+        const double ay = 0.5 * B * ((i + 0.5) * level.dx - xc);
+        level.phaseY[i] = std::polar(1.0, -ay * level.dy);
+    }
+    const std::size_t n = static_cast<std::size_t>(nx) * ny;
+    const double kinetic = 1.0 / (level.dx * level.dx) + 1.0 / (level.dy * level.dy);
+    level.diagInv.assign(n);
+    for (std::size_t k = 0; k < n; ++k) {
+        // 1 + i alpha (kinetic + V)
+        const cd d = cd(1.0, 0.0) + cd(0.0, alpha) * (cd(kinetic, 0.0) + cd(level.V.re[k], level.V.im[k]));
+        level.diagInv.set(k, 1.0 / d);
+    }
+    level.x.assign(n);
+    level.b.assign(n);
+    level.r.assign(n);
+}
+
+// coarse = average of each 2x2 block of fine
+void restrict_to(const Field& fine, int fnx, Field& coarse, int cnx, int cny, ThreadPool* pool) {
+    parallel_for(pool, 0, cny, [&](int j0, int j1, int) {
+        for (int J = j0; J < j1; ++J) {
+            const std::size_t f0 = static_cast<std::size_t>(2 * J) * fnx;
+            const std::size_t f1 = f0 + fnx;
+            const std::size_t c = static_cast<std::size_t>(J) * cnx;
+            for (int I = 0; I < cnx; ++I) {
+                const int i = 2 * I;
+                coarse.re[c + I] = 0.25 * (fine.re[f0 + i] + fine.re[f0 + i + 1] + fine.re[f1 + i] + fine.re[f1 + i + 1]);
+                coarse.im[c + I] = 0.25 * (fine.im[f0 + i] + fine.im[f0 + i + 1] + fine.im[f1 + i] + fine.im[f1 + i + 1]);
+            }
+        }
+    });
+}
+
+// fine += bilinear interpolation of coarse (cell-centred weights 9/16, 3/16, 3/16, 1/16; zero past the walls)
+void prolong_add(const Field& coarse, int cnx, int cny, Field& fine, int fnx, int fny, ThreadPool* pool) {
+    parallel_for(pool, 0, fny, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            const int J = j / 2;
+            const int J2 = (j % 2 == 0) ? J - 1 : J + 1;
+            const bool hasJ2 = J2 >= 0 && J2 < cny;
+            const std::size_t row = static_cast<std::size_t>(J) * cnx;
+            const std::size_t row2 = hasJ2 ? static_cast<std::size_t>(J2) * cnx : 0;
+            const std::size_t f = static_cast<std::size_t>(j) * fnx;
+            for (int i = 0; i < fnx; ++i) {
+                const int I = i / 2;
+                const int I2 = (i % 2 == 0) ? I - 1 : I + 1;
+                const bool hasI2 = I2 >= 0 && I2 < cnx;
+                double re = 0.5625 * coarse.re[row + I];
+                double im = 0.5625 * coarse.im[row + I];
+                if (hasI2) {
+                    re += 0.1875 * coarse.re[row + I2];
+                    im += 0.1875 * coarse.im[row + I2];
+                }
+                if (hasJ2) {
+                    re += 0.1875 * coarse.re[row2 + I];
+                    im += 0.1875 * coarse.im[row2 + I];
+                    if (hasI2) {
+                        re += 0.0625 * coarse.re[row2 + I2];
+                        im += 0.0625 * coarse.im[row2 + I2];
+                    }
+                }
+                fine.re[f + i] += re;
+                fine.im[f + i] += im;
+            }
+        }
+    });
+}
+
+// level.r = level.b - A level.x
+void residual(const CrankNicolsonMultigrid& mg, CrankNicolsonMultigrid::Level& level, double alpha, ThreadPool* pool) {
+    mg.apply(level, level.x, level.r, alpha, pool);
+    const int n = static_cast<int>(level.r.size());
+    parallel_for(pool, 0, n, [&](int k0, int k1, int) {
+        for (int k = k0; k < k1; ++k) {
+            level.r.re[k] = level.b.re[k] - level.r.re[k];
+            level.r.im[k] = level.b.im[k] - level.r.im[k];
+        }
+    });
+}
+
+// x += w D^-1 (b - A x), with r as scratch; from x = 0 when fromZero
+void jacobi(const CrankNicolsonMultigrid& mg, CrankNicolsonMultigrid::Level& level, double alpha, int sweeps,
+            bool fromZero, ThreadPool* pool) {
+    const int n = static_cast<int>(level.x.size());
+    const double w = CrankNicolsonMultigrid::kJacobiWeight;
+    for (int sweep = 0; sweep < sweeps; ++sweep) {
+        // The first sweep from zero has residual b and nothing to add to
+        const bool first = fromZero && sweep == 0;
+        if (!first) residual(mg, level, alpha, pool);
+        const Field& r = first ? level.b : level.r;
+        parallel_for(pool, 0, n, [&](int k0, int k1, int) {
+            for (int k = k0; k < k1; ++k) {
+                const double dr = level.diagInv.re[k], di = level.diagInv.im[k];
+                const double rr = r.re[k], ri = r.im[k];
+                const double ur = w * (dr * rr - di * ri), ui = w * (dr * ri + di * rr);
+                level.x.re[k] = first ? ur : level.x.re[k] + ur;
+                level.x.im[k] = first ? ui : level.x.im[k] + ui;
+            }
+        });
+    }
+}
+
+// y = a + c b (complex c), rows split across the pool
+void axpy(Field& y, const Field& a, cd c, const Field& b, ThreadPool* pool) {
+    const int n = static_cast<int>(y.size());
+    parallel_for(pool, 0, n, [&](int k0, int k1, int) {
+        for (int k = k0; k < k1; ++k) {
+            const double br = b.re[k], bi = b.im[k];
+            y.re[k] = a.re[k] + c.real() * br - c.imag() * bi;
+            y.im[k] = a.im[k] + c.real() * bi + c.imag() * br;
+        }
+    });
+}
+
+bool same(const Field& a, const Field& b) {
+    return a.size() == b.size() && std::memcmp(a.re.data(), b.re.data(), a.size() * sizeof(double)) == 0 &&
+           std::memcmp(a.im.data(), b.im.data(), a.size() * sizeof(double)) == 0;
+}
+
+} // namespace
+
+void CrankNicolsonMultigrid::ensure(const Field& V, int Nx, int Ny, double dx, double dy, double dt,
+                                    std::uint64_t vGeneration, int threads) {
+    if (valid && cachedNx == Nx && cachedNy == Ny && cachedDx == dx && cachedDy == dy && cachedDt == dt &&
+        cachedB == magneticField && cachedGeneration == vGeneration) {
+        return;
+    }
+    if (cachedNx != Nx || cachedNy != Ny) haveHistory = false;
+    cachedNx = Nx;
+    cachedNy = Ny;
+    cachedDx = dx;
+    cachedDy = dy;
+    cachedDt = dt;
+    cachedB = magneticField;
+    cachedGeneration = vGeneration;
+
+    int depth = 1;
+    for (int nx = Nx, ny = Ny; can_coarsen(nx, ny); nx /= 2, ny /= 2) ++depth;
+    levels.resize(static_cast<std::size_t>(depth));
+    const double alpha = 0.5 * dt;
+    for (int l = 0; l < depth; ++l) {
+        Level& level = levels[l];
+        level.Nx = l == 0 ? Nx : levels[l - 1].Nx / 2;
+        level.Ny = l == 0 ? Ny : levels[l - 1].Ny / 2;
+        level.dx = l == 0 ? dx : 2.0 * levels[l - 1].dx;
+        level.dy = l == 0 ? dy : 2.0 * levels[l - 1].dy;
+        const std::size_t n = static_cast<std::size_t>(level.Nx) * level.Ny;
+        if (l == 0) {
+            level.V.re.assign(V.re.begin(), V.re.end());
+            level.V.im.assign(V.im.begin(), V.im.end());
+        } else {
+            level.V.assign(n);
+            restrict_to(levels[l - 1].V, levels[l - 1].Nx, level.V, level.Nx, level.Ny, nullptr);
+        }
+        build_stencil(level, alpha, magneticField);
+    }
+
+    const std::size_t n = static_cast<std::size_t>(Nx) * Ny;
+    for (Field* f : {&rhs, &x, &r, &r0, &p, &v, &s, &t, &phat, &shat}) f->assign(n);
+    partial.assign(static_cast<std::size_t>(std::max(1, threads)), cd(0.0, 0.0));
+    valid = true;
+}
+
+void CrankNicolsonMultigrid::apply(const Level& level, const Field& in, Field& out, double alpha,
+                                   ThreadPool* pool) const {
+    const int nx = level.Nx, ny = level.Ny;
+    const double cx = 0.5 / (level.dx * level.dx);
+    const double cy = 0.5 / (level.dy * level.dy);
+    parallel_for(pool, 0, ny, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            const std::size_t row = static_cast<std::size_t>(j) * nx;
+            const cd ex = level.phaseX[j];
+            for (int i = 0; i < nx; ++i) {
+                const std::size_t k = row + i;
+                const cd c(in.re[k], in.im[k]);
+                cd hop(0.0, 0.0);
+                if (i + 1 < nx) hop += cx * ex * cd(in.re[k + 1], in.im[k + 1]);
+                if (i > 0) hop += cx * std::conj(ex) * cd(in.re[k - 1], in.im[k - 1]);
+                const cd ey = level.phaseY[i];
+                if (j + 1 < ny) hop += cy * ey * cd(in.re[k + nx], in.im[k + nx]);
+                if (j > 0) hop += cy * std::conj(ey) * cd(in.re[k - nx], in.im[k - nx]);
+                const cd h = (2.0 * (cx + cy) + cd(level.V.re[k], level.V.im[k])) * c - hop;
+                // c + i alpha h
+                out.re[k] = c.real() - alpha * h.imag();
+                out.im[k] = c.imag() + alpha * h.real();
+            }
+        }
+    });
+}
+
+void CrankNicolsonMultigrid::vcycle(int l, ThreadPool* pool) {
+    Level& level = levels[l];
+    const double alpha = 0.5 * cachedDt;
+    if (l + 1 == static_cast<int>(levels.size())) {
+        jacobi(*this, level, alpha, kCoarseSweeps, true, pool);
+        return;
+    }
+    jacobi(*this, level, alpha, kPreSmooth, true, pool);
+    residual(*this, level, alpha, pool);
+    Level& coarse = levels[l + 1];
+    restrict_to(level.r, level.Nx, coarse.b, coarse.Nx, coarse.Ny, pool);
+    vcycle(l + 1, pool);
+    prolong_add(coarse.x, coarse.Nx, coarse.Ny, level.x, level.Nx, level.Ny, pool);
+    jacobi(*this, level, alpha, kPostSmooth, false, pool);
+}
+
+CrankNicolsonMultigrid::cd CrankNicolsonMultigrid::dot(const Field& a, const Field& b, ThreadPool* pool) {
+    const int n = static_cast<int>(a.size());
+    std::fill(partial.begin(), partial.end(), cd(0.0, 0.0));
+    parallel_for(pool, 0, n, [&](int k0, int k1, int worker) {
+        double re = 0.0, im = 0.0;
+        for (int k = k0; k < k1; ++k) {
+            // conj(a) b
+            re += a.re[k] * b.re[k] + a.im[k] * b.im[k];
+            im += a.re[k] * b.im[k] - a.im[k] * b.re[k];
+        }
+        partial[worker] = cd(re, im);
+    });
+    cd sum(0.0, 0.0);
+    for (const cd& v : partial) sum += v;
+    return sum;
+}
+
+bool CrankNicolsonMultigrid::solve(ThreadPool* pool) {
+    S2D_PROFILE_SCOPE("CN-MG solve");
+    const Level& fine = levels[0];
+    const double alpha = 0.5 * cachedDt;
+    auto precondition = [&](const Field& in, Field& out) {
+        levels[0].b.re.assign(in.re.begin(), in.re.end());
+        levels[0].b.im.assign(in.im.begin(), in.im.end());
+        vcycle(0, pool);
+        out.re.assign(levels[0].x.re.begin(), levels[0].x.re.end());
+        out.im.assign(levels[0].x.im.begin(), levels[0].x.im.end());
+    };
+
+    const double bnorm = std::sqrt(dot(rhs, rhs, pool).real());
+    lastIterations = 0;
+    lastResidual = 0.0;
+    if (bnorm == 0.0) {
+        x.fill(cd(0.0, 0.0));
+        return true;
+    }
+    const double target = tol * bnorm;
+    apply(fine, x, r, alpha, pool);
+    axpy(r, rhs, cd(-1.0, 0.0), r, pool); // r = b - A x
+    r0.re.assign(r.re.begin(), r.re.end());
+    r0.im.assign(r.im.begin(), r.im.end());
+    double rnorm = std::sqrt(dot(r, r, pool).real());
+    if (rnorm <= target) {
+        lastResidual = rnorm / bnorm;
+        return true;
+    }
+
+    cd rho(1.0, 0.0), alphaK(1.0, 0.0), omega(1.0, 0.0);
+    for (int it = 0; it < maxIter; ++it) {
+        lastIterations = it + 1;
+        const cd rhoNew = dot(r0, r, pool);
+        if (std::abs(rhoNew) == 0.0) break; // breakdown: keep the best x so far
+        if (it == 0) {
+            p.re.assign(r.re.begin(), r.re.end());
+            p.im.assign(r.im.begin(), r.im.end());
+        } else {
+            const cd beta = (rhoNew / rho) * (alphaK / omega);
+            axpy(p, p, -omega, v, pool); // p - omega v
+            axpy(p, r, beta, p, pool);   // r + beta (p - omega v)
+        }
+        precondition(p, phat);
+        apply(fine, phat, v, alpha, pool);
+        alphaK = rhoNew / dot(r0, v, pool);
+        axpy(s, r, -alphaK, v, pool);
+        const double snorm = std::sqrt(dot(s, s, pool).real());
+        if (snorm <= target) {
+            axpy(x, x, alphaK, phat, pool);
+            lastResidual = snorm / bnorm;
+            return true;
+        }
+        precondition(s, shat);
+        apply(fine, shat, t, alpha, pool);
+        const double tt = dot(t, t, pool).real();
+        omega = tt > 0.0 ? dot(t, s, pool) / tt : cd(0.0, 0.0);
+        axpy(x, x, alphaK, phat, pool);
+        axpy(x, x, omega, shat, pool);
+        axpy(r, s, -omega, t, pool);
+        rnorm = std::sqrt(dot(r, r, pool).real());
+        lastResidual = rnorm / bnorm;
+        if (rnorm <= target) return true;
+        if (std::abs(omega) == 0.0) break;
+        rho = rhoNew;
+    }
+    return false;
+}
+
+void CrankNicolsonMultigrid::step_n(Field& psi, int Nx, int Ny, double dx, double dy, double dt, const Field& V,
+                                    std::uint64_t vGeneration, int steps, ThreadPool* pool, MassReduction* reduce) {
+    if (steps <= 0) return;
+    ensure(V, Nx, Ny, dx, dy, dt, vGeneration, pool_size(pool));
+    const double alpha = 0.5 * dt;
+    // The extrapolated guess only holds while psi is the solution this engine returned last
+    bool continuous = haveHistory && same(psi, last);
+    lastConverged = true;
+    for (int step = 0; step < steps; ++step) {
+        apply(levels[0], psi, rhs, -alpha, pool);
+        if (continuous) {
+            axpy(x, psi, cd(1.0, 0.0), psi, pool);
+            axpy(x, x, cd(-1.0, 0.0), previous, pool); // 2 psi - psi_prev
+        } else {
+            x.re.assign(psi.re.begin(), psi.re.end());
+            x.im.assign(psi.im.begin(), psi.im.end());
+        }
+        if (!solve(pool)) lastConverged = false;
+        previous.re.assign(psi.re.begin(), psi.re.end());
+        previous.im.assign(psi.im.begin(), psi.im.end());
+        psi.re.assign(x.re.begin(), x.re.end());
+        psi.im.assign(x.im.begin(), x.im.end());
+        continuous = true;
+    }
+    last.re.assign(psi.re.begin(), psi.re.end());
+    last.im.assign(psi.im.begin(), psi.im.end());
+    haveHistory = true;
+    if (reduce) reduce->reduce(psi, Nx, Ny, pool);
+}
+
+} // namespace sim
@@ -0,0 +1,91 @@
+// Full 2D Crank-Nicolson engine with a multigrid-preconditioned Krylov solve
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "field.hpp"
+#include "propagator.hpp"
+#include "thread_pool.hpp"
+
+namespace sim {
+
+// One step solves (I + i dt/2 H) psi' = (I - i dt/2 H) psi on the five-point
+// stencil, without splitting H into x and y parts, so terms that couple the
+// two directions are fine. H = (1/2)(p - A)^2 + V with a uniform field B_z in
+// the symmetric gauge about the domain centre; the vector potential enters as
+// Peierls phases on the stencil links. V may be complex (CAP sponge).
+//
+// The solve is right-preconditioned BiCGStab, matrix-free and split by rows
+// across the pool. The preconditioner is one geometric multigrid V-cycle:
+// damped Jacobi smoothing, 2x2 averaging restriction, bilinear prolongation,
+// the operator rediscretized on each coarser (cell-centred) grid while both
+// sizes stay even. The initial guess extrapolates from the previous two
+// solutions when psi is the last one returned, and is psi itself otherwise.
+//
+// Needs a few stencil applications per iteration (typically 3-6 iterations),
+// so CrankNicolsonADI stays the fast path whenever B = 0. Double precision only.
+struct CrankNicolsonMultigrid : Propagator {
+    using cd = std::complex<double>;
+
+    // A = I + i alpha H rediscretized on one grid
+    struct Level {
+        int Nx{0}, Ny{0};
+        double dx{1.0}, dy{1.0};
+        Field V;                 // restricted potential
+        std::vector<cd> phaseX;  // exp(-i A_x dx), factor on the (i+1, j) neighbour, per row j
+        std::vector<cd> phaseY;  // exp(-i A_y dy), factor on the (i, j+1) neighbour, per column i
+        Field diagInv;           // 1 / diagonal of A (Jacobi)
+        Field x, b, r;           // V-cycle solution, right-hand side, residual
+    };
+
+    static constexpr int kPreSmooth = 2;
+    static constexpr int kPostSmooth = 2;
+    static constexpr int kCoarseSweeps = 30;
+    static constexpr double kJacobiWeight = 0.8;
+
+    double magneticField{0.0}; // B_z, set by the caller before step_n()
+    // Relative residual |b - A x| / |b| per step. 1e-8 moves the smoke scene's
+    // mass by ~1e-7 relative, far below the scheme's own O(dt^2 + h^2) error;
+    // every further factor of 100 costs about one more iteration.
+    double tol{1e-8};
+    int maxIter{200};
+
+    // Statistics of the last step_n() call
+    int lastIterations{0};     // BiCGStab iterations of its last step
+    double lastResidual{0.0};  // relative residual reached
+    bool lastConverged{true};
+
+    // Hierarchy and solver vectors, rebuilt only when grid, dt, V or B change
+    bool valid{false};
+    int cachedNx{0}, cachedNy{0};
+    double cachedDx{0.0}, cachedDy{0.0}, cachedDt{0.0}, cachedB{0.0};
+    std::uint64_t cachedGeneration{0};
+    std::vector<Level> levels;
+    Field rhs, x, r, r0, p, v, s, t, phat, shat;
+    Field last, previous; // the last two solutions (warm start)
+    bool haveHistory{false};
+    std::vector<cd> partial; // per-worker dot products
+
+    const char* name() const override { return "CN multigrid"; }
+
+    void ensure(const Field& V, int Nx, int Ny, double dx, double dy, double dt, std::uint64_t vGeneration,
+                int threads);
+
+    void step_n(Field& psi,
+                int Nx, int Ny, double dx, double dy, double dt,
+                const Field& V, std::uint64_t vGeneration,
+                int steps,
+                ThreadPool* pool = nullptr,
+                MassReduction* reduce = nullptr) override;
+
+    // y = (I + i alpha H) x on a level (alpha = +dt/2 for A, -dt/2 for the right-hand side)
+    void apply(const Level& level, const Field& in, Field& out, double alpha, ThreadPool* pool) const;
+    // levels[l].x ~ A^-1 levels[l].b, from zero
+    void vcycle(int l, ThreadPool* pool);
+    cd dot(const Field& a, const Field& b, ThreadPool* pool); // sum conj(a) b
+    bool solve(ThreadPool* pool); // x: guess in, solution out; rhs given
+};
+
+} // namespace sim
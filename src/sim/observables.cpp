@@ -0,0 +1,214 @@
+#include "observables.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "alloc_guard.hpp"
+#include "profiler.hpp"
+
+namespace sim {
+
+namespace {
+
+// Partial sums per row and values per sample of each kind
+int slots_of(Probe::Kind kind) {
+    return kind == Probe::Kind::Moments ? 5 : 1;
+}
+
+int values_of(Probe::Kind kind) {
+    switch (kind) {
+    case Probe::Kind::Moments: return 4;
+    case Probe::Kind::Absorbed: return 2;
+    default: return 1;
+    }
+}
+
+// Im(conj(a) b) on split components
+inline double im_conj(double ar, double ai, double br, double bi) {
+    return ar * bi - ai * br;
+}
+
+} // namespace
+
+const char* probe_kind_name(Probe::Kind kind) {
+    switch (kind) {
+    case Probe::Kind::Flux: return "flux";
+    case Probe::Kind::Moments: return "moments";
+    case Probe::Kind::Absorbed: return "absorbed";
+    default: return "region";
+    }
+}
+
+bool parse_probe_kind(const std::string& name, Probe::Kind& out) {
+    for (Probe::Kind k : {Probe::Kind::Region, Probe::Kind::Flux, Probe::Kind::Moments, Probe::Kind::Absorbed}) {
+        if (name == probe_kind_name(k)) {
+            out = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> Observables::columns() const {
+    std::vector<std::string> names{"mass"};
+    for (const Probe& p : probes) {
+        if (p.kind == Probe::Kind::Moments) {
+            for (const char* suffix : {".x", ".y", ".px", ".py"}) names.push_back(p.name + suffix);
+        } else if (p.kind == Probe::Kind::Absorbed) {
+            names.push_back(p.name);
+            names.push_back(p.name + ".rate");
+        } else {
+            names.push_back(p.name);
+        }
+    }
+    return names;
+}
+
+std::uint64_t Observables::layout_key() const {
+    std::uint64_t k = heap::key({probes.size()});
+    for (const Probe& p : probes) k = heap::key({k, static_cast<std::uint64_t>(p.kind)});
+    return k;
+}
+
+void Observables::prepare(int Nx, int Ny) {
+    Nx_ = Nx;
+    Ny_ = Ny;
+    spans_.resize(probes.size());
+    int slot = 1; // slot 0: mass of the whole grid
+    int count = 1;
+    for (std::size_t k = 0; k < probes.size(); ++k) {
+        const Probe& p = probes[k];
+        Span& s = spans_[k];
+        s.slot = slot;
+        s.rect = box_rect(Box{p.x0, p.y0, p.x1, p.y1, 0.0}, Nx, Ny);
+        if (p.kind == Probe::Kind::Flux) {
+            s.vertical = p.x0 == p.x1;
+            s.face = s.vertical ? std::clamp(static_cast<int>(std::lround(p.x0 * Nx)), 1, Nx - 1)
+                                : std::clamp(static_cast<int>(std::lround(p.y0 * Ny)), 1, Ny - 1);
+        }
+        slot += slots_of(p.kind);
+        count += values_of(p.kind);
+    }
+    slots_ = slot;
+    partial_.resize(static_cast<std::size_t>(slots_) * Ny);
+    values.resize(static_cast<std::size_t>(count));
+}
+
+void Observables::measure(const Field& psi, const Field& V, int Nx, int Ny, double dx, double dy, double initialMass,
+                          ThreadPool* pool, MassReduction* sums) {
+    S2D_PROFILE_SCOPE("observables");
+    prepare(Nx, Ny);
+    if (sums) sums->prepare(Ny);
+    const double* zr = psi.re.data();
+    const double* zi = psi.im.data();
+    const double* vi = V.im.data();
+    auto slot = [this](int s, int j) -> double& { return partial_[static_cast<std::size_t>(s) * Ny_ + j]; };
+
+    parallel_for(pool, 0, Ny, [&](int jb, int je, int) {
+        for (int j = jb; j < je; ++j) {
+            const std::size_t row = static_cast<std::size_t>(j) * Nx;
+            const double* re = zr + row;
+            const double* im = zi + row;
+            if (sums) {
+                sums->accumulate_row(j, re, im, Nx);
+                slot(0, j) = sums->rowLeft[static_cast<std::size_t>(j)] + sums->rowRight[static_cast<std::size_t>(j)];
+            } else {
+                slot(0, j) = sum_norm(re, im, Nx);
+            }
+
+            for (std::size_t k = 0; k < probes.size(); ++k) {
+                const Span& s = spans_[k];
+                const GridRect& r = s.rect;
+                const bool inRows = j >= r.j0 && j < r.j1;
+                switch (probes[k].kind) {
+                case Probe::Kind::Region:
+                    slot(s.slot, j) = inRows ? sum_norm(re + r.i0, im + r.i0, r.i1 - r.i0) : 0.0;
+                    break;
+                case Probe::Kind::Flux: {
+                    double f = 0.0;
+                    if (s.vertical) {
+                        if (inRows) f = im_conj(re[s.face - 1], im[s.face - 1], re[s.face], im[s.face]);
+                    } else if (j == s.face - 1) {
+                        const double* nr = re + Nx;
+                        const double* ni = im + Nx;
+                        for (int i = r.i0; i < r.i1; ++i) f += im_conj(re[i], im[i], nr[i], ni[i]);
+                    }
+                    slot(s.slot, j) = f;
+                    break;
+                }
+                case Probe::Kind::Moments: {
+                    double m = 0.0, mx = 0.0, px = 0.0, py = 0.0;
+                    if (inRows) {
+                        const double* ur = j > 0 ? re - Nx : nullptr;
+                        const double* ui = j > 0 ? im - Nx : nullptr;
+                        const double* dr = j + 1 < Ny ? re + Nx : nullptr;
+                        const double* di = j + 1 < Ny ? im + Nx : nullptr;
+                        for (int i = r.i0; i < r.i1; ++i) {
+                            const double n = re[i] * re[i] + im[i] * im[i];
+                            m += n;
+                            mx += (i + 0.5) * dx * n;
+                            const double lr = i > 0 ? re[i - 1] : 0.0;
+                            const double li = i > 0 ? im[i - 1] : 0.0;
+                            const double rr = i + 1 < Nx ? re[i + 1] : 0.0;
+                            const double ri = i + 1 < Nx ? im[i + 1] : 0.0;
+                            px += im_conj(re[i], im[i], rr - lr, ri - li);
+                            const double ar = ur ? ur[i] : 0.0;
+                            const double ai = ui ? ui[i] : 0.0;
+                            const double br = dr ? dr[i] : 0.0;
+                            const double bi = di ? di[i] : 0.0;
+                            py += im_conj(re[i], im[i], br - ar, bi - ai);
+                        }
+                    }
+                    slot(s.slot, j) = m;
+                    slot(s.slot + 1, j) = mx;
+                    slot(s.slot + 2, j) = (j + 0.5) * dy * m;
+                    slot(s.slot + 3, j) = px;
+                    slot(s.slot + 4, j) = py;
+                    break;
+                }
+                case Probe::Kind::Absorbed: {
+                    double a = 0.0;
+                    for (int i = 0; i < Nx; ++i) a -= vi[row + i] * (re[i] * re[i] + im[i] * im[i]);
+                    slot(s.slot, j) = a;
+                    break;
+                }
+                }
+            }
+        }
+    });
+    if (sums) sums->finish();
+
+    auto total = [&](int s) { return pairwise_sum(partial_.data() + static_cast<std::size_t>(s) * Ny, Ny); };
+    const double cell = dx * dy;
+    const double mass = total(0) * cell;
+    std::size_t v = 0;
+    values[v++] = mass;
+    for (std::size_t k = 0; k < probes.size(); ++k) {
+        const Span& s = spans_[k];
+        switch (probes[k].kind) {
+        case Probe::Kind::Region:
+            values[v++] = total(s.slot) * cell;
+            break;
+        case Probe::Kind::Flux:
+            values[v++] = s.vertical ? total(s.slot) * dy / dx : total(s.slot) * dx / dy;
+            break;
+        case Probe::Kind::Moments: {
+            const double m = total(s.slot);
+            const double inv = m > 0.0 ? 1.0 / m : 0.0;
+            values[v++] = total(s.slot + 1) * inv;
+            values[v++] = total(s.slot + 2) * inv;
+            values[v++] = total(s.slot + 3) * inv / (2.0 * dx);
+            values[v++] = total(s.slot + 4) * inv / (2.0 * dy);
+            break;
+        }
+        case Probe::Kind::Absorbed:
+            values[v++] = initialMass - mass;
+            values[v++] = 2.0 * total(s.slot) * cell;
+            break;
+        }
+    }
+    ++samples;
+    stepsSinceSample = 0;
+}
+
+} // namespace sim
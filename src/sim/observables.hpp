@@ -0,0 +1,82 @@
+// Scalar observables of psi sampled during stepping, for time series
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "field.hpp"
+#include "potential.hpp"
+#include "propagator.hpp"
+#include "thread_pool.hpp"
+
+namespace sim {
+
+// A measurement of psi, placed in normalized [0,1] coordinates like Box.
+//  Region:   mass inside the rectangle.
+//  Flux:     probability current through a segment, positive along +x (vertical
+//            segment, x0 == x1) or +y (horizontal, y0 == y1). The discrete current
+//            Im(conj(psi_a) psi_b) / h across the cell faces on the segment is
+//            the one the five-point stencil conserves.
+//  Moments:  <x>, <y>, <p_x>, <p_y> of the part of psi inside the rectangle,
+//            normalized by its mass (central differences for p).
+//  Absorbed: mass the CAP has taken since the baseline (initial - current
+//            mass), and the instantaneous rate 2 sum |Im V| |psi|^2 dx dy.
+struct Probe {
+    enum class Kind { Region, Flux, Moments, Absorbed };
+
+    Kind kind{Kind::Region};
+    std::string name;
+    double x0{0.0}, y0{0.0}, x1{1.0}, y1{1.0};
+};
+
+const char* probe_kind_name(Probe::Kind kind);
+bool parse_probe_kind(const std::string& name, Probe::Kind& out); // "region" / "flux" / "moments" / "absorbed"
+
+// Probes evaluated together in one row-parallel pass over psi, every `every`
+// time steps. The pass also fills the diagnostics' MassReduction when one is
+// passed, so a step that is both sampled and checked reads psi once. Rows are
+// reduced independently and combined pairwise in row order, so samples do not
+// depend on the thread count.
+struct Observables {
+    std::vector<Probe> probes;
+    int every{10}; // time steps between samples
+
+    // Latest sample: one value per column (see columns())
+    std::vector<double> values;
+    std::uint64_t samples{0}; // samples taken; a driver compares it with the last one it wrote
+    std::uint64_t sampleStep{0};
+    double sampleTime{0.0};
+    int stepsSinceSample{0};
+
+    bool active() const { return !probes.empty(); }
+    // Column names: "mass", then each probe's (Moments: name.x, name.y,
+    // name.px, name.py; Absorbed: name, name.rate).
+    std::vector<std::string> columns() const;
+
+    // Sizes the per-row sums and maps the probes onto an Nx x Ny grid; only
+    // reallocates when the layout changed.
+    void prepare(int Nx, int Ny);
+    std::uint64_t layout_key() const; // what prepare() sizes its buffers by
+
+    // Measures psi; initialMass is the diagnostics baseline (Absorbed).
+    // With sums (prepared window), also accumulates and finishes the diagnostics rows.
+    void measure(const Field& psi, const Field& V, int Nx, int Ny, double dx, double dy, double initialMass,
+                 ThreadPool* pool, MassReduction* sums = nullptr);
+
+private:
+    // Cells of one probe on the prepared grid
+    struct Span {
+        int slot{0};    // first partial-sum slot
+        GridRect rect;  // Region, Moments; Flux: the cells along the segment
+        int face{0};    // Flux: between cells face - 1 and face (columns if vertical, rows otherwise)
+        bool vertical{true};
+    };
+
+    int Nx_{0}, Ny_{0};
+    int slots_{0};                // partial sums per row
+    std::vector<Span> spans_;
+    std::vector<double> partial_; // slot-major: partial_[slot * Ny + j]
+};
+
+} // namespace sim
@@ -2,97 +2,317 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
+
+#include "profiler.hpp"
 
 namespace sim {
 
 static inline int idx(int i, int j, int Nx) { return j * Nx + i; }
 
-void PotentialField::build(std::vector<std::complex<double>>& V) const {
-    using cd = std::complex<double>;
-    V.assign(static_cast<size_t>(Nx*Ny), cd(0.0, 0.0));
-
-    // Add rectangular boxes (real potential)
-    for (const auto& b : boxes) {
-        int ix0 = std::max(0, std::min(Nx-1, (int)std::floor(b.x0 * Nx)));
-        int ix1 = std::max(0, std::min(Nx-1, (int)std::floor(b.x1 * Nx)));
-        int iy0 = std::max(0, std::min(Ny-1, (int)std::floor(b.y0 * Ny)));
-        int iy1 = std::max(0, std::min(Ny-1, (int)std::floor(b.y1 * Ny)));
-        if (ix1 < ix0) std::swap(ix0, ix1);
-        if (iy1 < iy0) std::swap(iy0, iy1);
-        for (int j = iy0; j <= iy1; ++j) {
-            for (int i = ix0; i <= ix1; ++i) {
-                V[idx(i,j,Nx)] += cd(b.height, 0.0);
+static inline double well_r0(const RadialWell& w, const PotentialField& pf) {
+    return std::max(1e-4, w.radius * std::min(pf.Lx, pf.Ly));
+}
+
+static inline double well_value(const RadialWell& w, double r2, double r0, double r0sq) {
+    switch (w.profile) {
+    case RadialWell::Profile::Gaussian: {
+        double t = r2 / r0sq;
+        return w.strength * std::exp(-t);
+    }
+    case RadialWell::Profile::SoftCoulomb:
+        return w.strength / std::sqrt(r2 + r0sq);
+    case RadialWell::Profile::InverseSquare:
+        return w.strength / (r2 + r0sq);
+    case RadialWell::Profile::HarmonicOscillator: {
+        // Parabolic trap that reaches w.strength at the center and 0 at radius r0
+        double r = std::sqrt(r2);
+        if (r < r0) {
+            double t = r / r0;
+            return w.strength * (1.0 - t * t);
+        }
+        return 0.0;
+    }
+    }
+    return 0.0;
+}
+
+// Squared radius beyond which |contribution| < tol * |peak| (infinite if unbounded).
+static double well_cutoff_r2(const RadialWell& w, double r0sq, double tol) {
+    const double inf = std::numeric_limits<double>::infinity();
+    if (w.profile == RadialWell::Profile::HarmonicOscillator) return r0sq; // compact support
+    if (!(tol > 0.0) || tol >= 1.0) return inf;
+    switch (w.profile) {
+    case RadialWell::Profile::Gaussian:      return r0sq * -std::log(tol);             // exp(-r2/r0sq) = tol
+    case RadialWell::Profile::SoftCoulomb:   return r0sq * (1.0 / (tol * tol) - 1.0);  // r0/sqrt(r2+r0sq) = tol
+    case RadialWell::Profile::InverseSquare: return r0sq * (1.0 / tol - 1.0);          // r0sq/(r2+r0sq) = tol
+    case RadialWell::Profile::HarmonicOscillator: break;
+    }
+    return inf;
+}
+
+// Cells [lo, hi) whose centres (i + 0.5) * h can lie within rc of c, widened by
+// one cell so rounding never drops a cell that passes the exact r2 test.
+static void cell_span(double c, double rc, double h, int n, int& lo, int& hi) {
+    const double a = std::clamp((c - rc) / h - 0.5, -1.0, double(n));
+    const double b = std::clamp((c + rc) / h - 0.5, -1.0, double(n));
+    lo = std::max(0, int(std::ceil(a)) - 1);
+    hi = std::min(n, int(std::floor(b)) + 2);
+}
+
+GridRect box_rect(const Box& b, int Nx, int Ny) {
+    int ix0 = std::max(0, std::min(Nx-1, (int)std::floor(b.x0 * Nx)));
+    int ix1 = std::max(0, std::min(Nx-1, (int)std::floor(b.x1 * Nx)));
+    int iy0 = std::max(0, std::min(Ny-1, (int)std::floor(b.y0 * Ny)));
+    int iy1 = std::max(0, std::min(Ny-1, (int)std::floor(b.y1 * Ny)));
+    if (ix1 < ix0) std::swap(ix0, ix1);
+    if (iy1 < iy0) std::swap(iy0, iy1);
+    return GridRect{ix0, ix1 + 1, iy0, iy1 + 1};
+}
+
+GridRect well_rect(const RadialWell& w, const PotentialField& pf) {
+    const double r0 = well_r0(w, pf);
+    const double rc2 = well_cutoff_r2(w, r0 * r0, pf.well_cutoff);
+    if (!std::isfinite(rc2)) return GridRect{0, pf.Nx, 0, pf.Ny};
+    const double rc = std::sqrt(rc2);
+    GridRect r;
+    cell_span(w.cx * pf.Lx, rc, pf.Lx / pf.Nx, pf.Nx, r.i0, r.i1);
+    cell_span(w.cy * pf.Ly, rc, pf.Ly / pf.Ny, pf.Ny, r.j0, r.j1);
+    return r;
+}
+
+static GridRect intersect(const GridRect& a, const GridRect& b) {
+    return GridRect{std::max(a.i0, b.i0), std::min(a.i1, b.i1),
+                    std::max(a.j0, b.j0), std::min(a.j1, b.j1)};
+}
+
+// Values of w over its cutoff rectangle, clipped to `clip`.
+static void compute_well_layer(PotentialLayers::WellLayer& layer, const RadialWell& w, const PotentialField& pf,
+                               const GridRect& clip) {
+    layer.well = w;
+    layer.rect = intersect(well_rect(w, pf), clip);
+    const GridRect& r = layer.rect;
+    layer.values.assign(r.empty() ? 0 : size_t(r.i1 - r.i0) * size_t(r.j1 - r.j0), 0.0);
+    if (r.empty()) return;
+
+    const int Nx = pf.Nx;
+    const int Ny = pf.Ny;
+    const double r0 = well_r0(w, pf);
+    const double r0sq = r0 * r0;
+    const double rc2 = well_cutoff_r2(w, r0sq, pf.well_cutoff);
+    const double cx = w.cx * pf.Lx;
+    const double cy = w.cy * pf.Ly;
+    const int width = r.i1 - r.i0;
+    for (int j = r.j0; j < r.j1; ++j) {
+        double y = (j + 0.5) * (pf.Ly / Ny);
+        double dy = y - cy;
+        double* row = layer.values.data() + size_t(j - r.j0) * width;
+        for (int i = r.i0; i < r.i1; ++i) {
+            double x = (i + 0.5) * (pf.Lx / Nx);
+            double dx = x - cx;
+            double r2 = dx * dx + dy * dy;
+            if (r2 > rc2) continue;
+            row[i - r.i0] = well_value(w, r2, r0, r0sq);
+        }
+    }
+}
+
+static bool same_box(const Box& a, const Box& b) {
+    return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1 && a.height == b.height;
+}
+
+static bool same_well(const RadialWell& a, const RadialWell& b) {
+    return a.cx == b.cx && a.cy == b.cy && a.strength == b.strength &&
+           a.radius == b.radius && a.profile == b.profile;
+}
+
+void PotentialField::build(Field& V) const {
+    PotentialLayers layers;
+    layers.build(*this, V);
+}
+
+void PotentialLayers::fill_real(Field& V, const GridRect& r) const {
+    for (int j = r.j0; j < r.j1; ++j) {
+        std::fill(V.re.begin() + idx(r.i0, j, Nx), V.re.begin() + idx(r.i1, j, Nx), 0.0);
+    }
+
+    // Rectangular boxes (real potential)
+    for (size_t k = 0; k < boxes.size(); ++k) {
+        const GridRect c = intersect(r, boxRects[k]);
+        const double height = boxes[k].height;
+        for (int j = c.j0; j < c.j1; ++j) {
+            for (int i = c.i0; i < c.i1; ++i) {
+                V.re[idx(i,j,Nx)] += height;
+            }
+        }
+    }
+
+    // Smooth radial wells
+    for (const auto& layer : wells) {
+        const GridRect c = intersect(r, layer.rect);
+        const int width = layer.rect.i1 - layer.rect.i0;
+        for (int j = c.j0; j < c.j1; ++j) {
+            const double* row = layer.values.data() + size_t(j - layer.rect.j0) * width;
+            for (int i = c.i0; i < c.i1; ++i) {
+                V.re[idx(i,j,Nx)] += row[i - layer.rect.i0];
             }
         }
     }
+}
+
+// Complex absorbing potential (CAP) sponge near boundaries: Im V of cell (i, j).
+// A smooth polynomial ramp: w(s) = s^2 (3 - 2s) in [0,1]
+static inline double cap_value(int i, int j, int Nx, int Ny, int wx, int wy, double strength) {
+    double sx = 0.0;
+    if (i < wx) sx = double(wx - i) / double(wx);
+    else if (i >= Nx - wx) sx = double(i - (Nx - wx - 1)) / double(wx);
+    double sy = 0.0;
+    if (j < wy) sy = double(wy - j) / double(wy);
+    else if (j >= Ny - wy) sy = double(j - (Ny - wy - 1)) / double(wy);
+    double s = std::max(sx, sy);
+    if (s <= 0.0) return 0.0;
+    double ramp = s * s * (3.0 - 2.0 * s); // smoothstep
+    double absorb = strength * ramp * ramp; // stronger near edges
+    return -absorb; // -i*absorb (imaginary negative)
+}
 
-    // Add smooth radial wells
-    const double minLength = std::min(Lx, Ly);
-
-    for (const auto& w : wells) {
-        double r0 = std::max(1e-4, w.radius * minLength);
-        double r0sq = r0 * r0;
-        double cx = w.cx * Lx;
-        double cy = w.cy * Ly;
-        for (int j = 0; j < Ny; ++j) {
-            double y = (j + 0.5) * (Ly / Ny);
-            double dy = y - cy;
-            for (int i = 0; i < Nx; ++i) {
-                double x = (i + 0.5) * (Lx / Nx);
-                double dx = x - cx;
-                double r2 = dx * dx + dy * dy;
-                double contrib = 0.0;
-                switch (w.profile) {
-                case RadialWell::Profile::Gaussian: {
-                    double t = r2 / r0sq;
-                    contrib = w.strength * std::exp(-t);
-                    break;
-                }
-                case RadialWell::Profile::SoftCoulomb: {
-                    contrib = w.strength / std::sqrt(r2 + r0sq);
-                    break;
-                }
-                case RadialWell::Profile::InverseSquare: {
-                    contrib = w.strength / (r2 + r0sq);
-                    break;
-                }
-                case RadialWell::Profile::HarmonicOscillator: {
-                    // Parabolic trap that reaches w.strength at the center and 0 at radius r0
-                    double r = std::sqrt(r2);
-                    if (r < r0) {
-                        double t = r / r0;
-                        contrib = w.strength * (1.0 - t * t);
-                    } else {
-                        contrib = 0.0;
-                    }
-                    break;
-                }
-                }
-                V[idx(i,j,Nx)] += cd(contrib, 0.0);
+static inline int cap_width(double ratio, int n) {
+    return std::max(1, (int)std::round(ratio * n));
+}
+
+void PotentialField::build_rows(Field& V, int j0, int j1) const {
+    S2D_PROFILE_SCOPE("potential build");
+    j0 = std::max(0, j0);
+    j1 = std::min(Ny, j1);
+    const int rows = std::max(0, j1 - j0);
+    V.assign(static_cast<size_t>(Nx) * rows);
+    const GridRect slab{0, Nx, j0, j0 + rows};
+
+    // Same terms in the same order as PotentialLayers::fill_real()
+    for (const Box& b : boxes) {
+        const GridRect c = intersect(slab, box_rect(b, Nx, Ny));
+        for (int j = c.j0; j < c.j1; ++j) {
+            for (int i = c.i0; i < c.i1; ++i) {
+                V.re[idx(i, j - j0, Nx)] += b.height;
+            }
+        }
+    }
+    PotentialLayers::WellLayer layer;
+    for (const RadialWell& w : wells) {
+        compute_well_layer(layer, w, *this, slab);
+        const GridRect& r = layer.rect;
+        if (r.empty()) continue;
+        const int width = r.i1 - r.i0;
+        for (int j = r.j0; j < r.j1; ++j) {
+            const double* row = layer.values.data() + size_t(j - r.j0) * width;
+            for (int i = r.i0; i < r.i1; ++i) {
+                V.re[idx(i, j - j0, Nx)] += row[i - r.i0];
             }
         }
     }
 
-    // Add complex absorbing potential (CAP) sponge near boundaries
-    // A smooth polynomial ramp: w(s) = s^2 (3 - 2s) in [0,1]
-    const int wx = std::max(1, (int)std::round(cap_ratio * Nx));
-    const int wy = std::max(1, (int)std::round(cap_ratio * Ny));
+    const int wx = cap_width(cap_ratio, Nx);
+    const int wy = cap_width(cap_ratio, Ny);
+    for (int j = j0; j < j0 + rows; ++j) {
+        for (int i = 0; i < Nx; ++i) {
+            V.im[idx(i, j - j0, Nx)] = cap_value(i, j, Nx, Ny, wx, wy, cap_strength);
+        }
+    }
+}
+
+void PotentialLayers::build_cap(const PotentialField& pf) {
+    capStrength = pf.cap_strength;
+    capRatio = pf.cap_ratio;
+    cap.assign(static_cast<size_t>(Nx*Ny), 0.0);
+
+    const int wx = cap_width(capRatio, Nx);
+    const int wy = cap_width(capRatio, Ny);
     for (int j = 0; j < Ny; ++j) {
         for (int i = 0; i < Nx; ++i) {
-            double sx = 0.0;
-            if (i < wx) sx = double(wx - i) / double(wx);
-            else if (i >= Nx - wx) sx = double(i - (Nx - wx - 1)) / double(wx);
-            double sy = 0.0;
-            if (j < wy) sy = double(wy - j) / double(wy);
-            else if (j >= Ny - wy) sy = double(j - (Ny - wy - 1)) / double(wy);
-            double s = std::max(sx, sy);
-            if (s > 0.0) {
-                double ramp = s * s * (3.0 - 2.0 * s); // smoothstep
-                double absorb = cap_strength * ramp * ramp; // stronger near edges
-                V[idx(i,j,Nx)] += cd(0.0, -absorb); // -i*absorb (imaginary negative)
-            }
+            cap[idx(i,j,Nx)] = cap_value(i, j, Nx, Ny, wx, wy, capStrength);
         }
     }
 }
 
+void PotentialLayers::build(const PotentialField& pf, Field& V) {
+    S2D_PROFILE_SCOPE("potential build");
+    Nx = pf.Nx;
+    Ny = pf.Ny;
+    Lx = pf.Lx;
+    Ly = pf.Ly;
+    wellCutoff = pf.well_cutoff;
+    boxes = pf.boxes;
+    boxRects.resize(boxes.size());
+    for (size_t k = 0; k < boxes.size(); ++k) boxRects[k] = box_rect(boxes[k], Nx, Ny);
+    wells.resize(pf.wells.size());
+    for (size_t k = 0; k < wells.size(); ++k) compute_well_layer(wells[k], pf.wells[k], pf, GridRect{0, Nx, 0, Ny});
+    build_cap(pf);
+    valid = true;
+
+    V.assign(static_cast<size_t>(Nx*Ny));
+    fill_real(V, GridRect{0, Nx, 0, Ny});
+    std::copy(cap.begin(), cap.end(), V.im.begin());
+}
+
+bool PotentialLayers::update(const PotentialField& pf, Field& V) {
+    S2D_PROFILE_SCOPE("potential update");
+    if (!valid || pf.Nx != Nx || pf.Ny != Ny || pf.Lx != Lx || pf.Ly != Ly ||
+        pf.well_cutoff != wellCutoff || V.size() != static_cast<size_t>(Nx*Ny)) {
+        build(pf, V);
+        return true;
+    }
+
+    bool changed = false;
+    if (pf.cap_strength != capStrength || pf.cap_ratio != capRatio) {
+        build_cap(pf);
+        std::copy(cap.begin(), cap.end(), V.im.begin());
+        changed = true;
+    }
+
+    // Old and new footprints of every added, removed or modified object
+    dirty.clear();
+    auto mark = [this](const GridRect& r) {
+        if (!r.empty()) dirty.push_back(r);
+    };
+
+    const size_t nBoxes = std::max(boxes.size(), pf.boxes.size());
+    for (size_t k = 0; k < nBoxes; ++k) {
+        const bool hadOld = k < boxes.size();
+        const bool hasNew = k < pf.boxes.size();
+        if (hadOld && hasNew && same_box(boxes[k], pf.boxes[k])) continue;
+        if (hadOld) mark(boxRects[k]);
+        if (hasNew) mark(box_rect(pf.boxes[k], Nx, Ny));
+    }
+    boxes = pf.boxes;
+    boxRects.resize(boxes.size());
+    for (size_t k = 0; k < boxes.size(); ++k) boxRects[k] = box_rect(boxes[k], Nx, Ny);
+
+    const size_t nWells = std::max(wells.size(), pf.wells.size());
+    for (size_t k = 0; k < nWells; ++k) {
+        const bool hadOld = k < wells.size();
+        const bool hasNew = k < pf.wells.size();
+        if (hadOld && hasNew && same_well(wells[k].well, pf.wells[k])) continue;
+        if (hadOld) mark(wells[k].rect);
+        if (hasNew) {
+            if (!hadOld) wells.emplace_back();
+            compute_well_layer(wells[k], pf.wells[k], pf, GridRect{0, Nx, 0, Ny});
+            mark(wells[k].rect);
+        }
+    }
+    wells.resize(pf.wells.size());
+
+    if (dirty.empty()) return changed;
+
+    // Overlapping rectangles are simply refilled twice; past half the grid a
+    // single full refill is cheaper.
+    size_t area = 0;
+    for (const auto& r : dirty) area += size_t(r.i1 - r.i0) * size_t(r.j1 - r.j0);
+    if (2 * area >= static_cast<size_t>(Nx*Ny)) {
+        fill_real(V, GridRect{0, Nx, 0, Ny});
+    } else {
+        for (const auto& r : dirty) fill_real(V, r);
+    }
+    return true;
+}
+
 } // namespace sim
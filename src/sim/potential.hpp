@@ -3,6 +3,8 @@
 #include <complex>
 #include <vector>
 
+#include "field.hpp"
+
 namespace sim {
 
 struct Box {
@@ -36,11 +38,67 @@ struct PotentialField {
     double Ly{1.0};
     double cap_strength{1.0};  // absorption coefficient
     double cap_ratio{0.1};     // fraction of domain width used for sponge (each side)
+    double well_cutoff{1e-6};  // wells are dropped where |contribution| < well_cutoff * |peak|; 0 = full grid
     std::vector<Box> boxes;     // static rectangular features
     std::vector<RadialWell> wells; // smooth radial features
 
     // compute complex potential V(i,j)
-    void build(std::vector<std::complex<double>>& V) const;
+    void build(Field& V) const;
+    // V over rows [j0, j1) only (Nx * (j1 - j0) values), equal to those rows of build()
+    void build_rows(Field& V, int j0, int j1) const;
+};
+
+// Cell range [i0, i1) x [j0, j1) of the grid
+struct GridRect {
+    int i0{0}, i1{0};
+    int j0{0}, j1{0};
+
+    bool empty() const { return i1 <= i0 || j1 <= j0; }
+};
+
+// Cells covered by a box (same floor-clamped, inclusive bounds as build()).
+GridRect box_rect(const Box& b, int Nx, int Ny);
+// Bounding cells of a well within its cutoff radius (see PotentialField::well_cutoff).
+GridRect well_rect(const RadialWell& w, const PotentialField& pf);
+
+// Per-object contributions of a PotentialField, kept so that V can be patched
+// when a few objects change instead of rebuilt over the whole grid.
+// Each well layer holds its values over its cutoff bounding rectangle; the CAP
+// sponge is cached separately and only recomputed when its parameters or the
+// grid change. A dirty region is refilled from all layers in build() order, so
+// update() produces exactly the V that build() would.
+struct PotentialLayers {
+    struct WellLayer {
+        RadialWell well;
+        GridRect rect;
+        std::vector<double> values; // row-major over rect
+    };
+
+    bool valid{false};
+    int Nx{0}, Ny{0};
+    double Lx{0.0}, Ly{0.0};
+    double wellCutoff{0.0};
+    std::vector<Box> boxes;
+    std::vector<GridRect> boxRects;
+    std::vector<WellLayer> wells;
+
+    double capStrength{0.0};
+    double capRatio{0.0};
+    std::vector<double> cap; // Im V, length Nx*Ny
+    std::vector<GridRect> dirty; // scratch of update(), kept so a drag does not allocate every frame
+
+    // Full rebuild of all layers and of V.
+    void build(const PotentialField& pf, Field& V);
+
+    // Brings V in line with pf, touching only the old and new cells of objects
+    // that changed since the last build()/update(). Falls back to build() when
+    // the grid changed or the dirty area approaches the whole grid.
+    // Returns false when nothing changed (V untouched).
+    bool update(const PotentialField& pf, Field& V);
+
+    // Helpers of build()/update()
+    void fill_real(Field& V, const GridRect& r) const; // V.re over r = sum of box and well layers
+    void build_cap(const PotentialField& pf);
 };
 
 } // namespace sim
@@ -0,0 +1,194 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#include "alloc_guard.hpp"
+
+namespace sim::profile {
+
+std::int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+#if S2D_PROFILE
+
+std::atomic<bool> g_enabled{false};
+
+namespace {
+
+// Registration is the only locked operation; readers take a copy of the list.
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+Registry& registry() {
+    static Registry* r = new Registry; // never destroyed: threads may record during exit
+    return *r;
+}
+
+std::vector<ThreadBuffer*> buffers_snapshot() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<ThreadBuffer*> out;
+    out.reserve(r.buffers.size());
+    for (const auto& b : r.buffers) out.push_back(b.get());
+    return out;
+}
+
+} // namespace
+
+void set_enabled(bool on) {
+    g_enabled.store(on, std::memory_order_relaxed);
+}
+
+ThreadBuffer& this_thread_buffer() {
+    thread_local ThreadBuffer* buffer = [] {
+        heap::Uncounted setup; // first event of a thread, possibly inside a guarded step
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<int>(r.buffers.size())));
+        return r.buffers.back().get();
+    }();
+    return *buffer;
+}
+
+bool available() { return true; }
+
+void Collector::drain(std::vector<Sample>& out) {
+    const std::vector<ThreadBuffer*> buffers = buffers_snapshot();
+    if (cursors_.size() < buffers.size()) cursors_.resize(buffers.size(), 0);
+    for (std::size_t t = 0; t < buffers.size(); ++t) {
+        const ThreadBuffer& b = *buffers[t];
+        std::uint64_t& cursor = cursors_[t];
+        const std::uint64_t head = b.head();
+        if (head - cursor > ThreadBuffer::kCapacity) {
+            dropped_ += head - ThreadBuffer::kCapacity - cursor;
+            cursor = head - ThreadBuffer::kCapacity;
+        }
+        const std::size_t first = out.size();
+        for (std::uint64_t i = cursor; i < head; ++i) {
+            const Event& e = b.at(i);
+            out.push_back({e.name.load(std::memory_order_relaxed), b.id(), e.start.load(std::memory_order_relaxed),
+                           e.duration.load(std::memory_order_relaxed)});
+        }
+        // Slots the writer reused while they were copied hold newer events: drop them.
+        // Index i shares its slot with i + kCapacity, which the writer may already be
+        // filling while head still reads i + kCapacity, so that slot counts as lost too.
+        // The fence keeps the relaxed loads above before the second head() (seqlock).
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::uint64_t after = b.head();
+        if (after - cursor >= ThreadBuffer::kCapacity) {
+            const std::uint64_t lost =
+                std::min<std::uint64_t>(after - ThreadBuffer::kCapacity - cursor + 1, head - cursor);
+            out.erase(out.begin() + static_cast<std::ptrdiff_t>(first),
+                      out.begin() + static_cast<std::ptrdiff_t>(first + lost));
+            dropped_ += lost;
+        }
+        cursor = head;
+    }
+}
+
+#else
+
+bool available() { return false; }
+
+void Collector::drain(std::vector<Sample>&) {}
+
+#endif
+
+void StageStats::update() {
+    samples_.clear();
+    collector_.drain(samples_);
+    for (const Sample& s : samples_) {
+        auto it = std::find_if(accum_.begin(), accum_.end(), [&](const Accum& a) { return a.name == s.name; });
+        if (it == accum_.end()) {
+            accum_.push_back({s.name});
+            it = accum_.end() - 1;
+        }
+        it->total += s.duration;
+        it->max = std::max(it->max, s.duration);
+        ++it->calls;
+    }
+    const std::int64_t now = now_ns();
+    if (windowStart_ == 0) windowStart_ = now;
+    const double seconds = static_cast<double>(now - windowStart_) * 1e-9;
+    if (seconds < window_) return;
+    published_.clear();
+    for (Accum& a : accum_) {
+        Stage st;
+        st.name = a.name;
+        st.msPerSecond = static_cast<double>(a.total) * 1e-6 / seconds;
+        st.msPerCall = a.calls ? static_cast<double>(a.total) * 1e-6 / static_cast<double>(a.calls) : 0.0;
+        st.callsPerSecond = static_cast<double>(a.calls) / seconds;
+        st.maxMs = static_cast<double>(a.max) * 1e-6;
+        published_.push_back(st);
+        a.total = a.max = 0;
+        a.calls = 0;
+    }
+    windowStart_ = now;
+}
+
+TraceRecorder::~TraceRecorder() {
+    stop();
+}
+
+void TraceRecorder::start() {
+    stop();
+    samples_.clear();
+    collector_.drain(samples_); // skip anything recorded before
+    samples_.clear();
+    origin_ = now_ns();
+    stop_ = false;
+    set_enabled(true);
+    thread_ = std::thread([this] {
+        // Drains well before a ring can wrap (16k events per thread)
+        while (!stop_.load(std::memory_order_relaxed)) {
+            collector_.drain(samples_);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+}
+
+void TraceRecorder::stop() {
+    if (!thread_.joinable()) return;
+    set_enabled(false);
+    stop_ = true;
+    thread_.join();
+    collector_.drain(samples_);
+}
+
+void TraceRecorder::write_chrome_trace(std::ostream& out) const {
+    // Complete ("X") events in microseconds, one track per recording thread
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    char line[256];
+    for (std::size_t i = 0; i < samples_.size(); ++i) {
+        const Sample& s = samples_[i];
+        std::snprintf(line, sizeof(line),
+                      "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}%s\n",
+                      s.name, s.thread, static_cast<double>(s.start - origin_) * 1e-3,
+                      static_cast<double>(s.duration) * 1e-3, i + 1 < samples_.size() ? "," : "");
+        out << line;
+    }
+    out << "]}\n";
+}
+
+bool TraceRecorder::write_chrome_trace(const std::string& path, std::string* error) const {
+    std::ofstream f(path);
+    if (!f) {
+        if (error) *error = "cannot open " + path;
+        return false;
+    }
+    write_chrome_trace(f);
+    if (!f) {
+        if (error) *error = "write failed";
+        return false;
+    }
+    return true;
+}
+
+} // namespace sim::profile
@@ -0,0 +1,172 @@
+// Scoped-timer instrumentation of the hot paths
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sim::profile {
+
+// Timers cost two clock reads and a ring-buffer write while enabled() and a
+// relaxed load otherwise; building with S2D_PROFILE=0 (-DENABLE_PROFILER=OFF)
+// removes them entirely.
+#ifndef S2D_PROFILE
+#define S2D_PROFILE 1
+#endif
+
+std::int64_t now_ns(); // steady clock
+
+#if S2D_PROFILE
+
+struct Event {
+    std::atomic<const char*> name{nullptr}; // string literal
+    std::atomic<std::int64_t> start{0};     // ns, now_ns()
+    std::atomic<std::int64_t> duration{0};
+};
+
+// Single-producer ring of the events of one thread. The owning thread is the
+// only writer, so recording is a release fence, a few relaxed stores and one
+// release store; a reader that falls more than kCapacity events behind loses
+// the oldest ones.
+class ThreadBuffer {
+public:
+    static constexpr std::uint64_t kCapacity = 1u << 14;
+
+    explicit ThreadBuffer(int id) : id_(id), events_(kCapacity) {}
+
+    void record(const char* name, std::int64_t start, std::int64_t duration) {
+        const std::uint64_t h = head_.load(std::memory_order_relaxed);
+        Event& e = events_[h & (kCapacity - 1)];
+        // A reader that sees any of the stores below also sees head >= h (pairs
+        // with the acquire fence in Collector::drain); free on x86
+        std::atomic_thread_fence(std::memory_order_release);
+        e.name.store(name, std::memory_order_relaxed);
+        e.start.store(start, std::memory_order_relaxed);
+        e.duration.store(duration, std::memory_order_relaxed);
+        head_.store(h + 1, std::memory_order_release);
+    }
+    int id() const { return id_; }
+    std::uint64_t head() const { return head_.load(std::memory_order_acquire); }
+    const Event& at(std::uint64_t index) const { return events_[index & (kCapacity - 1)]; }
+
+private:
+    int id_;
+    std::atomic<std::uint64_t> head_{0};
+    std::vector<Event> events_;
+};
+
+extern std::atomic<bool> g_enabled;
+
+inline bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+void set_enabled(bool on);
+ThreadBuffer& this_thread_buffer(); // registered on first use, lives until exit
+
+class Scope {
+public:
+    explicit Scope(const char* name) : name_(enabled() ? name : nullptr), start_(name_ ? now_ns() : 0) {}
+    ~Scope() {
+        if (name_) this_thread_buffer().record(name_, start_, now_ns() - start_);
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name_;
+    std::int64_t start_;
+};
+
+#define S2D_PROFILE_CONCAT_(a, b) a##b
+#define S2D_PROFILE_CONCAT(a, b) S2D_PROFILE_CONCAT_(a, b)
+#define S2D_PROFILE_SCOPE(name) ::sim::profile::Scope S2D_PROFILE_CONCAT(s2dProfileScope_, __LINE__)(name)
+
+#else
+
+inline bool enabled() { return false; }
+inline void set_enabled(bool) {}
+#define S2D_PROFILE_SCOPE(name) ((void)0)
+
+#endif
+
+bool available(); // false when compiled out
+
+// A copied event, as read from a thread's ring
+struct Sample {
+    const char* name;
+    int thread;
+    std::int64_t start;
+    std::int64_t duration;
+};
+
+// Reads the rings of every thread; one Collector per reader thread. Each
+// drain() returns the events recorded since the previous one.
+class Collector {
+public:
+    void drain(std::vector<Sample>& out);
+    std::uint64_t dropped() const { return dropped_; } // overwritten before they were read
+
+private:
+    std::vector<std::uint64_t> cursors_; // per registered thread
+    std::uint64_t dropped_{0};
+};
+
+// Rolling per-stage totals for a live display, refreshed every `window` seconds
+class StageStats {
+public:
+    struct Stage {
+        std::string name;
+        double msPerSecond{0.0}; // wall time spent in the stage per second (summed over threads)
+        double msPerCall{0.0};
+        double callsPerSecond{0.0};
+        double maxMs{0.0};
+    };
+
+    explicit StageStats(double window = 0.5) : window_(window) {}
+    void update(); // drain and, once per window, publish
+    const std::vector<Stage>& stages() const { return published_; }
+    std::uint64_t dropped() const { return collector_.dropped(); }
+
+private:
+    struct Accum {
+        const char* name;
+        std::int64_t total{0};
+        std::int64_t max{0};
+        std::uint64_t calls{0};
+    };
+    double window_;
+    Collector collector_;
+    std::vector<Sample> samples_;
+    std::vector<Accum> accum_; // in order of first appearance
+    std::int64_t windowStart_{0};
+    std::vector<Stage> published_;
+};
+
+// Collects every event on a background thread until stop(), then writes them
+// in the Chrome trace event format (chrome://tracing, Perfetto).
+class TraceRecorder {
+public:
+    TraceRecorder() = default;
+    ~TraceRecorder();
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    void start(); // enables the timers
+    void stop();  // disables them and collects the rest
+    bool write_chrome_trace(const std::string& path, std::string* error = nullptr) const;
+    void write_chrome_trace(std::ostream& out) const;
+    std::size_t events() const { return samples_.size(); }
+    std::uint64_t dropped() const { return collector_.dropped(); }
+
+private:
+    Collector collector_;
+    std::vector<Sample> samples_;
+    std::int64_t origin_{0};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
+
+} // namespace sim::profile
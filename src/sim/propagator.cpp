@@ -0,0 +1,134 @@
+#include "propagator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.hpp"
+
+namespace sim {
+
+double pairwise_sum(const double* v, size_t n) {
+    if (n <= 8) {
+        double s = 0.0;
+        for (size_t k = 0; k < n; ++k) s += v[k];
+        return s;
+    }
+    const size_t h = n / 2;
+    return pairwise_sum(v, h) + pairwise_sum(v + h, n - h);
+}
+
+void MassReduction::prepare(int Ny) {
+    const size_t rows = static_cast<size_t>(std::max(0, Ny));
+    rowLeft.assign(rows, 0.0);
+    rowRight.assign(rows, 0.0);
+    rowInterior.assign(rows, 0.0);
+    rowFirst.assign(rows, 0);
+    rowLast.assign(rows, -1);
+}
+
+void MassReduction::finish() {
+    left = pairwise_sum(rowLeft.data(), rowLeft.size());
+    right = pairwise_sum(rowRight.data(), rowRight.size());
+    interior = pairwise_sum(rowInterior.data(), rowInterior.size());
+    total = left + right;
+    active = GridRect{};
+    if (activeThreshold <= 0.0) return;
+    bool any = false;
+    for (size_t j = 0; j < rowFirst.size(); ++j) {
+        if (rowFirst[j] > rowLast[j]) continue;
+        const int row = static_cast<int>(j);
+        if (!any) {
+            active = GridRect{rowFirst[j], rowLast[j] + 1, row, row + 1};
+            any = true;
+            continue;
+        }
+        active.i0 = std::min(active.i0, rowFirst[j]);
+        active.i1 = std::max(active.i1, rowLast[j] + 1);
+        active.j1 = row + 1;
+    }
+}
+
+template <typename Real>
+void MassReduction::reduce(const ComplexField<Real>& psi, int Nx, int Ny, ThreadPool* pool) {
+    prepare(Ny);
+    parallel_for(pool, 0, Ny, [&](int jb, int je, int) {
+        for (int j = jb; j < je; ++j) {
+            const size_t row = static_cast<size_t>(j) * Nx;
+            accumulate_row(j, psi.re.data() + row, psi.im.data() + row, Nx);
+        }
+    });
+    finish();
+}
+
+template void MassReduction::reduce<double>(const ComplexField<double>&, int, int, ThreadPool*);
+template void MassReduction::reduce<float>(const ComplexField<float>&, int, int, ThreadPool*);
+
+template <typename Real>
+void PotentialKicks<Real>::ensure(const Field& V, int nx, int ny, std::uint64_t vGeneration, double step,
+                                  ThreadPool* pool) {
+    if (valid && Nx == nx && Ny == ny && generation == vGeneration && dt == step) {
+        return;
+    }
+    // exp(-i V t) = exp(Im V t) * (cos(Re V t) - i sin(Re V t)), for t = dt/2 and dt
+    const size_t cells = static_cast<size_t>(nx) * ny;
+    half.assign(cells);
+    full.assign(cells);
+    const double half_dt = 0.5 * step;
+    const double* vr = V.re.data();
+    const double* vi = V.im.data();
+    parallel_for(pool, 0, ny, [&](int j0, int j1, int) {
+        const size_t k0 = static_cast<size_t>(j0) * nx;
+        const size_t k1 = static_cast<size_t>(j1) * nx;
+        for (size_t k = k0; k < k1; ++k) {
+            const double magH = std::exp(vi[k] * half_dt);
+            const double phH = -vr[k] * half_dt;
+            half.re[k] = static_cast<Real>(magH * std::cos(phH));
+            half.im[k] = static_cast<Real>(magH * std::sin(phH));
+            const double magF = std::exp(vi[k] * step);
+            const double phF = -vr[k] * step;
+            full.re[k] = static_cast<Real>(magF * std::cos(phF));
+            full.im[k] = static_cast<Real>(magF * std::sin(phF));
+        }
+    });
+    Nx = nx;
+    Ny = ny;
+    generation = vGeneration;
+    dt = step;
+    valid = true;
+}
+
+template <typename Real>
+void PotentialKicks<Real>::apply(ComplexField<Real>& psi, const ComplexField<Real>& factor, ThreadPool* pool,
+                                 MassReduction* reduce, const GridRect* rect) const {
+    S2D_PROFILE_SCOPE("potential kick");
+    const int nx = Nx;
+    const GridRect r = rect ? *rect : GridRect{0, Nx, 0, Ny};
+    Real* pr = psi.re.data();
+    Real* pi = psi.im.data();
+    const Real* cr = factor.re.data();
+    const Real* ci = factor.im.data();
+    if (reduce) reduce->prepare(Ny); // rows outside r keep their zero sums
+    parallel_for(pool, r.j0, r.j1, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            const size_t row = static_cast<size_t>(j) * nx;
+            const size_t k0 = row + static_cast<size_t>(r.i0);
+            const size_t k1 = row + static_cast<size_t>(r.i1);
+            for (size_t k = k0; k < k1; ++k) {
+                const Real c = cr[k];
+                const Real s = ci[k];
+                const Real zr = pr[k];
+                const Real zi = pi[k];
+                pr[k] = zr * c - zi * s;
+                pi[k] = zr * s + zi * c;
+            }
+            // The row was just written and is still in L1
+            if (reduce) reduce->accumulate_span(j, pr + row, pi + row, r.i0, r.i1);
+        }
+    });
+    if (reduce) reduce->finish();
+}
+
+template struct PotentialKicks<double>;
+template struct PotentialKicks<float>;
+
+} // namespace sim
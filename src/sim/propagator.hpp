@@ -0,0 +1,151 @@
+// Time-stepping engines and the potential kick they share
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "field.hpp"
+#include "potential.hpp"
+#include "thread_pool.hpp"
+
+namespace sim {
+
+// sum |z|^2 over n split-layout values, accumulated in double. Eight fixed
+// partial sums keep the reduction order deterministic while letting the
+// compiler use vector lanes.
+template <typename Real>
+inline double sum_norm(const Real* re, const Real* im, int n) {
+    double acc[8] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (int l = 0; l < 8; ++l) {
+            const double r = re[i + l];
+            const double m = im[i + l];
+            acc[l] += r * r + m * m;
+        }
+    }
+    double tail = 0.0;
+    for (; i < n; ++i) {
+        const double r = re[i];
+        const double m = im[i];
+        tail += r * r + m * m;
+    }
+    return ((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7])) + tail;
+}
+
+// Pairwise sum of v[0..n): error grows with log(n) instead of n, and the
+// association is fixed by n alone.
+double pairwise_sum(const double* v, std::size_t n);
+
+// Unscaled |psi|^2 sums behind Simulation's diagnostics: left half (columns
+// [0, mid)), right half and an interior window [i0, i1) x [j0, j1).
+// Rows are reduced independently (in parallel, or by the last potential kick
+// of a step while the row is still in cache) and then combined pairwise in
+// row order, so the sums do not depend on the thread count.
+// With activeThreshold > 0 the same pass also tracks the bounding box of the
+// cells whose |psi|^2 exceeds it (see Simulation's active window).
+struct MassReduction {
+    int mid{0};
+    int i0{0}, i1{0};
+    int j0{0}, j1{0};
+    double activeThreshold{0.0};
+    std::vector<double> rowLeft;
+    std::vector<double> rowRight;
+    std::vector<double> rowInterior;
+    std::vector<int> rowFirst; // first and last tracked cell of each row (first > last: none)
+    std::vector<int> rowLast;
+
+    // Set by finish()
+    double total{0.0};
+    double left{0.0};
+    double right{0.0};
+    double interior{0.0};
+    GridRect active; // tracked cells; empty when none or not tracking
+
+    void prepare(int Ny);
+    template <typename Real>
+    void accumulate_row(int j, const Real* re, const Real* im, int Nx) {
+        accumulate_span(j, re, im, 0, Nx);
+    }
+    // Row j where only columns [c0, c1) can be non-zero; re and im still point at column 0.
+    template <typename Real>
+    void accumulate_span(int j, const Real* re, const Real* im, int c0, int c1) {
+        auto sum = [&](int a, int b) { return b > a ? sum_norm(re + a, im + a, b - a) : 0.0; };
+        const size_t r = static_cast<size_t>(j);
+        rowLeft[r] = sum(c0, std::min(c1, mid));
+        rowRight[r] = sum(std::max(c0, mid), c1);
+        rowInterior[r] = (j >= j0 && j < j1) ? sum(std::max(c0, i0), std::min(c1, i1)) : 0.0;
+        if (activeThreshold > 0.0) {
+            // Scans in from both ends, so a row costs its empty margins
+            auto above = [&](int i) {
+                const double zr = re[i];
+                const double zi = im[i];
+                return zr * zr + zi * zi > activeThreshold;
+            };
+            int first = c0;
+            while (first < c1 && !above(first)) ++first;
+            int last = c1 - 1;
+            while (last > first && !above(last)) --last;
+            rowFirst[r] = first;
+            rowLast[r] = first < c1 ? last : first - 1;
+        }
+    }
+    void finish();
+
+    // Standalone pass over psi: prepare(), accumulate every row, finish().
+    template <typename Real>
+    void reduce(const ComplexField<Real>& psi, int Nx, int Ny, ThreadPool* pool);
+};
+
+// A time-stepping engine for i dpsi/dt = -(1/2) Laplacian(psi) + V psi on an
+// Nx x Ny grid with Dirichlet walls. V may be complex (CAP sponge).
+template <typename Real>
+struct BasicPropagator {
+    virtual ~BasicPropagator() = default;
+
+    virtual const char* name() const = 0;
+
+    // `steps` consecutive time steps of size dt, in place. vGeneration
+    // identifies the contents of V (see Simulation::potentialGeneration), so
+    // engines can cache anything derived from it. When reduce is given
+    // (prepared for Ny rows), it receives the mass sums of the final psi,
+    // accumulated during the last pass over the field.
+    virtual void step_n(ComplexField<Real>& psi,
+                        int Nx, int Ny, double dx, double dy, double dt,
+                        const Field& V, std::uint64_t vGeneration,
+                        int steps,
+                        ThreadPool* pool = nullptr,
+                        MassReduction* reduce = nullptr) = 0;
+};
+
+using Propagator = BasicPropagator<double>;
+
+// Potential propagators exp(-i V dt/2) ("half") and exp(-i V dt) ("full") per
+// cell, computed in double and rounded to Real. Valid for (Nx, Ny, generation, dt);
+// ensure() only reruns exp/sincos when one of those changes.
+template <typename Real>
+struct PotentialKicks {
+    bool valid{false};
+    int Nx{0};
+    int Ny{0};
+    std::uint64_t generation{0};
+    double dt{0.0};
+    ComplexField<Real> half;
+    ComplexField<Real> full;
+
+    void ensure(const Field& V, int nx, int ny, std::uint64_t vGeneration, double step, ThreadPool* pool);
+    void invalidate() { valid = false; }
+
+    // psi *= factor (half or full), cell by cell. With reduce, each row's
+    // mass sums are accumulated right after the row is kicked and finish() is called.
+    // With rect, only its cells are kicked and psi is taken as zero elsewhere.
+    void apply(ComplexField<Real>& psi, const ComplexField<Real>& factor, ThreadPool* pool,
+               MassReduction* reduce = nullptr, const GridRect* rect = nullptr) const;
+};
+
+extern template struct PotentialKicks<double>;
+extern template struct PotentialKicks<float>;
+
+} // namespace sim
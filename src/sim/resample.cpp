@@ -0,0 +1,174 @@
+#include "resample.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "propagator.hpp"
+
+namespace sim {
+
+namespace {
+
+// Source taps of every destination index along one axis, CSR style
+struct Filter {
+    std::vector<int> start; // taps of d are [start[d], start[d + 1])
+    std::vector<int> index;
+    std::vector<double> weight;
+};
+
+Filter make_filter(int nSrc, int nDst) {
+    Filter f;
+    f.start.reserve(static_cast<std::size_t>(nDst) + 1);
+    const double scale = static_cast<double>(nSrc) / nDst;
+    const double support = std::max(1.0, scale); // tent half-width in source cells
+    for (int d = 0; d < nDst; ++d) {
+        f.start.push_back(static_cast<int>(f.index.size()));
+        const double x = (d + 0.5) * scale - 0.5; // destination center in source index units
+        const int lo = std::max(0, static_cast<int>(std::ceil(x - support)));
+        const int hi = std::min(nSrc - 1, static_cast<int>(std::floor(x + support)));
+        const std::size_t first = f.index.size();
+        double sum = 0.0;
+        for (int s = lo; s <= hi; ++s) {
+            const double w = 1.0 - std::fabs(s - x) / support;
+            if (w <= 0.0) continue;
+            f.index.push_back(s);
+            f.weight.push_back(w);
+            sum += w;
+        }
+        // Taps past the walls are dropped (psi vanishes there); the rest keep unit sum
+        for (std::size_t t = first; t < f.index.size(); ++t) f.weight[t] /= sum;
+    }
+    f.start.push_back(static_cast<int>(f.index.size()));
+    return f;
+}
+
+double norm_sum(const Field& psi, int nx, int ny, ThreadPool* pool) {
+    std::vector<double> rows(static_cast<std::size_t>(ny), 0.0);
+    parallel_for(pool, 0, ny, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            const std::size_t row = static_cast<std::size_t>(j) * nx;
+            rows[j] = sum_norm(psi.re.data() + row, psi.im.data() + row, nx);
+        }
+    });
+    double sum = 0.0;
+    for (double r : rows) sum += r;
+    return sum;
+}
+
+} // namespace
+
+GridGeometry grid_geometry(int nx, int ny) {
+    GridGeometry g;
+    g.Nx = std::max(8, nx);
+    g.Ny = std::max(8, ny);
+    const double cell = 1.0 / static_cast<double>(std::min(g.Nx, g.Ny));
+    g.Lx = g.Nx * cell;
+    g.Ly = g.Ny * cell;
+    g.dx = cell;
+    g.dy = cell;
+    return g;
+}
+
+bool resample_field(const Field& src, int srcNx, int srcNy, Field& dst, int dstNx, int dstNy, ThreadPool* pool,
+                    const std::atomic<bool>* cancel) {
+    const Filter fx = make_filter(srcNx, dstNx);
+    const Filter fy = make_filter(srcNy, dstNy);
+    auto cancelled = [cancel] { return cancel && cancel->load(std::memory_order_relaxed); };
+
+    // Along x into srcNy rows of dstNx, then along y
+    Field rows;
+    rows.assign(static_cast<std::size_t>(srcNy) * dstNx);
+    parallel_for(pool, 0, srcNy, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1 && !cancelled(); ++j) {
+            const double* re = src.re.data() + static_cast<std::size_t>(j) * srcNx;
+            const double* im = src.im.data() + static_cast<std::size_t>(j) * srcNx;
+            double* outRe = rows.re.data() + static_cast<std::size_t>(j) * dstNx;
+            double* outIm = rows.im.data() + static_cast<std::size_t>(j) * dstNx;
+            for (int d = 0; d < dstNx; ++d) {
+                double sr = 0.0, si = 0.0;
+                for (int t = fx.start[d]; t < fx.start[d + 1]; ++t) {
+                    sr += fx.weight[t] * re[fx.index[t]];
+                    si += fx.weight[t] * im[fx.index[t]];
+                }
+                outRe[d] = sr;
+                outIm[d] = si;
+            }
+        }
+    });
+    if (cancelled()) return false;
+
+    dst.assign(static_cast<std::size_t>(dstNx) * dstNy);
+    parallel_for(pool, 0, dstNy, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1 && !cancelled(); ++j) {
+            double* outRe = dst.re.data() + static_cast<std::size_t>(j) * dstNx;
+            double* outIm = dst.im.data() + static_cast<std::size_t>(j) * dstNx;
+            for (int t = fy.start[j]; t < fy.start[j + 1]; ++t) {
+                const double w = fy.weight[t];
+                const double* re = rows.re.data() + static_cast<std::size_t>(fy.index[t]) * dstNx;
+                const double* im = rows.im.data() + static_cast<std::size_t>(fy.index[t]) * dstNx;
+                for (int i = 0; i < dstNx; ++i) {
+                    outRe[i] += w * re[i];
+                    outIm[i] += w * im[i];
+                }
+            }
+        }
+    });
+    return !cancelled();
+}
+
+void run_resample(GridResample& job, ThreadPool* pool, const std::atomic<bool>* cancel) {
+    const GridGeometry& g = job.grid;
+    Field out;
+    if (!resample_field(job.psi, job.fromNx, job.fromNy, out, g.Nx, g.Ny, pool, cancel)) {
+        job.cancelled = true;
+        return;
+    }
+    // Keep the norm: interpolation smooths |psi|^2 a little, more so when shrinking
+    const double before = norm_sum(job.psi, job.fromNx, job.fromNy, pool) * job.fromCell;
+    const double after = norm_sum(out, g.Nx, g.Ny, pool) * g.dx * g.dy;
+    if (before > 0.0 && after > 0.0) out.scale(std::sqrt(before / after));
+    job.psi = std::move(out);
+
+    job.pfield.Nx = g.Nx;
+    job.pfield.Ny = g.Ny;
+    job.pfield.Lx = g.Lx;
+    job.pfield.Ly = g.Ly;
+    job.layers.build(job.pfield, job.V);
+}
+
+GridResizeTask::~GridResizeTask() {
+    cancel();
+    join();
+}
+
+void GridResizeTask::start(GridResample job, int threads) {
+    cancel();
+    join();
+    cancel_.store(false);
+    job_ = std::move(job);
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread([this, threads] {
+        ThreadPool pool(threads);
+        run_resample(job_, &pool, &cancel_);
+        running_.store(false, std::memory_order_release);
+    });
+}
+
+void GridResizeTask::cancel() {
+    cancel_.store(true, std::memory_order_relaxed);
+}
+
+bool GridResizeTask::take_result(GridResample& out) {
+    if (!finished()) return false;
+    join();
+    out = std::move(job_);
+    job_ = GridResample{};
+    return true;
+}
+
+void GridResizeTask::join() {
+    if (thread_.joinable()) thread_.join();
+}
+
+} // namespace sim
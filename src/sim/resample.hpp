@@ -0,0 +1,75 @@
+// Moving a state onto another grid size
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "field.hpp"
+#include "potential.hpp"
+#include "thread_pool.hpp"
+
+namespace sim {
+
+// Cells are square with the shorter side of the domain at length 1.
+struct GridGeometry {
+    int Nx{0}, Ny{0};
+    double Lx{1.0}, Ly{1.0};
+    double dx{1.0}, dy{1.0};
+};
+GridGeometry grid_geometry(int nx, int ny); // nx, ny clamped to >= 8
+
+// dst = src resampled from srcNx x srcNy to dstNx x dstNy cells over the same
+// normalized domain. Separable linear filter on cell centers, widened to the
+// cell ratio when shrinking so every source cell contributes (no aliasing).
+// Returns false (dst incomplete) if cancel was raised.
+bool resample_field(const Field& src, int srcNx, int srcNy, Field& dst, int dstNx, int dstNy, ThreadPool* pool,
+                    const std::atomic<bool>* cancel = nullptr);
+
+// A grid change carried out away from the Simulation: prepared from it
+// (Simulation::prepare_resample), run anywhere, applied back (apply_resample).
+struct GridResample {
+    // Source state
+    int fromNx{0}, fromNy{0};
+    double fromCell{1.0};              // dx dy of the source grid
+    std::uint64_t psiGeneration{0};    // front psi the job was taken from
+    std::uint64_t stepCount{0};
+    double time{0.0};
+    PotentialField pfield;             // objects at the time; pfield's grid is set to the target
+
+    // Result: psi and V on the target grid; psi keeps the source norm
+    GridGeometry grid;
+    Field psi;                         // source psi until run
+    Field V;
+    PotentialLayers layers;
+    bool cancelled{false};
+};
+
+void run_resample(GridResample& job, ThreadPool* pool, const std::atomic<bool>* cancel = nullptr);
+
+// Runs run_resample on a background thread with its own pool.
+class GridResizeTask {
+public:
+    GridResizeTask() = default;
+    ~GridResizeTask();
+    GridResizeTask(const GridResizeTask&) = delete;
+    GridResizeTask& operator=(const GridResizeTask&) = delete;
+
+    // Cancels and joins a job still in flight first.
+    void start(GridResample job, int threads);
+    void cancel();
+    bool busy() const { return running_.load(std::memory_order_acquire); }
+    bool finished() const { return thread_.joinable() && !busy(); }
+    // Joins a finished job and hands it over; false while busy or idle.
+    bool take_result(GridResample& out);
+
+private:
+    void join();
+
+    GridResample job_;
+    std::atomic<bool> cancel_{false};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+} // namespace sim
@@ -0,0 +1,314 @@
+#include "sim_thread.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace sim {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Fast mode sizes step blocks to about this long, so commands are picked up promptly
+constexpr double kFastBlockSeconds = 1.0 / 240.0;
+constexpr int kMaxFastBlock = 1024;
+// Fast mode publishes at most this often (the UI cannot show more)
+constexpr auto kPublishInterval = std::chrono::milliseconds(8);
+constexpr double kRateWindowSeconds = 0.5;
+
+bool same_stability(const StabilityConfig& a, const StabilityConfig& b) {
+    return a.rel_mass_drift_tol == b.rel_mass_drift_tol &&
+           a.rel_cap_mass_growth_tol == b.rel_cap_mass_growth_tol &&
+           a.rel_interior_mass_drift_tol == b.rel_interior_mass_drift_tol &&
+           a.interior_mass_drift_vs_total_tol == b.interior_mass_drift_vs_total_tol &&
+           a.min_initial_interior_mass_fraction == b.min_initial_interior_mass_fraction &&
+           a.min_interior_area_fraction == b.min_interior_area_fraction &&
+           a.warmup_steps == b.warmup_steps &&
+           a.check_every_n_steps == b.check_every_n_steps &&
+           a.interior_drift_hard_fail == b.interior_drift_hard_fail &&
+           a.auto_pause_on_instability == b.auto_pause_on_instability;
+}
+
+bool same_active_region(const ActiveRegionConfig& a, const ActiveRegionConfig& b) {
+    return a.enabled == b.enabled && a.threshold == b.threshold && a.margin == b.margin;
+}
+
+} // namespace
+
+SimulationThread::SimulationThread() : thread_([this] { worker_loop(); }) {}
+
+SimulationThread::~SimulationThread() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+void SimulationThread::sync(const Simulation& front) {
+    const bool grid = !synced_ || front.Nx != syncedNx_ || front.Ny != syncedNy_;
+    const bool potential = grid || front.potentialGeneration != syncedPotential_;
+    const bool psi = grid || front.psiGeneration != syncedPsi_;
+    const bool settings = grid || front.dt != syncedDt_ || front.engine != syncedEngine_ ||
+                          front.precision != syncedPrecision_ || front.threads() != syncedThreads_ ||
+                          front.magneticField != syncedMagneticField_ ||
+                          front.spatialOrder != syncedSpatialOrder_ ||
+                          !same_active_region(front.activeRegion, syncedActiveRegion_) ||
+                          !same_stability(front.stability, syncedStability_);
+    if (!potential && !psi && !settings) return;
+
+    synced_ = true;
+    syncedNx_ = front.Nx;
+    syncedNy_ = front.Ny;
+    syncedPotential_ = front.potentialGeneration;
+    syncedPsi_ = front.psiGeneration;
+    syncedDt_ = front.dt;
+    syncedEngine_ = front.engine;
+    syncedPrecision_ = front.precision;
+    syncedMagneticField_ = front.magneticField;
+    syncedSpatialOrder_ = front.spatialOrder;
+    syncedActiveRegion_ = front.activeRegion;
+    syncedStability_ = front.stability;
+    syncedThreads_ = front.threads();
+
+    // Only the parts that changed are copied into the command
+    struct Edit {
+        bool grid, potential, state;
+        int Nx, Ny;
+        double Lx, Ly, dx, dy, dt;
+        Engine engine;
+        Precision precision;
+        double magneticField;
+        int spatialOrder;
+        ActiveRegionConfig activeRegion;
+        StabilityConfig stability;
+        int threads;
+        PotentialField pfield;
+        Field V;
+        std::uint64_t potentialGeneration;
+        Field psi;
+        std::vector<Packet> packets;
+        std::uint64_t stepCount, psiGeneration;
+        double time;
+        StabilityDiagnostics diagnostics;
+        int stepsSinceCheck;
+    };
+    auto edit = std::make_shared<Edit>();
+    edit->grid = grid;
+    edit->potential = potential;
+    edit->state = psi;
+    edit->Nx = front.Nx;
+    edit->Ny = front.Ny;
+    edit->Lx = front.Lx;
+    edit->Ly = front.Ly;
+    edit->dx = front.dx;
+    edit->dy = front.dy;
+    edit->dt = front.dt;
+    edit->engine = front.engine;
+    edit->precision = front.precision;
+    edit->magneticField = front.magneticField;
+    edit->spatialOrder = front.spatialOrder;
+    edit->activeRegion = front.activeRegion;
+    edit->stability = front.stability;
+    edit->threads = front.threads();
+    if (potential) {
+        edit->pfield = front.pfield;
+        edit->V = front.V;
+        edit->potentialGeneration = front.potentialGeneration;
+    }
+    if (psi) {
+        edit->psi = front.psi;
+        edit->packets = front.packets;
+        edit->stepCount = front.stepCount;
+        edit->time = front.time;
+        edit->psiGeneration = front.psiGeneration;
+        edit->diagnostics = front.diagnostics;
+        edit->stepsSinceCheck = front.stepsSinceCheck;
+    }
+    post([edit](Simulation& s) {
+        if (edit->grid) {
+            s.Nx = edit->Nx;
+            s.Ny = edit->Ny;
+            s.Lx = edit->Lx;
+            s.Ly = edit->Ly;
+            s.dx = edit->dx;
+            s.dy = edit->dy;
+        }
+        s.dt = edit->dt;
+        s.engine = edit->engine;
+        s.precision = edit->precision;
+        s.magneticField = edit->magneticField;
+        if (s.spatialOrder != edit->spatialOrder || !same_active_region(s.activeRegion, edit->activeRegion)) {
+            s.activeWindowValid = false; // its margin was sized for the old settings
+        }
+        s.spatialOrder = edit->spatialOrder;
+        s.activeRegion = edit->activeRegion;
+        s.stability = edit->stability;
+        s.set_threads(edit->threads);
+        if (edit->potential) {
+            // V arrives finished, so the stepping copy never rebuilds it
+            s.pfield = std::move(edit->pfield);
+            s.V = std::move(edit->V);
+            s.potentialGeneration = edit->potentialGeneration;
+        }
+        if (edit->state) {
+            s.psi = std::move(edit->psi);
+            s.packets = std::move(edit->packets);
+            s.stepCount = edit->stepCount;
+            s.time = edit->time;
+            s.psiGeneration = edit->psiGeneration;
+            s.diagnostics = std::move(edit->diagnostics);
+            s.stepsSinceCheck = edit->stepsSinceCheck;
+        }
+    });
+}
+
+bool SimulationThread::pull(Simulation& front) {
+    if (!snapshots_.update()) return false;
+    const SimulationSnapshot& snap = snapshots_.front();
+    if (snap.autoPauses != seenAutoPauses_) {
+        seenAutoPauses_ = snap.autoPauses;
+        front.running = false;
+    }
+    if (snap.psiGeneration != front.psiGeneration || snap.Nx != front.Nx || snap.Ny != front.Ny) return false;
+    front.psi = snap.psi;
+    front.stepCount = snap.stepCount;
+    front.time = snap.time;
+    front.diagnostics = snap.diagnostics;
+    front.stepsSinceCheck = snap.stepsSinceCheck;
+    front.multigrid.lastIterations = snap.multigridIterations;
+    front.multigrid.lastResidual = snap.multigridResidual;
+    return true;
+}
+
+void SimulationThread::post(Command cmd) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        commands_.push_back(std::move(cmd));
+    }
+    wake_.notify_one();
+}
+
+void SimulationThread::set_running(bool running) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ == running) return;
+        running_ = running;
+        if (!running) budget_ = 0;
+    }
+    wake_.notify_one();
+}
+
+void SimulationThread::set_fast(bool fast) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fast_ == fast) return;
+        fast_ = fast;
+    }
+    wake_.notify_one();
+}
+
+void SimulationThread::request_steps(int n) {
+    if (n <= 0) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // At most two frames' worth queued: when stepping is slower than the
+        // display, the UI keeps its frame rate and the request just waits.
+        budget_ = std::min(budget_ + n, 2 * n);
+    }
+    wake_.notify_one();
+}
+
+void SimulationThread::publish() {
+    SimulationSnapshot& snap = snapshots_.back();
+    snap.Nx = sim_.Nx;
+    snap.Ny = sim_.Ny;
+    snap.stepCount = sim_.stepCount;
+    snap.time = sim_.time;
+    snap.psiGeneration = sim_.psiGeneration;
+    sim_.sync_psi(); // after float steps
+    snap.psi = sim_.psi; // reuses the buffer's capacity
+    snap.diagnostics = sim_.diagnostics;
+    snap.stepsSinceCheck = sim_.stepsSinceCheck;
+    snap.autoPauses = autoPauses_;
+    snap.multigridIterations = sim_.multigrid.lastIterations;
+    snap.multigridResidual = sim_.multigrid.lastResidual;
+    snapshots_.publish();
+}
+
+void SimulationThread::worker_loop() {
+    std::vector<Command> commands;
+    int fastBlock = 1;
+    bool unpublished = false;
+    Clock::time_point lastPublish = Clock::now();
+    Clock::time_point windowStart = lastPublish;
+    std::uint64_t windowSteps = 0;
+
+    while (true) {
+        int n = 0;
+        bool fast = false;
+        bool running = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto ready = [this] { return stop_ || !commands_.empty() || (running_ && (fast_ || budget_ > 0)); };
+            if (unpublished) {
+                wake_.wait_for(lock, kPublishInterval, ready);
+            } else {
+                if (!ready()) stepsPerSecond_.store(0.0, std::memory_order_relaxed);
+                wake_.wait(lock, ready);
+            }
+            if (stop_) return;
+            commands.swap(commands_);
+            fast = fast_;
+            running = running_;
+            if (running) {
+                n = fast ? fastBlock : budget_;
+                budget_ = 0;
+            }
+        }
+
+        for (Command& cmd : commands) cmd(sim_);
+        const bool edited = !commands.empty();
+        commands.clear();
+
+        if (n > 0) {
+            sim_.running = true;
+            const Clock::time_point t0 = Clock::now();
+            sim_.stepN(n);
+            const Clock::time_point t1 = Clock::now();
+            if (!sim_.running) {
+                // Auto-paused on instability
+                ++autoPauses_;
+                std::lock_guard<std::mutex> lock(mutex_);
+                running_ = false;
+                budget_ = 0;
+            }
+            if (fast) {
+                const double perStep = std::chrono::duration<double>(t1 - t0).count() / n;
+                fastBlock = perStep > 0.0 ? std::clamp(static_cast<int>(kFastBlockSeconds / perStep), 1, kMaxFastBlock)
+                                          : kMaxFastBlock;
+            }
+            windowSteps += static_cast<std::uint64_t>(n);
+            const double window = std::chrono::duration<double>(t1 - windowStart).count();
+            if (window >= kRateWindowSeconds) {
+                stepsPerSecond_.store(static_cast<double>(windowSteps) / window, std::memory_order_relaxed);
+                windowStart = t1;
+                windowSteps = 0;
+            }
+        } else if (!running) {
+            windowStart = Clock::now();
+            windowSteps = 0;
+        }
+
+        if (n > 0 || edited) unpublished = true;
+        const Clock::time_point now = Clock::now();
+        if (unpublished && (!fast || !sim_.running || now - lastPublish >= kPublishInterval || n == 0)) {
+            publish();
+            lastPublish = now;
+            unpublished = false;
+        }
+    }
+}
+
+} // namespace sim
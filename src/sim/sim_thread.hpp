@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "simulation.hpp"
+#include "triple_buffer.hpp"
+
+namespace sim {
+
+// State published by the simulation thread after stepping.
+struct SimulationSnapshot {
+    int Nx{0}, Ny{0};
+    std::uint64_t stepCount{0};
+    double time{0.0};
+    std::uint64_t psiGeneration{0}; // front psi edit this state was stepped from
+    Field psi;
+    StabilityDiagnostics diagnostics;
+    int stepsSinceCheck{0};
+    std::uint64_t autoPauses{0};    // instability auto-pauses so far
+    int multigridIterations{0};     // CrankNicolsonMultigrid statistics
+    double multigridResidual{0.0};
+};
+
+// Steps a private copy of a Simulation on a dedicated thread.
+// The UI keeps editing its own ("front") Simulation directly; sync() turns what
+// changed since the last call (grid, potential, psi, settings) into a command for
+// the stepping copy, and pull() copies the latest stepped psi and diagnostics
+// back. Edits never race with stepping, and slow steps never stall the UI.
+//
+// Snapshots travel through a lock-free triple buffer; commands go through a
+// small mutex-guarded queue and run between step blocks, in order.
+class SimulationThread {
+public:
+    using Command = std::function<void(Simulation&)>;
+
+    SimulationThread();
+    ~SimulationThread();
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // UI thread only
+    void sync(const Simulation& front);
+    // Adopts the newest snapshot into front; false if there is none, or it was
+    // stepped from psi that front has since replaced. Clears front.running after
+    // an instability auto-pause.
+    bool pull(Simulation& front);
+    void post(Command cmd);        // runs on the stepping copy before the next step
+    void set_running(bool running);
+    void set_fast(bool fast);      // step as fast as possible instead of per request_steps()
+    void request_steps(int n);     // paced mode: n more steps while running
+    double steps_per_second() const { return stepsPerSecond_.load(std::memory_order_relaxed); }
+
+private:
+    void worker_loop();
+    void publish();
+
+    Simulation sim_; // stepping copy, touched by the worker only
+    TripleBuffer<SimulationSnapshot> snapshots_;
+    std::uint64_t autoPauses_{0};
+
+    // What the stepping copy last received (UI thread)
+    bool synced_{false};
+    int syncedNx_{0}, syncedNy_{0};
+    std::uint64_t syncedPotential_{0};
+    std::uint64_t syncedPsi_{0};
+    double syncedDt_{0.0};
+    Engine syncedEngine_{Engine::CrankNicolsonADI};
+    Precision syncedPrecision_{Precision::Double};
+    double syncedMagneticField_{0.0};
+    int syncedSpatialOrder_{2};
+    ActiveRegionConfig syncedActiveRegion_;
+    StabilityConfig syncedStability_;
+    int syncedThreads_{0};
+    std::uint64_t seenAutoPauses_{0};
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<Command> commands_;
+    int budget_{0};
+    bool running_{false};
+    bool fast_{false};
+    bool stop_{false};
+    std::atomic<double> stepsPerSecond_{0.0};
+    std::thread thread_;
+};
+
+} // namespace sim
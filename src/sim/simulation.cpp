@@ -5,14 +5,12 @@
 #include <limits>
 #include <numeric>
 
+#include "profiler.hpp"
+
 namespace sim {
 
 namespace {
 
-static inline bool is_finite_complex(const std::complex<double>& z) {
-    return std::isfinite(std::real(z)) && std::isfinite(std::imag(z));
-}
-
 struct InteriorWindow {
     int i0{0};
     int i1{0};
@@ -50,46 +48,159 @@ static InteriorWindow compute_interior_window(int Nx, int Ny, double cap_ratio)
     return w;
 }
 
+// Cells over which one CN half-step's line solve, tridiag(off, diag, off) with
+// a = i dt / (4 h^2), off = b - a and diag = (1 - 2b) + 2a (b = 1/12 for the
+// compact stencil, else 0), carries an amplitude down by eps: its Green's
+// function decays as |rho|^d, rho the root of off rho^2 + diag rho + off = 0
+// inside the unit circle.
+static int cn_coupling_cells(double dt, double h, double eps, bool compact) {
+    const double b = compact ? 1.0 / 12.0 : 0.0;
+    const std::complex<double> a(0.0, dt / (4.0 * h * h));
+    const std::complex<double> off = b - a;
+    const std::complex<double> diag = (1.0 - 2.0 * b) + 2.0 * a;
+    const std::complex<double> rho = (-diag + std::sqrt(diag * diag - 4.0 * off * off)) / (2.0 * off);
+    const double decay = std::min(std::abs(rho), 1.0 / std::abs(rho));
+    if (!(decay > 0.0) || decay >= 1.0 || !(eps > 0.0) || eps >= 1.0) return 0;
+    return static_cast<int>(std::ceil(std::log(eps) / std::log(decay)));
+}
+
+// Longer than every diagnostics message
+constexpr std::size_t kReasonCapacity = 96;
+
 } // namespace
 
-Simulation::Simulation() {
+const char* precision_name(Precision p) {
+    return p == Precision::Float ? "float" : "double";
+}
+
+bool parse_precision(const std::string& name, Precision& out) {
+    if (name == "double") {
+        out = Precision::Double;
+        return true;
+    }
+    if (name == "float") {
+        out = Precision::Float;
+        return true;
+    }
+    return false;
+}
+
+const char* engine_name(Engine e) {
+    switch (e) {
+    case Engine::SplitStepFourier: return "split_step";
+    case Engine::CrankNicolsonMultigrid: return "cn_mg";
+    default: return "cn_adi";
+    }
+}
+
+bool parse_engine(const std::string& name, Engine& out) {
+    if (name == "cn_adi") {
+        out = Engine::CrankNicolsonADI;
+        return true;
+    }
+    if (name == "split_step") {
+        out = Engine::SplitStepFourier;
+        return true;
+    }
+    if (name == "cn_mg") {
+        out = Engine::CrankNicolsonMultigrid;
+        return true;
+    }
+    return false;
+}
+
+Simulation::Simulation() : pool(std::make_shared<ThreadPool>(1)) {
     resize(Nx, Ny);
 }
 
 void Simulation::resize(int newNx, int newNy) {
-    Nx = std::max(8, newNx);
-    Ny = std::max(8, newNy);
-    const int minDim = std::max(8, std::min(Nx, Ny));
-    const double cell = 1.0 / static_cast<double>(minDim);
-    Lx = Nx * cell;
-    Ly = Ny * cell;
-    dx = cell;
-    dy = cell;
-    psi.assign(static_cast<size_t>(Nx*Ny), std::complex<double>(0.0, 0.0));
+    const GridGeometry g = grid_geometry(newNx, newNy);
+    Nx = g.Nx;
+    Ny = g.Ny;
+    Lx = g.Lx;
+    Ly = g.Ly;
+    dx = g.dx;
+    dy = g.dy;
+    psi.assign(static_cast<size_t>(Nx*Ny));
     pfield.Nx = Nx;
     pfield.Ny = Ny;
     pfield.Lx = Lx;
     pfield.Ly = Ly;
-    pfield.build(V);
+    rebuild_potential();
     reset();
 }
 
+GridResample Simulation::prepare_resample(int newNx, int newNy) const {
+    GridResample job;
+    job.fromNx = Nx;
+    job.fromNy = Ny;
+    job.fromCell = dx * dy;
+    job.psiGeneration = psiGeneration;
+    job.stepCount = stepCount;
+    job.time = time;
+    job.pfield = pfield;
+    job.grid = grid_geometry(newNx, newNy);
+    if (float_ahead()) job.psi.assign_from(psiF);
+    else job.psi = psi;
+    return job;
+}
+
+bool Simulation::apply_resample(GridResample&& job) {
+    if (job.cancelled || job.fromNx != Nx || job.fromNy != Ny || job.psiGeneration != psiGeneration) return false;
+    const GridGeometry& g = job.grid;
+    Nx = g.Nx;
+    Ny = g.Ny;
+    Lx = g.Lx;
+    Ly = g.Ly;
+    dx = g.dx;
+    dy = g.dy;
+    psi = std::move(job.psi);
+    psiFAhead = false; // replaced, so the float state is stale
+    stepCount = job.stepCount;
+    time = job.time;
+    pfield.Nx = Nx;
+    pfield.Ny = Ny;
+    pfield.Lx = Lx;
+    pfield.Ly = Ly;
+    V = std::move(job.V);
+    potentialLayers = std::move(job.layers);
+    potentialLayers.update(pfield, V); // objects edited while the job ran
+    ++potentialGeneration;
+    stepper.restart();
+    spectral.clear();
+    refresh_diagnostics_baseline();
+    return true;
+}
+
+void Simulation::resample(int newNx, int newNy) {
+    GridResample job = prepare_resample(newNx, newNy);
+    run_resample(job, pool.get());
+    apply_resample(std::move(job));
+}
+
 void Simulation::clearPsi() {
-    std::fill(psi.begin(), psi.end(), std::complex<double>(0.0, 0.0));
+    psi.fill(std::complex<double>(0.0, 0.0));
+    ++psiGeneration;
 }
 
 void Simulation::reset() {
+    heap::NoAllocScope guard("Simulation::reset", resetSteady.arm(reset_key()));
     clearPsi();
+    stepCount = 0;
+    time = 0.0;
+    stepper.restart();
     pfield.Nx = Nx;
     pfield.Ny = Ny;
     pfield.Lx = Lx;
     pfield.Ly = Ly;
-    pfield.build(V);
+    rebuild_potential();
     for (const auto& p : packets) injectGaussian(p);
     refresh_diagnostics_baseline();
+    observables.prepare(Nx, Ny); // sized here so sampled steps do not allocate
+    observables.stepsSinceSample = 0;
 }
 
-void Simulation::injectGaussian(const Packet& p) {
+void add_packet_rows(Field& psi, const Packet& p, int Nx, int j0, int j1, double Lx, double Ly, double dx, double dy) {
     // Convert normalized parameters to physical coordinates
     const double cx_phys = p.cx * Lx;
     const double cy_phys = p.cy * Ly;
@@ -97,7 +208,7 @@ void Simulation::injectGaussian(const Packet& p) {
     const double sigx = sig_base;
     const double sigy = sig_base;
     const std::complex<double> I(0.0, 1.0);
-    for (int j = 0; j < Ny; ++j) {
+    for (int j = j0; j < j1; ++j) {
         double y = (j + 0.5) * dy;
         double dyc = (y - cy_phys) / sigy;
         for (int i = 0; i < Nx; ++i) {
@@ -107,55 +218,324 @@ void Simulation::injectGaussian(const Packet& p) {
             // plane-wave factor exp(i k·r). Interpret k in radians per unit length.
             double phase = p.kx * (x - cx_phys) + p.ky * (y - cy_phys);
             std::complex<double> w = p.amplitude * g * std::exp(I * phase);
-            psi[idx(i, j)] += w;
+            psi.add(static_cast<size_t>(j - j0) * Nx + i, w);
         }
     }
+}
+
+void Simulation::injectGaussian(const Packet& p) {
+    sync_psi();
+    add_packet_rows(psi, p, Nx, 0, Ny, Lx, Ly, dx, dy);
+    ++psiGeneration;
     update_diagnostics(false);
 }
 
 void Simulation::addBox(const Box& b) {
     pfield.boxes.push_back(b);
-    pfield.build(V);
+    update_potential();
     update_diagnostics(false);
 }
 
 void Simulation::addWell(const RadialWell& w) {
     pfield.wells.push_back(w);
-    pfield.build(V);
+    update_potential();
     update_diagnostics(false);
 }
 
-void Simulation::step() {
-    solver.step(psi, Nx, Ny, dx, dy, dt, V);
-    update_diagnostics(true);
+void Simulation::rebuild_potential() {
+    potentialLayers.build(pfield, V);
+    ++potentialGeneration;
+}
+
+void Simulation::update_potential() {
+    if (potentialLayers.update(pfield, V)) ++potentialGeneration;
+}
+
+void Simulation::sync_psi() {
+    if (float_ahead()) psi.assign_from(psiF);
+    psiFAhead = false;
+}
+
+void Simulation::advance(int n, MassReduction* reduce) {
+    // Any other engine steps the whole grid, so psi is no longer zero outside the window
+    if (!cropped()) activeWindowValid = false;
+    const bool useFloat = precision == Precision::Float && engine == Engine::CrankNicolsonADI && separable();
+    if (!useFloat) sync_psi();
+    if (engine == Engine::CrankNicolsonMultigrid || !separable()) {
+        multigrid.magneticField = magneticField;
+        multigrid.step_n(psi, Nx, Ny, dx, dy, dt, V, potentialGeneration, n, pool.get(), reduce);
+        return;
+    }
+    if (engine == Engine::SplitStepFourier) {
+        fourier.step_n(psi, Nx, Ny, dx, dy, dt, V, potentialGeneration, n, pool.get(), reduce);
+        return;
+    }
+    const bool crop = cropped();
+    if (useFloat) {
+        // float -> double is exact, so sums over psiF equal sums over the widened psi
+        if (!float_ahead()) {
+            psiF.assign_from(psi);
+            psiFGeneration = psiGeneration;
+        }
+        solverF.stencil = adi_stencil<CrankNicolsonADIf>();
+        solverF.windowed = crop;
+        solverF.window = activeWindow;
+        solverF.step_n(psiF, Nx, Ny, dx, dy, dt, V, potentialGeneration, n, pool.get(), reduce);
+        psiFAhead = true;
+        return;
+    }
+    solver.stencil = adi_stencil<CrankNicolsonADI>();
+    solver.windowed = crop;
+    solver.window = activeWindow;
+    solver.step_n(psi, Nx, Ny, dx, dy, dt, V, potentialGeneration, n, pool.get(), reduce);
+}
+
+void Simulation::advance_checked(int n) {
+    heap::NoAllocScope guard("Simulation::step", stepSteady.arm(step_key()));
+    S2D_PROFILE_SCOPE("Simulation::step");
+    // Mass sums come for free from the step's last kick, but the checks only
+    // run every check_every_n_steps steps; in between psi is not reduced at all.
+    stepsSinceCheck += n;
+    stepCount += static_cast<std::uint64_t>(n);
+    time += n * dt;
+    observables.stepsSinceSample += n;
+    const bool sample = observables.active() && observables.stepsSinceSample >= std::max(1, observables.every);
+    if (stepsSinceCheck < std::max(1, stability.check_every_n_steps)) {
+        advance(n);
+        if (sample) sample_observables();
+        return;
+    }
+    prepare_mass_reduction();
+    if (sample) {
+        // The probe pass reads psi anyway; the diagnostics sums ride along
+        advance(n);
+        sample_observables(&massReduction);
+    } else {
+        advance(n, &massReduction);
+    }
+    evaluate_diagnostics(true, stepsSinceCheck);
+    stepsSinceCheck = 0;
+    if (tracks_active_region()) update_active_window();
     if (diagnostics.unstable && stability.auto_pause_on_instability) {
         running = false;
     }
 }
 
+bool Simulation::tracks_active_region() const {
+    return activeRegion.enabled && engine == Engine::CrankNicolsonADI && separable();
+}
+
+bool Simulation::cropped() const {
+    return tracks_active_region() && activeWindowValid && activeWindowGeneration == psiGeneration;
+}
+
+void Simulation::update_active_window() {
+    if (massReduction.activeThreshold <= 0.0) {
+        // No baseline mass to measure against
+        activeWindowValid = false;
+        return;
+    }
+    const GridRect old = cropped() ? activeWindow : GridRect{0, Nx, 0, Ny};
+    GridRect next;
+    if (!massReduction.active.empty()) {
+        // The walls at the window edges only disturb psi by what the line
+        // solves would have carried across them: past the coupling length
+        // that is below the threshold amplitude
+        const double eps = std::sqrt(std::max(0.0, activeRegion.threshold));
+        const bool compact = spatialOrder == 4;
+        const int mx = std::max(0, activeRegion.margin) + cn_coupling_cells(dt, dx, eps, compact);
+        const int my = std::max(0, activeRegion.margin) + cn_coupling_cells(dt, dy, eps, compact);
+        next.i0 = std::max(0, massReduction.active.i0 - mx);
+        next.i1 = std::min(Nx, massReduction.active.i1 + mx);
+        next.j0 = std::max(0, massReduction.active.j0 - my);
+        next.j1 = std::min(Ny, massReduction.active.j1 + my);
+    }
+    // Crop: whatever was stepped but lies outside the new window is below
+    // the threshold; zero it so the window edges see a zero neighbourhood
+    auto crop = [&](auto& field) {
+        using Real = std::decay_t<decltype(field.re[0])>;
+        Real* re = field.re.data();
+        Real* im = field.im.data();
+        for (int j = old.j0; j < old.j1; ++j) {
+            Real* rowRe = re + static_cast<size_t>(j) * Nx;
+            Real* rowIm = im + static_cast<size_t>(j) * Nx;
+            if (next.empty() || j < next.j0 || j >= next.j1) {
+                std::fill(rowRe + old.i0, rowRe + old.i1, Real(0));
+                std::fill(rowIm + old.i0, rowIm + old.i1, Real(0));
+                continue;
+            }
+            const int a = std::min(old.i1, std::max(old.i0, next.i0));
+            const int b = std::max(old.i0, std::min(old.i1, next.i1));
+            std::fill(rowRe + old.i0, rowRe + a, Real(0));
+            std::fill(rowIm + old.i0, rowIm + a, Real(0));
+            std::fill(rowRe + b, rowRe + old.i1, Real(0));
+            std::fill(rowIm + b, rowIm + old.i1, Real(0));
+        }
+    };
+    if (float_ahead()) crop(psiF);
+    else crop(psi);
+    activeWindow = next;
+    activeWindowValid = true;
+    activeWindowGeneration = psiGeneration;
+}
+
+void Simulation::observables_stepped(int n) {
+    observables.stepsSinceSample += n;
+    if (observables.active() && observables.stepsSinceSample >= std::max(1, observables.every)) sample_observables();
+}
+
+void Simulation::sample_observables(MassReduction* sums) {
+    sync_psi();
+    observables.measure(psi, V, Nx, Ny, dx, dy, diagnostics.initial_mass, pool.get(), sums);
+    observables.sampleStep = stepCount;
+    observables.sampleTime = time;
+}
+
+std::uint64_t Simulation::step_key() const {
+    return heap::key({static_cast<std::uint64_t>(Nx), static_cast<std::uint64_t>(Ny),
+                      static_cast<std::uint64_t>(engine), static_cast<std::uint64_t>(precision),
+                      static_cast<std::uint64_t>(threads()), potentialGeneration, heap::bits(dt),
+                      heap::bits(magneticField), observables.layout_key()});
+}
+
+std::uint64_t Simulation::reset_key() const {
+    // Well layers are sized by each well's footprint
+    std::uint64_t wells = heap::key({pfield.wells.size(), heap::bits(pfield.well_cutoff)});
+    for (const RadialWell& w : pfield.wells) {
+        wells = heap::key({wells, heap::bits(w.cx), heap::bits(w.cy), heap::bits(w.radius),
+                           static_cast<std::uint64_t>(w.profile)});
+    }
+    return heap::key({static_cast<std::uint64_t>(Nx), static_cast<std::uint64_t>(Ny), pfield.boxes.size(),
+                      packets.size(), static_cast<std::uint64_t>(threads()), wells, observables.layout_key()});
+}
+
+void Simulation::step() {
+    advance_checked(1);
+}
+
 void Simulation::stepN(int n) {
-    for (int k = 0; k < n; ++k) {
+    if (n <= 0) return;
+    // Intermediate states are never materialized (adjacent half-kicks are fused),
+    // so the stability check and auto-pause run at most once for the whole block.
+    advance_checked(n);
+}
+
+void Simulation::step_adaptive(double maxDt) {
+    S2D_PROFILE_SCOPE("Simulation::step_adaptive");
+    if (engine != Engine::CrankNicolsonADI || precision != Precision::Double || !separable()) {
+        dt = std::min(dt, maxDt);
         step();
-        if (!running) break;
+        return;
+    }
+    sync_psi(); // precision was Float until now
+    if (!stepper.configured_for(adaptive)) stepper.reset(adaptive, dt);
+    sync_diagnostics(); // the candidate is checked against an up-to-date baseline
+    // A step shortened to land on maxDt uses its own solvers, outside the level ladder
+    double h = stepper.dt_at(stepper.level());
+    if (maxDt < h * (1.0 - 1e-9)) h = maxDt;
+    savedDiagnostics = diagnostics;
+    activeWindowValid = false; // the stepper's solvers step the whole grid
+    stepper.start = psi;
+    double error = 0.0;
+    for (int attempt = 0;; ++attempt) {
+        const bool last = attempt >= adaptive.max_rejects || h * 0.5 < adaptive.dt_min;
+        stepper.coarse = stepper.start;
+        stepper.solver_for(h).stencil = adi_stencil<CrankNicolsonADI>();
+        stepper.solver_for(0.5 * h).stencil = adi_stencil<CrankNicolsonADI>();
+        stepper.solver_for(h).step_n(stepper.coarse, Nx, Ny, dx, dy, h, V, potentialGeneration, 1, pool.get());
+        prepare_mass_reduction();
+        stepper.solver_for(0.5 * h).step_n(psi, Nx, Ny, dx, dy, 0.5 * h, V, potentialGeneration, 2, pool.get(),
+                                            &massReduction);
+        error = stepper.relative_difference(psi, stepper.coarse, Nx, Ny, pool.get()) / 3.0;
+        bool rejected = false;
+        if (error > adaptive.tol && !last) {
+            ++stepper.stats.errorRejects;
+            rejected = true;
+        } else {
+            evaluate_diagnostics(true, 1);
+            if (diagnostics.unstable && !last) {
+                ++stepper.stats.stabilityRejects;
+                diagnostics = savedDiagnostics;
+                rejected = true;
+            }
+        }
+        if (!rejected) break;
+        psi = stepper.start;
+        stepper.set_level(stepper.level() + 1);
+        h = std::min(stepper.dt_at(stepper.level()), 0.5 * h);
+    }
+    stepper.stats.lastError = error;
+    stepper.stats.record(time, h);
+    dt = h;
+    time += h;
+    ++stepCount;
+    stepsSinceCheck = 0;
+    // Local error scales as h^3: the next level up is expected at 8x the error
+    if (h == stepper.dt_at(stepper.level()) && error * 8.0 < 0.5 * adaptive.tol) stepper.set_level(stepper.level() - 1);
+    observables_stepped(1);
+    if (diagnostics.unstable && stability.auto_pause_on_instability) running = false;
+}
+
+void Simulation::advance_to(double t) {
+    // Relative slack so rounding in the sum of steps does not add a sliver step
+    const double slack = 1e-12 * std::max(1.0, std::fabs(t));
+    while (time < t - slack) {
+        step_adaptive(t - time);
+        if (diagnostics.unstable && stability.auto_pause_on_instability) break;
     }
 }
 
+void Simulation::sync_diagnostics() {
+    if (stepsSinceCheck > 0) {
+        update_diagnostics(true, stepsSinceCheck);
+        if (diagnostics.unstable && stability.auto_pause_on_instability) {
+            running = false;
+        }
+    }
+}
+
+void Simulation::set_threads(int n) {
+    pool->resize(n);
+}
+
+int Simulation::threads() const {
+    return pool->size();
+}
+
 double Simulation::mass() const {
-    double sum = 0.0;
-    for (const auto& z : psi) sum += std::norm(z);
+    const double sum = float_ahead() ? sum_norm(psiF.re.data(), psiF.im.data(), static_cast<int>(psiF.size()))
+                                     : sum_norm(psi.re.data(), psi.im.data(), static_cast<int>(psi.size()));
     return sum * dx * dy;
 }
 
+void prepare_mass_window(MassReduction& sums, int Nx, int Ny, double capRatio) {
+    const InteriorWindow interior = compute_interior_window(Nx, Ny, capRatio);
+    sums.mid = Nx / 2;
+    sums.i0 = interior.i0;
+    sums.i1 = interior.i1;
+    sums.j0 = interior.j0;
+    sums.j1 = interior.j1;
+}
+
+void Simulation::prepare_mass_reduction() {
+    prepare_mass_window(massReduction, Nx, Ny, pfield.cap_ratio);
+    // Unscaled per-cell threshold of the occupied box
+    massReduction.activeThreshold =
+        tracks_active_region() ? std::max(0.0, activeRegion.threshold) * diagnostics.initial_mass / (dx * dy) : 0.0;
+}
+
 double Simulation::interior_mass() const {
     const InteriorWindow interior = compute_interior_window(Nx, Ny, pfield.cap_ratio);
 
-    double sum = 0.0;
-    for (int j = interior.j0; j < interior.j1; ++j) {
-        for (int i = interior.i0; i < interior.i1; ++i) {
-            sum += std::norm(psi[idx(i, j)]);
+    auto sum = [&](const auto& field) {
+        double s = 0.0;
+        for (int j = interior.j0; j < interior.j1; ++j) {
+            const size_t row = static_cast<size_t>(idx(interior.i0, j));
+            s += sum_norm(field.re.data() + row, field.im.data() + row, interior.i1 - interior.i0);
         }
-    }
-    return sum * dx * dy;
+        return s;
+    };
+    return (float_ahead() ? sum(psiF) : sum(psi)) * dx * dy;
 }
 
 void Simulation::mass_split(double& left, double& right) const {
@@ -164,8 +544,25 @@ void Simulation::mass_split(double& left, double& right) const {
 }
 
 void Simulation::refresh_diagnostics_baseline() {
-    diagnostics = StabilityDiagnostics{};
+    sync_psi(); // psi is kept, so it must hold the stepped state before the bump
+    ++psiGeneration;
+    // A fresh record that takes over the old strings, so their buffers survive
+    // the reset. Reserved up front, so no later message has to grow them.
+    StabilityDiagnostics fresh;
+    fresh.reason.swap(diagnostics.reason);
+    fresh.warning_reason.swap(diagnostics.warning_reason);
+    fresh.interior_guard_reason.swap(diagnostics.interior_guard_reason);
+    diagnostics = std::move(fresh);
+    for (std::string* text : {&diagnostics.reason, &diagnostics.warning_reason, &diagnostics.interior_guard_reason}) {
+        text->clear();
+        text->reserve(kReasonCapacity);
+    }
     update_diagnostics(false);
+    rebase_stability(diagnostics);
+    stepsSinceCheck = 0;
+}
+
+void rebase_stability(StabilityDiagnostics& diagnostics) {
     diagnostics.initial_mass = diagnostics.current_mass;
     diagnostics.initial_interior_mass = diagnostics.current_interior_mass;
     diagnostics.initial_interior_mass_fraction =
@@ -183,26 +580,33 @@ void Simulation::refresh_diagnostics_baseline() {
     diagnostics.reason.clear();
 }
 
-void Simulation::update_diagnostics(bool is_time_step) {
-    const int mid = Nx / 2;
-    const InteriorWindow interiorWindow = compute_interior_window(Nx, Ny, pfield.cap_ratio);
+void Simulation::update_diagnostics(bool is_time_step, int steps) {
+    S2D_PROFILE_SCOPE("diagnostics");
+    prepare_mass_reduction();
+    if (float_ahead()) massReduction.reduce(psiF, Nx, Ny, pool.get());
+    else massReduction.reduce(psi, Nx, Ny, pool.get());
+    evaluate_diagnostics(is_time_step, steps);
+    if (is_time_step) stepsSinceCheck = 0;
+}
 
-    bool finite = true;
-    double total = 0.0;
-    double interiorMass = 0.0;
-    double left = 0.0;
-    double right = 0.0;
-    for (int j = 0; j < Ny; ++j) {
-        const bool insideY = (j >= interiorWindow.j0 && j < interiorWindow.j1);
-        for (int i = 0; i < Nx; ++i) {
-            const auto z = psi[idx(i, j)];
-            finite = finite && is_finite_complex(z);
-            const double w = std::norm(z) * dx * dy;
-            total += w;
-            if (i < mid) left += w; else right += w;
-            if (insideY && i >= interiorWindow.i0 && i < interiorWindow.i1) interiorMass += w;
-        }
-    }
+void Simulation::evaluate_diagnostics(bool is_time_step, int steps) {
+    evaluate_stability(diagnostics, stability, massReduction, Nx, Ny, dx * dy, pfield, is_time_step, steps);
+}
+
+void evaluate_stability(StabilityDiagnostics& diagnostics, const StabilityConfig& stability,
+                        const MassReduction& sums, int Nx, int Ny, double cell, const PotentialField& pfield,
+                        bool is_time_step, int steps) {
+    const InteriorWindow interiorWindow = compute_interior_window(Nx, Ny, pfield.cap_ratio);
+    double total = sums.total;
+    double interiorMass = sums.interior;
+    double left = sums.left;
+    double right = sums.right;
+    // Every term is non-negative, so a NaN/Inf anywhere in psi makes the total non-finite.
+    const bool finite = std::isfinite(total);
+    total *= cell;
+    interiorMass *= cell;
+    left *= cell;
+    right *= cell;
 
     diagnostics.current_mass = total;
     diagnostics.current_interior_mass = interiorMass;
@@ -220,7 +624,7 @@ void Simulation::update_diagnostics(bool is_time_step) {
     diagnostics.initial_interior_mass_fraction =
         diagnostics.initial_mass > 1e-15 ? diagnostics.initial_interior_mass / diagnostics.initial_mass : 0.0;
     if (is_time_step) {
-        diagnostics.steps_since_baseline += 1;
+        diagnostics.steps_since_baseline += std::max(1, steps);
     }
 
     diagnostics.warning = false;
@@ -304,170 +708,59 @@ void Simulation::update_diagnostics(bool is_time_step) {
     diagnostics.level = diagnostics.warning ? StabilityLevel::Warning : StabilityLevel::Ok;
 }
 
-static void tridiagonal_eigen(std::vector<double> diag, std::vector<double> off, std::vector<double>& evals, std::vector<std::vector<double>>& evecs) {
-    const int n = static_cast<int>(diag.size());
-    evals = diag;
-    evecs.assign(n, std::vector<double>(n, 0.0));
-    for (int i = 0; i < n; ++i) evecs[i][i] = 1.0;
-    if (n == 0) return;
-    off.push_back(0.0); // pad
-    const double eps = std::numeric_limits<double>::epsilon();
-    for (int l = 0; l < n; ++l) {
-        int iter = 0;
-        while (true) {
-            int m = l;
-            for (; m < n - 1; ++m) {
-                double sum = std::fabs(evals[m]) + std::fabs(evals[m + 1]);
-                if (std::fabs(off[m]) <= eps * sum) break;
-            }
-            if (m == l) break;
-            if (++iter > 60) break;
-            double g = (evals[l + 1] - evals[l]) / (2.0 * off[l]);
-            double r = std::hypot(g, 1.0);
-            g = evals[m] - evals[l] + off[l] / (g + std::copysign(r, g));
-            double s = 1.0, c = 1.0, p = 0.0;
-            for (int i = m - 1; i >= l; --i) {
-                double f = s * off[i];
-                double b = c * off[i];
-                if (std::fabs(f) >= std::fabs(g)) {
-                    c = g / f;
-                    r = std::hypot(c, 1.0);
-                    off[i + 1] = f * r;
-                    s = 1.0 / r;
-                    c *= s;
-                } else {
-                    s = f / g;
-                    r = std::hypot(s, 1.0);
-                    off[i + 1] = g * r;
-                    c = 1.0 / r;
-                    s *= c;
-                }
-                g = evals[i + 1] - p;
-                r = (evals[i] - g) * s + 2.0 * b * c;
-                p = s * r;
-                evals[i + 1] = g + p;
-                g = c * r - b;
-                for (int k = 0; k < n; ++k) {
-                    double fz = evecs[k][i + 1];
-                    evecs[k][i + 1] = s * evecs[k][i] + c * fz;
-                    evecs[k][i] = c * evecs[k][i] - s * fz;
-                }
-            }
-            evals[l] -= p;
-            off[l] = g;
-            off[m] = 0.0;
-        }
-    }
+EigenProblem Simulation::eigen_problem() const {
+    EigenProblem problem;
+    problem.Nx = Nx;
+    problem.Ny = Ny;
+    problem.dx = dx;
+    problem.dy = dy;
+    problem.compact = spatialOrder == 4;
+    problem.V.assign(V.re.begin(), V.re.end());
+    return problem;
 }
 
 std::vector<EigenState> Simulation::compute_eigenstates(int modes, int maxBasis, int maxIter, double tol) const {
-    const int N = Nx * Ny;
-    modes = std::max(1, modes);
-    maxBasis = std::max(modes, maxBasis);
-    maxIter = std::max(maxIter, modes);
-    const int maxSteps = std::min(maxBasis, maxIter);
-    const double h = dx; // dx == dy by construction
-    const double vol = dx * dy;
-
-    auto applyH = [&](const std::vector<double>& x, std::vector<double>& y) {
-        y.assign(N, 0.0);
-        for (int j = 0; j < Ny; ++j) {
-            for (int i = 0; i < Nx; ++i) {
-                const int k = idx(i, j);
-                double center = x[k];
-                double lap = 0.0;
-                if (i > 0) lap += x[idx(i - 1, j)];
-                if (i < Nx - 1) lap += x[idx(i + 1, j)];
-                if (j > 0) lap += x[idx(i, j - 1)];
-                if (j < Ny - 1) lap += x[idx(i, j + 1)];
-                lap -= 4.0 * center;
-                lap /= (h * h);
-                double v = std::real(V[k]);
-                y[k] = -0.5 * lap + v * center;
-            }
-        }
-    };
-
-    auto dot = [&](const std::vector<double>& a, const std::vector<double>& b) {
-        double s = 0.0;
-        for (int i = 0; i < N; ++i) s += a[i] * b[i];
-        return s * vol;
-    };
-
-    // initial vector
-    std::vector<double> q(N, 0.0), q_prev(N, 0.0);
-    for (int i = 0; i < N; i += std::max(1, N / 50)) q[i] = 1.0;
-    double nrm = std::sqrt(dot(q, q));
-    if (nrm < 1e-12) q[0] = 1.0, nrm = 1.0;
-    for (double& v : q) v /= nrm;
-
-    std::vector<double> alphas;
-    std::vector<double> betas;
-    std::vector<std::vector<double>> basis;
-    basis.reserve(maxBasis);
-    basis.push_back(q);
-
-    std::vector<double> w(N, 0.0);
-    double beta = 0.0;
-    for (int iter = 0; iter < maxSteps; ++iter) {
-        applyH(q, w);
-        for (int i = 0; i < N; ++i) w[i] -= beta * q_prev[i];
-        double alpha = dot(q, w);
-        for (int i = 0; i < N; ++i) w[i] -= alpha * q[i];
-        double nextBeta = std::sqrt(dot(w, w));
-        alphas.push_back(alpha);
-        if (iter > 0) betas.push_back(beta);
-        if (nextBeta < tol) {
-            break;
-        }
-        q_prev.swap(q);
-        q.swap(w);
-        for (double& v : q) v /= nextBeta;
-        basis.push_back(q);
-        beta = nextBeta;
-    }
-    const int m = static_cast<int>(alphas.size());
-    if (m == 0) return {};
-
-    std::vector<double> evals;
-    std::vector<std::vector<double>> evecsSmall;
-    tridiagonal_eigen(alphas, betas, evals, evecsSmall);
-
-    std::vector<int> order(m);
-    std::iota(order.begin(), order.end(), 0);
-    std::sort(order.begin(), order.end(), [&](int a, int b) { return evals[a] < evals[b]; });
-
-    int take = std::min(modes, m);
-    std::vector<EigenState> results;
-    results.reserve(take);
-    for (int t = 0; t < take; ++t) {
-        int idxMode = order[t];
-        std::vector<double> phi(N, 0.0);
-        for (int b = 0; b < m; ++b) {
-            double coeff = evecsSmall[b][idxMode];
-            const auto& qb = basis[b];
-            for (int i = 0; i < N; ++i) {
-                phi[i] += coeff * qb[i];
-            }
-        }
-        double norm = std::sqrt(dot(phi, phi));
-        if (norm < 1e-12) continue;
-        double invNorm = 1.0 / norm;
-        EigenState es;
-        es.energy = evals[idxMode];
-        es.psi.resize(N);
-        for (int i = 0; i < N; ++i) es.psi[i] = phi[i] * invNorm;
-        results.push_back(std::move(es));
-    }
-    return results;
+    EigenSolverOptions options;
+    options.modes = modes;
+    options.basis = maxBasis;
+    options.maxIter = maxIter;
+    options.tol = tol;
+    return solve_eigenstates(eigen_problem(), options, pool.get(), nullptr, nullptr, &workspace).states;
 }
 
 void Simulation::apply_eigenstate(const EigenState& state) {
     if (static_cast<int>(state.psi.size()) != Nx * Ny) return;
-    psi = state.psi;
+    psi.assign_from(state.psi);
+    psiFAhead = false; // replaced, so the float state is stale
     packets.clear();
     running = false;
     refresh_diagnostics_baseline();
 }
 
+double Simulation::project_spectral(const std::vector<EigenState>& modes) {
+    sync_psi();
+    const double residual = spectral.project(psi, modes, Nx, Ny, dx, dy, pool.get(), &workspace);
+    spectral.potentialGeneration = potentialGeneration;
+    spectralOrigin = stepCount;
+    spectralOriginTime = time;
+    return residual;
+}
+
+bool Simulation::spectral_ready() const {
+    return !spectral.empty() && spectral.Nx == Nx && spectral.Ny == Ny &&
+           spectral.potentialGeneration == potentialGeneration && stepCount >= spectralOrigin;
+}
+
+bool Simulation::evolve_spectral(std::uint64_t steps) {
+    if (!spectral_ready()) return false;
+    stepCount += steps;
+    time += static_cast<double>(steps) * dt;
+    spectral.evaluate(time - spectralOriginTime, psi, pool.get());
+    ++psiGeneration; // not stepped: snapshots stepped from the old psi are stale
+    update_diagnostics(true, static_cast<int>(steps));
+    observables_stepped(static_cast<int>(steps));
+    if (diagnostics.unstable && stability.auto_pause_on_instability) running = false;
+    return true;
+}
+
 } // namespace sim
@@ -1,11 +1,25 @@
 #pragma once
 
 #include <complex>
+#include <cstdint>
+#include <limits>
+#include <memory>
 #include <vector>
 #include <string>
 
+#include "adaptive.hpp"
+#include "alloc_guard.hpp"
+#include "eigensolver.hpp"
+#include "field.hpp"
+#include "multigrid.hpp"
+#include "observables.hpp"
 #include "solver.hpp"
+#include "spectral.hpp"
+#include "split_step.hpp"
 #include "potential.hpp"
+#include "resample.hpp"
+#include "thread_pool.hpp"
+#include "workspace.hpp"
 
 namespace sim {
 
@@ -13,10 +27,23 @@ enum class ViewMode { MagnitudePhase, Real, Imag, Magnitude, Phase };
 
 enum class StabilityLevel { Ok, Warning, Unstable };
 
-struct EigenState {
-    double energy{0.0};
-    std::vector<std::complex<double>> psi;
-};
+// Arithmetic precision of time stepping. psi and V are always kept in double;
+// Float steps a float working copy of psi with the float solver.
+enum class Precision { Double, Float };
+
+const char* precision_name(Precision p);
+bool parse_precision(const std::string& name, Precision& out); // "double" / "float"
+
+// Time-stepping engine (see propagator.hpp).
+//  CrankNicolsonADI: second order in dx and dt, any precision.
+//  SplitStepFourier: spectral kinetic step, second order in dt only; double precision.
+//  CrankNicolsonMultigrid: unsplit CN with an iterative solve (multigrid.hpp); double precision.
+// With a magnetic field the kinetic term no longer splits into x and y parts,
+// and every engine steps with CrankNicolsonMultigrid.
+enum class Engine { CrankNicolsonADI, SplitStepFourier, CrankNicolsonMultigrid };
+
+const char* engine_name(Engine e);
+bool parse_engine(const std::string& name, Engine& out); // "cn_adi" / "split_step" / "cn_mg"
 
 struct StabilityConfig {
     double rel_mass_drift_tol{0.15};
@@ -26,10 +53,24 @@ struct StabilityConfig {
     double min_initial_interior_mass_fraction{0.05};
     double min_interior_area_fraction{0.01};
     int warmup_steps{8};
+    int check_every_n_steps{1}; // time steps between stability checks (mass sums are only taken then)
     bool interior_drift_hard_fail{false};
     bool auto_pause_on_instability{true};
 };
 
+// Cropped CN-ADI stepping. Each stability check also finds the bounding box
+// of the occupied cells (|psi|^2 dx dy above threshold * the baseline mass);
+// until the next check only that box, grown on every side, is stepped and psi
+// outside it is set to zero. The growth is the distance over which the
+// implicit line solves spread an amplitude down to sqrt(threshold) (derived
+// from dt and the spacing), plus margin cells, which must cover how far psi
+// travels in check_every_n_steps steps or it reflects off the window edge.
+struct ActiveRegionConfig {
+    bool enabled{false};
+    double threshold{1e-12};
+    int margin{16};
+};
+
 struct StabilityDiagnostics {
     double initial_mass{0.0};
     double current_mass{0.0};
@@ -53,53 +94,167 @@ struct StabilityDiagnostics {
     std::string interior_guard_reason;
 };
 
+// Pieces of Simulation that also work on a band of rows (see distributed.hpp)
+// psi += packet p over rows [j0, j1) of a grid with Nx columns; psi holds only those rows.
+void add_packet_rows(Field& psi, const Packet& p, int Nx, int j0, int j1, double Lx, double Ly, double dx, double dy);
+// Midline and interior window of the diagnostics sums for an Nx x Ny grid.
+void prepare_mass_window(MassReduction& sums, int Nx, int Ny, double capRatio);
+// diagnostics from the finished, unscaled sums of psi (cell = dx dy).
+void evaluate_stability(StabilityDiagnostics& diagnostics, const StabilityConfig& stability,
+                        const MassReduction& sums, int Nx, int Ny, double cell, const PotentialField& pfield,
+                        bool is_time_step, int steps);
+// Takes the current masses as the new baseline and clears every verdict.
+void rebase_stability(StabilityDiagnostics& diagnostics);
+
 struct Simulation {
     int Nx{372}, Ny{300};
     double Lx{1.0}, Ly{1.0};      // physical domain size (arbitrary units)
     double dx{Lx/Nx}, dy{Ly/Ny};  // grid spacing
     double dt{0.0001};
     bool running{false};
+    std::uint64_t stepCount{0}; // time steps taken since the last reset()
+    double time{0.0};           // simulated time since the last reset() (sum of the dt stepped)
 
-    // Fields
-    std::vector<std::complex<double>> psi; // wavefunction
-    std::vector<std::complex<double>> V;   // potential (real + i*imag for CAP)
+    // Fields (split real/imag storage, see field.hpp)
+    Field psi; // wavefunction (behind psiF between float steps, see sync_psi())
+    std::uint64_t psiGeneration{0}; // bumped whenever psi or the diagnostics baseline is set other than by stepping
+    Field V;   // potential (real + i*imag for CAP)
+    std::uint64_t potentialGeneration{0}; // bumped on every rebuild of V (keys the solver's propagator cache)
 
     // Objects (for reconstructing initial conditions on reset)
     PotentialField pfield;   // includes boxes + CAP params
+    PotentialLayers potentialLayers; // per-object layers of V for update_potential()
     std::vector<Packet> packets; // defined sources (for reset)
 
     // Numerics
+    Engine engine{Engine::CrankNicolsonADI};
+    Precision precision{Precision::Double}; // CN-ADI only; the split-step engine always runs in double
+    // Order of the discrete Laplacian: 2 (three-point) or 4 (compact, see
+    // BasicCrankNicolsonADI::Stencil). Applies to CN-ADI steps and eigenmodes;
+    // the split-step engine is spectral and the multigrid engine stays second order.
+    int spatialOrder{2};
     CrankNicolsonADI solver;
+    CrankNicolsonADIf solverF;      // used when precision == Float
+    SplitStepFourier fourier;       // used when engine == SplitStepFourier
+    CrankNicolsonMultigrid multigrid; // used when engine == CrankNicolsonMultigrid or !separable()
+    double magneticField{0.0};      // uniform B_z (symmetric gauge about the centre); eigenmodes ignore it
+    // Float stepping state. It stays resident across steps, loaded from psi
+    // only when psiGeneration moved past psiFGeneration (psi was set), and
+    // psi is widened from it only when read (psiFAhead: steps psi lacks).
+    ComplexField<float> psiF;
+    std::uint64_t psiFGeneration{0};
+    bool psiFAhead{false};
+    SpectralEvolution spectral;     // psi projected onto eigenmodes, see project_spectral()
+    std::uint64_t spectralOrigin{0}; // stepCount at the projection
+    double spectralOriginTime{0.0};  // time at the projection; evolved modes are evaluated at time - this
+    AdaptiveConfig adaptive;        // dt control of step_adaptive() / advance_to()
+    AdaptiveStepper stepper;
+    mutable Workspace workspace;    // grid-sized scratch of compute_eigenstates() and project_spectral()
+    std::shared_ptr<ThreadPool> pool; // worker threads shared by the parallel kernels
 
     // Stability / diagnostics
     StabilityConfig stability;
     StabilityDiagnostics diagnostics;
+    MassReduction massReduction;  // row sums behind diagnostics, filled by the last kick of a checked step
+    int stepsSinceCheck{0};       // time steps advanced since diagnostics were last evaluated
+    StabilityDiagnostics savedDiagnostics; // step_adaptive()'s pre-step copy (its strings keep their buffers)
+    // Window stepped while cropping (activeRegion), taken from the sums of
+    // the last checked step; psi is zero outside it. Only used while
+    // activeWindowGeneration == psiGeneration and the engine is CN-ADI.
+    ActiveRegionConfig activeRegion;
+    GridRect activeWindow;
+    bool activeWindowValid{false};
+    std::uint64_t activeWindowGeneration{0};
+    // Probes sampled every observables.every time steps; a sample due on a
+    // checked step shares its pass over psi with the diagnostics.
+    Observables observables;
+
+    // Debug builds assert that step() and reset() do not allocate once their
+    // buffers are sized, i.e. from the second call with the same key on (alloc_guard.hpp).
+    heap::SteadyState stepSteady;
+    heap::SteadyState resetSteady;
 
     Simulation();
 
     void resize(int newNx, int newNy);
+    // Grid change that keeps the evolved state: psi is resampled onto the new
+    // grid (norm preserved) and V rebuilt there, stepCount and time carry on.
+    // prepare_resample() copies what the job needs, run_resample() (possibly on
+    // another thread, see GridResizeTask) does the work, apply_resample() adopts
+    // the result. Apply refuses (false) when the grid or psi changed since the
+    // job was prepared; objects edited meanwhile are patched into V.
+    GridResample prepare_resample(int newNx, int newNy) const;
+    bool apply_resample(GridResample&& job);
+    void resample(int newNx, int newNy); // all three in place
     void reset();               // rebuild V and re-inject packets (psi from scratch)
     void clearPsi();            // set psi = 0
     void injectGaussian(const Packet& p); // add a Gaussian packet to psi
     void addBox(const Box& b);  // add a rectangle to potential & rebuild V
     void addWell(const RadialWell& w); // add a smooth radial feature
+    void rebuild_potential();   // V = pfield.build(), bumps potentialGeneration
+    void update_potential();    // patch V where pfield objects changed; bumps potentialGeneration if V changed
 
     void step();                // one CN-ADI step
-    void stepN(int n);
+    void stepN(int n);          // n steps with fused half-kicks; diagnostics once at the end
+    // One accepted step with error control (CN-ADI in double; other engines
+    // take a fixed step of dt). The step size is at most maxDt; it is rejected
+    // and retried smaller when its local error exceeds adaptive.tol or the
+    // result fails the stability checks. dt is left at the size taken.
+    void step_adaptive(double maxDt = std::numeric_limits<double>::infinity());
+    void advance_to(double t);  // step_adaptive() until time reaches t
+
+    // The kinetic term splits into x and y parts (no magnetic field), so the
+    // ADI and split-step engines apply.
+    bool separable() const { return magneticField == 0.0; }
+    template <typename Solver>
+    typename Solver::Stencil adi_stencil() const {
+        return spatialOrder == 4 ? Solver::Stencil::Compact : Solver::Stencil::Standard;
+    }
+
+    // Brings psi up to date after float steps (a no-op otherwise). Readers of
+    // psi outside Simulation call it after stepping; members do it themselves.
+    void sync_psi();
+    bool float_ahead() const { return psiFAhead && psiFGeneration == psiGeneration; }
+
+    // Worker threads used by step(); n <= 0 selects the hardware thread count.
+    void set_threads(int n);
+    int threads() const;
 
     // Diagnostics
     double mass() const;        // discrete L2 norm integral sum |psi|^2 dx dy
     double interior_mass() const; // excludes CAP border band
     void mass_split(double& left, double& right) const; // split by vertical midline
     void refresh_diagnostics_baseline();
-    void update_diagnostics(bool is_time_step);
+    void update_diagnostics(bool is_time_step, int steps = 1); // steps: time steps since the last call
+    void sync_diagnostics();    // evaluate diagnostics now if steps are pending from the check cadence
+    // Measures the probes now, stamped with stepCount and time. With sums
+    // (window prepared), the same pass also fills the diagnostics sums.
+    void sample_observables(MassReduction* sums = nullptr);
 
-    // Eigenmodes of the current Hamiltonian (real part of V, Dirichlet boundary)
+    // Eigenmodes of the current Hamiltonian (real part of V, Dirichlet boundary), see eigensolver.hpp
+    EigenProblem eigen_problem() const;
     std::vector<EigenState> compute_eigenstates(int modes, int maxBasis = 64, int maxIter = 200, double tol = 1e-6) const;
     void apply_eigenstate(const EigenState& state);
+    // Spectral evolution: psi is projected onto modes once, then set to its
+    // value at any later time without stepping. Exact inside the basis for the
+    // Hermitian part of H; the CAP does not absorb. Returns the relative norm
+    // of psi outside the basis.
+    double project_spectral(const std::vector<EigenState>& modes);
+    bool spectral_ready() const; // projected on this grid and V unchanged since
+    bool evolve_spectral(std::uint64_t steps); // advance by steps * dt; false if not ready
 
     // Helpers
     inline int idx(int i, int j) const { return j * Nx + i; }
+    void advance(int n, MassReduction* reduce = nullptr); // n steps of the selected engine and precision
+    void prepare_mass_reduction(); // regions (midline, interior window) of massReduction
+    void evaluate_diagnostics(bool is_time_step, int steps); // diagnostics from massReduction's sums
+    void advance_checked(int n); // advance, then check stability and sample probes when their cadences are due
+    void observables_stepped(int n); // count n steps taken outside advance_checked() towards the sample cadence
+    bool tracks_active_region() const; // cropping is on and applies to the current engine
+    bool cropped() const;              // activeWindow holds for the current psi
+    void update_active_window();       // new window from massReduction.active; zeroes psi left outside it
+    std::uint64_t step_key() const;  // what sizes the stepping buffers
+    std::uint64_t reset_key() const; // what sizes the buffers rebuilt by reset()
 };
 
 } // namespace sim
@@ -1,108 +1,363 @@
 #include "solver.hpp"
-#include "tridiag.hpp"
 
 #include <algorithm>
 #include <cmath>
 
+#include "profiler.hpp"
+
 namespace sim {
 
 static inline int idx(int i, int j, int Nx) { return j * Nx + i; }
 
-void CrankNicolsonADI::ensure_workspace(int Nx, int Ny) {
-    if (cachedNx == Nx && cachedNy == Ny) {
+// Lanes [0, lanes) of a line of n points, point i of lane l at [i * stride + l],
+// replaced in place by the explicit operator (zero beyond both ends).
+template <typename Real>
+static void apply_explicit_line(const ExplicitOp<Real>& op, Real* re, Real* im, int n, size_t stride, int lanes) {
+    Real prevR[kBatchLanesFor<float>] = {};
+    Real prevI[kBatchLanesFor<float>] = {};
+    for (int i = 0; i < n; ++i) {
+        Real* r = re + static_cast<size_t>(i) * stride;
+        Real* m = im + static_cast<size_t>(i) * stride;
+        const bool next = i + 1 < n;
+        for (int l = 0; l < lanes; ++l) {
+            const Real zr = r[l];
+            const Real zi = m[l];
+            const Real nr = next ? r[stride + l] : Real(0);
+            const Real ni = next ? m[stride + l] : Real(0);
+            op.apply(zr, zi, prevR[l] + nr, prevI[l] + ni, r[l], m[l]);
+            prevR[l] = zr;
+            prevI[l] = zi;
+        }
+    }
+}
+
+template <typename Real>
+void BasicCrankNicolsonADI<Real>::ensure_workspace(int Nx, int Ny, int threads) {
+    threads = std::max(1, threads);
+    if (cachedNx != Nx || cachedNy != Ny) {
+        cachedNx = Nx;
+        cachedNy = Ny;
+        factorsValid = false;
+        phi.assign(static_cast<size_t>(Nx) * Ny);
+        zeroRow.assign(static_cast<size_t>(std::max(Nx, Ny)), Real(0));
+        lines.clear();
+    }
+    if (static_cast<int>(lines.size()) < threads) {
+        lines.resize(static_cast<size_t>(threads));
+    }
+    const size_t batchLen = static_cast<size_t>(kLanes) * Nx;
+    for (auto& ws : lines) {
+        if (ws.d.size() != static_cast<size_t>(Nx)) ws.d.assign(static_cast<size_t>(Nx), cd(0, 0));
+        if (ws.rhs.size() != static_cast<size_t>(Ny)) ws.rhs.assign(static_cast<size_t>(Ny), cd(0, 0));
+        if (ws.bre.size() != batchLen) {
+            ws.bre.assign(batchLen, Real(0));
+            ws.bim.assign(batchLen, Real(0));
+        }
+    }
+}
+
+template <typename Real>
+void BasicCrankNicolsonADI<Real>::ensure_factors(double dx, double dy, double dt) {
+    if (factorsValid && factorDx == dx && factorDy == dy && factorDt == dt && factorStencil == stencil) {
         return;
     }
-    cachedNx = Nx;
-    cachedNy = Ny;
-    phi.assign(static_cast<size_t>(Nx * Ny), cd(0.0, 0.0));
-    a.assign(static_cast<size_t>(Nx), cd(0.0, 0.0));
-    b.assign(static_cast<size_t>(Nx), cd(0.0, 0.0));
-    c.assign(static_cast<size_t>(Nx), cd(0.0, 0.0));
-    d.assign(static_cast<size_t>(Nx), cd(0.0, 0.0));
-    ay_a.assign(static_cast<size_t>(Ny), cd(0.0, 0.0));
-    ay_b.assign(static_cast<size_t>(Ny), cd(0.0, 0.0));
-    ay_c.assign(static_cast<size_t>(Ny), cd(0.0, 0.0));
-    rhs.assign(static_cast<size_t>(Ny), cd(0.0, 0.0));
+    // ADI for kinetic term (CN): alpha = i dt / 4
+    using cdd = std::complex<double>;
+    const cdd alpha = cdd(0.0, 1.0) * (dt * 0.25);
+    const cdd ax = alpha / (dx * dx);
+    const cdd ay = alpha / (dy * dy);
+    if (stencil == Stencil::Compact) {
+        // B -/+ a delta^2 with B = tridiag(1, 10, 1) / 12
+        const double off = 1.0 / 12.0;
+        const double diag = 10.0 / 12.0;
+        fx.factor(cachedNx, off - ax, diag + 2.0 * ax, off - ax);
+        fy.factor(cachedNy, off - ay, diag + 2.0 * ay, off - ay);
+        const cd cx(diag - 2.0 * ax), nx(off + ax);
+        const cd cy(diag - 2.0 * ay), ny(off + ay);
+        opx = ExplicitOp<Real>{cx.real(), cx.imag(), nx.real(), nx.imag()};
+        opy = ExplicitOp<Real>{cy.real(), cy.imag(), ny.real(), ny.imag()};
+    } else {
+        fx.factor(cachedNx, -ax, cdd(1.0, 0.0) + cdd(2.0, 0.0) * ax, -ax);
+        fy.factor(cachedNy, -ay, cdd(1.0, 0.0) + cdd(2.0, 0.0) * ay, -ay);
+        // Explicit halves I + a D: center * (1 - 2a) + a * (sum of neighbours)
+        const cd rx = -fx.sup;
+        const cd ry = -fy.sup;
+        const cd cx = cd(1.0, 0.0) - cd(2.0, 0.0) * rx;
+        const cd cy = cd(1.0, 0.0) - cd(2.0, 0.0) * ry;
+        opx = ExplicitOp<Real>{cx.real(), cx.imag(), rx.real(), rx.imag()};
+        opy = ExplicitOp<Real>{cy.real(), cy.imag(), ry.real(), ry.imag()};
+    }
+    bfx.assign(fx);
+    bfy.assign(fy);
+    // Full-size copies reserve the window factors' storage, so shrinking and
+    // regrowing the window never allocates
+    wfx.prefix(fx, cachedNx);
+    wfy.prefix(fy, cachedNy);
+    wbfx.assign(wfx);
+    wbfy.assign(wfy);
+    factorDx = dx;
+    factorDy = dy;
+    factorDt = dt;
+    factorStencil = stencil;
+    factorsValid = true;
 }
 
-void CrankNicolsonADI::step(std::vector<std::complex<double>>& psi,
-                            int Nx, int Ny, double dx, double dy, double dt,
-                            const std::vector<std::complex<double>>& V)
-{
-    ensure_workspace(Nx, Ny);
+template <typename Real>
+GridRect BasicCrankNicolsonADI<Real>::step_rect() const {
+    if (!windowed) return GridRect{0, cachedNx, 0, cachedNy};
+    GridRect r;
+    r.i0 = std::clamp(window.i0, 0, cachedNx);
+    r.i1 = std::clamp(window.i1, r.i0, cachedNx);
+    r.j0 = std::clamp(window.j0, 0, cachedNy);
+    r.j1 = std::clamp(window.j1, r.j0, cachedNy);
+    return r;
+}
 
-    const cd I(0.0, 1.0);
+template <typename Real>
+void BasicCrankNicolsonADI<Real>::ensure_window_factors() {
+    const GridRect r = step_rect();
+    if (wfx.n != r.i1 - r.i0) {
+        wfx.prefix(fx, r.i1 - r.i0);
+        wbfx.assign(wfx);
+    }
+    if (wfy.n != r.j1 - r.j0) {
+        wfy.prefix(fy, r.j1 - r.j0);
+        wbfy.assign(wfy);
+    }
+}
 
-    // Potential half-step: psi <- exp(-i V dt/2) psi
-    const double half = 0.5;
-    const double half_dt = half * dt;
-    for (int j = 0; j < Ny; ++j) {
-        for (int i = 0; i < Nx; ++i) {
-            const int k = idx(i, j, Nx);
-            psi[k] *= std::exp(-I * V[k] * half_dt);
+template <typename Real>
+void BasicCrankNicolsonADI<Real>::sweep_x(const FieldT& psi, ThreadPool* pool) {
+    S2D_PROFILE_SCOPE("CN x-sweep");
+    const int Nx = cachedNx;
+    // Rows [r.j0, r.j1), each solved over columns [r.i0, r.i1) (m unknowns)
+    const GridRect r = step_rect();
+    const int m = r.i1 - r.i0;
+    const BasicTridiagFactor<Real>& f = (m == Nx) ? fx : wfx;
+    const BasicBatchedFactor<Real>& bf = (m == Nx) ? bfx : wbfx;
+    // Explicit half (I + alpha D_y), then (Compact) the x factor Bx + ax delta_x^2
+    const ExplicitOp<Real>& op = opy;
+    const bool compact = factorStencil == Stencil::Compact;
+    const Real* zero = zeroRow.data();
+
+    // RHS of row j into out[(i - r.i0) * stride] (split components); the
+    // Compact x factor is applied to the whole line afterwards.
+    auto build_row = [&](int j, Real* outR, Real* outI, size_t stride) {
+        const size_t row = static_cast<size_t>(j) * Nx + r.i0;
+        const Real* zr = psi.re.data() + row;
+        const Real* zi = psi.im.data() + row;
+        const Real* ur = (j > r.j0) ? zr - Nx : zero;
+        const Real* ui = (j > r.j0) ? zi - Nx : zero;
+        const Real* dr = (j < r.j1 - 1) ? zr + Nx : zero;
+        const Real* di = (j < r.j1 - 1) ? zi + Nx : zero;
+        for (int i = 0; i < m; ++i) {
+            op.apply(zr[i], zi[i], ur[i] + dr[i], ui[i] + di[i], outR[i * stride], outI[i * stride]);
         }
+    };
+
+    // (I - alpha D_x) phi = (I + alpha D_y) psi
+    if (lineKernel == LineKernel::Batched) {
+        // kLanes consecutive rows per batch; row j0 + l is lane l.
+        constexpr int L = kLanes;
+        const int batches = (r.j1 - r.j0 + L - 1) / L;
+        parallel_for(pool, 0, batches, [&](int b0, int b1, int worker) {
+            Real* re = lines[static_cast<size_t>(worker)].bre.data();
+            Real* im = lines[static_cast<size_t>(worker)].bim.data();
+            for (int b = b0; b < b1; ++b) {
+                const int j0 = r.j0 + b * L;
+                const int rows = std::min(L, r.j1 - j0);
+                for (int l = 0; l < L; ++l) {
+                    if (l < rows) {
+                        build_row(j0 + l, re + l, im + l, L);
+                    } else {
+                        for (int i = 0; i < m; ++i) re[i * L + l] = im[i * L + l] = Real(0);
+                    }
+                }
+                if (compact) apply_explicit_line(opx, re, im, m, L, rows);
+                solve_batched(bf, re, im, L, 1, simd);
+                for (int l = 0; l < rows; ++l) {
+                    const size_t row = static_cast<size_t>(j0 + l) * Nx + r.i0;
+                    Real* outR = phi.re.data() + row;
+                    Real* outI = phi.im.data() + row;
+                    for (int i = 0; i < m; ++i) {
+                        outR[i] = re[i * L + l];
+                        outI[i] = im[i * L + l];
+                    }
+                }
+            }
+        });
+        return;
     }
 
-    // ADI for kinetic term (CN): alpha = i dt / 4
-    const cd alpha = I * (dt * 0.25);
-    const cd ax = alpha / (dx * dx);
-    const cd ay = alpha / (dy * dy);
-
-    // Temporary buffer
-    // 1) Solve along x: (I - alpha D_x) phi = (I + alpha D_y) psi
-    for (int j = 0; j < Ny; ++j) {
-        // Build RHS: (I + ay * D_y) psi
-        for (int i = 0; i < Nx; ++i) {
-            const cd center = psi[idx(i, j, Nx)];
-            cd up = (j > 0) ? psi[idx(i, j - 1, Nx)] : cd(0.0, 0.0);
-            cd dn = (j < Ny - 1) ? psi[idx(i, j + 1, Nx)] : cd(0.0, 0.0);
-            cd Dy_center = (up - cd(2.0, 0.0) * center + dn) / (dy * dy);
-            d[i] = center + alpha * Dy_center; // (I + alpha D_y)
+    parallel_for(pool, r.j0, r.j1, [&](int j0, int j1, int worker) {
+        cd* d = lines[static_cast<size_t>(worker)].d.data();
+        Real* dd = reinterpret_cast<Real*>(d);
+        for (int j = j0; j < j1; ++j) {
+            // Build RHS: (I + ay * D_y) psi
+            build_row(j, dd, dd + 1, 2);
+            if (compact) apply_explicit_line(opx, dd, dd + 1, m, 2, 1);
+            // Solve row with the cached factorization
+            solve_factored(f, d);
+            // Store into phi
+            const size_t row = static_cast<size_t>(j) * Nx + r.i0;
+            for (int i = 0; i < m; ++i) {
+                phi.re[row + i] = d[i].real();
+                phi.im[row + i] = d[i].imag();
+            }
         }
+    });
+}
+
+template <typename Real>
+void BasicCrankNicolsonADI<Real>::sweep_y(FieldT& psi, ThreadPool* pool) {
+    S2D_PROFILE_SCOPE("CN y-sweep");
+    const int Nx = cachedNx;
+    // Columns [r.i0, r.i1), each solved over rows [r.j0, r.j1) (m unknowns)
+    const GridRect r = step_rect();
+    const int m = r.j1 - r.j0;
+    const BasicTridiagFactor<Real>& f = (m == cachedNy) ? fy : wfy;
+    const BasicBatchedFactor<Real>& bf = (m == cachedNy) ? bfy : wbfy;
+    // Explicit half (I + alpha D_x): center * (1 - 2a) + a * (lf + rt)
+    const ExplicitOp<Real>& op = opx;
+    const bool compact = factorStencil == Stencil::Compact;
 
-        // Build tridiagonal coefficients for (I - alpha D_x)
-        for (int i = 0; i < Nx; ++i) {
-            a[i] = (i == 0) ? cd(0.0, 0.0) : -ax; // sub-diagonal
-            b[i] = cd(1.0, 0.0) + cd(2.0, 0.0) * ax; // main diag
-            c[i] = (i == Nx - 1) ? cd(0.0, 0.0) : -ax; // super-diagonal
+    // RHS of columns [i0, i1) (inside [r.i0, r.i1)) in row j into out[(i - i0) * stride]:
+    // (I + alpha D_x) phi, or phi itself when Compact (the x-sweep applied both factors).
+    auto build_segment = [&](int j, int i0, int i1, Real* outR, Real* outI, size_t stride) {
+        const size_t row = static_cast<size_t>(j) * Nx;
+        const Real* zr = phi.re.data() + row;
+        const Real* zi = phi.im.data() + row;
+        if (compact) {
+            for (int i = i0; i < i1; ++i) {
+                const size_t o = static_cast<size_t>(i - i0) * stride;
+                outR[o] = zr[i];
+                outI[o] = zi[i];
+            }
+            return;
+        }
+        int i = i0;
+        if (i == r.i0 && i < i1) {
+            const Real rr = (i + 1 < r.i1) ? zr[i + 1] : Real(0);
+            const Real ri = (i + 1 < r.i1) ? zi[i + 1] : Real(0);
+            op.apply(zr[i], zi[i], Real(0) + rr, Real(0) + ri, outR[0], outI[0]);
+            ++i;
         }
-        // Solve row
-        solve_tridiagonal(a, b, c, d);
-        // Store into phi
-        for (int i = 0; i < Nx; ++i) {
-            phi[idx(i, j, Nx)] = d[i];
+        const int inner = std::min(i1, r.i1 - 1);
+        for (; i < inner; ++i) {
+            const size_t o = static_cast<size_t>(i - i0) * stride;
+            op.apply(zr[i], zi[i], zr[i - 1] + zr[i + 1], zi[i - 1] + zi[i + 1], outR[o], outI[o]);
         }
+        if (i < i1) { // i == r.i1 - 1
+            const size_t o = static_cast<size_t>(i - i0) * stride;
+            op.apply(zr[i], zi[i], zr[i - 1] + Real(0), zi[i - 1] + Real(0), outR[o], outI[o]);
+        }
+    };
+
+    // (I - alpha D_y) psi_new = (I + alpha D_x) phi
+    if (ySweep == YSweep::Columns) {
+        parallel_for(pool, r.i0, r.i1, [&](int c0, int c1, int worker) {
+            cd* rhs = lines[static_cast<size_t>(worker)].rhs.data();
+            Real* rr = reinterpret_cast<Real*>(rhs);
+            for (int i = c0; i < c1; ++i) {
+                for (int j = 0; j < m; ++j) {
+                    build_segment(r.j0 + j, i, i + 1, rr + 2 * j, rr + 2 * j + 1, 2);
+                }
+                solve_factored(f, rhs);
+                for (int j = 0; j < m; ++j) {
+                    psi.set(static_cast<size_t>(idx(i, r.j0 + j, Nx)), rhs[j]);
+                }
+            }
+        });
+        return;
     }
 
-    // 2) Solve along y: (I - alpha D_y) psi_new = (I + alpha D_x) phi
-    for (int i = 0; i < Nx; ++i) {
-        // RHS: (I + ax * D_x) phi
-        for (int j = 0; j < Ny; ++j) {
-            const cd center = phi[idx(i, j, Nx)];
-            cd lf = (i > 0) ? phi[idx(i - 1, j, Nx)] : cd(0.0, 0.0);
-            cd rt = (i < Nx - 1) ? phi[idx(i + 1, j, Nx)] : cd(0.0, 0.0);
-            cd Dx_center = (lf - cd(2.0, 0.0) * center + rt) / (dx * dx);
-            rhs[j] = center + alpha * Dx_center; // (I + alpha D_x)
+    // Tiled: the RHS of a tile is written straight into psi and the recurrence
+    // runs in place with stride Nx, lanes being adjacent columns. RHS rows are
+    // produced a few at a time and forward-eliminated while still in cache, so
+    // the tile is only walked twice (down, then back up). With batching, the
+    // tile's full kBatchLanes groups go through the SIMD kernel.
+    constexpr int kRowChunk = 8;
+    const int tile = std::max(1, tileWidth);
+    const int tiles = (r.i1 - r.i0 + tile - 1) / tile;
+    const size_t stride = static_cast<size_t>(Nx);
+    const bool batched = (lineKernel == LineKernel::Batched);
+    parallel_for(pool, 0, tiles, [&](int t0, int t1, int) {
+        for (int t = t0; t < t1; ++t) {
+            const int ti0 = r.i0 + t * tile;
+            const int ti1 = std::min(r.i1, ti0 + tile);
+            const int groups = batched ? (ti1 - ti0) / kLanes : 0;
+            const int split = ti0 + groups * kLanes; // [split, ti1) uses the lane-count kernel
+            // Row r.j0 is row 0 of the recurrence
+            Real* re = psi.re.data() + static_cast<size_t>(r.j0) * Nx;
+            Real* im = psi.im.data() + static_cast<size_t>(r.j0) * Nx;
+            for (int j0 = 0; j0 < m; j0 += kRowChunk) {
+                const int j1 = std::min(m, j0 + kRowChunk);
+                for (int j = j0; j < j1; ++j) {
+                    const size_t o = static_cast<size_t>(j) * Nx + ti0;
+                    build_segment(r.j0 + j, ti0, ti1, re + o, im + o, 1);
+                }
+                if (groups > 0) solve_batched_forward(bf, j0, j1, re + ti0, im + ti0, stride, groups, simd);
+                if (split < ti1) solve_lanes_forward(bf, j0, j1, re + split, im + split, stride, ti1 - split);
+            }
+            if (groups > 0) solve_batched_backward(bf, re + ti0, im + ti0, stride, groups, simd);
+            if (split < ti1) solve_lanes_backward(bf, re + split, im + split, stride, ti1 - split);
         }
-        // Tridiagonal for y
-        for (int j = 0; j < Ny; ++j) {
-            ay_a[j] = (j == 0) ? cd(0.0, 0.0) : -ay;
-            ay_b[j] = cd(1.0, 0.0) + cd(2.0, 0.0) * ay;
-            ay_c[j] = (j == Ny - 1) ? cd(0.0, 0.0) : -ay;
-        }
-        solve_tridiagonal(ay_a, ay_b, ay_c, rhs);
-        for (int j = 0; j < Ny; ++j) {
-            psi[idx(i, j, Nx)] = rhs[j];
+    });
+}
+
+template <typename Real>
+void BasicCrankNicolsonADI<Real>::step(FieldT& psi,
+                            int Nx, int Ny, double dx, double dy, double dt,
+                            const Field& V, std::uint64_t vGeneration,
+                            ThreadPool* pool)
+{
+    step_n(psi, Nx, Ny, dx, dy, dt, V, vGeneration, 1, pool);
+}
+
+template <typename Real>
+void BasicCrankNicolsonADI<Real>::step_n(FieldT& psi,
+                              int Nx, int Ny, double dx, double dy, double dt,
+                              const Field& V, std::uint64_t vGeneration,
+                              int steps,
+                              ThreadPool* pool,
+                              MassReduction* reduce)
+{
+    if (steps <= 0) return;
+    S2D_PROFILE_SCOPE("CN-ADI step_n");
+    ensure_workspace(Nx, Ny, pool ? pool->size() : 1);
+    ensure_factors(dx, dy, dt);
+    const GridRect r = step_rect();
+    const GridRect* rect = windowed ? &r : nullptr;
+    if (windowed) {
+        if (r.empty()) {
+            // Nothing to step: psi is zero throughout
+            if (reduce) {
+                reduce->prepare(Ny);
+                reduce->finish();
+            }
+            return;
         }
+        ensure_window_factors();
     }
+    kicks.ensure(V, Nx, Ny, vGeneration, dt, pool);
 
-    // Potential half-step again
-    for (int j = 0; j < Ny; ++j) {
-        for (int i = 0; i < Nx; ++i) {
-            const int k = idx(i, j, Nx);
-            psi[k] *= std::exp(-I * V[k] * half_dt);
-        }
+    // Potential half-step: psi <- exp(-i V dt/2) psi
+    kicks.apply(psi, kicks.half, pool, nullptr, rect);
+    for (int n = 0; n < steps; ++n) {
+        // ADI for kinetic term (CN)
+        // 1) Solve along x: (I - alpha D_x) phi = (I + alpha D_y) psi
+        sweep_x(psi, pool);
+        // 2) Solve along y: (I - alpha D_y) psi_new = (I + alpha D_x) phi
+        sweep_y(psi, pool);
+
+        // Potential half-step again, merged with the next step's leading half;
+        // the last one also feeds the diagnostics reduction
+        const bool last = n + 1 == steps;
+        kicks.apply(psi, last ? kicks.half : kicks.full, pool, last ? reduce : nullptr, rect);
     }
 }
 
+template struct BasicCrankNicolsonADI<double>;
+template struct BasicCrankNicolsonADI<float>;
+
 } // namespace sim
@@ -1,34 +1,140 @@
 #pragma once
 
 #include <complex>
+#include <cstdint>
 #include <vector>
 
+#include "batched_thomas.hpp"
+#include "field.hpp"
+#include "propagator.hpp"
+#include "thread_pool.hpp"
+#include "tridiag.hpp"
+
 namespace sim {
 
 // Crank–Nicolson ADI solver for i dpsi/dt = -(1/2) Laplacian(psi) + V psi
 // Potential is allowed to be complex (for absorbing boundary sponge).
-struct CrankNicolsonADI {
-    using cd = std::complex<double>;
+// Real is the storage and arithmetic precision of psi and of the line solves
+// (double or float); V, the factorization and the propagators are computed in
+// double and rounded to Real once.
+template <typename Real>
+struct BasicCrankNicolsonADI : BasicPropagator<Real> {
+    using cd = std::complex<Real>;
+    using FieldT = ComplexField<Real>;
+    static constexpr int kLanes = kBatchLanesFor<Real>;
+
+    // How the second (y) half-step walks memory.
+    //  Columns: one column at a time through a line buffer (stride-Nx access).
+    //  Tiled:   tileWidth adjacent columns advance through the recurrence together,
+    //           in place in psi, so every access touches a contiguous run of each row.
+    enum class YSweep { Columns, Tiled };
+
+    // Line solver used by the x-sweep and the tiled y-sweep.
+    //  Scalar:  one line at a time (solve_factored / solve_lanes).
+    //  Batched: kLanes lines in lockstep on split real/imag lanes
+    //           (solve_batched), dispatched on `simd`.
+    enum class LineKernel { Scalar, Batched };
+
+    // Discretization of each one-dimensional second derivative.
+    //  Standard: three-point delta^2 / h^2, second order.
+    //  Compact:  fourth-order compact (Numerov) B^-1 delta^2 / h^2 with
+    //            B = tridiag(1, 10, 1) / 12. Multiplying the CN step through by
+    //            Bx By gives the D'Yakonov form
+    //              (Bx - ax delta_x^2) phi = (Bx + ax delta_x^2)(By + ay delta_y^2) psi
+    //              (By - ay delta_y^2) psi_new = phi
+    //            so both sweeps stay tridiagonal; the x-sweep's right-hand side
+    //            becomes a nine-point stencil and the y-sweep's is phi itself.
+    enum class Stencil { Standard, Compact };
+
+    // Scratch for one tridiagonal line; one per worker thread.
+    struct LineWorkspace {
+        std::vector<cd> d;   // x-sweep line (length Nx)
+        std::vector<cd> rhs; // y-sweep line (length Ny)
+        AlignedVector<Real> bre; // x-sweep batch lanes, kLanes * Nx
+        AlignedVector<Real> bim;
+    };
+
+    YSweep ySweep{YSweep::Tiled};
+    int tileWidth{64}; // columns per y tile
+    LineKernel lineKernel{LineKernel::Batched};
+    Stencil stencil{Stencil::Standard};
+    SimdLevel simd{detect_simd_level()};
 
     int cachedNx{0};
     int cachedNy{0};
-    std::vector<cd> phi;
-    std::vector<cd> a;
-    std::vector<cd> b;
-    std::vector<cd> c;
-    std::vector<cd> d;
-    std::vector<cd> ay_a;
-    std::vector<cd> ay_b;
-    std::vector<cd> ay_c;
-    std::vector<cd> rhs;
-
-    void ensure_workspace(int Nx, int Ny);
+    FieldT phi;
+    AlignedVector<Real> zeroRow; // Dirichlet neighbour outside the grid
+    std::vector<LineWorkspace> lines;
+
+    // Factorized (I - alpha D_x) and (I - alpha D_y) operators (Bx - ax delta_x^2
+    // and By - ay delta_y^2 when Compact) and the explicit halves opx, opy,
+    // valid for (cachedNx, cachedNy, factorDx, factorDy, factorDt, factorStencil).
+    bool factorsValid{false};
+    double factorDx{0.0};
+    double factorDy{0.0};
+    double factorDt{0.0};
+    Stencil factorStencil{Stencil::Standard};
+    BasicTridiagFactor<Real> fx;
+    BasicTridiagFactor<Real> fy;
+    BasicBatchedFactor<Real> bfx;
+    BasicBatchedFactor<Real> bfy;
+    ExplicitOp<Real> opx{};
+    ExplicitOp<Real> opy{};
+
+    // Cropped stepping: with windowed, step_n() only steps the cells of window
+    // and psi must be zero outside it (it stays zero; the window edges act as
+    // Dirichlet walls). An empty window leaves psi alone.
+    bool windowed{false};
+    GridRect window;
+    // Factors for the window's width and height: the leading blocks of fx/fy
+    // (see BasicTridiagFactor::prefix), valid after ensure_window_factors().
+    BasicTridiagFactor<Real> wfx;
+    BasicTridiagFactor<Real> wfy;
+    BasicBatchedFactor<Real> wbfx;
+    BasicBatchedFactor<Real> wbfy;
+
+    PotentialKicks<Real> kicks; // exp(-i V dt/2), exp(-i V dt)
+
+    const char* name() const override { return "CN-ADI"; }
+
+    // Resizing the workspace also invalidates the cached factorization.
+    void ensure_workspace(int Nx, int Ny, int threads = 1);
+    void ensure_factors(double dx, double dy, double dt);
+    void ensure_window_factors();
+    // Cells the sweeps cover: window (clipped to the grid) or the whole grid
+    GridRect step_rect() const;
 
     // One time step in-place. psi and V are length Nx*Ny row-major.
-    // dx, dy: grid spacing; dt: time step.
-    void step(std::vector<std::complex<double>>& psi,
+    // dx, dy: grid spacing; dt: time step; vGeneration identifies the contents of V.
+    // Lines of each sweep are distributed over pool (serial when null); every
+    // line is solved independently, so the result does not depend on the pool size.
+    void step(FieldT& psi,
               int Nx, int Ny, double dx, double dy, double dt,
-              const std::vector<std::complex<double>>& V);
+              const Field& V, std::uint64_t vGeneration,
+              ThreadPool* pool = nullptr);
+
+    // `steps` consecutive time steps. The trailing half-kick of each step and the
+    // leading half-kick of the next are applied as one full kick exp(-i V dt),
+    // so psi is only a valid time-step state again on return.
+    void step_n(FieldT& psi,
+                int Nx, int Ny, double dx, double dy, double dt,
+                const Field& V, std::uint64_t vGeneration,
+                int steps,
+                ThreadPool* pool = nullptr,
+                MassReduction* reduce = nullptr) override;
+
+    // Stages of step(), exposed for benchmarking. The sweeps require
+    // ensure_workspace() and ensure_factors() to have been called, and
+    // ensure_window_factors() when windowed.
+    void sweep_x(const FieldT& psi, ThreadPool* pool); // psi -> phi
+    void sweep_y(FieldT& psi, ThreadPool* pool);       // phi -> psi
 };
 
+// Defined in solver.cpp for these two precisions.
+extern template struct BasicCrankNicolsonADI<double>;
+extern template struct BasicCrankNicolsonADI<float>;
+
+using CrankNicolsonADI = BasicCrankNicolsonADI<double>;
+using CrankNicolsonADIf = BasicCrankNicolsonADI<float>;
+
 } // namespace sim
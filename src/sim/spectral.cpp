@@ -0,0 +1,126 @@
+#include "spectral.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sim {
+
+namespace {
+
+using cd = std::complex<double>;
+
+// Points per tile when every mode is streamed into one tile of the output
+constexpr int kTile = 1024;
+
+int pool_size(ThreadPool* pool) {
+    return pool ? pool->size() : 1;
+}
+
+} // namespace
+
+void SpectralEvolution::clear() {
+    modes.clear();
+    energies.clear();
+    coeff.clear();
+    residual = 0.0;
+}
+
+double SpectralEvolution::project(const Field& psi, const std::vector<EigenState>& states, int nx, int ny,
+                                  double dx, double dy, ThreadPool* pool, Workspace* workspace) {
+    clear();
+    Nx = nx;
+    Ny = ny;
+    cell = dx * dy;
+    const std::size_t n = static_cast<std::size_t>(nx) * static_cast<std::size_t>(ny);
+    if (psi.size() != n) return residual;
+    for (const EigenState& s : states) {
+        if (s.psi.size() != n) continue;
+        modes.emplace_back();
+        modes.back().assign_from(s.psi);
+        energies.push_back(s.energy);
+    }
+    const int M = static_cast<int>(modes.size());
+    if (M == 0) return residual = 1.0;
+
+    // c_n = sum conj(phi_n) psi dx dy, row partials per worker
+    const int W = pool_size(pool);
+    std::vector<cd> partial(static_cast<std::size_t>(W) * M, cd(0.0, 0.0));
+    parallel_for(pool, 0, ny, [&](int j0, int j1, int worker) {
+        const std::size_t b = static_cast<std::size_t>(j0) * nx;
+        const std::size_t e = static_cast<std::size_t>(j1) * nx;
+        cd* acc = partial.data() + static_cast<std::size_t>(worker) * M;
+        for (int m = 0; m < M; ++m) {
+            const double* pr = modes[m].re.data();
+            const double* pi = modes[m].im.data();
+            double sr = 0.0, si = 0.0;
+            for (std::size_t k = b; k < e; ++k) {
+                sr += pr[k] * psi.re[k] + pi[k] * psi.im[k];
+                si += pr[k] * psi.im[k] - pi[k] * psi.re[k];
+            }
+            acc[m] += cd(sr, si);
+        }
+    });
+    coeff.assign(M, cd(0.0, 0.0));
+    for (int w = 0; w < W; ++w) {
+        for (int m = 0; m < M; ++m) coeff[m] += partial[static_cast<std::size_t>(w) * M + m] * cell;
+    }
+
+    // Part of psi outside the basis, measured directly so non-orthogonal modes show up too
+    Field local;
+    Field& fit = workspace ? workspace->field(Scratch::SpectralFit, psi.size()) : local;
+    evaluate(0.0, fit, pool);
+    std::vector<double> rowOut(ny, 0.0), rowIn(ny, 0.0);
+    parallel_for(pool, 0, ny, [&](int j0, int j1, int) {
+        for (int j = j0; j < j1; ++j) {
+            double out = 0.0, in = 0.0;
+            for (std::size_t k = static_cast<std::size_t>(j) * nx, e = k + nx; k < e; ++k) {
+                const double r = psi.re[k] - fit.re[k];
+                const double i = psi.im[k] - fit.im[k];
+                out += r * r + i * i;
+                in += psi.re[k] * psi.re[k] + psi.im[k] * psi.im[k];
+            }
+            rowOut[j] = out;
+            rowIn[j] = in;
+        }
+    });
+    double out = 0.0, in = 0.0;
+    for (int j = 0; j < ny; ++j) {
+        out += rowOut[j];
+        in += rowIn[j];
+    }
+    residual = in > 0.0 ? std::sqrt(out / in) : 0.0;
+    return residual;
+}
+
+void SpectralEvolution::evaluate(double t, Field& out, ThreadPool* pool) const {
+    const std::size_t n = static_cast<std::size_t>(Nx) * static_cast<std::size_t>(Ny);
+    if (out.size() != n) out.assign(n);
+    const int M = static_cast<int>(coeff.size());
+    std::vector<double> a(M), b(M);
+    for (int m = 0; m < M; ++m) {
+        const cd c = coeff[m] * std::polar(1.0, -energies[m] * t);
+        a[m] = c.real();
+        b[m] = c.imag();
+    }
+    parallel_for(pool, 0, Ny, [&](int j0, int j1, int) {
+        const std::size_t end = static_cast<std::size_t>(j1) * Nx;
+        for (std::size_t t0 = static_cast<std::size_t>(j0) * Nx; t0 < end; t0 += kTile) {
+            const std::size_t t1 = std::min(end, t0 + kTile);
+            double* __restrict ore = out.re.data();
+            double* __restrict oim = out.im.data();
+            std::fill(ore + t0, ore + t1, 0.0);
+            std::fill(oim + t0, oim + t1, 0.0);
+            for (int m = 0; m < M; ++m) {
+                const double* __restrict pr = modes[m].re.data();
+                const double* __restrict pi = modes[m].im.data();
+                const double am = a[m], bm = b[m];
+                for (std::size_t k = t0; k < t1; ++k) {
+                    ore[k] += am * pr[k] - bm * pi[k];
+                    oim[k] += am * pi[k] + bm * pr[k];
+                }
+            }
+        }
+    });
+}
+
+} // namespace sim
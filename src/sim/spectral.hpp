@@ -0,0 +1,39 @@
+// Time evolution by projection onto computed eigenmodes
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "eigensolver.hpp"
+#include "field.hpp"
+#include "thread_pool.hpp"
+#include "workspace.hpp"
+
+namespace sim {
+
+// psi(t) = sum_n c_n exp(-i E_n t) phi_n, with c_n = <phi_n | psi(0)>.
+// Exact for the part of psi inside the basis (modes of H with Re V, so the
+// CAP does not absorb), at O(modes N) per evaluation for any t.
+struct SpectralEvolution {
+    std::vector<Field> modes;      // phi_n, unit norm in sum |phi|^2 dx dy
+    std::vector<double> energies;  // E_n
+    std::vector<std::complex<double>> coeff; // c_n at t = 0
+    double residual{0.0};          // |psi - sum c_n phi_n| / |psi| at projection
+    double cell{1.0};              // dx dy
+    int Nx{0}, Ny{0};
+    std::uint64_t potentialGeneration{0}; // V the modes belong to
+
+    bool empty() const { return coeff.empty(); }
+    void clear();
+
+    // Takes the modes and projects psi onto them; returns residual.
+    // Modes of another grid size are skipped. The check of the fit uses
+    // workspace's SpectralFit slot when given.
+    double project(const Field& psi, const std::vector<EigenState>& states, int nx, int ny, double dx, double dy,
+                   ThreadPool* pool, Workspace* workspace = nullptr);
+    // out = psi(t), t measured from the projection
+    void evaluate(double t, Field& out, ThreadPool* pool) const;
+};
+
+} // namespace sim
@@ -0,0 +1,253 @@
+#include "split_step.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.hpp"
+
+#if S2D_HAVE_FFTW
+#include <fftw3.h>
+#include <mutex>
+#endif
+
+namespace sim {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846264338327950;
+
+#if S2D_HAVE_FFTW
+// FFTW's planner is not thread-safe, and the eigensolver plans on its own thread
+std::mutex& fftw_planner_mutex() {
+    static std::mutex m;
+    return m;
+}
+#endif
+
+// Plain complex product (no C Annex G NaN recovery branch)
+inline std::complex<double> mul(std::complex<double> a, std::complex<double> b) {
+    return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+// x *= (pr + i pi) on split components
+inline void apply_phase(double* re, double* im, const double* pr, const double* pi, int n) {
+    for (int m = 0; m < n; ++m) {
+        const double xr = re[m];
+        const double xi = im[m];
+        re[m] = xr * pr[m] - xi * pi[m];
+        im[m] = xr * pi[m] + xi * pr[m];
+    }
+}
+
+} // namespace
+
+void SplitStepFourier::SineTransform::init(int size) {
+    n = std::max(0, size);
+#if S2D_HAVE_FFTW
+    auto plan = [this](fftw_r2r_kind kind) {
+        std::vector<double> probe(static_cast<size_t>(std::max(1, n)));
+        std::lock_guard<std::mutex> lock(fftw_planner_mutex());
+        fftw_plan p = fftw_plan_r2r_1d(n, probe.data(), probe.data(), kind, FFTW_MEASURE | FFTW_UNALIGNED);
+        return std::shared_ptr<void>(p, [](void* q) {
+            std::lock_guard<std::mutex> destroyLock(fftw_planner_mutex());
+            fftw_destroy_plan(static_cast<fftw_plan>(q));
+        });
+    };
+    fftwForward = plan(FFTW_RODFT10); // the old plan is released after the lock is dropped
+    fftwInverse = plan(FFTW_RODFT01);
+#else
+    fft.init(2 * n);
+    twistForward.resize(static_cast<size_t>(n));
+    twistInverse.resize(static_cast<size_t>(n) + 1);
+    for (int m = 0; m < n; ++m) {
+        twistForward[m] = cd(0.0, 1.0) * std::polar(1.0, -kPi * (m + 1) / (2.0 * n));
+    }
+    for (int k = 0; k <= n; ++k) {
+        twistInverse[k] = std::polar(1.0, kPi * k / (2.0 * n));
+    }
+#endif
+}
+
+size_t SplitStepFourier::SineTransform::scratch_size() const {
+#if S2D_HAVE_FFTW
+    return 0;
+#else
+    return static_cast<size_t>(fft.n) + fft.scratch_size();
+#endif
+}
+
+void SplitStepFourier::SineTransform::forward(double* re, double* im, cd* scratch) const {
+    if (n == 0) return;
+#if S2D_HAVE_FFTW
+    (void)scratch;
+    fftw_plan plan = static_cast<fftw_plan>(fftwForward.get());
+    fftw_execute_r2r(plan, re, re);
+    fftw_execute_r2r(plan, im, im);
+#else
+    // Odd extension about the half-sample: y = [x, -reverse(x)];
+    // FFT(y)[m + 1] = -i exp(i pi (m + 1) / (2n)) X_m.
+    const int len = fft.n;
+    cd* y = scratch;
+    for (int j = 0; j < n; ++j) {
+        y[j] = cd(re[j], im[j]);
+        y[len - 1 - j] = cd(-re[j], -im[j]);
+    }
+    fft.forward(y, scratch + len);
+    for (int m = 0; m < n; ++m) {
+        const cd X = mul(twistForward[m], y[m + 1]);
+        re[m] = X.real();
+        im[m] = X.imag();
+    }
+#endif
+}
+
+void SplitStepFourier::SineTransform::inverse(double* re, double* im, cd* scratch) const {
+    if (n == 0) return;
+#if S2D_HAVE_FFTW
+    (void)scratch;
+    fftw_plan plan = static_cast<fftw_plan>(fftwInverse.get());
+    fftw_execute_r2r(plan, re, re);
+    fftw_execute_r2r(plan, im, im);
+#else
+    // x_j = -i sum_k c_k exp(2 pi i k j / 2n) with c_k = X_{k-1} exp(i pi k / 2n)
+    // and c_{2n-k} = -X_{k-1} exp(-i pi k / 2n); evaluated as -i conj(FFT(conj(c))).
+    const int len = fft.n;
+    cd* c = scratch;
+    c[0] = cd(0.0, 0.0);
+    for (int k = 1; k <= n; ++k) {
+        const cd X(re[k - 1], im[k - 1]);
+        c[k] = std::conj(mul(X, twistInverse[k]));
+        if (k < n) c[len - k] = -std::conj(mul(X, std::conj(twistInverse[k])));
+    }
+    fft.forward(c, scratch + len);
+    for (int j = 0; j < n; ++j) {
+        re[j] = -c[j].imag();
+        im[j] = -c[j].real();
+    }
+#endif
+}
+
+void SplitStepFourier::ensure_plans(int Nx, int Ny, int threads) {
+    threads = std::max(1, threads);
+    if (cachedNx != Nx || cachedNy != Ny) {
+        cachedNx = Nx;
+        cachedNy = Ny;
+        phasesValid = false;
+        dstX.init(Nx);
+        dstY.init(Ny);
+        lines.clear();
+    }
+    if (static_cast<int>(lines.size()) < threads) {
+        lines.resize(static_cast<size_t>(threads));
+    }
+    const size_t scratch = std::max(dstX.scratch_size(), dstY.scratch_size());
+    const size_t block = static_cast<size_t>(kColumnBlock) * Ny;
+    for (auto& ws : lines) {
+        if (ws.scratch.size() != scratch) ws.scratch.assign(scratch, cd(0.0, 0.0));
+        if (ws.colRe.size() != block) {
+            ws.colRe.assign(block, 0.0);
+            ws.colIm.assign(block, 0.0);
+        }
+    }
+}
+
+void SplitStepFourier::ensure_phases(double dx, double dy, double dt) {
+    if (phasesValid && phaseDx == dx && phaseDy == dy && phaseDt == dt) {
+        return;
+    }
+    // Mode m of a line of n cells with walls on its outer edges has
+    // k = pi (m + 1) / (n h) and kinetic energy k^2 / 2.
+    auto build = [dt](int n, double h, std::vector<double>& pr, std::vector<double>& pi) {
+        pr.resize(static_cast<size_t>(n));
+        pi.resize(static_cast<size_t>(n));
+        const double norm = 1.0 / (2.0 * n);
+        for (int m = 0; m < n; ++m) {
+            const double k = kPi * (m + 1) / (n * h);
+            const double phase = -0.5 * k * k * dt;
+            pr[m] = norm * std::cos(phase);
+            pi[m] = norm * std::sin(phase);
+        }
+    };
+    build(cachedNx, dx, phaseXr, phaseXi);
+    build(cachedNy, dy, phaseYr, phaseYi);
+    phaseDx = dx;
+    phaseDy = dy;
+    phaseDt = dt;
+    phasesValid = true;
+}
+
+void SplitStepFourier::kinetic_x(Field& psi, ThreadPool* pool) {
+    S2D_PROFILE_SCOPE("FFT kinetic x");
+    const int Nx = cachedNx;
+    parallel_for(pool, 0, cachedNy, [&](int j0, int j1, int worker) {
+        cd* scratch = lines[static_cast<size_t>(worker)].scratch.data();
+        for (int j = j0; j < j1; ++j) {
+            double* re = psi.re.data() + static_cast<size_t>(j) * Nx;
+            double* im = psi.im.data() + static_cast<size_t>(j) * Nx;
+            dstX.forward(re, im, scratch);
+            apply_phase(re, im, phaseXr.data(), phaseXi.data(), Nx);
+            dstX.inverse(re, im, scratch);
+        }
+    });
+}
+
+void SplitStepFourier::kinetic_y(Field& psi, ThreadPool* pool) {
+    S2D_PROFILE_SCOPE("FFT kinetic y");
+    const int Nx = cachedNx;
+    const int Ny = cachedNy;
+    constexpr int B = kColumnBlock;
+    const int blocks = (Nx + B - 1) / B;
+    parallel_for(pool, 0, blocks, [&](int b0, int b1, int worker) {
+        LineWorkspace& ws = lines[static_cast<size_t>(worker)];
+        for (int b = b0; b < b1; ++b) {
+            const int i0 = b * B;
+            const int cols = std::min(B, Nx - i0);
+            // Gather cols columns (one contiguous run per row), transform each as a line.
+            for (int j = 0; j < Ny; ++j) {
+                const size_t row = static_cast<size_t>(j) * Nx + i0;
+                for (int l = 0; l < cols; ++l) {
+                    ws.colRe[static_cast<size_t>(l) * Ny + j] = psi.re[row + l];
+                    ws.colIm[static_cast<size_t>(l) * Ny + j] = psi.im[row + l];
+                }
+            }
+            for (int l = 0; l < cols; ++l) {
+                double* re = ws.colRe.data() + static_cast<size_t>(l) * Ny;
+                double* im = ws.colIm.data() + static_cast<size_t>(l) * Ny;
+                dstY.forward(re, im, ws.scratch.data());
+                apply_phase(re, im, phaseYr.data(), phaseYi.data(), Ny);
+                dstY.inverse(re, im, ws.scratch.data());
+            }
+            for (int j = 0; j < Ny; ++j) {
+                const size_t row = static_cast<size_t>(j) * Nx + i0;
+                for (int l = 0; l < cols; ++l) {
+                    psi.re[row + l] = ws.colRe[static_cast<size_t>(l) * Ny + j];
+                    psi.im[row + l] = ws.colIm[static_cast<size_t>(l) * Ny + j];
+                }
+            }
+        }
+    });
+}
+
+void SplitStepFourier::step_n(Field& psi,
+                              int Nx, int Ny, double dx, double dy, double dt,
+                              const Field& V, std::uint64_t vGeneration,
+                              int steps,
+                              ThreadPool* pool,
+                              MassReduction* reduce)
+{
+    if (steps <= 0) return;
+    ensure_plans(Nx, Ny, pool ? pool->size() : 1);
+    ensure_phases(dx, dy, dt);
+    kicks.ensure(V, Nx, Ny, vGeneration, dt, pool);
+
+    // Strang splitting; consecutive half-kicks are merged as in CrankNicolsonADI::step_n.
+    kicks.apply(psi, kicks.half, pool);
+    for (int n = 0; n < steps; ++n) {
+        kinetic_x(psi, pool);
+        kinetic_y(psi, pool);
+        const bool last = n + 1 == steps;
+        kicks.apply(psi, last ? kicks.half : kicks.full, pool, last ? reduce : nullptr);
+    }
+}
+
+} // namespace sim
@@ -0,0 +1,98 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+#include "profiler.hpp"
+
+namespace sim {
+
+ThreadPool::ThreadPool(int threads) {
+    resize(threads);
+}
+
+ThreadPool::~ThreadPool() {
+    stop_workers();
+}
+
+int ThreadPool::hardware_threads() {
+    const unsigned n = std::thread::hardware_concurrency();
+    return n > 0 ? static_cast<int>(n) : 1;
+}
+
+void ThreadPool::stop_workers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) t.join();
+    workers_.clear();
+    stop_ = false;
+}
+
+void ThreadPool::resize(int threads) {
+    if (threads <= 0) threads = hardware_threads();
+    if (threads == size()) return;
+    stop_workers();
+    // New workers start at the current generation, so they wait for the next
+    // job instead of rerunning the last one (whose job_ has been cleared)
+    unsigned generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation = generation_;
+    }
+    workers_.reserve(static_cast<size_t>(threads - 1));
+    for (int w = 1; w < threads; ++w) {
+        workers_.emplace_back([this, w, generation] { worker_loop(w, generation); });
+    }
+}
+
+void ThreadPool::run_chunk(int worker) {
+    const long long n = static_cast<long long>(jobEnd_) - jobBegin_;
+    const int parts = size();
+    const int b = jobBegin_ + static_cast<int>(n * worker / parts);
+    const int e = jobBegin_ + static_cast<int>(n * (worker + 1) / parts);
+    if (e > b) (*job_)(b, e, worker);
+}
+
+void ThreadPool::worker_loop(int worker, unsigned seen) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+        }
+        {
+            S2D_PROFILE_SCOPE("pool worker");
+            run_chunk(worker);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) done_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallel_for(int begin, int end, const RangeFn& fn) {
+    if (end <= begin) return;
+    if (workers_.empty()) {
+        fn(begin, end, 0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &fn;
+        jobBegin_ = begin;
+        jobEnd_ = end;
+        pending_ = static_cast<int>(workers_.size());
+        ++generation_;
+    }
+    wake_.notify_all();
+    run_chunk(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return pending_ == 0; });
+    job_ = nullptr;
+}
+
+} // namespace sim
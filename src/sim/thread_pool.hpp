@@ -0,0 +1,82 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace sim {
+
+// Non-owning reference to a callable fn(begin, end, worker). Unlike
+// std::function it never allocates, so a parallel loop costs no heap traffic
+// however much its lambda captures. The callable must outlive the call.
+class RangeRef {
+public:
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, RangeRef>>>
+    RangeRef(F&& fn) noexcept // NOLINT: implicit, like std::function
+        : object_(const_cast<void*>(static_cast<const void*>(&fn))),
+          call_([](void* object, int begin, int end, int worker) {
+              (*static_cast<std::remove_reference_t<F>*>(object))(begin, end, worker);
+          }) {}
+
+    void operator()(int begin, int end, int worker) const { call_(object_, begin, end, worker); }
+
+private:
+    void* object_;
+    void (*call_)(void*, int, int, int);
+};
+
+// Persistent worker pool for data-parallel loops over grid lines.
+// The calling thread takes part as worker 0. A range is always split into
+// size() contiguous chunks, so for a fixed thread count every worker sees the
+// same partition from call to call (results are reproducible run to run).
+class ThreadPool {
+public:
+    using RangeFn = RangeRef;
+
+    explicit ThreadPool(int threads = 1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // threads <= 0 selects hardware_threads()
+    void resize(int threads);
+    int size() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Runs fn(chunkBegin, chunkEnd, worker) for every non-empty chunk of [begin, end)
+    // and returns once all chunks have finished.
+    void parallel_for(int begin, int end, const RangeFn& fn);
+
+    static int hardware_threads();
+
+private:
+    void stop_workers();
+    void worker_loop(int worker, unsigned seen);
+    void run_chunk(int worker);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const RangeFn* job_{nullptr};
+    int jobBegin_{0};
+    int jobEnd_{0};
+    unsigned generation_{0};
+    int pending_{0};
+    bool stop_{false};
+};
+
+// Serial fallback when no pool is attached.
+inline void parallel_for(ThreadPool* pool, int begin, int end, const ThreadPool::RangeFn& fn) {
+    if (end <= begin) return;
+    if (!pool || pool->size() <= 1) {
+        fn(begin, end, 0);
+        return;
+    }
+    pool->parallel_for(begin, end, fn);
+}
+
+} // namespace sim
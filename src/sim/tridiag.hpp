@@ -1,6 +1,7 @@
 // Simple complex tridiagonal solver (Thomas algorithm)
 #pragma once
 
+#include <algorithm>
 #include <complex>
 #include <vector>
 
@@ -10,15 +11,16 @@ namespace sim {
 // a[0] is unused (0), c[N-1] is unused (0)
 // b is main diagonal, a is sub-diagonal, c is super-diagonal
 // All vectors length N. d is overwritten with the solution x.
+template <typename Real>
 inline void solve_tridiagonal(
-    std::vector<std::complex<double>>& a,
-    std::vector<std::complex<double>>& b,
-    std::vector<std::complex<double>>& c,
-    std::vector<std::complex<double>>& d)
+    std::vector<std::complex<Real>>& a,
+    std::vector<std::complex<Real>>& b,
+    std::vector<std::complex<Real>>& c,
+    std::vector<std::complex<Real>>& d)
 {
     const int n = static_cast<int>(b.size());
     for (int i = 1; i < n; ++i) {
-        std::complex<double> w = a[i] / b[i - 1];
+        std::complex<Real> w = a[i] / b[i - 1];
         b[i] = b[i] - w * c[i - 1];
         d[i] = d[i] - w * d[i - 1];
     }
@@ -28,5 +30,73 @@ inline void solve_tridiagonal(
     }
 }
 
-} // namespace sim
+// Thomas factors of a constant-coefficient tridiagonal matrix
+// (sub-diagonal `sub`, main diagonal `diag`, super-diagonal `sup`).
+// The elimination multipliers and reciprocal pivots only depend on the
+// coefficients, so they are computed once and reused for every line.
+// The factorization itself always runs in double and is rounded to Real on store.
+template <typename Real>
+struct BasicTridiagFactor {
+    int n{0};
+    std::complex<Real> sup{0, 0};
+    std::vector<std::complex<Real>> w;     // w[i] = sub / b'[i-1], w[0] unused
+    std::vector<std::complex<Real>> inv_b; // 1 / b'[i]
+
+    void factor(int size, std::complex<double> sub, std::complex<double> diag, std::complex<double> super) {
+        n = size;
+        sup = std::complex<Real>(super);
+        w.assign(static_cast<size_t>(n), std::complex<Real>(0, 0));
+        inv_b.assign(static_cast<size_t>(n), std::complex<Real>(0, 0));
+        if (n == 0) return;
+        std::complex<double> pivot = diag;
+        std::complex<double> inv = 1.0 / pivot;
+        inv_b[0] = std::complex<Real>(inv);
+        for (int i = 1; i < n; ++i) {
+            const std::complex<double> wi = sub * inv;
+            pivot = diag - wi * super;
+            inv = 1.0 / pivot;
+            w[i] = std::complex<Real>(wi);
+            inv_b[i] = std::complex<Real>(inv);
+        }
+    }
+
+    // Factors of the leading size x size block of f's matrix. Elimination
+    // only looks back, so they are f's first `size` entries, bit for bit.
+    void prefix(const BasicTridiagFactor& f, int size) {
+        n = std::min(size, f.n);
+        sup = f.sup;
+        w.assign(f.w.begin(), f.w.begin() + n);
+        inv_b.assign(f.inv_b.begin(), f.inv_b.begin() + n);
+    }
+};
+
+using TridiagFactor = BasicTridiagFactor<double>;
+
+// Solve-only kernel for a factorized system. d (length f.n) is overwritten with x.
+template <typename Real>
+inline void solve_factored(const BasicTridiagFactor<Real>& f, std::complex<Real>* d) {
+    const int n = f.n;
+    if (n == 0) return;
+    for (int i = 1; i < n; ++i) {
+        d[i] -= f.w[i] * d[i - 1];
+    }
+    d[n - 1] *= f.inv_b[n - 1];
+    for (int i = n - 2; i >= 0; --i) {
+        d[i] = (d[i] - f.sup * d[i + 1]) * f.inv_b[i];
+    }
+}
 
+// Explicit half-step c * z + a * s (s = sum of the two neighbours) on split
+// components. Same operation order as the std::complex expression, so the
+// scalar and batched paths round identically.
+template <typename Real>
+struct ExplicitOp {
+    Real cr, ci, ar, ai;
+
+    inline void apply(Real zr, Real zi, Real sr, Real si, Real& outR, Real& outI) const {
+        outR = (cr * zr - ci * zi) + (ar * sr - ai * si);
+        outI = (cr * zi + ci * zr) + (ar * si + ai * sr);
+    }
+};
+
+} // namespace sim
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+
+namespace sim {
+
+// Lock-free single-producer / single-consumer triple buffer.
+// The writer fills back() and publish()es it; the reader calls update() and
+// then reads front(). Neither side ever waits: the writer always has a buffer
+// of its own, and the reader always sees the most recently published value
+// (intermediate ones are skipped). Buffers are reused, so a T that keeps its
+// capacity (vectors) stays allocation-free once sized.
+template <class T>
+class TripleBuffer {
+public:
+    T& back() { return buffers_[back_]; }                  // writer only
+    const T& front() const { return buffers_[front_]; }    // reader only
+
+    // Writer: hands back() to the reader and takes the spare buffer.
+    void publish() {
+        back_ = state_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndex;
+    }
+
+    // Reader: swaps in the latest published buffer; false if nothing new.
+    bool update() {
+        if ((state_.load(std::memory_order_acquire) & kFresh) == 0) return false;
+        front_ = state_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+
+private:
+    static constexpr unsigned kIndex = 3u;
+    static constexpr unsigned kFresh = 4u;
+
+    T buffers_[3];
+    std::atomic<unsigned> state_{1}; // index of the spare buffer | kFresh
+    unsigned back_{0};
+    unsigned front_{2};
+};
+
+} // namespace sim
@@ -0,0 +1,27 @@
+#include "workspace.hpp"
+
+namespace sim {
+
+std::vector<double>& Workspace::doubles(Scratch slot, std::size_t n, int offset) {
+    std::vector<double>& v = doubles_[static_cast<std::size_t>(slot) + static_cast<std::size_t>(offset)];
+    if (n > v.capacity()) ++growths_;
+    v.assign(n, 0.0);
+    return v;
+}
+
+Field& Workspace::field(Scratch slot, std::size_t n) {
+    Field& f = fields_[static_cast<std::size_t>(slot)];
+    if (n > f.re.capacity()) ++growths_;
+    f.re.resize(n);
+    f.im.resize(n);
+    return f;
+}
+
+std::size_t Workspace::bytes() const {
+    std::size_t total = 0;
+    for (const auto& v : doubles_) total += v.capacity() * sizeof(double);
+    for (const auto& f : fields_) total += (f.re.capacity() + f.im.capacity()) * sizeof(double);
+    return total;
+}
+
+} // namespace sim
@@ -0,0 +1,48 @@
+// Grid-sized scratch buffers reused from call to call
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "field.hpp"
+
+namespace sim {
+
+// Named scratch slots. Each slot's buffer only ever grows, so repeated work on
+// the same grid never returns to the heap after its first call.
+enum class Scratch : int {
+    EigenBlock,     // LOBPCG blocks [X W P]
+    EigenImage,     // H applied to EigenBlock
+    EigenBasis,     // Lanczos basis
+    EigenVector,    // H x of one mode, guess loading
+    Minres,         // 7 MINRES vectors, consecutive slots from here
+    SpectralFit = Minres + 7, // sum c_n phi_n during projection
+    Count
+};
+
+// Copies start empty (assignment keeps the target's own buffers): scratch is
+// never state, and a Simulation snapshot should not drag it along.
+class Workspace {
+public:
+    Workspace() = default;
+    Workspace(const Workspace&) {}
+    Workspace& operator=(const Workspace&) { return *this; }
+    Workspace(Workspace&&) noexcept = default;
+    Workspace& operator=(Workspace&&) noexcept = default;
+
+    // Length n, zero-filled.
+    std::vector<double>& doubles(Scratch slot, std::size_t n, int offset = 0);
+    // Length n, contents unspecified.
+    Field& field(Scratch slot, std::size_t n);
+
+    std::size_t bytes() const; // capacity held across all slots
+    std::uint64_t growths() const { return growths_; } // calls that had to allocate
+
+private:
+    std::vector<std::vector<double>> doubles_ = std::vector<std::vector<double>>(static_cast<std::size_t>(Scratch::Count));
+    std::vector<Field> fields_ = std::vector<Field>(static_cast<std::size_t>(Scratch::Count));
+    std::uint64_t growths_{0};
+};
+
+} // namespace sim
@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <cmath>
 
+#include "sim/profiler.hpp"
+
 #if defined(_WIN32)
 #ifndef NOMINMAX
 #define NOMINMAX
@@ -30,92 +32,199 @@ void ensure_texture(GLuint& tex, int& texW, int& texH, int w, int h) {
     }
 }
 
-void render_field_to_rgba(const sim::Simulation& sim,
-                          std::vector<unsigned char>& outRGBA,
-                          bool showPotential,
-                          sim::ViewMode view,
-                          bool normalizeView) {
-    const int W = sim.Nx;
-    const int H = sim.Ny;
-    outRGBA.resize(static_cast<size_t>(W) * static_cast<size_t>(H) * 4);
-    double maxmag = 1.0;
-    if (normalizeView) {
-        double m = 1e-12;
-        for (const auto& z : sim.psi) {
-            m = std::max(m, static_cast<double>(std::abs(z)));
+namespace {
+
+constexpr int kHueBins = 4096; // power of two
+constexpr float kPi = 3.14159265358979323846f;
+
+// atan2 to about 1e-5 rad. The octant fix-ups are arithmetic rather than
+// branches: phases are random from pixel to pixel, so branches mispredict.
+inline float fast_atan2(float y, float x) {
+    const float ax = std::fabs(x);
+    const float ay = std::fabs(y);
+    const float mn = std::min(ax, ay);
+    const float mx = std::max(ax, ay);
+    const float a = mn / (mx + 1e-30f);
+    const float s = a * a;
+    float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+    const float steep = std::max(0.0f, std::copysign(1.0f, ay - ax)); // 1 where |y| >= |x|
+    r += steep * (0.5f * kPi - 2.0f * r);          // |y| > |x|: pi/2 - r
+    const float sx = std::copysign(1.0f, x);
+    r = (0.5f - 0.5f * sx) * kPi + sx * r;          // x < 0: pi - r
+    return std::copysign(r, y);
+}
+
+inline unsigned char to_byte(float v) {
+    return static_cast<unsigned char>(v * 255.0f + 0.5f);
+}
+
+// Per-row scratch for the two-pass hue views
+struct RowScratch {
+    float* value;
+    int* bin;
+};
+
+// Row colorizer for one view mode. The hue views first compute value and hue
+// bin for the whole row (pure arithmetic, vectorizes), then look colors up.
+template <sim::ViewMode View>
+void colorize_row(const double* __restrict re, const double* __restrict im, const float* __restrict addR,
+                  const float* __restrict addB, const float* __restrict hue, float invMax, bool normalizeView, int W,
+                  RowScratch scratch, unsigned char* __restrict out) {
+    constexpr bool kHue = View == sim::ViewMode::MagnitudePhase || View == sim::ViewMode::Phase;
+    if (kHue) {
+        // value holds v^2 here; the sqrt (which has an errno branch) waits for the second pass
+        const float hueScale = static_cast<float>(kHueBins) / (2.0f * kPi);
+        const float invMax2 = (View == sim::ViewMode::Phase && normalizeView) ? 0.0f : invMax * invMax;
+        const float floor2 = (View == sim::ViewMode::Phase && normalizeView) ? 1.0f : 0.0f;
+        float* __restrict value = scratch.value;
+        int* __restrict bin = scratch.bin;
+        for (int i = 0; i < W; ++i) {
+            const float zr = static_cast<float>(re[i]);
+            const float zi = static_cast<float>(im[i]);
+            value[i] = std::min(1.0f, (zr * zr + zi * zi) * invMax2 + floor2);
+            bin[i] = std::min(kHueBins - 1, static_cast<int>((fast_atan2(zi, zr) + kPi) * hueScale));
         }
-        maxmag = m;
     }
-    double maxVre = 0.0;
-    if (showPotential) {
-        for (int j = 0; j < H; ++j) {
-            for (int i = 0; i < W; ++i) {
-                maxVre = std::max(maxVre, std::abs(static_cast<double>(std::real(sim.V[sim.idx(i, j)]))));
+    for (int i = 0; i < W; ++i) {
+        float r, g, b;
+        if (kHue) {
+            // HSV with s = 1: RGB = v * hue(phase)
+            const float* h = hue + 3 * scratch.bin[i];
+            const float v = std::sqrt(scratch.value[i]);
+            r = v * h[0];
+            g = v * h[1];
+            b = v * h[2];
+        } else {
+            const float zr = static_cast<float>(re[i]);
+            const float zi = static_cast<float>(im[i]);
+            if (View == sim::ViewMode::Magnitude) {
+                r = g = b = std::min(1.0f, std::sqrt(zr * zr + zi * zi) * invMax);
+            } else {
+                const float c = View == sim::ViewMode::Real ? zr : zi;
+                r = g = b = std::clamp(0.5f + 0.5f * c * invMax, 0.0f, 1.0f);
             }
         }
+        if (addR) {
+            r = std::min(1.0f, r + addR[i]);
+            b = std::min(1.0f, b + addB[i]);
+        }
+        out[4 * i + 0] = to_byte(r);
+        out[4 * i + 1] = to_byte(g);
+        out[4 * i + 2] = to_byte(b);
+        out[4 * i + 3] = 255;
     }
+}
+
+using RowFn = void (*)(const double*, const double*, const float*, const float*, const float*, float, bool, int,
+                       RowScratch, unsigned char*);
+
+RowFn row_kernel(sim::ViewMode view) {
+    switch (view) {
+    case sim::ViewMode::Real: return colorize_row<sim::ViewMode::Real>;
+    case sim::ViewMode::Imag: return colorize_row<sim::ViewMode::Imag>;
+    case sim::ViewMode::Magnitude: return colorize_row<sim::ViewMode::Magnitude>;
+    case sim::ViewMode::Phase: return colorize_row<sim::ViewMode::Phase>;
+    case sim::ViewMode::MagnitudePhase: break;
+    }
+    return colorize_row<sim::ViewMode::MagnitudePhase>;
+}
+
+} // namespace
+
+FieldRenderer::FieldRenderer() : hue_(static_cast<size_t>(kHueBins) * 3) {
+    // Hue h = (phase + pi) / 2pi at the bin centre, HSV with s = v = 1
+    for (int k = 0; k < kHueBins; ++k) {
+        const float h = (static_cast<float>(k) + 0.5f) / static_cast<float>(kHueBins);
+        const float x = 1.0f - std::fabs(std::fmod(h * 6.0f, 2.0f) - 1.0f);
+        float rgb[3] = {0.0f, 0.0f, 0.0f};
+        switch (static_cast<int>(std::floor(h * 6.0f)) % 6) {
+        case 0: rgb[0] = 1; rgb[1] = x; break;
+        case 1: rgb[0] = x; rgb[1] = 1; break;
+        case 2: rgb[1] = 1; rgb[2] = x; break;
+        case 3: rgb[1] = x; rgb[2] = 1; break;
+        case 4: rgb[0] = x; rgb[2] = 1; break;
+        default: rgb[0] = 1; rgb[2] = x; break;
+        }
+        std::copy(rgb, rgb + 3, hue_.begin() + 3 * k);
+    }
+}
+
+void FieldRenderer::update_overlay(const sim::Simulation& sim) {
+    if (overlayValid_ && overlayGeneration_ == sim.potentialGeneration && overlayNx_ == sim.Nx && overlayNy_ == sim.Ny) {
+        return;
+    }
+    const size_t cells = static_cast<size_t>(sim.Nx) * static_cast<size_t>(sim.Ny);
+    const double* VRe = sim.V.re.data();
+    double maxVre = 0.0;
+    for (size_t k = 0; k < cells; ++k) maxVre = std::max(maxVre, std::fabs(VRe[k]));
     const double Vscale = (maxVre > 1e-12 ? 0.8 * maxVre : 20.0);
-    for (int j = 0; j < H; ++j) {
-        for (int i = 0; i < W; ++i) {
-            auto z = sim.psi[sim.idx(i, j)];
-            float r = 0.0f;
-            float g = 0.0f;
-            float b = 0.0f;
-            if (view == sim::ViewMode::Real) {
-                float v = static_cast<float>(0.5 + 0.5 * (std::real(z) / maxmag));
-                r = g = b = v;
-            } else if (view == sim::ViewMode::Imag) {
-                float v = static_cast<float>(0.5 + 0.5 * (std::imag(z) / maxmag));
-                r = g = b = v;
-            } else if (view == sim::ViewMode::Magnitude) {
-                float v = static_cast<float>(std::min(1.0, std::abs(z) / maxmag));
-                r = g = b = v;
-            } else {
-                const double PI = 3.14159265358979323846;
-                const double phase = std::atan2(std::imag(z), std::real(z));
-                float h = static_cast<float>((phase + PI) / (2.0 * PI));
-                float s = 1.0f;
-                float v = 1.0f;
-                if (view == sim::ViewMode::Phase) {
-                    v = normalizeView ? 1.0f : static_cast<float>(std::min(1.0, std::abs(z) / maxmag));
-                } else {
-                    v = static_cast<float>(std::min(1.0, std::abs(z) / maxmag));
-                }
-                float c = v * s;
-                float x = c * (1 - static_cast<float>(std::fabs(std::fmod(h * 6.0f, 2.0f) - 1)));
-                float m = v - c;
-                float rr = 0.0f;
-                float gg = 0.0f;
-                float bb = 0.0f;
-                int hi = static_cast<int>(std::floor(h * 6.0f)) % 6;
-                if (hi == 0)      { rr = c; gg = x; bb = 0; }
-                else if (hi == 1) { rr = x; gg = c; bb = 0; }
-                else if (hi == 2) { rr = 0; gg = c; bb = x; }
-                else if (hi == 3) { rr = 0; gg = x; bb = c; }
-                else if (hi == 4) { rr = x; gg = 0; bb = c; }
-                else              { rr = c; gg = 0; bb = x; }
-                r = rr + m;
-                g = gg + m;
-                b = bb + m;
-            }
+    overlayR_.resize(cells);
+    overlayB_.resize(cells);
+    for (size_t k = 0; k < cells; ++k) {
+        const float pv = static_cast<float>(std::clamp(VRe[k] / Vscale, -1.0, 1.0));
+        overlayR_[k] = std::max(0.0f, pv) * 0.3f;
+        overlayB_[k] = std::max(0.0f, -pv) * 0.3f;
+    }
+    overlayValid_ = true;
+    overlayGeneration_ = sim.potentialGeneration;
+    overlayNx_ = sim.Nx;
+    overlayNy_ = sim.Ny;
+}
+
+void FieldRenderer::render(const sim::Simulation& sim,
+                           std::vector<unsigned char>& outRGBA,
+                           bool showPotential,
+                           sim::ViewMode view,
+                           bool normalizeView) {
+    S2D_PROFILE_SCOPE("colorize");
+    const int W = sim.Nx;
+    const int H = sim.Ny;
+    const sim::heap::NoAllocScope guard(
+        "FieldRenderer::render",
+        steady_.arm(sim::heap::key({static_cast<std::uint64_t>(W), static_cast<std::uint64_t>(H),
+                                    static_cast<std::uint64_t>(sim.threads()), static_cast<std::uint64_t>(view),
+                                    showPotential, normalizeView,
+                                    static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(&outRGBA))})));
+    outRGBA.resize(static_cast<size_t>(W) * static_cast<size_t>(H) * 4);
+    const double* psiRe = sim.psi.re.data();
+    const double* psiIm = sim.psi.im.data();
+    sim::ThreadPool* pool = sim.pool.get();
 
-            if (showPotential) {
-                auto V = sim.V[sim.idx(i, j)];
-                float pv = static_cast<float>(std::clamp(std::real(V) / Vscale, -1.0, 1.0));
-                if (pv > 0) {
-                    r = std::min(1.0f, r + pv * 0.3f);
-                } else if (pv < 0) {
-                    b = std::min(1.0f, b + (-pv) * 0.3f);
-                }
+    double maxmag = 1.0;
+    if (normalizeView) {
+        rowMax_.assign(static_cast<size_t>(H), 0.0);
+        sim::parallel_for(pool, 0, H, [&](int j0, int j1, int) {
+            for (int j = j0; j < j1; ++j) {
+                const double* re = psiRe + static_cast<size_t>(j) * W;
+                const double* im = psiIm + static_cast<size_t>(j) * W;
+                double m2 = 0.0;
+                for (int i = 0; i < W; ++i) m2 = std::max(m2, re[i] * re[i] + im[i] * im[i]);
+                rowMax_[static_cast<size_t>(j)] = m2;
             }
+        });
+        double m2 = 1e-24;
+        for (double m : rowMax_) m2 = std::max(m2, m);
+        maxmag = std::sqrt(m2);
+    }
+    if (showPotential) update_overlay(sim);
 
-            const size_t k = static_cast<size_t>((j * W + i) * 4);
-            outRGBA[k + 0] = static_cast<unsigned char>(std::round(r * 255.0f));
-            outRGBA[k + 1] = static_cast<unsigned char>(std::round(g * 255.0f));
-            outRGBA[k + 2] = static_cast<unsigned char>(std::round(b * 255.0f));
-            outRGBA[k + 3] = 255;
+    const RowFn kernel = row_kernel(view);
+    const float invMax = static_cast<float>(1.0 / maxmag);
+    const float* hue = hue_.data();
+    unsigned char* out = outRGBA.data();
+    const size_t workers = static_cast<size_t>(pool ? pool->size() : 1);
+    scratchValue_.resize(workers * static_cast<size_t>(W));
+    scratchBin_.resize(workers * static_cast<size_t>(W));
+    sim::parallel_for(pool, 0, H, [&](int j0, int j1, int worker) {
+        const RowScratch scratch{scratchValue_.data() + static_cast<size_t>(worker) * W,
+                                 scratchBin_.data() + static_cast<size_t>(worker) * W};
+        for (int j = j0; j < j1; ++j) {
+            const size_t row = static_cast<size_t>(j) * W;
+            kernel(psiRe + row, psiIm + row, showPotential ? overlayR_.data() + row : nullptr,
+                   showPotential ? overlayB_.data() + row : nullptr, hue, invMax, normalizeView, W, scratch,
+                   out + 4 * row);
         }
-    }
+    });
 }
 
 } // namespace ui
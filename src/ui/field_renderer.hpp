@@ -2,8 +2,10 @@
 
 #if BUILD_GUI
 
+#include <cstdint>
 #include <vector>
 
+#include "sim/alloc_guard.hpp"
 #include "sim/simulation.hpp"
 
 namespace ui {
@@ -12,11 +14,37 @@ using GLuint = unsigned int;
 
 void ensure_texture(GLuint& tex, int& texW, int& texH, int w, int h);
 
-void render_field_to_rgba(const sim::Simulation& sim,
-                          std::vector<unsigned char>& outRGBA,
-                          bool showPotential,
-                          sim::ViewMode view,
-                          bool normalizeView);
+// Colorizes psi into RGBA8 for the view texture.
+// Phase colors come from a precomputed hue table, and the potential overlay
+// (with its max |Re V| scale) is cached until V changes (sim.potentialGeneration),
+// so a frame is one max pass (normalized views only) plus one branch-free
+// colorize pass. Both are split by rows across sim's thread pool. Once the
+// buffers are sized for a grid and view, a frame allocates nothing (asserted
+// in debug builds, see sim/alloc_guard.hpp).
+class FieldRenderer {
+public:
+    FieldRenderer();
+
+    void render(const sim::Simulation& sim,
+                std::vector<unsigned char>& outRGBA,
+                bool showPotential,
+                sim::ViewMode view,
+                bool normalizeView);
+
+private:
+    void update_overlay(const sim::Simulation& sim);
+
+    std::vector<float> hue_;     // kHueBins x RGB at full value, indexed by phase
+    std::vector<float> overlayR_; // red added where Re V > 0
+    std::vector<float> overlayB_; // blue added where Re V < 0
+    bool overlayValid_{false};
+    std::uint64_t overlayGeneration_{0};
+    int overlayNx_{0}, overlayNy_{0};
+    std::vector<double> rowMax_; // per-row max |psi|^2
+    std::vector<float> scratchValue_; // per-worker row of values (hue views)
+    std::vector<int> scratchBin_;     // per-worker row of hue bins
+    sim::heap::SteadyState steady_;
+};
 
 } // namespace ui
 
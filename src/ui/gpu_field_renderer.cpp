@@ -0,0 +1,377 @@
+#if BUILD_GUI
+
+#include "gpu_field_renderer.hpp"
+
+#include <imgui.h>
+
+#include <GLFW/glfw3.h>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "sim/profiler.hpp"
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+namespace ui {
+
+namespace {
+
+// GL 2.1 / ARB_texture_float tokens (GL/gl.h only guarantees 1.1)
+constexpr unsigned kGL_TEXTURE0 = 0x84C0;
+constexpr unsigned kGL_TEXTURE1 = 0x84C1;
+constexpr unsigned kGL_CLAMP_TO_EDGE = 0x812F;
+constexpr unsigned kGL_FRAGMENT_SHADER = 0x8B30;
+constexpr unsigned kGL_VERTEX_SHADER = 0x8B31;
+constexpr unsigned kGL_COMPILE_STATUS = 0x8B81;
+constexpr unsigned kGL_LINK_STATUS = 0x8B82;
+constexpr unsigned kGL_INFO_LOG_LENGTH = 0x8B84;
+constexpr unsigned kGL_PIXEL_UNPACK_BUFFER = 0x88EC;
+constexpr unsigned kGL_STREAM_DRAW = 0x88E0;
+constexpr unsigned kGL_WRITE_ONLY = 0x88B9;
+constexpr unsigned kGL_LUMINANCE32F = 0x8818;       // ARB_texture_float
+constexpr unsigned kGL_LUMINANCE_ALPHA32F = 0x8819; // ARB_texture_float
+
+// Entry points above GL 1.1, resolved through GLFW
+struct GlFunctions {
+    GLuint(APIENTRY* CreateShader)(GLenum);
+    void(APIENTRY* ShaderSource)(GLuint, GLsizei, const char* const*, const GLint*);
+    void(APIENTRY* CompileShader)(GLuint);
+    void(APIENTRY* GetShaderiv)(GLuint, GLenum, GLint*);
+    void(APIENTRY* GetShaderInfoLog)(GLuint, GLsizei, GLsizei*, char*);
+    void(APIENTRY* DeleteShader)(GLuint);
+    GLuint(APIENTRY* CreateProgram)();
+    void(APIENTRY* AttachShader)(GLuint, GLuint);
+    void(APIENTRY* LinkProgram)(GLuint);
+    void(APIENTRY* GetProgramiv)(GLuint, GLenum, GLint*);
+    void(APIENTRY* GetProgramInfoLog)(GLuint, GLsizei, GLsizei*, char*);
+    void(APIENTRY* DeleteProgram)(GLuint);
+    void(APIENTRY* UseProgram)(GLuint);
+    GLint(APIENTRY* GetUniformLocation)(GLuint, const char*);
+    void(APIENTRY* Uniform1i)(GLint, GLint);
+    void(APIENTRY* Uniform1f)(GLint, GLfloat);
+    void(APIENTRY* ActiveTexture)(GLenum);
+    void(APIENTRY* GenBuffers)(GLsizei, GLuint*);
+    void(APIENTRY* DeleteBuffers)(GLsizei, const GLuint*);
+    void(APIENTRY* BindBuffer)(GLenum, GLuint);
+    void(APIENTRY* BufferData)(GLenum, std::ptrdiff_t, const void*, GLenum);
+    void*(APIENTRY* MapBuffer)(GLenum, GLenum);
+    GLboolean(APIENTRY* UnmapBuffer)(GLenum);
+};
+
+GlFunctions gl{};
+
+template <class Fn>
+bool load(Fn& fn, const char* name) {
+    fn = reinterpret_cast<Fn>(glfwGetProcAddress(name));
+    return fn != nullptr;
+}
+
+bool load_functions() {
+    bool ok = true;
+    ok &= load(gl.CreateShader, "glCreateShader");
+    ok &= load(gl.ShaderSource, "glShaderSource");
+    ok &= load(gl.CompileShader, "glCompileShader");
+    ok &= load(gl.GetShaderiv, "glGetShaderiv");
+    ok &= load(gl.GetShaderInfoLog, "glGetShaderInfoLog");
+    ok &= load(gl.DeleteShader, "glDeleteShader");
+    ok &= load(gl.CreateProgram, "glCreateProgram");
+    ok &= load(gl.AttachShader, "glAttachShader");
+    ok &= load(gl.LinkProgram, "glLinkProgram");
+    ok &= load(gl.GetProgramiv, "glGetProgramiv");
+    ok &= load(gl.GetProgramInfoLog, "glGetProgramInfoLog");
+    ok &= load(gl.DeleteProgram, "glDeleteProgram");
+    ok &= load(gl.UseProgram, "glUseProgram");
+    ok &= load(gl.GetUniformLocation, "glGetUniformLocation");
+    ok &= load(gl.Uniform1i, "glUniform1i");
+    ok &= load(gl.Uniform1f, "glUniform1f");
+    ok &= load(gl.ActiveTexture, "glActiveTexture");
+    ok &= load(gl.GenBuffers, "glGenBuffers");
+    ok &= load(gl.DeleteBuffers, "glDeleteBuffers");
+    ok &= load(gl.BindBuffer, "glBindBuffer");
+    ok &= load(gl.BufferData, "glBufferData");
+    ok &= load(gl.MapBuffer, "glMapBuffer");
+    ok &= load(gl.UnmapBuffer, "glUnmapBuffer");
+    return ok;
+}
+
+bool has_extension(const char* name) {
+    const char* all = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    if (!all) return false;
+    const size_t len = std::strlen(name);
+    for (const char* p = all; (p = std::strstr(p, name)) != nullptr; p += len) {
+        if ((p == all || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0')) return true;
+    }
+    return false;
+}
+
+const char* kVertexShader = R"(#version 120
+varying vec2 uv;
+void main() {
+    uv = gl_MultiTexCoord0.xy;
+    gl_FrontColor = gl_Color;
+    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+}
+)";
+
+// Same mapping as FieldRenderer (ViewMode order: MagnitudePhase, Real, Imag, Magnitude, Phase)
+const char* kFragmentShader = R"(#version 120
+uniform sampler2D psiTex; // luminance = Re psi, alpha = Im psi
+uniform sampler2D potTex; // Re V / Vscale, clamped to [-1, 1]
+uniform int view;
+uniform float invMax;
+uniform int showPotential;
+uniform int unitValue;    // Phase view with normalization: full brightness
+varying vec2 uv;
+
+vec3 hue(float h) {
+    return clamp(abs(mod(h * 6.0 + vec3(0.0, 4.0, 2.0), 6.0) - 3.0) - 1.0, 0.0, 1.0);
+}
+
+void main() {
+    vec4 t = texture2D(psiTex, uv);
+    vec2 z = vec2(t.r, t.a) * invMax;
+    float mag = min(1.0, length(z));
+    vec3 c;
+    if (view == 1) {
+        c = vec3(clamp(0.5 + 0.5 * z.x, 0.0, 1.0));
+    } else if (view == 2) {
+        c = vec3(clamp(0.5 + 0.5 * z.y, 0.0, 1.0));
+    } else if (view == 3) {
+        c = vec3(mag);
+    } else {
+        float h = (atan(z.y, z.x) + 3.14159265) / 6.28318531;
+        c = (unitValue == 1 ? 1.0 : mag) * hue(h);
+    }
+    if (showPotential == 1) {
+        float pv = texture2D(potTex, uv).r;
+        c.r = min(1.0, c.r + max(pv, 0.0) * 0.3);
+        c.b = min(1.0, c.b + max(-pv, 0.0) * 0.3);
+    }
+    gl_FragColor = vec4(c, 1.0) * gl_Color;
+}
+)";
+
+GLuint compile(GLenum type, const char* source, std::string& error) {
+    GLuint shader = gl.CreateShader(type);
+    gl.ShaderSource(shader, 1, &source, nullptr);
+    gl.CompileShader(shader);
+    GLint ok = 0;
+    gl.GetShaderiv(shader, kGL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        GLint len = 0;
+        gl.GetShaderiv(shader, kGL_INFO_LOG_LENGTH, &len);
+        std::string log(static_cast<size_t>(std::max(len, 1)), '\0');
+        gl.GetShaderInfoLog(shader, len, nullptr, &log[0]);
+        error = "shader compile failed: " + log;
+        gl.DeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+void set_filtering(GLuint tex) {
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, kGL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, kGL_CLAMP_TO_EDGE);
+}
+
+} // namespace
+
+GpuFieldRenderer::~GpuFieldRenderer() = default;
+
+bool GpuFieldRenderer::init() {
+    if (initialized_) return available_;
+    initialized_ = true;
+
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    int major = 0, minor = 0;
+    if (!version || std::sscanf(version, "%d.%d", &major, &minor) != 2 || major * 10 + minor < 21) {
+        error_ = "OpenGL 2.1 required";
+        return false;
+    }
+    if (!has_extension("GL_ARB_texture_float") && major < 3) {
+        error_ = "GL_ARB_texture_float not supported";
+        return false;
+    }
+    if (!load_functions()) {
+        error_ = "missing OpenGL 2.1 entry points";
+        return false;
+    }
+
+    GLuint vs = compile(kGL_VERTEX_SHADER, kVertexShader, error_);
+    if (!vs) return false;
+    GLuint fs = compile(kGL_FRAGMENT_SHADER, kFragmentShader, error_);
+    if (!fs) {
+        gl.DeleteShader(vs);
+        return false;
+    }
+    program_ = gl.CreateProgram();
+    gl.AttachShader(program_, vs);
+    gl.AttachShader(program_, fs);
+    gl.LinkProgram(program_);
+    gl.DeleteShader(vs);
+    gl.DeleteShader(fs);
+    GLint linked = 0;
+    gl.GetProgramiv(program_, kGL_LINK_STATUS, &linked);
+    if (!linked) {
+        GLint len = 0;
+        gl.GetProgramiv(program_, kGL_INFO_LOG_LENGTH, &len);
+        std::string log(static_cast<size_t>(std::max(len, 1)), '\0');
+        gl.GetProgramInfoLog(program_, len, nullptr, &log[0]);
+        error_ = "shader link failed: " + log;
+        gl.DeleteProgram(program_);
+        program_ = 0;
+        return false;
+    }
+    locPsi_ = gl.GetUniformLocation(program_, "psiTex");
+    locPot_ = gl.GetUniformLocation(program_, "potTex");
+    locView_ = gl.GetUniformLocation(program_, "view");
+    locInvMax_ = gl.GetUniformLocation(program_, "invMax");
+    locShowPot_ = gl.GetUniformLocation(program_, "showPotential");
+    locUnitValue_ = gl.GetUniformLocation(program_, "unitValue");
+
+    glGenTextures(1, &psiTex_);
+    glGenTextures(1, &potTex_);
+    set_filtering(psiTex_);
+    set_filtering(potTex_);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    gl.GenBuffers(2, pbo_);
+    available_ = true;
+    return true;
+}
+
+void GpuFieldRenderer::shutdown() {
+    if (!available_) return;
+    gl.DeleteProgram(program_);
+    glDeleteTextures(1, &psiTex_);
+    glDeleteTextures(1, &potTex_);
+    gl.DeleteBuffers(2, pbo_);
+    program_ = psiTex_ = potTex_ = 0;
+    pbo_[0] = pbo_[1] = 0;
+    available_ = false;
+}
+
+void GpuFieldRenderer::ensure_textures(int w, int h) {
+    if (texW_ == w && texH_ == h) return;
+    texW_ = w;
+    texH_ = h;
+    glBindTexture(GL_TEXTURE_2D, psiTex_);
+    glTexImage2D(GL_TEXTURE_2D, 0, kGL_LUMINANCE_ALPHA32F, w, h, 0, GL_LUMINANCE_ALPHA, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, potTex_);
+    glTexImage2D(GL_TEXTURE_2D, 0, kGL_LUMINANCE32F, w, h, 0, GL_LUMINANCE, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    potValid_ = false;
+}
+
+void GpuFieldRenderer::upload(const sim::Simulation& sim) {
+    if (!available_) return;
+    S2D_PROFILE_SCOPE("GPU upload");
+    const int W = sim.Nx;
+    const int H = sim.Ny;
+    ensure_textures(W, H);
+    const size_t cells = static_cast<size_t>(W) * static_cast<size_t>(H);
+
+    if (!potValid_ || potGeneration_ != sim.potentialGeneration) {
+        // V changes rarely: scale it once and upload directly
+        const double* VRe = sim.V.re.data();
+        double maxVre = 0.0;
+        for (size_t k = 0; k < cells; ++k) maxVre = std::max(maxVre, std::fabs(VRe[k]));
+        const double Vscale = (maxVre > 1e-12 ? 0.8 * maxVre : 20.0);
+        std::vector<float>& pv = potScratch_;
+        pv.resize(cells);
+        for (size_t k = 0; k < cells; ++k) pv[k] = static_cast<float>(std::clamp(VRe[k] / Vscale, -1.0, 1.0));
+        glBindTexture(GL_TEXTURE_2D, potTex_);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, W, H, GL_LUMINANCE, GL_FLOAT, pv.data());
+        potValid_ = true;
+        potGeneration_ = sim.potentialGeneration;
+    }
+
+    // Fill the other PBO while the previous transfer may still be in flight;
+    // orphaning it first means the map never waits on the GPU.
+    pboIndex_ = 1 - pboIndex_;
+    const std::ptrdiff_t bytes = static_cast<std::ptrdiff_t>(cells * 2 * sizeof(float));
+    gl.BindBuffer(kGL_PIXEL_UNPACK_BUFFER, pbo_[pboIndex_]);
+    gl.BufferData(kGL_PIXEL_UNPACK_BUFFER, bytes, nullptr, kGL_STREAM_DRAW);
+    float* dst = static_cast<float*>(gl.MapBuffer(kGL_PIXEL_UNPACK_BUFFER, kGL_WRITE_ONLY));
+    if (dst) {
+        const double* re = sim.psi.re.data();
+        const double* im = sim.psi.im.data();
+        std::vector<double>& rowMax = rowMax_;
+        rowMax.assign(static_cast<size_t>(H), 0.0);
+        sim::parallel_for(sim.pool.get(), 0, H, [&](int j0, int j1, int) {
+            for (int j = j0; j < j1; ++j) {
+                const size_t row = static_cast<size_t>(j) * W;
+                double m2 = 0.0;
+                for (int i = 0; i < W; ++i) {
+                    const double zr = re[row + i];
+                    const double zi = im[row + i];
+                    dst[2 * (row + i) + 0] = static_cast<float>(zr);
+                    dst[2 * (row + i) + 1] = static_cast<float>(zi);
+                    m2 = std::max(m2, zr * zr + zi * zi);
+                }
+                rowMax[static_cast<size_t>(j)] = m2;
+            }
+        });
+        double m2 = 1e-24;
+        for (double m : rowMax) m2 = std::max(m2, m);
+        maxMag_ = std::sqrt(m2);
+        gl.UnmapBuffer(kGL_PIXEL_UNPACK_BUFFER);
+        glBindTexture(GL_TEXTURE_2D, psiTex_);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, W, H, GL_LUMINANCE_ALPHA, GL_FLOAT, nullptr); // from the PBO
+    }
+    gl.BindBuffer(kGL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GpuFieldRenderer::draw_image(ImDrawList* drawList, float width, float height,
+                                  bool showPotential, sim::ViewMode view, bool normalizeView) {
+    view_ = static_cast<int>(view);
+    invMax_ = normalizeView ? static_cast<float>(1.0 / maxMag_) : 1.0f;
+    showPotential_ = showPotential;
+    unitValue_ = view == sim::ViewMode::Phase && normalizeView;
+    drawList->AddCallback(&GpuFieldRenderer::begin_callback, this);
+    ImGui::Image((ImTextureID)(intptr_t)psiTex_, ImVec2(width, height));
+    drawList->AddCallback(&GpuFieldRenderer::end_callback, this);
+    drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+}
+
+void GpuFieldRenderer::begin_callback(const ImDrawList*, const ImDrawCmd* cmd) {
+    const GpuFieldRenderer* self = static_cast<const GpuFieldRenderer*>(cmd->UserCallbackData);
+    gl.UseProgram(self->program_);
+    gl.Uniform1i(self->locPsi_, 0);
+    gl.Uniform1i(self->locPot_, 1);
+    gl.Uniform1i(self->locView_, self->view_);
+    gl.Uniform1f(self->locInvMax_, self->invMax_);
+    gl.Uniform1i(self->locShowPot_, self->showPotential_ ? 1 : 0);
+    gl.Uniform1i(self->locUnitValue_, self->unitValue_ ? 1 : 0);
+    gl.ActiveTexture(kGL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, self->potTex_);
+    gl.ActiveTexture(kGL_TEXTURE0); // the backend binds psiTex here for the image
+}
+
+void GpuFieldRenderer::end_callback(const ImDrawList*, const ImDrawCmd*) {
+    gl.UseProgram(0);
+    gl.ActiveTexture(kGL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    gl.ActiveTexture(kGL_TEXTURE0);
+}
+
+} // namespace ui
+
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+
+#if BUILD_GUI
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sim/simulation.hpp"
+
+struct ImDrawList;
+struct ImDrawCmd;
+
+namespace ui {
+
+using GLuint = unsigned int;
+
+// GPU colormap for the view: psi is streamed as a two-channel float texture
+// through two alternating pixel buffer objects (the upload runs asynchronously
+// while the next frame is converted), and a GLSL 1.20 fragment shader applies
+// the view mode and the potential overlay while ImGui draws the image.
+//
+// Needs OpenGL 2.1 (shaders, PBOs) and ARB_texture_float; init() reports
+// false otherwise and the caller keeps using FieldRenderer on the CPU.
+class GpuFieldRenderer {
+public:
+    GpuFieldRenderer() = default;
+    ~GpuFieldRenderer();
+    GpuFieldRenderer(const GpuFieldRenderer&) = delete;
+    GpuFieldRenderer& operator=(const GpuFieldRenderer&) = delete;
+
+    // Once, with the GL context current. Safe to call again (no-op after the first call).
+    bool init();
+    bool available() const { return available_; }
+    const std::string& error() const { return error_; }
+
+    // Streams psi (and V when potentialGeneration changed) for the next draw.
+    void upload(const sim::Simulation& sim);
+
+    // Draws the field as an image of the given size at the cursor, like ImGui::Image.
+    void draw_image(ImDrawList* drawList, float width, float height,
+                    bool showPotential, sim::ViewMode view, bool normalizeView);
+
+    void shutdown(); // releases GL objects (context must still be current)
+
+private:
+    static void begin_callback(const ImDrawList* list, const ImDrawCmd* cmd);
+    static void end_callback(const ImDrawList* list, const ImDrawCmd* cmd);
+    void ensure_textures(int w, int h);
+
+    bool initialized_{false};
+    bool available_{false};
+    std::string error_;
+
+    GLuint program_{0};
+    GLuint psiTex_{0};
+    GLuint potTex_{0};
+    GLuint pbo_[2]{0, 0};
+    int pboIndex_{0};
+    int texW_{0}, texH_{0};
+    bool potValid_{false};
+    std::uint64_t potGeneration_{0};
+    double maxMag_{1.0}; // max |psi| of the last upload
+    std::vector<float> potScratch_; // scaled V for its texture
+    std::vector<double> rowMax_;    // per-row max |psi|^2
+
+    // Uniform locations
+    int locPsi_{-1}, locPot_{-1}, locView_{-1}, locInvMax_{-1}, locShowPot_{-1}, locUnitValue_{-1};
+
+    // Draw parameters of the current frame (read by the draw callback)
+    int view_{0};
+    float invMax_{1.0f};
+    bool showPotential_{false};
+    bool unitValue_{false};
+};
+
+} // namespace ui
+
+#endif
@@ -31,12 +31,15 @@
 #include <iostream>
 
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb/stb_image_write.h"
 
+#include "sim/profiler.hpp"
 #include "sim/simulation.hpp"
+#include "sim/sim_thread.hpp"
+#include "io/checkpoint.hpp"
+#include "io/recorder.hpp"
 #include "io/scene.hpp"
 #include "ui/field_renderer.hpp"
+#include "ui/gpu_field_renderer.hpp"
 #include "ui/presets.hpp"
 
 namespace {
@@ -60,7 +63,9 @@ static constexpr double kCapSliderMaxOpen = 3000.0;
 
 
 struct AppState {
-    sim::Simulation sim;
+    sim::Simulation sim;          // edited by the UI; psi and diagnostics follow simThread
+    sim::SimulationThread simThread; // steps a copy of sim off the render thread
+    bool fastMode{false};         // step as fast as possible instead of stepsPerFrame per frame
     sim::ViewMode view{sim::ViewMode::MagnitudePhase};
     bool showPotential{true};
     bool normalizeView{true};
@@ -142,6 +147,8 @@ struct AppState {
 
     bool showStyleEditor{false};
     bool showPreferences{false};
+    bool showProfiler{false};
+    sim::profile::StageStats profilerStats; // rolling stage timings of the Profiler window
     bool autoDisableNormalizeOnCapPreset{true};
     double capStrengthSliderMin{kCapSliderMinHardWall};
     double capStrengthSliderMax{kCapSliderMaxHardWall};
@@ -166,19 +173,43 @@ struct AppState {
 
      struct EigenPanelState {
          int modes{3};
-         int basis{0};
+         int basis{32};
          int maxIter{0};
          double tol{1e-6};
+         bool shiftInvert{false};
+         double shift{0.0};
          int selected{-1};
          std::string status;
          std::vector<sim::EigenState> states;
+         sim::EigenSolveTask task; // solves off the UI thread
+         bool track{true};          // re-solve (warm started) when V changes
+         std::uint64_t requestedGeneration{0}; // potentialGeneration of the last started solve
+         std::uint64_t solvedGeneration{0};    // ... and of the states shown
+         int solvedNx{0}, solvedNy{0};
+         bool spectral{false};       // play by evaluating the projection instead of stepping
      } eigen;
 
+    // Grid changes from the settings panel: psi is resampled off the UI thread
+    // while the old grid keeps showing, then swapped in
+    struct GridResizeState {
+        sim::GridResizeTask task;
+        int Nx{0}, Ny{0};   // target of the job in flight
+        bool resume{false}; // running when the first job started (stepping pauses meanwhile)
+    } gridResize;
+
     // Scene IO
     std::filesystem::path sceneLastSaveDir;
     std::filesystem::path sceneLastLoadDir;
     char saveScenePath[512]{};
     char loadScenePath[512]{};
+    char checkpointPath[512]{};
+    bool checkpointCompress{true};
+    io::AsyncCheckpointWriter checkpointWriter; // saves psi without stalling playback
+    // Recording (movies / density series) and screenshots, encoded off the UI thread
+    io::FrameRecorder recorder;
+    char recordDir[512]{"recording"};
+    int recordFormat{0}; // RecordFormat
+    int recordStride{10};
     bool scenePathInit{false};
 
     // Deferred shift-multiselect (apply on mouse release if it was a click)
@@ -192,6 +223,9 @@ struct AppState {
     GLuint tex{0};
     int texW{0}, texH{0};
     std::vector<unsigned char> rgbaBuffer;
+    ui::FieldRenderer renderer; // hue table + cached potential overlay
+    ui::GpuFieldRenderer gpuRenderer; // shader colormap; renderer is the fallback
+    bool gpuView{true};
     bool fieldDirty{true};
     bool potentialDirtyDrag{false};
     bool lastUnstable{false};
@@ -206,7 +240,7 @@ static void load_well_lattice_scene(AppState& app);
 static void load_ring_resonator_scene(AppState& app);
 static void load_barrier_gauntlet_scene(AppState& app);
 static void push_toast(AppState& app, const std::string& message, float duration_seconds);
-static bool save_current_view_png(const AppState& app, const std::filesystem::path& path);
+static bool save_current_view_png(AppState& app, const std::filesystem::path& path);
 static std::filesystem::path default_screenshot_path();
 static void take_screenshot(AppState& app);
 static inline ImVec2 operator+(ImVec2 a, ImVec2 b) { return ImVec2(a.x + b.x, a.y + b.y); }
@@ -527,9 +561,13 @@ static ImU32 make_rgba(float r, float g, float b, float a = 1.0f) {
     return IM_COL32((int)(r * 255.0f), (int)(g * 255.0f), (int)(b * 255.0f), (int)(a * 255.0f));
 }
 
-static void render_field_to_rgba(const sim::Simulation& sim, std::vector<unsigned char>& outRGBA,
-                                 bool showPotential, sim::ViewMode view, bool normalizeView) {
-    ui::render_field_to_rgba(sim, outRGBA, showPotential, view, normalizeView);
+static void render_field_to_rgba(AppState& app) {
+    app.renderer.render(app.sim, app.rgbaBuffer, app.showPotential, app.view, app.normalizeView);
+}
+
+// True when the view is drawn by the shader path (rgbaBuffer is then not kept current)
+static bool gpu_view_active(AppState& app) {
+    return app.gpuView && app.gpuRenderer.init();
 }
 
 static void mark_scene_changed(AppState& app) {
@@ -570,7 +608,7 @@ static void apply_cap_preset(AppState& app,
         normalizeDisabled = true;
     }
 
-    app.sim.pfield.build(app.sim.V);
+    app.sim.update_potential();
     app.sim.refresh_diagnostics_baseline();
     app.fieldDirty = true;
 
@@ -789,13 +827,16 @@ static std::string save_json_file_dialog(const std::filesystem::path& initialDir
 }
 #endif
 
-static bool save_current_view_png(const AppState& app, const std::filesystem::path& path) {
+// Queues the current view on the recorder's encoder thread; the displayed
+// RGBA buffer is reused unless it is stale.
+static bool save_current_view_png(AppState& app, const std::filesystem::path& path) {
     if (app.sim.Nx <= 0 || app.sim.Ny <= 0)
         return false;
-    std::vector<unsigned char> rgba;
-    render_field_to_rgba(app.sim, rgba, app.showPotential, app.view, app.normalizeView);
-    int stride = app.sim.Nx * 4;
-    return stbi_write_png(path.string().c_str(), app.sim.Nx, app.sim.Ny, 4, rgba.data(), stride) != 0;
+    const size_t bytes = static_cast<size_t>(app.sim.Nx) * static_cast<size_t>(app.sim.Ny) * 4;
+    if (app.fieldDirty || app.rgbaBuffer.size() != bytes || gpu_view_active(app)) {
+        render_field_to_rgba(app);
+    }
+    return app.recorder.submit_png(path.string(), app.rgbaBuffer.data(), app.sim.Nx, app.sim.Ny);
 }
 
 static ImVec2 fit_size_keep_aspect(ImVec2 content, ImVec2 avail) {
@@ -819,9 +860,9 @@ static void push_toast(AppState& app, const std::string& message, float duration
 static void take_screenshot(AppState& app) {
     std::filesystem::path target = default_screenshot_path();
     if (save_current_view_png(app, target)) {
-        push_toast(app, std::string("Saved screenshot to ") + target.string(), 3.0f);
+        push_toast(app, std::string("Saving screenshot to ") + target.string(), 3.0f);
     } else {
-        push_toast(app, "Failed to save screenshot", 3.0f);
+        push_toast(app, "Failed to save screenshot (encoder busy)", 3.0f);
     }
 }
 
@@ -838,6 +879,30 @@ static const char* tool_mode_name(AppState::Mode mode) {
     }
 }
 
+// Starts a background resize, or retargets the one in flight
+static void start_grid_resize(AppState& app, int nx, int ny) {
+    if (!app.gridResize.task.busy()) app.gridResize.resume = app.sim.running;
+    app.sim.running = false;
+    app.gridResize.Nx = nx;
+    app.gridResize.Ny = ny;
+    app.gridResize.task.start(app.sim.prepare_resample(nx, ny), app.sim.threads());
+}
+
+// Once per frame: swaps in a finished resize
+static void update_grid_resize(AppState& app) {
+    sim::GridResample job;
+    if (!app.gridResize.task.take_result(job) || job.cancelled) return;
+    const bool sameGrid = job.fromNx == app.sim.Nx && job.fromNy == app.sim.Ny;
+    if (app.sim.apply_resample(std::move(job))) {
+        selection_clear(app);
+        app.fieldDirty = true;
+        app.sim.running = app.gridResize.resume;
+    } else if (sameGrid) {
+        // psi was replaced meanwhile (a load, a new packet): that edit wins
+        push_toast(app, "Grid change dropped: psi changed while resampling", 3.0f);
+    }
+}
+
 static void draw_settings(AppState& app) {
     // For the 4 main controls: Slightly larger padding and a visible border
     ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(14, 6));
@@ -848,8 +913,8 @@ static void draw_settings(AppState& app) {
     }
     ImGui::SameLine();
     if (ImGui::Button("Step")) {
-        app.sim.step();
-        app.fieldDirty = true;
+        app.simThread.sync(app.sim); // edits made earlier this frame first
+        app.simThread.post([](sim::Simulation& s) { s.step(); });
     }
     //Line
     if (ImGui::Button("Reset [R]")) {
@@ -861,7 +926,7 @@ static void draw_settings(AppState& app) {
         double m = app.sim.mass();
         if (m > 1e-12) {
             double s = 1.0 / std::sqrt(m);
-            for (auto& z : app.sim.psi) z *= s;
+            app.sim.psi.scale(s);
             app.sim.refresh_diagnostics_baseline();
             app.fieldDirty = true;
         }
@@ -874,14 +939,61 @@ static void draw_settings(AppState& app) {
                      "Time step. Larger values run faster but reduce accuracy.");
         int spfMin = 1;
         int spfMax = 32;
+        ImGui::BeginDisabled(app.fastMode);
         slider_block("Steps / frame", "##steps_per_frame", ImGuiDataType_S32, &app.stepsPerFrame, &spfMin, &spfMax, "%d", 0,
                      "How many simulation steps run each frame while playing.");
+        ImGui::EndDisabled();
+        ImGui::Checkbox("As fast as possible", &app.fastMode);
+        ImGui::SameLine();
+        help_marker("Step continuously on the simulation thread, independent of the display rate.");
+        if (app.sim.running) {
+            ImGui::SameLine();
+            ImGui::Text("%.0f steps/s", app.simThread.steps_per_second());
+        }
+        int threads = app.sim.threads();
+        int thrMin = 1;
+        int thrMax = std::max(1, sim::ThreadPool::hardware_threads());
+        if (slider_block("Threads", "##threads", ImGuiDataType_S32, &threads, &thrMin, &thrMax, "%d", 0,
+                         "Worker threads for the ADI sweeps. Results do not depend on this value.")) {
+            app.sim.set_threads(std::clamp(threads, thrMin, thrMax));
+        }
+        int engine = static_cast<int>(app.sim.engine);
+        const char* engines[] = {"CN-ADI", "Split-step Fourier", "CN multigrid"};
+        if (ImGui::Combo("Engine", &engine, engines, IM_ARRAYSIZE(engines))) {
+            app.sim.engine = static_cast<sim::Engine>(engine);
+        }
+        ImGui::SameLine();
+        help_marker("CN-ADI: finite differences. Split-step Fourier: exact kinetic step, accurate on coarser grids for fast packets. "
+                    "CN multigrid: unsplit Crank-Nicolson with an iterative solve, slower; used for any engine while B is set.");
+        double bMin = -200.0;
+        double bMax = 200.0;
+        slider_block("Magnetic field B", "##magnetic_field", ImGuiDataType_Double, &app.sim.magneticField, &bMin, &bMax,
+                     "%.1f", 0, "Uniform field out of the plane. Couples x and y, so stepping switches to CN multigrid. "
+                                "Eigenmodes ignore it.");
+        if (!app.sim.separable() || app.sim.engine == sim::Engine::CrankNicolsonMultigrid) {
+            ImGui::TextDisabled("Multigrid: %d iterations, residual %.1e", app.sim.multigrid.lastIterations,
+                                app.sim.multigrid.lastResidual);
+        }
+        bool singlePrecision = app.sim.precision == sim::Precision::Float;
+        if (ImGui::Checkbox("Single precision", &singlePrecision)) {
+            app.sim.precision = singlePrecision ? sim::Precision::Float : sim::Precision::Double;
+        }
+        ImGui::SameLine();
+        help_marker("Step in float instead of double: faster, with mass drift around 1e-4 relative. Saved with the scene.");
+        bool compactStencil = app.sim.spatialOrder == 4;
+        if (ImGui::Checkbox("Fourth-order stencil", &compactStencil)) {
+            app.sim.spatialOrder = compactStencil ? 4 : 2;
+        }
+        ImGui::SameLine();
+        help_marker("Compact fourth-order Laplacian for CN-ADI and eigenmodes: resolves short wavelengths on coarser grids "
+                    "at a slightly costlier x-sweep. Recompute eigenmodes after switching.");
     }
-    const int originalNx = app.sim.Nx;
-    const int originalNy = app.sim.Ny;
+    const bool resizing = app.gridResize.task.busy();
+    const int originalNx = resizing ? app.gridResize.Nx : app.sim.Nx;
+    const int originalNy = resizing ? app.gridResize.Ny : app.sim.Ny;
     int nx = originalNx;
-   
-    const auto clampGrid = [](int v) { return std::clamp(v, 16, 1024); };
+
+    const auto clampGrid = [](int v) { return std::clamp(v, 16, 4096); };
 
     bool nxValueChanged = ImGui::InputInt("Nx", &nx);
     ImGui::SameLine();
@@ -974,10 +1086,18 @@ static void draw_settings(AppState& app) {
     nx = clampGrid(nx);
     ny = clampGrid(ny);
 
-    if (nx != app.sim.Nx || ny != app.sim.Ny) {
-        app.sim.resize(nx, ny);
-        selection_clear(app);
-        app.fieldDirty = true;
+    if (nx != originalNx || ny != originalNy) {
+        if (nx == app.sim.Nx && ny == app.sim.Ny) {
+            app.gridResize.task.cancel(); // back to the current grid
+            app.gridResize.Nx = nx;
+            app.gridResize.Ny = ny;
+            app.sim.running = app.gridResize.resume;
+        } else {
+            start_grid_resize(app, nx, ny);
+        }
+    }
+    if (resizing) {
+        ImGui::TextDisabled("Resampling psi to %d x %d...", app.gridResize.Nx, app.gridResize.Ny);
     }
 
     const auto& diag = app.sim.diagnostics;
@@ -1004,6 +1124,12 @@ static void draw_settings(AppState& app) {
     if (ImGui::Checkbox("Potential overlay", &app.showPotential)) app.fieldDirty = true;
     ImGui::SameLine();
     help_marker("Overlay positive/negative potential tint.");
+    if (ImGui::Checkbox("GPU colormap", &app.gpuView)) app.fieldDirty = true;
+    ImGui::SameLine();
+    help_marker("Color the view in a shader from a float texture of psi, streamed through pixel buffers.");
+    if (app.gpuView && !app.gpuRenderer.available() && !app.gpuRenderer.error().empty()) {
+        ImGui::TextDisabled("CPU fallback: %s", app.gpuRenderer.error().c_str());
+    }
     int vm = static_cast<int>(app.view);
     const char* modes[] = {"Mag+Phase","Real","Imag","Magnitude","Phase"};
     if (ImGui::Combo("Mode", &vm, modes, IM_ARRAYSIZE(modes))) {
@@ -1080,7 +1206,7 @@ static void draw_settings(AppState& app) {
         changed |= slider_block("CAP ratio", "##cap_ratio", ImGuiDataType_Double, &app.sim.pfield.cap_ratio, &vmin, &vmax, "%.3f",
                                 0, "Fraction of each edge used as CAP sponge.");
         if (changed) {
-            app.sim.pfield.build(app.sim.V);
+            app.sim.update_potential();
             app.sim.refresh_diagnostics_baseline();
             app.fieldDirty = true;
         }
@@ -1152,6 +1278,12 @@ static void draw_settings(AppState& app) {
                                      &app.sim.stability.warmup_steps, &warmMin, &warmMax, "%d",
                                      0, "Initial steps ignored by instability checks.");
 
+        int checkMin = 1;
+        int checkMax = 200;
+        guardChanged |= slider_block("Check every N steps", "##stability_check_every", ImGuiDataType_S32,
+                                     &app.sim.stability.check_every_n_steps, &checkMin, &checkMax, "%d",
+                                     0, "Cadence of mass/stability checks; sums are taken in the last potential kick of a checked step.");
+
         guardChanged |= ImGui::Checkbox("Strict interior drift hard-fail", &app.sim.stability.interior_drift_hard_fail);
         ImGui::SameLine();
         help_marker("If enabled, interior drift exceeding tolerance becomes UNSTABLE instead of WARNING.");
@@ -1229,6 +1361,80 @@ static void draw_settings(AppState& app) {
             }
         }
 
+        ImGui::Spacing();
+        ImGui::TextUnformatted("Checkpoint (scene + evolved psi)");
+        if (app.checkpointPath[0] == '\0') {
+            const std::string ckptDefault = (app.sceneLastSaveDir / "run.s2dckpt").string();
+            std::snprintf(app.checkpointPath, sizeof(app.checkpointPath), "%s", ckptDefault.c_str());
+        }
+        ImGui::SetNextItemWidth(-1.0f);
+        ImGui::InputText("##checkpoint_path", app.checkpointPath, IM_ARRAYSIZE(app.checkpointPath));
+        if (ImGui::Button("Save checkpoint")) {
+            app.checkpointWriter.submit(app.checkpointPath, app.sim,
+                                        app.checkpointCompress && io::checkpoint_compression_available());
+            push_toast(app, std::string("Writing checkpoint ") + app.checkpointPath, 2.0f);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load checkpoint")) {
+            app.checkpointWriter.wait();
+            std::string error;
+            if (io::load_checkpoint(app.checkpointPath, app.sim, &error)) {
+                selection_clear(app);
+                app.fieldDirty = true;
+                app.lastUnstable = false;
+                app.lastWarning = false;
+                push_toast(app, std::string("Restored checkpoint from ") + app.checkpointPath, 2.5f);
+            } else {
+                push_toast(app, "Failed to load checkpoint: " + error, 3.0f);
+            }
+        }
+        if (io::checkpoint_compression_available()) {
+            ImGui::SameLine();
+            ImGui::Checkbox("Compress", &app.checkpointCompress);
+        }
+        if (!app.checkpointWriter.busy() && !app.checkpointWriter.last_ok()) {
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Last checkpoint failed: %s", app.checkpointWriter.last_error().c_str());
+        }
+
+        ImGui::Spacing();
+        ImGui::TextUnformatted("Recording");
+        const bool recording = app.recorder.active();
+        ImGui::BeginDisabled(recording);
+        ImGui::SetNextItemWidth(-1.0f);
+        ImGui::InputText("##record_dir", app.recordDir, IM_ARRAYSIZE(app.recordDir));
+        const char* recordFormats[] = {"PNG sequence", "Raw float32 |psi|^2", "Chunked stream"};
+        ImGui::Combo("Format", &app.recordFormat, recordFormats, IM_ARRAYSIZE(recordFormats));
+        ImGui::SliderInt("Every N steps", &app.recordStride, 1, 500);
+        ImGui::EndDisabled();
+        if (!recording) {
+            if (ImGui::Button("Start recording")) {
+                io::RecorderConfig config;
+                config.format = static_cast<io::RecordFormat>(app.recordFormat);
+                config.directory = app.recordDir;
+                config.stride = app.recordStride;
+                std::string error;
+                if (app.recorder.start(config, app.sim.Nx, app.sim.Ny, app.sim.dt, &error)) {
+                    app.fieldDirty = true;
+                    push_toast(app, std::string("Recording to ") + app.recordDir, 2.0f);
+                } else {
+                    push_toast(app, "Failed to start recording: " + error, 3.0f);
+                }
+            }
+        } else if (ImGui::Button("Stop recording")) {
+            app.recorder.stop();
+            push_toast(app, "Recorded " + std::to_string(app.recorder.frames_written()) + " frames", 2.5f);
+        }
+        if (recording || app.recorder.frames_written() > 0 || app.recorder.frames_dropped() > 0) {
+            ImGui::Text("Frames: %llu written, %llu dropped (%.1f MB)",
+                        static_cast<unsigned long long>(app.recorder.frames_written()),
+                        static_cast<unsigned long long>(app.recorder.frames_dropped()),
+                        static_cast<double>(app.recorder.bytes_written()) / (1024.0 * 1024.0));
+        }
+        const std::string recordError = app.recorder.last_error();
+        if (!recordError.empty()) {
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Recorder: %s", recordError.c_str());
+        }
+
         ImGui::Spacing();
         ImGui::TextDisabled("Optional native dialogs:");
 
@@ -1277,6 +1483,52 @@ static void draw_settings(AppState& app) {
 
 }
 
+// Seeds from the modes on screen when they belong to the same grid
+static void start_eigen_solve(AppState& app) {
+    sim::EigenSolverOptions options;
+    options.modes = app.eigen.modes;
+    options.basis = app.eigen.basis;
+    options.maxIter = app.eigen.maxIter;
+    options.tol = app.eigen.tol;
+    options.shiftInvert = app.eigen.shiftInvert;
+    options.shift = app.eigen.shift;
+    std::vector<sim::EigenState> guess;
+    if (app.eigen.solvedNx == app.sim.Nx && app.eigen.solvedNy == app.sim.Ny) guess = app.eigen.states;
+    app.eigen.task.start(app.sim.eigen_problem(), options, app.sim.threads(), std::move(guess));
+    app.eigen.requestedGeneration = app.sim.potentialGeneration;
+    app.eigen.status = "Solving...";
+}
+
+// Once per frame: collects a finished solve, and re-solves a tracked set of modes after V changed
+static void update_eigenstates(AppState& app) {
+    sim::EigenResult solved;
+    if (app.eigen.task.take_result(solved)) {
+        const std::size_t points = static_cast<std::size_t>(app.sim.Nx) * app.sim.Ny;
+        if (solved.cancelled) {
+            app.eigen.status = "Cancelled";
+        } else if (!solved.states.empty() && solved.states[0].psi.size() != points) {
+            app.eigen.status = "Grid changed during the solve";
+        } else {
+            app.eigen.states = std::move(solved.states);
+            app.eigen.solvedGeneration = app.eigen.requestedGeneration;
+            app.eigen.solvedNx = app.sim.Nx;
+            app.eigen.solvedNy = app.sim.Ny;
+            if (app.eigen.selected >= static_cast<int>(app.eigen.states.size())) app.eigen.selected = -1;
+            if (app.eigen.selected < 0 && !app.eigen.states.empty()) app.eigen.selected = 0;
+            char status[128];
+            std::snprintf(status, sizeof(status), "%s: %d/%zu converged after %d iterations",
+                          app.eigen.states.empty() ? "No modes found" : "Solved", solved.converged,
+                          app.eigen.states.size(), solved.iterations);
+            app.eigen.status = status;
+        }
+    }
+    const bool sameGrid = app.eigen.solvedNx == app.sim.Nx && app.eigen.solvedNy == app.sim.Ny;
+    if (app.eigen.track && !app.eigen.task.busy() && !app.eigen.states.empty() && sameGrid &&
+        app.eigen.requestedGeneration != app.sim.potentialGeneration) {
+        start_eigen_solve(app);
+    }
+}
+
 static void draw_tools_panel(AppState& app) {
     ImGuiStyle& style = ImGui::GetStyle();
 
@@ -1359,34 +1611,58 @@ static void draw_tools_panel(AppState& app) {
     ImGui::Separator();
     if (ImGui::CollapsingHeader("Eigenstates", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::BeginDisabled();
-        ImGui::TextWrapped("Solves lowest modes of H = -(1/2)∇² + Re(V)");
+        ImGui::TextWrapped("Solves the lowest modes of H = -(1/2)∇² + Re(V), or those nearest a target energy");
         ImGui::EndDisabled();
-        const int maxBasisAllowed = std::max(1, app.sim.Nx*app.sim.Ny); // full limit
-        const int defaultBasis = std::max(1, 2*std::max(app.sim.Nx, app.sim.Ny)); // reasonable default
-        if (app.eigen.basis <= 0) app.eigen.basis = defaultBasis;
+        const int gridPoints = std::max(1, app.sim.Nx * app.sim.Ny);
         if (app.eigen.maxIter <= 0) app.eigen.maxIter = 1000;
         int modes = app.eigen.modes;
         if (ImGui::InputInt("Modes", &modes)) {
-            app.eigen.modes = std::clamp(modes, 1, std::min(32, defaultBasis));
-        }
-        int basis = app.eigen.basis;
-        if (ImGui::InputInt("Krylov size", &basis)) {
-            app.eigen.basis = std::clamp(basis, app.eigen.modes, maxBasisAllowed); // full limit
+            app.eigen.modes = std::clamp(modes, 1, std::min(32, gridPoints));
         }
         int maxIter = app.eigen.maxIter;
         if (ImGui::InputInt("Max iters", &maxIter)) {
-            app.eigen.maxIter = std::clamp(maxIter, app.eigen.basis, 4000*modes); // Arbitrary upper limit
+            app.eigen.maxIter = std::clamp(maxIter, app.eigen.modes, 4000 * app.eigen.modes); // Arbitrary upper limit
         }
+        ImGui::SameLine();
+        help_marker("Hamiltonian applications (or inner solves with shift-invert) before giving up.");
         double tol = app.eigen.tol;
         if (ImGui::InputDouble("Tolerance", &tol, 0.0, 0.0, "%.2e")) {
             app.eigen.tol = std::max(1e-12, tol);
         }
-        if (ImGui::Button("Solve eigenmodes")) {
-            app.eigen.status = "Solving...";
-            ImGui::SetItemDefaultFocus();
-            app.eigen.states = app.sim.compute_eigenstates(app.eigen.modes, app.eigen.basis, app.eigen.maxIter, app.eigen.tol);
-            app.eigen.selected = app.eigen.states.empty() ? -1 : 0;
-            app.eigen.status = app.eigen.states.empty() ? "No modes found" : "Solved";
+        ImGui::SameLine();
+        help_marker("Relative residual |H psi - E psi| / |E| each mode must reach.");
+        ImGui::Checkbox("Shift-invert", &app.eigen.shiftInvert);
+        ImGui::SameLine();
+        help_marker("Find the modes nearest a target energy instead of the lowest ones (slower: every iteration solves a linear system).");
+        if (app.eigen.shiftInvert) {
+            ImGui::InputDouble("Target energy", &app.eigen.shift, 0.0, 0.0, "%.4f");
+            int basis = app.eigen.basis;
+            if (ImGui::InputInt("Krylov size", &basis)) {
+                app.eigen.basis = std::clamp(basis, app.eigen.modes + 2, std::min(256, gridPoints));
+            }
+            ImGui::TextDisabled("Basis memory: %.1f MB", (app.eigen.basis + 1) * 8.0 * gridPoints / 1e6);
+        }
+
+        ImGui::Checkbox("Track while editing", &app.eigen.track);
+        ImGui::SameLine();
+        help_marker("Re-solve from the current modes whenever the potential changes; modes keep their place in the list.");
+
+        sim::EigenSolveTask& task = app.eigen.task;
+        if (task.busy()) {
+            const sim::EigenProgress& progress = task.progress();
+            const int iterations = progress.iterations.load(std::memory_order_relaxed);
+            const float fraction = static_cast<float>(iterations) / static_cast<float>(std::max(1, task.options().maxIter));
+            char overlay[96];
+            std::snprintf(overlay, sizeof(overlay), "%d/%d converged, residual %.1e",
+                          progress.converged.load(std::memory_order_relaxed), task.options().modes,
+                          progress.residual.load(std::memory_order_relaxed));
+            ImGui::ProgressBar(std::clamp(fraction, 0.0f, 1.0f), ImVec2(-1.0f, 0.0f), overlay);
+            if (ImGui::Button("Cancel")) task.cancel();
+        } else if (ImGui::Button("Solve eigenmodes")) {
+            start_eigen_solve(app);
+        }
+        if (!task.busy() && !app.eigen.states.empty() && app.eigen.solvedGeneration != app.sim.potentialGeneration) {
+            ImGui::TextDisabled("Potential changed since this solve");
         }
         if (!app.eigen.status.empty()) {
             ImGui::TextDisabled("%s", app.eigen.status.c_str());
@@ -1415,6 +1691,30 @@ static void draw_tools_panel(AppState& app) {
                 }
                 ImGui::PopID();
             }
+
+            ImGui::Separator();
+            const bool current = app.eigen.solvedNx == app.sim.Nx && app.eigen.solvedNy == app.sim.Ny &&
+                                 app.eigen.solvedGeneration == app.sim.potentialGeneration;
+            ImGui::BeginDisabled(!current);
+            if (ImGui::Button("Project psi")) {
+                const double residual = app.sim.project_spectral(app.eigen.states);
+                char msg[96];
+                std::snprintf(msg, sizeof(msg), "Projected: %.2f%% of |psi| outside the modes", 100.0 * residual);
+                push_toast(app, msg, 2.5f);
+            }
+            ImGui::EndDisabled();
+            ImGui::SameLine();
+            help_marker("Expand psi in the modes above. Spectral playback then evaluates psi(t) directly, "
+                        "with no time stepping; the part of psi outside the modes is dropped.");
+            if (!app.sim.spectral.empty()) {
+                ImGui::TextDisabled("Outside basis: %.2f%%", 100.0 * app.sim.spectral.residual);
+            }
+            ImGui::BeginDisabled(!app.sim.spectral_ready());
+            ImGui::Checkbox("Spectral playback", &app.eigen.spectral);
+            ImGui::EndDisabled();
+            ImGui::SameLine();
+            help_marker("While playing, advance by evaluating the projection (O(modes N) per frame) instead of stepping. "
+                        "Exact for bound states; the absorbing border has no effect. Stops when V or the grid changes.");
         }
     }
 }
@@ -1424,22 +1724,36 @@ static void draw_view_content(AppState& app) {
     ImVec2 target = fit_size_keep_aspect(ImVec2((float)app.sim.Lx, (float)app.sim.Ly), avail);
     ImVec2 cur = ImGui::GetCursorScreenPos();
 
-    const bool texSizeChanged = (app.texW != app.sim.Nx || app.texH != app.sim.Ny);
-    const bool needUpload = texSizeChanged || app.fieldDirty || app.rgbaBuffer.empty();
-    if (needUpload) {
-        render_field_to_rgba(app.sim, app.rgbaBuffer, app.showPotential, app.view, app.normalizeView);
-        app.fieldDirty = false;
-    }
-    ensure_texture(app, app.sim.Nx, app.sim.Ny);
-    if (needUpload) {
-        glBindTexture(GL_TEXTURE_2D, app.tex);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, app.sim.Nx, app.sim.Ny, GL_RGBA, GL_UNSIGNED_BYTE, app.rgbaBuffer.data());
-        glBindTexture(GL_TEXTURE_2D, 0);
+    ImDrawList* dl = ImGui::GetWindowDrawList();
+    if (gpu_view_active(app)) {
+        if (app.fieldDirty) {
+            app.gpuRenderer.upload(app.sim);
+            app.fieldDirty = false;
+            if (app.recorder.active()) {
+                // Frames still need RGBA bytes, so the CPU renderer runs while recording
+                render_field_to_rgba(app);
+                app.recorder.maybe_capture(app.sim, app.rgbaBuffer.data());
+            }
+        }
+        app.gpuRenderer.draw_image(dl, target.x, target.y, app.showPotential, app.view, app.normalizeView);
+    } else {
+        const bool texSizeChanged = (app.texW != app.sim.Nx || app.texH != app.sim.Ny);
+        const bool needUpload = texSizeChanged || app.fieldDirty || app.rgbaBuffer.empty();
+        if (needUpload) {
+            render_field_to_rgba(app);
+            app.fieldDirty = false;
+            if (app.recorder.active()) app.recorder.maybe_capture(app.sim, app.rgbaBuffer.data());
+        }
+        ensure_texture(app, app.sim.Nx, app.sim.Ny);
+        if (needUpload) {
+            S2D_PROFILE_SCOPE("texture upload");
+            glBindTexture(GL_TEXTURE_2D, app.tex);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, app.sim.Nx, app.sim.Ny, GL_RGBA, GL_UNSIGNED_BYTE, app.rgbaBuffer.data());
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        ImGui::Image((void*)(intptr_t)app.tex, target);
     }
 
-    ImGui::Image((void*)(intptr_t)app.tex, target);
-
-    ImDrawList* dl = ImGui::GetWindowDrawList();
     ImVec2 tl = cur;
     ImVec2 br = cur + target;
 
@@ -1882,7 +2196,10 @@ static void draw_view_content(AppState& app) {
             }
 
             app.dragStart = app.dragEnd;
-            if (rebuildPotential) app.potentialDirtyDrag = true;
+            if (rebuildPotential) {
+                app.sim.update_potential(); // only the moved objects' cells are refilled
+                app.potentialDirtyDrag = true;
+            }
             if (packetMoved) app.selectionDragDirty = true;
             if (rebuildPotential || packetMoved) app.fieldDirty = true;
         } else if (app.dragAction == AppState::DragAction::AdjustBoxEdge) {
@@ -1894,6 +2211,7 @@ static void draw_view_content(AppState& app) {
                 auto& b = app.sim.pfield.boxes[app.dragPrimaryIdx];
                 box_apply_edge_drag(b, app.dragBoxEdge, d.x, d.y);
                 app.dragStart = app.dragEnd;
+                app.sim.update_potential();
                 app.potentialDirtyDrag = true;
                 app.fieldDirty = true;
             }
@@ -2003,7 +2321,7 @@ static void draw_view_content(AppState& app) {
         }
 
         if (app.potentialDirtyDrag) {
-            app.sim.pfield.build(app.sim.V);
+            app.sim.update_potential();
             app.sim.refresh_diagnostics_baseline();
             app.potentialDirtyDrag = false;
             app.fieldDirty = true;
@@ -2094,7 +2412,7 @@ static void draw_object_editors(AppState& app) {
                     rebuild = true;
                 }
                 if (rebuild) {
-                    app.sim.pfield.build(app.sim.V);
+                    app.sim.update_potential();
                     app.sim.refresh_diagnostics_baseline();
                     app.fieldDirty = true;
                 }
@@ -2214,7 +2532,7 @@ static void draw_object_editors(AppState& app) {
                     rebuild = true;
                 }
                 if (rebuild) {
-                    app.sim.pfield.build(app.sim.V);
+                    app.sim.update_potential();
                     app.sim.refresh_diagnostics_baseline();
                     app.fieldDirty = true;
                 }
@@ -2269,6 +2587,50 @@ static void draw_style_editor(AppState& app) {
     ImGui::End();
 }
 
+// Rolling per-stage timings. The timers only run while the window is open.
+static void draw_profiler_window(AppState& app) {
+    sim::profile::set_enabled(app.showProfiler);
+    if (!app.showProfiler)
+        return;
+    app.profilerStats.update();
+    ImGui::SetNextWindowSize(ImVec2(460.0f, 0.0f), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Profiler", &app.showProfiler)) {
+        ImGui::Text("%.0f steps/s   %.1f fps", app.sim.running ? app.simThread.steps_per_second() : 0.0,
+                    ImGui::GetIO().Framerate);
+        ImGui::SameLine();
+        help_marker("ms/s: time spent in a stage per second of wall time, summed over threads "
+                    "(nested stages are included in their parents).");
+        if (ImGui::BeginTable("profiler_stages", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+            ImGui::TableSetupColumn("Stage");
+            ImGui::TableSetupColumn("ms/s");
+            ImGui::TableSetupColumn("ms/call");
+            ImGui::TableSetupColumn("calls/s");
+            ImGui::TableSetupColumn("max ms");
+            ImGui::TableHeadersRow();
+            for (const auto& st : app.profilerStats.stages()) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(st.name.c_str());
+                ImGui::TableSetColumnIndex(1);
+                char load[32];
+                std::snprintf(load, sizeof(load), "%.1f", st.msPerSecond);
+                ImGui::ProgressBar(std::min(1.0f, static_cast<float>(st.msPerSecond / 1000.0)), ImVec2(-1.0f, 0.0f), load);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.3f", st.msPerCall);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%.0f", st.callsPerSecond);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%.3f", st.maxMs);
+            }
+            ImGui::EndTable();
+        }
+        if (app.profilerStats.dropped() > 0) {
+            ImGui::TextDisabled("%llu events dropped", static_cast<unsigned long long>(app.profilerStats.dropped()));
+        }
+    }
+    ImGui::End();
+}
+
 static void draw_preferences_window(AppState& app) {
     if (!app.showPreferences)
         return;
@@ -2415,6 +2777,9 @@ static void draw_top_bar(AppState& app, GLFWwindow* window, float& out_height, I
         if (ImGui::MenuItem("Style Editor...", nullptr, app.showStyleEditor)) {
             app.showStyleEditor = true;
         }
+        if (ImGui::MenuItem("Profiler...", nullptr, app.showProfiler, sim::profile::available())) {
+            app.showProfiler = !app.showProfiler;
+        }
         ImGui::EndMenu();
     }
 
@@ -2541,6 +2906,9 @@ int run_gui(GLFWwindow* window) {
     // Main loop
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
+        if (app.simThread.pull(app.sim)) app.fieldDirty = true;
+        update_eigenstates(app);
+        update_grid_resize(app);
         ImGui_ImplOpenGL2_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -2687,11 +3055,20 @@ int run_gui(GLFWwindow* window) {
 
         draw_style_editor(app);
         draw_preferences_window(app);
+        draw_profiler_window(app);
         draw_toast_overlay(app);
 
-        if (app.sim.running) {
-            app.sim.stepN(std::max(1, app.stepsPerFrame));
-            app.fieldDirty = true;
+        // Hand this frame's edits to the simulation thread, then let it step
+        if (app.eigen.spectral && !app.sim.spectral_ready()) app.eigen.spectral = false;
+        if (app.eigen.spectral && app.sim.running) {
+            // The stepping thread idles; its stale snapshots fail pull()'s psiGeneration check
+            app.simThread.set_running(false);
+            if (app.sim.evolve_spectral(static_cast<std::uint64_t>(std::max(1, app.stepsPerFrame)))) app.fieldDirty = true;
+        } else {
+            app.simThread.sync(app.sim);
+            app.simThread.set_fast(app.fastMode);
+            app.simThread.set_running(app.sim.running);
+            if (app.sim.running && !app.fastMode) app.simThread.request_steps(std::max(1, app.stepsPerFrame));
         }
 
         if (app.sim.diagnostics.unstable && !app.lastUnstable) {
@@ -2719,6 +3096,7 @@ int run_gui(GLFWwindow* window) {
     }
 
     if (app.tex) glDeleteTextures(1, &app.tex);
+    app.gpuRenderer.shutdown();
     ImGui_ImplOpenGL2_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
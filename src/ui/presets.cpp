@@ -16,7 +16,7 @@ static void clear_scene(sim::Simulation& sim) {
 void load_default_twowall_scene(sim::Simulation& sim) {
     clear_scene(sim);
     sim.pfield.boxes.push_back(sim::Box{0.48, 0.0, 0.52, 1.0, 2400.0});
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.25, 0.75, 0.05, 1.0, 10.0, -1.0});
     sim.packets.push_back(sim::Packet{0.25, 0.25, 0.05, 1.0, 42.0, 4.0});
@@ -28,7 +28,7 @@ void load_default_doubleslit_scene(sim::Simulation& sim) {
     sim.pfield.boxes.push_back(sim::Box{0.48, 0.0, 0.52, 0.4, 2400.0});
     sim.pfield.boxes.push_back(sim::Box{0.48, 0.6, 0.52, 1.0, 2400.0});
     sim.pfield.boxes.push_back(sim::Box{0.48, 0.45, 0.52, 0.55, 2400.0});
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.25, 0.5, 0.05, 1.0, 24.0, 0.0});
     sim.reset();
@@ -40,7 +40,7 @@ void load_default_doubleslit2_scene(sim::Simulation& sim) {
     sim.pfield.boxes.push_back(sim::Box{0.48, 0.0, 0.52, 0.4, 100000.0});
     sim.pfield.boxes.push_back(sim::Box{0.48, 0.6, 0.52, 1.0, 100000.0});
     sim.pfield.boxes.push_back(sim::Box{0.48, 0.45, 0.52, 0.55, 100000.0});
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.25, 0.5, 0.05, 1.0, 192.0, 0.0});
     sim.reset();
@@ -48,7 +48,7 @@ void load_default_doubleslit2_scene(sim::Simulation& sim) {
 
 void load_counterpropagating_scene(sim::Simulation& sim) {
     clear_scene(sim);
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.28, 0.5, 0.045, 0.8, 22.0, 0.0});
     sim.packets.push_back(sim::Packet{0.72, 0.5, 0.045, 0.8, -22.0, 0.0});
@@ -62,7 +62,7 @@ void load_waveguide_scene(sim::Simulation& sim) {
     sim.pfield.boxes.push_back(sim::Box{0.0, 0.92, 1.0, 1.0, 2200.0});
     sim.pfield.boxes.push_back(sim::Box{0.36, 0.0, 0.44, 0.38, 2200.0});
     sim.pfield.boxes.push_back(sim::Box{0.56, 0.62, 0.64, 1.0, 2200.0});
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.12, 0.5, 0.05, 1.0, 28.0, 0.0});
     sim.reset();
@@ -76,7 +76,7 @@ void load_trap_scene(sim::Simulation& sim) {
     sim.pfield.boxes.push_back(sim::Box{0.88, 0.1, 0.9, 0.9, 3400.0});
     sim.pfield.boxes.push_back(sim::Box{0.43, 0.43, 0.57, 0.57, 2800.0});
     sim.pfield.wells.push_back(sim::RadialWell{0.5, 0.5, -320.0, 0.08, sim::RadialWell::Profile::SoftCoulomb});
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.3, 0.5, 0.04, 0.7, 12.0, 6.0});
     sim.packets.push_back(sim::Packet{0.7, 0.5, 0.04, 0.7, -12.0, -6.0});
@@ -94,7 +94,7 @@ void load_central_well_scene(sim::Simulation& sim) {
     well.radius = 0.075;
     well.profile = sim::RadialWell::Profile::Gaussian;
     sim.pfield.wells.push_back(well);
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.35, 0.5, 0.035, 0.85, 0.0, 14.0});
     sim.packets.push_back(sim::Packet{0.65, 0.5, 0.035, 0.85, 0.0, -14.0});
@@ -111,7 +111,7 @@ void load_central_well_2_scene(sim::Simulation& sim) {
     well.radius = 0.075;
     well.profile = sim::RadialWell::Profile::InverseSquare;
     sim.pfield.wells.push_back(well);
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.175, 0.5, 0.035, 0.85, 65.0, 25.0});
     sim.reset();
@@ -127,7 +127,7 @@ void load_central_well_3_scene(sim::Simulation& sim) {
     well.radius = 0.18;
     well.profile = sim::RadialWell::Profile::HarmonicOscillator;
     sim.pfield.wells.push_back(well);
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.425, 0.5, 0.035, 0.85, 15.0, 0.0});
     sim.reset();
@@ -154,7 +154,7 @@ void load_well_lattice_scene(sim::Simulation& sim) {
             sim.pfield.wells.push_back(w);
         }
     }
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.08, 0.25, 0.03, 0.85, 60.0, 2.0});
     sim.packets.push_back(sim::Packet{0.08, 0.75, 0.03, 0.85, 55.0, -2.0});
@@ -183,7 +183,7 @@ void load_ring_resonator_scene(sim::Simulation& sim) {
     core.strength = -450.0;
     core.profile = sim::RadialWell::Profile::HarmonicOscillator;
     sim.pfield.wells.push_back(core);
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.35, 0.5, 0.035, 0.8, 0.0, 24.0});
     sim.packets.push_back(sim::Packet{0.65, 0.5, 0.035, 0.8, 0.0, -24.0});
@@ -216,7 +216,7 @@ void load_barrier_gauntlet_scene(sim::Simulation& sim) {
     exit.strength = -520.0;
     exit.profile = sim::RadialWell::Profile::SoftCoulomb;
     sim.pfield.wells.push_back(exit);
-    sim.pfield.build(sim.V);
+    sim.rebuild_potential();
 
     sim.packets.push_back(sim::Packet{0.18, 0.5, 0.035, 0.9, 48.0, 0.0});
     sim.packets.push_back(sim::Packet{0.22, 0.35, 0.025, 0.7, 60.0, 12.0});
@@ -0,0 +1,72 @@
+// Batch sweeps: scene lines applied over the spec's base
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "io/batch.hpp"
+#include "io/scene.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                                    \
+        }                                                                  \
+    } while (0)
+
+static void write_text(const std::string& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+static std::string read_text(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    std::ostringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+int main(int argc, char** argv) {
+    const std::string dir = argc > 1 ? argv[1] : ".";
+    const std::string base = R"({"Nx": 32, "Ny": 32, "dt": 0.001, "steps": 4,
+        "boxes": [{"x0": 0.6, "y0": 0.0, "x1": 0.65, "y1": 1.0, "height": 100}],
+        "packets": [{"cx": 0.3, "cy": 0.5, "sigma": 0.05, "amplitude": 1, "kx": 10, "ky": 0}]})";
+
+    // A line replaces the fields and lists it names and keeps the rest of the base
+    io::Scene s;
+    CHECK(io::parse_scene(base, s));
+    CHECK(io::overlay_scene(R"({"steps": 20})", s));
+    CHECK(s.steps == 20 && s.packets.size() == 1 && s.boxes.size() == 1);
+    CHECK(io::overlay_scene(R"({"boxes": []})", s));
+    CHECK(s.boxes.empty() && s.packets.size() == 1);
+    // A whole scene still replaces every list
+    CHECK(io::parse_scene(R"({"steps": 3})", s));
+    CHECK(s.packets.empty());
+
+    // Spec with scenes over a base and an axis that indexes the base's packets
+    write_text(dir + "/batch_test_base.json", base);
+    write_text(dir + "/batch_test_scenes.jsonl", "{\"steps\": 3}\n{\"steps\": 5, \"boxes\": []}\n");
+    write_text(dir + "/batch_test_spec.json", R"({"base": "batch_test_base.json", "scenes": "batch_test_scenes.jsonl",
+        "sweep": [{"param": "packets[0].kx", "values": [8, 12]}], "output": "batch_test_out.jsonl", "workers": 1})");
+    io::SweepSpec spec;
+    std::string error;
+    CHECK(io::load_sweep_spec(dir + "/batch_test_spec.json", spec, error));
+    CHECK(io::sweep_job_count(spec) == 4);
+
+    io::BatchOptions opts;
+    opts.output = dir + "/batch_test_out.jsonl";
+    CHECK(io::run_batch_cli(dir + "/batch_test_spec.json", opts) == 0);
+    const std::string out = read_text(opts.output);
+    int rows = 0;
+    for (size_t at = out.find("\"mass\": "); at != std::string::npos; at = out.find("\"mass\": ", at + 1)) {
+        ++rows;
+        CHECK(std::stod(out.substr(at + 8)) > 0.0); // the base's packet is there
+    }
+    CHECK(rows == 4);
+    CHECK(out.find("INVALID") == std::string::npos);
+
+    if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
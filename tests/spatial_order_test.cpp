@@ -0,0 +1,91 @@
+// Spatial order: halving h cuts the particle-in-a-box error ~4x with the
+// three-point Laplacian and ~16x with the compact fourth-order one
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <vector>
+
+#include "sim/eigensolver.hpp"
+#include "sim/solver.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                                    \
+        }                                                                  \
+    } while (0)
+
+static const double kPi = 3.14159265358979323846;
+
+// N x N cells with zero values outside, h = 1 / (N + 1): a unit box whose
+// lowest mode sin(pi x) sin(pi y) has E = pi^2 (H = -Laplacian / 2)
+static double exact_energy() { return kPi * kPi; }
+
+// Lowest eigenvalue from the eigensolver (apply_hamiltonian / the compact operator)
+static double eigen_energy(int N, bool compact) {
+    sim::EigenProblem problem;
+    problem.Nx = problem.Ny = N;
+    problem.dx = problem.dy = 1.0 / (N + 1);
+    problem.compact = compact;
+    problem.V.assign(static_cast<size_t>(N) * N, 0.0);
+    sim::EigenSolverOptions options;
+    options.modes = 1;
+    options.maxIter = 2000;
+    options.tol = 1e-10;
+    const sim::EigenResult result = sim::solve_eigenstates(problem, options, nullptr);
+    return result.states.empty() ? 0.0 : result.states[0].energy;
+}
+
+// Energy seen by one CN-ADI step: the box mode is an eigenvector of the discrete
+// operator, so the step only turns its phase, by E dt up to O((E dt)^3).
+static double step_energy(int N, bool compact) {
+    const double h = 1.0 / (N + 1);
+    const double dt = 1e-6;
+    const size_t n = static_cast<size_t>(N) * N;
+    sim::Field psi, mode, V;
+    psi.assign(n);
+    V.assign(n);
+    for (int j = 0; j < N; ++j) {
+        for (int i = 0; i < N; ++i) {
+            psi.set(static_cast<size_t>(j) * N + i, std::sin(kPi * (i + 1) * h) * std::sin(kPi * (j + 1) * h));
+        }
+    }
+    mode = psi;
+    sim::CrankNicolsonADI solver;
+    solver.stencil = compact ? sim::CrankNicolsonADI::Stencil::Compact : sim::CrankNicolsonADI::Stencil::Standard;
+    solver.step(psi, N, N, h, h, dt, V, 1);
+    std::complex<double> overlap(0.0, 0.0);
+    double norm = 0.0;
+    for (size_t k = 0; k < n; ++k) {
+        overlap += mode.re[k] * psi[k];
+        norm += mode.re[k] * mode.re[k];
+    }
+    return -std::arg(overlap / norm) / dt;
+}
+
+// Errors at h = 1/16, 1/32, 1/64 must each fall by about 2^order
+template <typename Energy>
+static void check_order(const char* what, Energy energy, bool compact, double lo, double hi) {
+    double previous = 0.0;
+    for (const int N : {15, 31, 63}) {
+        const double error = std::abs(energy(N, compact) - exact_energy());
+        if (previous > 0.0) {
+            const double ratio = previous / error;
+            std::printf("%s order %d: N=%d error=%.3e ratio=%.2f\n", what, compact ? 4 : 2, N, error, ratio);
+            CHECK(ratio > lo && ratio < hi);
+        }
+        previous = error;
+    }
+}
+
+int main() {
+    check_order("eigensolver", eigen_energy, false, 3.5, 4.5);
+    check_order("eigensolver", eigen_energy, true, 14.0, 18.0);
+    check_order("cn-adi step", step_energy, false, 3.5, 4.5);
+    check_order("cn-adi step", step_energy, true, 14.0, 18.0);
+    if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
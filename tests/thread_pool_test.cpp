@@ -0,0 +1,48 @@
+// ThreadPool: resizing a pool that has already run jobs
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+#include "sim/thread_pool.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                                    \
+        }                                                                  \
+    } while (0)
+
+// Every index of [0, n) is visited exactly once
+static bool covers(sim::ThreadPool& pool, int n) {
+    std::vector<std::atomic<int>> hits(static_cast<size_t>(n));
+    pool.parallel_for(0, n, [&](int b, int e, int) {
+        for (int i = b; i < e; ++i) hits[static_cast<size_t>(i)].fetch_add(1);
+    });
+    for (const auto& h : hits) {
+        if (h.load() != 1) return false;
+    }
+    return true;
+}
+
+int main() {
+    // Workers started by resize() after jobs have run must wait for the next one
+    for (int round = 0; round < 50; ++round) {
+        sim::ThreadPool pool(2);
+        CHECK(covers(pool, 1000));
+        CHECK(covers(pool, 1000));
+        pool.resize(4);
+        CHECK(pool.size() == 4);
+        CHECK(covers(pool, 1000));
+        pool.resize(3);
+        CHECK(covers(pool, 7));
+        pool.resize(1);
+        CHECK(covers(pool, 5));
+        pool.resize(2);
+        CHECK(covers(pool, 1000));
+    }
+    if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}